@@ -24,7 +24,22 @@
 #define ADC_NUM_SAMPLE_CYCLES ADC_SAMPLETIME_7_5
 #endif
 
+// The MCU only has one ADC
+#if defined(ADC_NUM_SIMULTANEOUS) && ADC_NUM_SIMULTANEOUS != 1
+#error "Simultaneous ADC conversion is not supported"
+#endif
+
 // ADC resolution in bits, set by `scripts/make.py`
 #if ADC_RESOLUTION != 12
 #error "Unsupported ADC resolution"
 #endif
+
+//--------------------------------------------------------------------+
+// CRC32 Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(CRC32_SLICES)
+// The CRC unit overrides `crc32_init()` and `crc32_compute()`, so the default
+// implementation does not need any lookup table.
+#define CRC32_SLICES 0
+#endif
@@ -24,6 +24,18 @@
 #define ADC_NUM_SAMPLE_CYCLES ADC_SAMPLETIME_3CYCLES
 #endif
 
+#if !defined(ADC_NUM_SIMULTANEOUS)
+// Number of ADCs converting the inputs simultaneously (1 to 3). The input at
+// position `i` of `ADC_MUX_INPUT_CHANNELS` followed by `ADC_RAW_INPUT_CHANNELS`
+// is converted by ADC `i % ADC_NUM_SIMULTANEOUS + 1`, so it must be an input
+// channel of that ADC. `scripts/make.py` orders the inputs accordingly.
+#define ADC_NUM_SIMULTANEOUS 1
+#endif
+
+#if !(1 <= ADC_NUM_SIMULTANEOUS && ADC_NUM_SIMULTANEOUS <= 3)
+#error "ADC_NUM_SIMULTANEOUS must be between 1 and 3"
+#endif
+
 // ADC resolution in bits, set by `scripts/make.py`
 #if ADC_RESOLUTION == 12
 #define ADC_RESOLUTION_HAL ADC_RESOLUTION_12B
@@ -36,3 +48,13 @@
 #else
 #error "Unsupported ADC resolution"
 #endif
+
+//--------------------------------------------------------------------+
+// CRC32 Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(CRC32_SLICES)
+// The CRC unit overrides `crc32_init()` and `crc32_compute()`, so the default
+// implementation does not need any lookup table.
+#define CRC32_SLICES 0
+#endif
@@ -29,6 +29,22 @@ typedef struct {
   uint8_t keycodes[2];
 } ak_state_null_bind_t;
 
+//--------------------------------------------------------------------+
+// SOCD Group State
+//--------------------------------------------------------------------+
+
+// SOCD group state. Bit i of the masks refers to the i-th member.
+typedef struct {
+  // Members that are pressed
+  uint8_t pressed;
+  // Members that are registered
+  uint8_t registered;
+  // Active keycodes of the members
+  uint8_t keycodes[SOCD_GROUP_MAX_MEMBERS];
+  // Pressed members from the most to the least recently pressed
+  uint8_t order[SOCD_GROUP_MAX_MEMBERS];
+} ak_state_socd_group_t;
+
 //--------------------------------------------------------------------+
 // Dynamic Keystroke State
 //--------------------------------------------------------------------+
@@ -90,6 +106,7 @@ typedef union {
   ak_state_dynamic_keystroke_t dynamic_keystroke;
   ak_state_tap_hold_t tap_hold;
   ak_state_toggle_t toggle;
+  ak_state_socd_group_t socd_group;
 } advanced_key_state_t;
 
 //--------------------------------------------------------------------+
@@ -112,7 +129,7 @@ typedef struct {
   uint8_t type;
   // Key index
   uint8_t key;
-  // Underlying keycode. Only for Null Bind advanced keys
+  // Underlying keycode. Only for Null Bind and SOCD group advanced keys
   uint8_t keycode;
   // Advanced key index associated with the key
   uint8_t ak_index;
@@ -148,6 +165,17 @@ void advanced_key_clear(void);
  */
 void advanced_key_process(const advanced_key_event_t *event);
 
+/**
+ * @brief Resolve the SOCD groups
+ *
+ * This function should be called once per matrix scan after the key events
+ * have been processed. The SOCD group events only update the pressed members,
+ * and each group with events in the scan is resolved once here.
+ *
+ * @return None
+ */
+void advanced_key_resolve(void);
+
 /**
  * @brief Advanced key tick
  *
@@ -17,8 +17,52 @@
 
 #include "common.h"
 #include "eeconfig.h"
+#include "idle.h"
+#include "lib/compress.h"
+#include "noise.h"
 #include "usb_descriptors.h"
 
+//--------------------------------------------------------------------+
+// Command Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(COMMAND_ANALOG_STREAM_MIN_INTERVAL)
+// Minimum interval between analog stream frames in milliseconds
+#define COMMAND_ANALOG_STREAM_MIN_INTERVAL 1
+#endif
+
+#if !defined(COMMAND_ANALOG_STREAM_KEEPALIVE)
+// Number of consecutive analog stream frames without any change after which an
+// empty report is sent anyway, so that the host can tell that the stream is
+// still running
+#define COMMAND_ANALOG_STREAM_KEEPALIVE 100
+#endif
+
+_Static_assert(0 < COMMAND_ANALOG_STREAM_KEEPALIVE &&
+                   COMMAND_ANALOG_STREAM_KEEPALIVE <= 255,
+               "COMMAND_ANALOG_STREAM_KEEPALIVE must be between 1 and 255");
+
+#if !defined(COMMAND_TRACE_CAPTURE_MIN_INTERVAL)
+// Minimum interval between trace capture frames in milliseconds
+#define COMMAND_TRACE_CAPTURE_MIN_INTERVAL 1
+#endif
+
+#if !defined(COMMAND_TRANSACTION_BUFFER_SIZE)
+// Size of the buffer used to stage the writes of a transaction in bytes
+#define COMMAND_TRANSACTION_BUFFER_SIZE 2048
+#endif
+
+#if !defined(COMMAND_TRANSACTION_MAX_WRITES)
+// Maximum number of writes that can be staged in a transaction
+#define COMMAND_TRANSACTION_MAX_WRITES 64
+#endif
+
+#if !defined(COMMAND_TRANSACTION_TIMEOUT)
+// Time in milliseconds without any command after which a transaction that was
+// not committed is discarded, e.g. if the host disconnected
+#define COMMAND_TRANSACTION_TIMEOUT 5000
+#endif
+
 //--------------------------------------------------------------------+
 // Commands
 //--------------------------------------------------------------------+
@@ -40,6 +84,35 @@ typedef enum {
   COMMAND_GET_METADATA,
   COMMAND_GET_SERIAL,
   COMMAND_SAVE_CALIBRATION_THRESHOLD,
+  COMMAND_ANALOG_STREAM,
+  // Start staging the per-profile write commands in RAM. Staged commands are
+  // not acknowledged, and other commands are processed immediately, except for
+  // `COMMAND_FACTORY_RESET`, `COMMAND_RESET_PROFILE` and
+  // `COMMAND_DUPLICATE_PROFILE` which are rejected. The transaction is
+  // discarded after `COMMAND_TRANSACTION_TIMEOUT` milliseconds without any
+  // command.
+  COMMAND_BEGIN_TRANSACTION,
+  // Apply the staged write commands at once
+  COMMAND_COMMIT_TRANSACTION,
+  COMMAND_GET_SWITCH_MODELS,
+  COMMAND_SET_SWITCH_MODELS,
+  // Stream the raw ADC values of every key as a trace. See `lib/trace.h` for
+  // the format of the byte stream, which starts with the trace header.
+  COMMAND_TRACE_CAPTURE,
+  COMMAND_GET_WEAR_STATS,
+  // Get the statistics of the low-power scan mode. Any command restores the
+  // full scan rate.
+  COMMAND_GET_IDLE_STATS,
+  // Start or stop a noise measurement. See `noise.h`.
+  COMMAND_NOISE_DIAGNOSTICS,
+  COMMAND_GET_NOISE_STATS,
+  COMMAND_GET_CALIBRATION_EPSILON,
+  COMMAND_SET_CALIBRATION_EPSILON,
+  // Get the auto-tune state of the keys, including the effective actuation
+  // configuration. The auto-tune is enabled with `COMMAND_SET_OPTIONS`.
+  COMMAND_GET_AUTO_TUNE,
+  // Discard the staged write commands of the transaction
+  COMMAND_ABORT_TRANSACTION,
 
   COMMAND_GET_KEYMAP = 128,
   COMMAND_SET_KEYMAP,
@@ -53,10 +126,40 @@ typedef enum {
   COMMAND_SET_GAMEPAD_BUTTONS,
   COMMAND_GET_GAMEPAD_OPTIONS,
   COMMAND_SET_GAMEPAD_OPTIONS,
+  // Export the whole profile as a compressed blob. The blob starts with a
+  // `command_profile_blob_header_t` and is read in chunks by increasing offset.
+  COMMAND_EXPORT_PROFILE,
+  // Import a whole profile from a compressed blob in the same format as
+  // `COMMAND_EXPORT_PROFILE`. The chunks must be sent in order, and the profile
+  // is applied once the last chunk is received. In a transaction, the chunks
+  // are staged like the write commands.
+  COMMAND_IMPORT_PROFILE,
+  // Same as `COMMAND_GET_ACTUATION_MAP` and `COMMAND_SET_ACTUATION_MAP`, but
+  // with 16-bit distances. The lower 8 bits are only used if the firmware is
+  // built with `DISTANCE_HIGH_RESOLUTION`. `COMMAND_SET_ACTUATION_MAP` clears
+  // the lower 8 bits of the written keys.
+  COMMAND_GET_ACTUATION_MAP_WIDE,
+  COMMAND_SET_ACTUATION_MAP_WIDE,
 
   COMMAND_UNKNOWN = 255,
 } command_id_t;
 
+//---------------------------------------------------------------------+
+// Profile Blob
+//---------------------------------------------------------------------+
+
+typedef struct __attribute__((packed)) {
+  // Length of the compressed profile following the header in bytes
+  uint16_t len;
+  // CRC32 of the uncompressed profile, as computed by `crc32_compute()`
+  uint32_t crc;
+} command_profile_blob_header_t;
+
+// Maximum size of a profile blob in bytes
+#define COMMAND_PROFILE_BLOB_SIZE                                              \
+  (sizeof(command_profile_blob_header_t) +                                     \
+   COMPRESS_BOUND(sizeof(eeconfig_profile_t)))
+
 //---------------------------------------------------------------------+
 // Input Report Structures
 //---------------------------------------------------------------------+
@@ -67,6 +170,16 @@ typedef struct __attribute__((packed)) {
 
 typedef eeconfig_calibration_t command_in_calibration_t;
 
+typedef struct __attribute__((packed)) {
+  // Interval between frames in milliseconds. If zero, the stream is stopped.
+  uint8_t interval;
+  // Minimum change in the filtered ADC value for a key to be included in the
+  // next frame. If zero, any change is reported.
+  uint8_t threshold;
+  // Bitmap of the keys to subscribe to
+  uint8_t keys[M_DIV_CEIL(NUM_KEYS, 8)];
+} command_in_analog_stream_t;
+
 typedef eeconfig_options_t command_in_options_t;
 
 typedef struct __attribute__((packed)) {
@@ -82,6 +195,42 @@ typedef struct __attribute__((packed)) {
   uint32_t offset;
 } command_in_metadata_t;
 
+typedef struct __attribute__((packed)) {
+  uint8_t offset;
+  uint8_t len;
+  uint8_t switch_models[61];
+} command_in_switch_models_t;
+
+typedef struct __attribute__((packed)) {
+  // Interval between frames in milliseconds. If zero, the capture is stopped.
+  // A frame is only captured after the previous one is completely sent, so
+  // the actual interval may be longer.
+  uint8_t interval;
+} command_in_trace_capture_t;
+
+typedef struct __attribute__((packed)) {
+  // Duration of the measurement in milliseconds. If zero, the measurement in
+  // progress is stopped.
+  uint16_t duration;
+  // Whether to save the calibration epsilons derived from the measurement when
+  // it completes
+  bool save;
+} command_in_noise_diagnostics_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t offset;
+} command_in_noise_stats_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t offset;
+  uint8_t len;
+  uint8_t calibration_epsilon[61];
+} command_in_calibration_epsilon_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t offset;
+} command_in_auto_tune_t;
+
 typedef struct __attribute__((packed)) {
   uint8_t profile;
   uint8_t layer;
@@ -121,16 +270,42 @@ typedef struct __attribute__((packed)) {
   gamepad_options_t gamepad_options;
 } command_in_gamepad_options_t;
 
+typedef struct __attribute__((packed)) {
+  uint8_t profile;
+  uint16_t offset;
+} command_in_export_profile_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t profile;
+  uint16_t offset;
+  uint8_t len;
+  uint8_t data[59];
+} command_in_import_profile_t;
+
+typedef struct __attribute__((packed)) {
+  uint8_t profile;
+  uint8_t offset;
+  uint8_t len;
+  actuation_wide_t actuation_map[8];
+} command_in_actuation_map_wide_t;
+
 // Command input buffer type
 typedef struct __attribute__((packed)) {
   uint8_t command_id;
   union __attribute__((packed)) {
     command_in_analog_info_t analog_info;
     command_in_calibration_t calibration;
+    command_in_analog_stream_t analog_stream;
     command_in_options_t options;
     command_in_reset_profile_t reset_profile;
     command_in_duplicate_profile_t duplicate_profile;
     command_in_metadata_t metadata;
+    command_in_switch_models_t switch_models;
+    command_in_trace_capture_t trace_capture;
+    command_in_noise_diagnostics_t noise_diagnostics;
+    command_in_noise_stats_t noise_stats;
+    command_in_calibration_epsilon_t calibration_epsilon;
+    command_in_auto_tune_t auto_tune;
 
     command_in_keymap_t keymap;
     command_in_actuation_map_t actuation_map;
@@ -138,6 +313,9 @@ typedef struct __attribute__((packed)) {
     command_in_tick_rate_t tick_rate;
     command_in_gamepad_buttons_t gamepad_buttons;
     command_in_gamepad_options_t gamepad_options;
+    command_in_export_profile_t export_profile;
+    command_in_import_profile_t import_profile;
+    command_in_actuation_map_wide_t actuation_map_wide;
   };
 } command_in_buffer_t;
 
@@ -158,6 +336,62 @@ typedef struct __attribute__((packed)) {
   uint8_t metadata[59];
 } command_out_metadata_t;
 
+typedef struct __attribute__((packed)) {
+  uint8_t key;
+  uint16_t adc_value;
+  uint8_t distance;
+} command_out_analog_stream_entry_t;
+
+// Analog stream report. A frame only contains the subscribed keys whose values
+// have changed since they were last reported, and may span multiple reports.
+// Frames without any change are not sent, except for an empty report every
+// `COMMAND_ANALOG_STREAM_KEEPALIVE` of them.
+//
+// The reply to `COMMAND_ANALOG_STREAM` shares the command ID and the IN
+// endpoint with the stream, but is all zeros after the command ID. A report
+// of the stream is either full or the last of its frame, so it never has both
+// `len` and `last` zero like the reply.
+typedef struct __attribute__((packed)) {
+  // Frame counter, incremented after the last report of each frame and after
+  // each frame that is not sent
+  uint8_t frame;
+  // Number of entries in this report, always the maximum unless `last`
+  uint8_t len;
+  // Whether this is the last report of the frame
+  bool last;
+  command_out_analog_stream_entry_t entries[15];
+} command_out_analog_stream_t;
+
+// Trace capture report. The data of the reports form a continuous byte stream.
+// The reply to `COMMAND_TRACE_CAPTURE` has the same command ID but a zero
+// `len`, which the reports never have.
+typedef struct __attribute__((packed)) {
+  // Report counter to detect lost reports
+  uint8_t seq;
+  // Number of bytes in this report, at least 1
+  uint8_t len;
+  uint8_t data[61];
+} command_out_trace_capture_t;
+
+typedef struct __attribute__((packed)) {
+  wl_stats_t stats;
+  // Ratio of `flash_bytes` to `user_bytes` in hundredths, or zero if no byte
+  // has been committed
+  uint32_t write_amplification;
+} command_out_wear_stats_t;
+
+typedef struct __attribute__((packed)) {
+  // Whether a measurement is in progress
+  bool active;
+  noise_stats_t stats[2];
+} command_out_noise_stats_t;
+
+typedef struct __attribute__((packed)) {
+  // Total length of the blob in bytes
+  uint16_t len;
+  uint8_t data[61];
+} command_out_export_profile_t;
+
 // Command output buffer type
 typedef struct __attribute__((packed)) {
   uint8_t command_id;
@@ -176,6 +410,22 @@ typedef struct __attribute__((packed)) {
     command_out_metadata_t metadata;
     // For `COMMAND_GET_SERIAL`
     char serial[32];
+    // Pushed by the analog stream after `COMMAND_ANALOG_STREAM`
+    command_out_analog_stream_t analog_stream;
+    // For `COMMAND_GET_SWITCH_MODELS`
+    uint8_t switch_models[63];
+    // Pushed by the trace capture after `COMMAND_TRACE_CAPTURE`
+    command_out_trace_capture_t trace_capture;
+    // For `COMMAND_GET_WEAR_STATS`
+    command_out_wear_stats_t wear_stats;
+    // For `COMMAND_GET_IDLE_STATS`
+    idle_stats_t idle_stats;
+    // For `COMMAND_GET_NOISE_STATS`
+    command_out_noise_stats_t noise_stats;
+    // For `COMMAND_GET_CALIBRATION_EPSILON`
+    uint8_t calibration_epsilon[63];
+    // For `COMMAND_GET_AUTO_TUNE`
+    noise_tune_t auto_tune[5];
 
     // For `COMMAND_GET_KEYMAP`
     uint8_t keymap[63];
@@ -189,6 +439,10 @@ typedef struct __attribute__((packed)) {
     uint8_t gamepad_buttons[63];
     // For `COMMAND_GET_GAMEPAD_OPTIONS`
     gamepad_options_t gamepad_options;
+    // For `COMMAND_EXPORT_PROFILE`
+    command_out_export_profile_t export_profile;
+    // For `COMMAND_GET_ACTUATION_MAP_WIDE`
+    actuation_wide_t actuation_map_wide[9];
   };
 } command_out_buffer_t;
 
@@ -214,3 +468,13 @@ void command_init(void);
  * @return None
  */
 void command_process(const uint8_t *buf);
+
+/**
+ * @brief Command task
+ *
+ * This function pushes the analog stream frames to the raw HID interface, if
+ * the stream is enabled.
+ *
+ * @return None
+ */
+void command_task(void);
@@ -93,6 +93,22 @@ _Static_assert(1 <= NUM_ADVANCED_KEYS && NUM_ADVANCED_KEYS <= 64,
 // Keyboard Types
 //--------------------------------------------------------------------+
 
+#if defined(DISTANCE_HIGH_RESOLUTION)
+// Key travel distance in the range [0, 65535]. The upper 8 bits are the same as
+// the 8-bit distance, and the lower 8 bits are its fractional part.
+typedef uint16_t distance_t;
+// Number of fractional bits of the key travel distance
+#define DISTANCE_FRACTION_BITS 8
+#else
+// Key travel distance in the range [0, 255]
+typedef uint8_t distance_t;
+// Number of fractional bits of the key travel distance
+#define DISTANCE_FRACTION_BITS 0
+#endif
+
+// Maximum key travel distance
+#define DISTANCE_MAX ((distance_t)((256u << DISTANCE_FRACTION_BITS) - 1))
+
 // Actuation configuration for a key. If `rt_down` is non-zero, Rapid Trigger is
 // enabled. If `rt_up` is non-zero, both `rt_down` and `rt_up` are used to
 // configure the Rapid Trigger press and release sensitivity, respectively.
@@ -107,6 +123,32 @@ typedef struct __attribute__((packed)) {
   bool continuous;
 } actuation_t;
 
+// Fractional part of the actuation configuration for a key, in units of 1/256
+// of the 8-bit distance. It is only used if `DISTANCE_HIGH_RESOLUTION` is
+// defined, in which case it extends each field of `actuation_t` to 16 bits.
+typedef struct __attribute__((packed)) {
+  // Fractional part of the actuation point
+  uint8_t actuation_point;
+  // Fractional part of the Rapid Trigger press sensitivity
+  uint8_t rt_down;
+  // Fractional part of the Rapid Trigger release sensitivity
+  uint8_t rt_up;
+} actuation_fine_t;
+
+// Actuation configuration for a key with 16-bit distances, combining
+// `actuation_t` and `actuation_fine_t`. The upper 8 bits of each distance are
+// stored in `actuation_t` and the lower 8 bits in `actuation_fine_t`.
+typedef struct __attribute__((packed)) {
+  // Actuation point (0-65535)
+  uint16_t actuation_point;
+  // Rapid Trigger press sensitivity (0-65535)
+  uint16_t rt_down;
+  // Rapid Trigger release sensitivity (0-65535)
+  uint16_t rt_up;
+  // Whether Continuous Rapid Trigger is enabled
+  bool continuous;
+} actuation_wide_t;
+
 // Advanced key types
 typedef enum {
   AK_TYPE_NONE = 0,
@@ -114,6 +156,7 @@ typedef enum {
   AK_TYPE_DYNAMIC_KEYSTROKE,
   AK_TYPE_TAP_HOLD,
   AK_TYPE_TOGGLE,
+  AK_TYPE_SOCD_GROUP,
   AK_TYPE_COUNT,
 } ak_type_t;
 
@@ -141,6 +184,29 @@ typedef struct __attribute__((packed)) {
   uint8_t bottom_out_point;
 } null_bind_t;
 
+// Maximum number of keys in an SOCD group, including the primary key
+#define SOCD_GROUP_MAX_MEMBERS 8
+
+// SOCD group configuration. The members are the primary key of the advanced
+// key followed by the keys in `keys`. The members are split into two axes, and
+// the Null Bind behavior is applied to the pressed members of each axis
+// independently, e.g., W and S on one axis and A and D on the other for
+// diagonal movements.
+typedef struct __attribute__((packed)) {
+  // Other members of the group. Unused entries are set to 255.
+  uint8_t keys[SOCD_GROUP_MAX_MEMBERS - 1];
+  // Null Bind behavior except for `NB_BEHAVIOR_SECONDARY`. The primary
+  // behavior prioritizes the members in order.
+  uint8_t behavior : 4;
+  // Number of members on the first axis. If zero, all the members are on the
+  // first axis.
+  uint8_t split : 4;
+  // Bottom-out point (0-255). If non-zero, all the pressed members of an axis
+  // will be registered if all of them are pressed past this point, regardless
+  // of the behavior.
+  uint8_t bottom_out_point;
+} socd_group_t;
+
 // Dynamic Keystroke actions for each part of the keystroke
 typedef enum {
   DKS_ACTION_HOLD = 0,
@@ -191,9 +257,13 @@ typedef struct __attribute__((packed)) {
     dynamic_keystroke_t dynamic_keystroke;
     tap_hold_t tap_hold;
     toggle_t toggle;
+    socd_group_t socd_group;
   };
 } advanced_key_t;
 
+_Static_assert(sizeof(advanced_key_t) == 12,
+               "advanced_key_t must be 12 bytes");
+
 // Gamepad buttons
 typedef enum {
   GP_BUTTON_NONE = 0,
@@ -17,14 +17,34 @@
 
 #include "common.h"
 
+//--------------------------------------------------------------------+
+// CRC32 Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(CRC32_SLICES)
+// Number of 1 KiB lookup tables used by the default implementation. If zero,
+// the CRC32 is computed bit by bit without any table. The drivers with a CRC
+// unit set it to zero since they override the default implementation, so the
+// tables are only used by the host builds and drivers without a CRC unit.
+#define CRC32_SLICES 1
+#endif
+
+_Static_assert(CRC32_SLICES == 0 || CRC32_SLICES == 1 || CRC32_SLICES == 4 ||
+                   CRC32_SLICES == 8,
+               "CRC32_SLICES must be 0, 1, 4, or 8.");
+
 //--------------------------------------------------------------------+
 // CRC32 API
 //--------------------------------------------------------------------+
 
+// Callback invoked with the result of an asynchronous CRC32 computation
+typedef void (*crc32_callback_t)(uint32_t crc);
+
 /**
  * @brief Initialize the CRC32 module
  *
- * A default implementation is provided but can be overriden.
+ * A default implementation, which generates the lookup tables of the default
+ * `crc32_compute()`, is provided but can be overridden for hardware
  * acceleration.
  *
  * @return None
@@ -45,3 +65,24 @@ void crc32_init(void);
  * @return CRC32 value
  */
 uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc);
+
+/**
+ * @brief Compute the CRC32 of a buffer asynchronously
+ *
+ * A default implementation, which computes the CRC32 synchronously and invokes
+ * the callback before returning, is provided but can be overridden to offload
+ * the computation to DMA. The result must be the same as `crc32_compute()`.
+ * Only one computation can be in progress at a time, the buffer must not be
+ * modified until the callback is invoked, and the callback may be invoked
+ * from an interrupt handler.
+ *
+ * @param buf Pointer to the buffer
+ * @param len Length of the buffer in bytes
+ * @param crc Initial CRC value
+ * @param callback Callback invoked with the CRC32 value
+ *
+ * @return true if the computation was started, false if another computation
+ * is in progress
+ */
+bool crc32_compute_async(const void *buf, uint32_t len, uint32_t crc,
+                         crc32_callback_t callback);
@@ -24,13 +24,25 @@
 // Distance lookup table size
 #define DISTANCE_LUT_SIZE 1024
 
+#if defined(DISTANCE_NUM_LUTS)
+// Distance lookup tables of each switch model, generated by `scripts/make.py`
+// from the `distance` configuration in `keyboard.json`
+#include "distance_luts.h"
+#else
+#if defined(DISTANCE_HIGH_RESOLUTION)
+#error "DISTANCE_HIGH_RESOLUTION requires the generated distance lookup tables"
+#endif
+
+// Number of distance lookup tables
+#define DISTANCE_NUM_LUTS 1
+
 // Distance lookup table obtained from running `tools/distance_lut.py`
 // The table represents 255 * log(1 + ax) / log(1 + (LUT_SIZE - 1)x), where x is
 // the ADC values normalized to the range [0, LUT_SIZE - 1] and a is a constant
 // obtained through fitting the curve to the samples from GEON Raw HE switches
 // and OH49E-S Hall sensors. The table values are board-specific and should be
 // recalculated for each board. See https://www.desmos.com/calculator/nzl6twp6ui
-static const uint8_t distance_lut[] = {
+static const uint8_t distance_luts[][DISTANCE_LUT_SIZE] = {{
     0,   1,   2,   3,   4,   5,   6,   6,   7,   8,   9,   10,  11,  12,  12,
     13,  14,  15,  16,  17,  17,  18,  19,  20,  21,  21,  22,  23,  24,  24,
     25,  26,  27,  27,  28,  29,  30,  30,  31,  32,  32,  33,  34,  35,  35,
@@ -100,24 +112,26 @@ static const uint8_t distance_lut[] = {
     252, 252, 252, 252, 252, 252, 252, 252, 252, 252, 253, 253, 253, 253, 253,
     253, 253, 253, 253, 254, 254, 254, 254, 254, 254, 254, 254, 254, 254, 255,
     255, 255, 255, 255,
-};
+}};
+#endif
 
-_Static_assert(M_ARRAY_SIZE(distance_lut) == DISTANCE_LUT_SIZE,
-               "Invalid distance lookup table size");
+_Static_assert(M_ARRAY_SIZE(distance_luts) == DISTANCE_NUM_LUTS,
+               "Invalid number of distance lookup tables");
 
 /**
- * @brief Convert ADC value to distance in the range [0, 255]
+ * @brief Convert ADC value to distance in the range [0, DISTANCE_MAX]
  *
  * This function assumes that the following invariant holds:
  *
+ * @param lut Distance lookup table index
  * @param adc ADC value
  * @param adc_rest_value ADC value when the key is fully released
  * @param adc_bottom_out_value ADC value when the key is fully pressed
  *
- * @return Distance in the range [0, 255]
+ * @return Distance in the range [0, DISTANCE_MAX]
  */
-__attribute__((always_inline)) static inline uint8_t
-adc_to_distance(uint16_t adc, uint16_t adc_rest_value,
+__attribute__((always_inline)) static inline distance_t
+adc_to_distance(uint8_t lut, uint16_t adc, uint16_t adc_rest_value,
                 uint16_t adc_bottom_out_value) {
   // Handle edge cases. This is necessary since we no longer update the rest
   // value during the runtime and the bottom-out value can be lower than the
@@ -125,12 +139,12 @@ adc_to_distance(uint16_t adc, uint16_t adc_rest_value,
   if ((adc <= adc_rest_value) | (adc_rest_value >= adc_bottom_out_value))
     return 0;
   if (adc >= adc_bottom_out_value)
-    return 255;
+    return DISTANCE_MAX;
 
   // Normalize ADC value to the range [0, LUT_SIZE - 1]
   const uint32_t normalized = (uint32_t)(adc - adc_rest_value) *
                               (uint32_t)(DISTANCE_LUT_SIZE - 1) /
                               (uint32_t)(adc_bottom_out_value - adc_rest_value);
 
-  return distance_lut[normalized];
+  return distance_luts[lut][normalized];
 }
@@ -51,8 +51,11 @@ typedef union __attribute__((packed)) {
     // Whether 8kHz polling rate is enabled. Only applicable if USB HS is
     // enabled. If disabled, the 1kHz polling rate is used instead.
     bool high_polling_rate_enabled : 1;
+    // Whether the actuation point and the Rapid Trigger sensitivities of each
+    // key are raised above the noise of the key at runtime. See `noise.h`.
+    bool auto_tune_enabled : 1;
     // Reserved bits for future use
-    uint16_t reserved : 13;
+    uint16_t reserved : 12;
   };
   uint16_t raw;
 } eeconfig_options_t;
@@ -64,6 +67,8 @@ _Static_assert(sizeof(eeconfig_options_t) == sizeof(uint16_t),
 typedef struct __attribute__((packed)) {
   uint8_t keymap[NUM_LAYERS][NUM_KEYS];
   actuation_t actuation_map[NUM_KEYS];
+  // Fractional part of `actuation_map`, only used with high-resolution distance
+  actuation_fine_t actuation_fine_map[NUM_KEYS];
   advanced_key_t advanced_keys[NUM_ADVANCED_KEYS];
   uint8_t gamepad_buttons[NUM_KEYS];
   gamepad_options_t gamepad_options;
@@ -73,12 +78,12 @@ typedef struct __attribute__((packed)) {
 // Persistent configuration version. The size of the configuration must be
 // non-decreasing, so that the migration can assume that the new version is at
 // least as large as the previous version.
-#define EECONFIG_VERSION 0x0104
+#define EECONFIG_VERSION 0x0108
 
 // Keyboard configuration
 // Whenever there is a change in the configuration, `EECONFIG_VERSION` must be
-// bumped. Make sure to update `eeconfig_reset()`, and add a migration function
-// in `migration.c`.
+// bumped. Make sure to update `eeconfig_reset()`, and add the migration
+// operations in `migration.c`.
 typedef struct __attribute__((packed)) {
   // Global configurations
   // Magic number to identify the start of the configuration
@@ -97,6 +102,12 @@ typedef struct __attribute__((packed)) {
   uint8_t current_profile;
   // Last non-default profile index, used for profile swapping
   uint8_t last_non_default_profile;
+  // Switch model of each key, used as the index of its distance lookup table
+  uint8_t switch_models[NUM_KEYS];
+  // Minimum change in the filtered ADC value of each key to update its
+  // calibration values, e.g. as measured by the noise diagnostics. If zero,
+  // `MATRIX_CALIBRATION_EPSILON` is used instead.
+  uint8_t calibration_epsilon[NUM_KEYS];
   // End of global configurations
 
   // Profiles
@@ -106,13 +117,61 @@ typedef struct __attribute__((packed)) {
   uint32_t magic_end;
 } eeconfig_t;
 
+#if defined(EECONFIG_COMPACT_PROFILES)
+// With compact profiles, `eeconfig_t` describes the logical layout of the
+// configuration. The global configurations are stored as they are, but each
+// profile is stored as a compressed delta against its default profile in a
+// slot of `EECONFIG_PROFILE_DELTA_SIZE` bytes, followed by `magic_end`. Only
+// the current profile is expanded in RAM, so `profiles` and `magic_end` must
+// not be accessed through `eeconfig`.
+
+#if defined(EECONFIG_PROFILE_DELTA_SIZE)
+// Size of the slot of each profile for a global configuration of the given
+// size, e.g. in a previous version
+#define EECONFIG_PROFILE_DELTA_SIZE_OF(global_config_size)                     \
+  EECONFIG_PROFILE_DELTA_SIZE
+#else
+// Size of the slot of each profile in bytes. By default, the virtual storage
+// after the global configurations is divided equally between the profiles.
+#define EECONFIG_PROFILE_DELTA_SIZE_OF(global_config_size)                     \
+  ((WL_VIRTUAL_SIZE - (global_config_size) - sizeof(uint32_t)) / NUM_PROFILES)
+#define EECONFIG_PROFILE_DELTA_SIZE                                            \
+  EECONFIG_PROFILE_DELTA_SIZE_OF(offsetof(eeconfig_t, profiles))
+#endif
+
+// Compressed delta of a profile against its default profile
+typedef struct __attribute__((packed)) {
+  // Length of the compressed delta in bytes
+  uint16_t len;
+  // Compressed XOR of the profile and its default profile
+  uint8_t data[EECONFIG_PROFILE_DELTA_SIZE - sizeof(uint16_t)];
+} eeconfig_profile_delta_t;
+
+// Address of the slot of a profile in the virtual storage
+#define EECONFIG_PROFILE_DELTA_ADDR(profile)                                   \
+  (offsetof(eeconfig_t, profiles) + (profile) * EECONFIG_PROFILE_DELTA_SIZE)
+
+_Static_assert(EECONFIG_PROFILE_DELTA_SIZE >= 64,
+               "Profile delta size must be at least 64 bytes.");
+_Static_assert(
+    EECONFIG_PROFILE_DELTA_ADDR(NUM_PROFILES) + sizeof(uint32_t) <=
+        WL_VIRTUAL_SIZE,
+    "Keyboard configuration size must be at most the virtual storage size.");
+#else
 _Static_assert(
     sizeof(eeconfig_t) <= WL_VIRTUAL_SIZE,
     "Keyboard configuration size must be at most the virtual storage size.");
+#endif
 
 extern const eeconfig_t *eeconfig;
 
+#if defined(EECONFIG_COMPACT_PROFILES)
+extern const eeconfig_profile_t *const eeconfig_current_profile;
+
+#define CURRENT_PROFILE (*eeconfig_current_profile)
+#else
 #define CURRENT_PROFILE (eeconfig->profiles[eeconfig->current_profile])
+#endif
 
 //--------------------------------------------------------------------+
 // Default Keyboard Configuration
@@ -128,6 +187,7 @@ extern const eeconfig_t *eeconfig;
   {                                                                            \
       .xinput_enabled = false,                                                 \
       .high_polling_rate_enabled = true,                                       \
+      .auto_tune_enabled = false,                                              \
   }
 #endif
 
@@ -150,6 +210,11 @@ extern const eeconfig_t *eeconfig;
   }
 #endif
 
+#if !defined(DEFAULT_SWITCH_MODELS)
+// Default switch model of each key
+#define DEFAULT_SWITCH_MODELS {0}
+#endif
+
 #if !defined(DEFAULT_TICK_RATE)
 // Default tick rate
 #define DEFAULT_TICK_RATE 30
@@ -182,6 +247,89 @@ bool eeconfig_reset(void);
  */
 bool eeconfig_reset_profile(uint8_t profile);
 
+/**
+ * @brief Read from the persistent configuration
+ *
+ * @param addr Offset in `eeconfig_t` to read from
+ * @param buf Buffer to read into
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_read(uint32_t addr, void *buf, uint32_t len);
+
+/**
+ * @brief Write to the persistent configuration
+ *
+ * @param addr Offset in `eeconfig_t` to write to
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_write(uint32_t addr, const void *buf, uint32_t len);
+
+/**
+ * @brief Write multiple regions to the persistent configuration
+ *
+ * The writes are applied atomically, except with `EECONFIG_COMPACT_PROFILES`
+ * where each write is applied atomically.
+ *
+ * @param writes Array of writes with offsets in `eeconfig_t`
+ * @param num_writes Number of writes
+ *
+ * @return true if successful, false otherwise
+ */
+bool eeconfig_write_batch(const wl_write_t *writes, uint32_t num_writes);
+
+#if defined(EECONFIG_COMPACT_PROFILES)
+/**
+ * @brief Get the default value of a profile
+ *
+ * @param profile Profile index
+ * @param dst Buffer to write the profile into
+ *
+ * @return None
+ */
+void eeconfig_get_default_profile(uint8_t profile, eeconfig_profile_t *dst);
+
+/**
+ * @brief Store a profile as its compressed delta
+ *
+ * The current profile is not updated.
+ *
+ * @param profile Profile index
+ * @param buf Expanded profile, which is restored before returning
+ *
+ * @return true if successful, false if the delta does not fit in the slot
+ */
+bool eeconfig_store_profile(uint8_t profile, eeconfig_profile_t *buf);
+#endif
+
+/**
+ * @brief Read a field from the persistent configuration
+ *
+ * @param field Field to read from
+ * @param buf Buffer to read into
+ *
+ * @return true if successful, false otherwise
+ */
+#define EECONFIG_READ(field, buf)                                              \
+  eeconfig_read(offsetof(eeconfig_t, field), buf,                              \
+                sizeof(((eeconfig_t *)0)->field))
+
+/**
+ * @brief Read a field from the persistent configuration
+ *
+ * @param field Field to read from
+ * @param buf Buffer to read into
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+#define EECONFIG_READ_N(field, buf, len)                                       \
+  eeconfig_read(offsetof(eeconfig_t, field), buf, len)
+
 /**
  * @brief Write a value to a field in the persistent configuration
  *
@@ -191,8 +339,8 @@ bool eeconfig_reset_profile(uint8_t profile);
  * @return true if successful, false otherwise
  */
 #define EECONFIG_WRITE(field, value)                                           \
-  wear_leveling_write(offsetof(eeconfig_t, field), value,                      \
-                      sizeof(((eeconfig_t *)0)->field))
+  eeconfig_write(offsetof(eeconfig_t, field), value,                           \
+                 sizeof(((eeconfig_t *)0)->field))
 
 /**
  * @brief Write a value to a field in the persistent configuration
@@ -204,4 +352,4 @@ bool eeconfig_reset_profile(uint8_t profile);
  * @return true if successful, false otherwise
  */
 #define EECONFIG_WRITE_N(field, value, len)                                    \
-  wear_leveling_write(offsetof(eeconfig_t, field), value, len)
+  eeconfig_write(offsetof(eeconfig_t, field), value, len)
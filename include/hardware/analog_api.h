@@ -74,6 +74,13 @@ _Static_assert((F_CPU / 1000000) * ADC_SAMPLE_DELAY < 65536,
 #endif
 #endif
 
+// If `ADC_DMA_FRAME` is defined, the DMA writes the conversions of each
+// multiplexer channel directly into its slice of a frame of all the channels,
+// and the frame is stored in the ADC values of the keys once per sweep.
+#if defined(ADC_DMA_FRAME) && ADC_NUM_MUX_INPUTS == 0
+#error "ADC_DMA_FRAME requires multiplexer inputs"
+#endif
+
 #if !(0 < (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS) &&                         \
       (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS) <= ADC_NUM_CHANNELS)
 #error "Invalid number of ADC inputs"
@@ -113,3 +120,26 @@ void analog_task(void);
  * @return Raw ADC value
  */
 uint16_t analog_read(uint8_t key);
+
+/**
+ * @brief Enable or disable the continuous conversion loop
+ *
+ * When disabled, the driver stops after the current sweep over all the keys
+ * has completed, and a new sweep is only started by `analog_start_sweep()`.
+ * Enabling it again resumes the conversion loop if it is stopped.
+ *
+ * @param continuous true to scan continuously, false to scan on demand
+ *
+ * @return None
+ */
+void analog_set_continuous(bool continuous);
+
+/**
+ * @brief Start a single sweep over all the keys
+ *
+ * This function has no effect if a sweep is already in progress or if the
+ * conversion loop is continuous.
+ *
+ * @return None
+ */
+void analog_start_sweep(void);
@@ -80,3 +80,13 @@ uint32_t board_serial(char *buf);
  * @return Current cycle count
  */
 uint32_t board_cycle_count(void);
+
+/**
+ * @brief Wait for the next interrupt
+ *
+ * This function should put the CPU in a low-power state until an interrupt
+ * occurs. The system tick must wake the CPU at least every millisecond.
+ *
+ * @return None
+ */
+void board_idle(void);
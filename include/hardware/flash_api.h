@@ -57,6 +57,18 @@ bool flash_erase(uint32_t sector);
  */
 bool flash_read(uint32_t addr, void *buf, uint32_t len);
 
+/**
+ * @brief Get a pointer to read data in place from the memory-mapped flash
+ *
+ * The data may change if the flash is written or erased.
+ *
+ * @param addr Address to read from
+ * @param len Length of the data in words (4 bytes)
+ *
+ * @return Pointer to the data, or NULL if the range is invalid
+ */
+const void *flash_map(uint32_t addr, uint32_t len);
+
 /**
  * @brief Write data to flash
  *
@@ -0,0 +1,108 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Idle Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(IDLE_TIMEOUT)
+// Inactivity timeout in milliseconds before entering the low-power scan mode.
+// Set to 0 to always scan at full rate.
+#define IDLE_TIMEOUT 5000
+#endif
+
+#if !defined(IDLE_SCAN_INTERVAL)
+// Interval in milliseconds between the sweeps over all the keys in the
+// low-power scan mode. The first key movement is detected at most
+// `IDLE_SCAN_INTERVAL` milliseconds, plus the duration of a sweep and a system
+// tick, after it has happened.
+#define IDLE_SCAN_INTERVAL 2
+#endif
+
+_Static_assert(0 < IDLE_SCAN_INTERVAL && IDLE_SCAN_INTERVAL <= 8,
+               "IDLE_SCAN_INTERVAL must be between 1 and 8 milliseconds");
+
+#if !defined(IDLE_WAKE_THRESHOLD)
+// Minimum change in the distance of a key (0-255) to be considered activity.
+// This must be above the noise of the unfiltered ADC values since they are used
+// to detect the activity in the low-power scan mode.
+#define IDLE_WAKE_THRESHOLD 8
+#endif
+
+//--------------------------------------------------------------------+
+// Idle Statistics
+//--------------------------------------------------------------------+
+
+typedef struct __attribute__((packed)) {
+  // Total time spent in the low-power scan mode in milliseconds, excluding the
+  // current period if any
+  uint32_t idle_time;
+  // Number of times the full scan rate was restored
+  uint32_t wakeups;
+  // Upper bound on the time between the first key movement and the return to
+  // the full scan rate in microseconds, for the last wake-up
+  uint32_t last_wake_latency;
+  // Maximum of `last_wake_latency` over all the wake-ups
+  uint32_t max_wake_latency;
+} idle_stats_t;
+
+//--------------------------------------------------------------------+
+// Idle API
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Initialize the idle module
+ *
+ * @return None
+ */
+void idle_init(void);
+
+/**
+ * @brief Idle task
+ *
+ * This function should be called at the end of each iteration of the main loop
+ * after the keys have been scanned. It enters the low-power scan mode after
+ * `IDLE_TIMEOUT` milliseconds of inactivity, and returns to the full scan rate
+ * as soon as activity is detected. In the low-power scan mode, a sweep over all
+ * the keys is started every `IDLE_SCAN_INTERVAL` milliseconds and the CPU
+ * sleeps until the next interrupt.
+ *
+ * @return None
+ */
+void idle_task(void);
+
+/**
+ * @brief Report activity that is not visible from the key matrix
+ *
+ * This function restores the full scan rate at the next call to `idle_task()`
+ * and restarts the inactivity timeout, e.g. when a command is received from the
+ * host.
+ *
+ * @return None
+ */
+void idle_wake(void);
+
+/**
+ * @brief Get the idle statistics
+ *
+ * @param stats Pointer to store the statistics
+ *
+ * @return None
+ */
+void idle_get_stats(idle_stats_t *stats);
@@ -0,0 +1,167 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Byte-Oriented LZ Compression
+//
+// The compressed stream is a sequence of tokens:
+// - 0x00-0x7F: A literal run of (token + 1) bytes that follows the token.
+// - 0x80-0xFF: A copy of ((token & 0x7F) + 3) bytes starting (next byte + 1)
+//   bytes back in the output. The copy may overlap with itself, so runs of a
+//   repeated byte or of a repeated structure are encoded as a single token.
+//--------------------------------------------------------------------+
+
+#define COMPRESS_MIN_MATCH 3
+#define COMPRESS_MAX_MATCH (0x7F + COMPRESS_MIN_MATCH)
+#define COMPRESS_MAX_LITERAL 128
+#define COMPRESS_WINDOW_SIZE 256
+
+// Upper bound on the compressed size of `len` bytes
+#define COMPRESS_BOUND(len) ((len) + M_DIV_CEIL(len, COMPRESS_MAX_LITERAL))
+
+/**
+ * @brief Emit a literal run
+ *
+ * @param dst Destination buffer
+ * @param dst_len Length of the destination buffer
+ * @param pos Current position in the destination buffer
+ * @param src Literal bytes
+ * @param len Number of literal bytes
+ *
+ * @return true if successful, false if the destination buffer is too small
+ */
+static inline bool compress_emit_literals(uint8_t *dst, uint32_t dst_len,
+                                          uint32_t *pos, const uint8_t *src,
+                                          uint32_t len) {
+  while (len > 0) {
+    const uint32_t n = M_MIN(len, (uint32_t)COMPRESS_MAX_LITERAL);
+
+    if (*pos + 1 + n > dst_len)
+      return false;
+    dst[(*pos)++] = n - 1;
+    memcpy(dst + *pos, src, n);
+    *pos += n;
+    src += n;
+    len -= n;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Compress a buffer
+ *
+ * The encoder greedily takes the longest match in the window at each position.
+ *
+ * @param dst Destination buffer
+ * @param dst_len Length of the destination buffer
+ * @param src Source buffer
+ * @param src_len Length of the source buffer
+ * @param out_len Pointer to store the compressed length
+ *
+ * @return true if successful, false if the destination buffer is too small
+ */
+static inline bool compress_encode(uint8_t *dst, uint32_t dst_len,
+                                   const uint8_t *src, uint32_t src_len,
+                                   uint32_t *out_len) {
+  uint32_t pos = 0, literal_start = 0, i = 0;
+
+  while (i < src_len) {
+    const uint32_t max_len = M_MIN(src_len - i, (uint32_t)COMPRESS_MAX_MATCH);
+    const uint32_t max_dist = M_MIN(i, (uint32_t)COMPRESS_WINDOW_SIZE);
+    uint32_t best_len = 0, best_dist = 0;
+
+    for (uint32_t dist = 1; dist <= max_dist && best_len < max_len; dist++) {
+      uint32_t len = 0;
+      while (len < max_len && src[i + len] == src[i + len - dist])
+        len++;
+      if (len > best_len) {
+        best_len = len;
+        best_dist = dist;
+      }
+    }
+
+    if (best_len < COMPRESS_MIN_MATCH) {
+      i++;
+      continue;
+    }
+
+    if (!compress_emit_literals(dst, dst_len, &pos, src + literal_start,
+                                i - literal_start) ||
+        pos + 2 > dst_len)
+      return false;
+    dst[pos++] = 0x80 | (best_len - COMPRESS_MIN_MATCH);
+    dst[pos++] = best_dist - 1;
+    i += best_len;
+    literal_start = i;
+  }
+
+  if (!compress_emit_literals(dst, dst_len, &pos, src + literal_start,
+                              src_len - literal_start))
+    return false;
+  *out_len = pos;
+
+  return true;
+}
+
+/**
+ * @brief Decompress a buffer
+ *
+ * @param dst Destination buffer
+ * @param dst_len Length of the destination buffer
+ * @param src Source buffer
+ * @param src_len Length of the source buffer
+ * @param out_len Pointer to store the decompressed length
+ *
+ * @return true if successful, false if the stream is malformed or the
+ * destination buffer is too small
+ */
+static inline bool compress_decode(uint8_t *dst, uint32_t dst_len,
+                                   const uint8_t *src, uint32_t src_len,
+                                   uint32_t *out_len) {
+  uint32_t pos = 0, i = 0;
+
+  while (i < src_len) {
+    const uint8_t token = src[i++];
+
+    if (token < 0x80) {
+      const uint32_t n = token + 1;
+
+      if (n > src_len - i || n > dst_len - pos)
+        return false;
+      memcpy(dst + pos, src + i, n);
+      pos += n;
+      i += n;
+    } else {
+      const uint32_t n = (token & 0x7F) + COMPRESS_MIN_MATCH;
+
+      if (i >= src_len)
+        return false;
+      const uint32_t dist = src[i++] + 1;
+      if (dist > pos || n > dst_len - pos)
+        return false;
+      // Copy byte by byte since the source may overlap with the destination
+      for (uint32_t j = 0; j < n; j++, pos++)
+        dst[pos] = dst[pos - dist];
+    }
+  }
+  *out_len = pos;
+
+  return true;
+}
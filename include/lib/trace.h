@@ -0,0 +1,141 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// ADC Input Trace
+//
+// A trace is a `trace_header_t` followed by a sequence of frames. Each frame
+// contains the raw ADC values of every key at a point in time:
+// - A varint of the milliseconds elapsed since the previous frame, or since the
+//   start of the capture for the first frame.
+// - For each key, a zigzag-encoded varint of the difference between its ADC
+//   value and its ADC value in the previous frame, which is taken as zero for
+//   the first frame.
+// Varints are little-endian base-128, with the MSB of each byte set if more
+// bytes follow. A frame of idle keys takes about one byte per key.
+//--------------------------------------------------------------------+
+
+// Magic number to identify a trace ("HETR")
+#define TRACE_MAGIC 0x52544548
+// Trace format version
+#define TRACE_VERSION 1
+
+// Maximum size of a varint in bytes
+#define TRACE_VARINT_MAX_SIZE 5
+// Upper bound on the size of a frame of `num_keys` keys in bytes
+#define TRACE_FRAME_MAX_SIZE(num_keys) (TRACE_VARINT_MAX_SIZE + (num_keys) * 3)
+
+// Trace header
+typedef struct __attribute__((packed)) {
+  // Magic number, `TRACE_MAGIC`
+  uint32_t magic;
+  // Trace format version, `TRACE_VERSION`
+  uint8_t version;
+  // Resolution of the ADC values in bits
+  uint8_t adc_resolution;
+  // Number of keys in each frame
+  uint16_t num_keys;
+} trace_header_t;
+
+/**
+ * @brief Encode a varint
+ *
+ * @param dst Destination buffer of at least `TRACE_VARINT_MAX_SIZE` bytes
+ * @param value Value to encode
+ *
+ * @return Number of bytes written
+ */
+static inline uint32_t trace_encode_varint(uint8_t *dst, uint32_t value) {
+  uint32_t len = 0;
+
+  while (value >= 0x80) {
+    dst[len++] = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  dst[len++] = (uint8_t)value;
+
+  return len;
+}
+
+/**
+ * @brief Encode the ADC value of a key
+ *
+ * @param dst Destination buffer of at least 3 bytes
+ * @param last Pointer to the ADC value in the previous frame, which is updated
+ * to the new value
+ * @param value New ADC value
+ *
+ * @return Number of bytes written
+ */
+static inline uint32_t trace_encode_sample(uint8_t *dst, uint16_t *last,
+                                           uint16_t value) {
+  const int32_t delta = (int32_t)value - (int32_t)*last;
+
+  *last = value;
+  return trace_encode_varint(dst, ((uint32_t)delta << 1) ^
+                                      (uint32_t)(delta >> 31));
+}
+
+/**
+ * @brief Decode a varint
+ *
+ * @param src Source buffer
+ * @param len Length of the source buffer
+ * @param pos Current position in the source buffer, which is advanced past the
+ * varint
+ * @param value Pointer to store the decoded value
+ *
+ * @return true if successful, false if the varint is truncated or too long
+ */
+static inline bool trace_decode_varint(const uint8_t *src, uint32_t len,
+                                       uint32_t *pos, uint32_t *value) {
+  *value = 0;
+  for (uint32_t i = 0; i < TRACE_VARINT_MAX_SIZE && *pos < len; i++) {
+    const uint8_t byte = src[(*pos)++];
+
+    *value |= (uint32_t)(byte & 0x7F) << (7 * i);
+    if ((byte & 0x80) == 0)
+      return true;
+  }
+
+  return false;
+}
+
+/**
+ * @brief Decode the ADC value of a key
+ *
+ * @param src Source buffer
+ * @param len Length of the source buffer
+ * @param pos Current position in the source buffer, which is advanced past the
+ * encoded value
+ * @param last Pointer to the ADC value in the previous frame, which is updated
+ * to the decoded value
+ *
+ * @return true if successful, false otherwise
+ */
+static inline bool trace_decode_sample(const uint8_t *src, uint32_t len,
+                                       uint32_t *pos, uint16_t *last) {
+  uint32_t zigzag;
+
+  if (!trace_decode_varint(src, len, pos, &zigzag))
+    return false;
+  *last = (uint16_t)((uint32_t)*last + ((zigzag >> 1) ^ (0u - (zigzag & 1))));
+
+  return true;
+}
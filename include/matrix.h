@@ -36,10 +36,26 @@
 
 #if !defined(MATRIX_CALIBRATION_EPSILON)
 // Minimum change in ADC values required to update the calibration values. This
-// is used to mitigate the inconsistency of the Hall effect sensors.
+// is used to mitigate the inconsistency of the Hall effect sensors. It can be
+// overridden for each key by `eeconfig_t.calibration_epsilon`, e.g. with the
+// values measured by the noise diagnostics.
 #define MATRIX_CALIBRATION_EPSILON 5
 #endif
 
+#if !defined(MATRIX_DRIFT_INTERVAL)
+// Interval in milliseconds between the corrections of the rest values of the
+// keys at rest. Each correction moves the rest value by one ADC count towards
+// the filtered ADC value to compensate for the drift of the sensors, e.g. due
+// to temperature. Set to 0 to disable the correction.
+#define MATRIX_DRIFT_INTERVAL 1000
+#endif
+
+#if !defined(MATRIX_DRIFT_THRESHOLD)
+// Maximum difference in ADC values between the filtered ADC value and the rest
+// value for a key to be considered at rest by the drift correction
+#define MATRIX_DRIFT_THRESHOLD 32
+#endif
+
 #if !defined(MATRIX_INACTIVITY_TIMEOUT)
 // Inactivity timeout in milliseconds. Bottom-out threshold will be saved after
 // there is no change to the threshold of any key for this duration.
@@ -67,12 +83,17 @@ typedef struct {
 
   // Key travel distance (0-255)
   uint8_t distance;
-  // Last extremum point of the key travel distance (0-255)
-  uint8_t extremum;
+  // Last extremum point of the key travel distance (0-DISTANCE_MAX)
+  distance_t extremum;
   // Current key travel direction
   uint8_t key_dir;
   // Whether the key is pressed
   bool is_pressed;
+
+  // Minimum actuation point and Rapid Trigger sensitivities enforced by the
+  // auto-tune (0-DISTANCE_MAX). They are zero if the auto-tune is disabled.
+  distance_t min_actuation_point;
+  distance_t min_rt;
 } key_state_t;
 
 // Key matrix
@@ -92,7 +113,9 @@ void matrix_init(void);
 /**
  * @brief Restart the calibration process
  *
- * This function will block until the calibration process is complete.
+ * The calibration is performed by `matrix_scan()` for
+ * `MATRIX_CALIBRATION_DURATION` milliseconds. The keys are reported as
+ * released until the calibration is complete.
  *
  * @param reset_bottom_out_threshold Whether to reset the saved bottom-out
  * threshold as well
@@ -108,6 +131,45 @@ void matrix_recalibrate(bool reset_bottom_out_threshold);
  */
 void matrix_scan(void);
 
+/**
+ * @brief Convert an ADC value of a key to a distance
+ *
+ * The distance is computed with the calibration values and the switch model of
+ * the key.
+ *
+ * @param key Key index
+ * @param adc ADC value
+ *
+ * @return Key travel distance (0-DISTANCE_MAX)
+ */
+distance_t matrix_adc_to_distance(uint8_t key, uint16_t adc);
+
+/**
+ * @brief Get the effective actuation configuration of a key
+ *
+ * The configuration of the current profile is raised to the minimum values of
+ * the auto-tune, and the Rapid Trigger sensitivities are zero if Rapid Trigger
+ * is disabled.
+ *
+ * @param key Key index
+ * @param actuation Pointer to store the configuration with 16-bit distances
+ *
+ * @return None
+ */
+void matrix_get_actuation(uint8_t key, actuation_wide_t *actuation);
+
+/**
+ * @brief Get the distance of a key from its unfiltered ADC value
+ *
+ * Unlike `key_state_t.distance`, the distance does not lag behind the ADC
+ * value, but it is noisier.
+ *
+ * @param key Key index
+ *
+ * @return Key travel distance (0-255)
+ */
+uint8_t matrix_raw_distance(uint8_t key);
+
 /**
  * @brief Disable Rapid Trigger of a key
  *
@@ -17,13 +17,66 @@
 
 #include "common.h"
 
+#if !defined(MIGRATION_WINDOW_SIZE)
+// Size of the buffer used to stream the configuration during migration. It
+// must be at least as large as the stride of any transform operation.
+#define MIGRATION_WINDOW_SIZE 64
+#endif
+
 //---------------------------------------------------------------------+
 // Migration Types
 //---------------------------------------------------------------------+
 
+// Migration operation types
+typedef enum {
+  // Copy bytes from the source
+  MIGRATION_OP_COPY = 0,
+  // Copy bytes from the source, and transform them
+  MIGRATION_OP_TRANSFORM,
+  // Insert bytes of the same value
+  MIGRATION_OP_FILL,
+  // Insert bytes from a constant array
+  MIGRATION_OP_INSERT,
+} migration_op_type_t;
+
+// Migration operation. A configuration section is migrated by applying its
+// operations in order, each of them producing `len` bytes of the destination.
+// Operations may only insert bytes, so that every field is moved towards the
+// end of the configuration. This allows the migration to be done in place.
+typedef struct {
+  // Type of the operation
+  uint8_t type;
+  // Number of bytes produced by the operation
+  uint32_t len;
+  // Value to fill the bytes with for `MIGRATION_OP_FILL`
+  uint8_t value;
+  // Bytes to insert for `MIGRATION_OP_INSERT`
+  const uint8_t *data;
+  // Size of the records passed to `transform` for `MIGRATION_OP_TRANSFORM`.
+  // `len` must be a multiple of the stride.
+  uint32_t stride;
+  // Transform function for `MIGRATION_OP_TRANSFORM`. `buf` points to `len`
+  // bytes, which is a multiple of the stride, to be transformed in place.
+  void (*transform)(uint8_t *buf, uint32_t len);
+} migration_op_t;
+
+#define MIGRATION_COPY(n) {.type = MIGRATION_OP_COPY, .len = (n)}
+#define MIGRATION_TRANSFORM(n, s, f)                                           \
+  {.type = MIGRATION_OP_TRANSFORM, .len = (n), .stride = (s), .transform = (f)}
+#define MIGRATION_FILL(v, n)                                                   \
+  {.type = MIGRATION_OP_FILL, .len = (n), .value = (v)}
+#define MIGRATION_INSERT_ARRAY(arr)                                            \
+  {.type = MIGRATION_OP_INSERT, .len = sizeof(arr), .data = (arr)}
+#define MIGRATION_INSERT(...)                                                  \
+  {                                                                            \
+      .type = MIGRATION_OP_INSERT,                                             \
+      .len = sizeof((const uint8_t[]){__VA_ARGS__}),                           \
+      .data = (const uint8_t[]){__VA_ARGS__},                                  \
+  }
+
 // Migration metadata. Each configuration version should have a
 // corresponding migration metadata structure.
-typedef struct __attribute__((packed)) {
+typedef struct {
   // Configuration version this migration applies to
   uint16_t version;
   // Size of the global configuration part of the configuration in bytes. This
@@ -31,15 +84,14 @@ typedef struct __attribute__((packed)) {
   uint32_t global_config_size;
   // Size of each profile configuration in bytes
   uint32_t profile_config_size;
-  // Migration function for the global configuration. This function should
-  // return true if the migration was successful, false otherwise. `dst` and
-  // `src` point to the start of the global configuration.
-  bool (*global_config_func)(uint8_t *dst, const uint8_t *src);
-  // Migration function for each profile configuration. This function should
-  // return true if the migration was successful, false otherwise. `dst` and
-  // `src` point to the start of the profile configuration.
-  bool (*profile_config_func)(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src);
+  // Operations to migrate the global configuration from the previous version
+  const migration_op_t *global_config_ops;
+  // Number of operations for the global configuration
+  uint32_t num_global_config_ops;
+  // Operations to migrate each profile configuration from the previous version
+  const migration_op_t *profile_config_ops;
+  // Number of operations for each profile configuration
+  uint32_t num_profile_config_ops;
 } migration_t;
 
 //--------------------------------------------------------------------+
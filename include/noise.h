@@ -0,0 +1,192 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Noise Diagnostics Configuration
+//--------------------------------------------------------------------+
+
+#if !defined(NOISE_MIN_SAMPLES)
+// Minimum number of samples of a key at rest to derive its calibration epsilon
+#define NOISE_MIN_SAMPLES 256
+#endif
+
+#if !defined(NOISE_EPSILON_MARGIN)
+// Margin in ADC counts added to the peak-to-peak noise of the filtered ADC
+// value to derive the calibration epsilon of a key
+#define NOISE_EPSILON_MARGIN 1
+#endif
+
+#if !defined(NOISE_SETTLE_TIME)
+// Time in milliseconds after a key is released before its filtered ADC value is
+// compared with the one before the press
+#define NOISE_SETTLE_TIME 100
+#endif
+
+#if !defined(NOISE_TUNE_WINDOW)
+// Window in milliseconds over which the noise of the keys at rest is measured
+// by the auto-tune. The noise of a key is only updated if it was at rest for
+// the whole window.
+#define NOISE_TUNE_WINDOW 1000
+#endif
+
+#if !defined(NOISE_TUNE_DECAY_EXPONENT)
+// Exponent of the decay of the noise estimate of the auto-tune. The estimate
+// follows an increase of the noise immediately, and a decrease by
+// 1/2^NOISE_TUNE_DECAY_EXPONENT of the difference after each window, so that a
+// few quiet windows do not hide a noisy sensor.
+#define NOISE_TUNE_DECAY_EXPONENT 3
+#endif
+
+#if !defined(NOISE_TUNE_MARGIN)
+// Margin in 8-bit distance units (0-255) added to the noise of a key in
+// distance units to obtain its minimum actuation point and Rapid Trigger
+// sensitivities
+#define NOISE_TUNE_MARGIN 1
+#endif
+
+//--------------------------------------------------------------------+
+// Noise Statistics
+//--------------------------------------------------------------------+
+
+// Noise statistics of a key. A key is at rest if it is released and its
+// filtered ADC value is within `MATRIX_DRIFT_THRESHOLD` of its rest value, and
+// it is bottomed out if its filtered ADC value is within
+// `MATRIX_DRIFT_THRESHOLD` of its bottom-out value. The ADC values are sampled
+// once per millisecond.
+typedef struct __attribute__((packed)) {
+  // Number of samples at rest
+  uint16_t rest_samples;
+  // Peak-to-peak noise of the unfiltered ADC value at rest
+  uint16_t rest_peak_to_peak;
+  // Variance of the unfiltered ADC value at rest in 1/256 ADC counts squared
+  uint32_t rest_variance;
+  // Peak-to-peak noise of the filtered ADC value at rest
+  uint16_t rest_filtered_peak_to_peak;
+  // Change of the rest value over the measurement in ADC counts
+  int16_t rest_drift;
+  // Number of samples bottomed out
+  uint16_t bottom_out_samples;
+  // Peak-to-peak noise of the unfiltered ADC value bottomed out
+  uint16_t bottom_out_peak_to_peak;
+  // Variance of the unfiltered ADC value bottomed out in 1/256 ADC counts
+  // squared
+  uint32_t bottom_out_variance;
+  // Peak-to-peak noise of the filtered ADC value bottomed out
+  uint16_t bottom_out_filtered_peak_to_peak;
+  // Maximum change of the filtered ADC value at rest over a press, measured
+  // `NOISE_SETTLE_TIME` milliseconds after the release
+  uint16_t press_drift;
+  // Calibration epsilon derived from the peak-to-peak noise of the filtered
+  // ADC value, or zero if there are less than `NOISE_MIN_SAMPLES` samples at
+  // rest
+  uint8_t epsilon;
+} noise_stats_t;
+
+// Auto-tune state of a key. The distances are 16-bit as in
+// `actuation_wide_t`.
+typedef struct __attribute__((packed)) {
+  // Estimated peak-to-peak noise of the filtered ADC value at rest
+  uint16_t adc_noise;
+  // Minimum actuation point
+  uint16_t min_actuation_point;
+  // Minimum Rapid Trigger press and release sensitivities
+  uint16_t min_rt;
+  // Effective actuation point
+  uint16_t actuation_point;
+  // Effective Rapid Trigger press sensitivity, or zero if Rapid Trigger is
+  // disabled
+  uint16_t rt_down;
+  // Effective Rapid Trigger release sensitivity
+  uint16_t rt_up;
+} noise_tune_t;
+
+//--------------------------------------------------------------------+
+// Noise Diagnostics API
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Start a noise measurement
+ *
+ * The statistics of the previous measurement are cleared. The keys should be
+ * left at rest for most of the measurement, and pressed all the way down a few
+ * times to measure the noise bottomed out and the drift over a press.
+ *
+ * @param duration Duration of the measurement in milliseconds. If zero, the
+ * measurement in progress is stopped.
+ * @param save Whether to save the calibration epsilons of the keys with enough
+ * samples at rest when the measurement completes
+ *
+ * @return None
+ */
+void noise_start(uint16_t duration, bool save);
+
+/**
+ * @brief Check whether a noise measurement is in progress
+ *
+ * @return true if a measurement is in progress, false otherwise
+ */
+bool noise_is_active(void);
+
+/**
+ * @brief Noise diagnostics task
+ *
+ * This function should be called after the keys have been scanned. It samples
+ * the ADC values of the keys once per millisecond while a measurement is in
+ * progress. If the auto-tune is enabled, it also estimates the noise of the
+ * keys at rest, and raises the actuation point and the Rapid Trigger
+ * sensitivities of each key in `key_matrix` to at least its noise in distance
+ * units plus `NOISE_TUNE_MARGIN` after each `NOISE_TUNE_WINDOW`. The stored
+ * actuation configuration is left untouched.
+ *
+ * @return None
+ */
+void noise_task(void);
+
+/**
+ * @brief Get the noise statistics of a key
+ *
+ * The statistics are updated while a measurement is in progress, and kept
+ * after it completes.
+ *
+ * @param key Key index
+ * @param stats Pointer to store the statistics
+ *
+ * @return None
+ */
+void noise_get_stats(uint8_t key, noise_stats_t *stats);
+
+/**
+ * @brief Get the auto-tune state of a key
+ *
+ * @param key Key index
+ * @param tune Pointer to store the auto-tune state
+ *
+ * @return None
+ */
+void noise_get_tune(uint8_t key, noise_tune_t *tune);
+
+/**
+ * @brief Save the calibration epsilons derived from the last measurement
+ *
+ * The calibration epsilon of the keys with less than `NOISE_MIN_SAMPLES`
+ * samples at rest is left unchanged.
+ *
+ * @return true if successful, false otherwise
+ */
+bool noise_save_epsilon(void);
@@ -29,12 +29,63 @@ _Static_assert(WL_VIRTUAL_SIZE % 4 == 0,
 _Static_assert(WL_WRITE_LOG_SIZE % 4 == 0,
                "WL_WRITE_LOG_SIZE must be word-aligned.");
 
-// Flash space in bytes used by the wear leveling module
+// Flash space in bytes used by each bank of the wear leveling module
 #define WL_BACKING_STORE_SIZE (WL_VIRTUAL_SIZE + WL_WRITE_LOG_SIZE)
+// Space in bytes at the end of the write log reserved for the wear statistics
+#define WL_STATS_SIZE 36
 
-_Static_assert(WL_BACKING_STORE_SIZE <= FLASH_SIZE,
+#if defined(WL_DOUBLE_BANK)
+// The backing store is duplicated so that it can be consolidated into the
+// inactive bank in the background. The active bank is left untouched until the
+// inactive bank is complete, so a power loss never loses committed data.
+#define WL_NUM_BANKS 2
+#else
+// A power loss while the single bank is being consolidated, between its erase
+// and the write of its checksum, clears the virtual storage
+#define WL_NUM_BANKS 1
+#endif
+
+_Static_assert(WL_NUM_BANKS * WL_BACKING_STORE_SIZE <= FLASH_SIZE,
                "The wear leveling backing store must fit in flash.");
 
+#if !defined(WL_WRITE_BACK_TIMEOUT)
+// Time in milliseconds since the last write after which the pending writes are
+// committed to flash. If zero, writes are committed immediately.
+#define WL_WRITE_BACK_TIMEOUT 1000
+#endif
+
+#if !defined(WL_WRITE_BACK_THRESHOLD)
+// Number of pending bytes after which the pending writes are committed to flash
+#define WL_WRITE_BACK_THRESHOLD 1024
+#endif
+
+#if !defined(WL_DIRTY_RANGES)
+// Maximum number of disjoint pending ranges in the virtual storage
+#define WL_DIRTY_RANGES 8
+#endif
+
+#if !defined(WL_DIRTY_MERGE_GAP)
+// Pending ranges that are at most this many bytes apart are merged into one
+#define WL_DIRTY_MERGE_GAP 4
+#endif
+
+_Static_assert(WL_DIRTY_RANGES >= 1, "WL_DIRTY_RANGES must be at least 1.");
+
+#if !defined(WL_CONSOLIDATION_THRESHOLD)
+// Number of bytes used in the write log after which the backing store starts
+// being consolidated in the background. Only used with `WL_DOUBLE_BANK`.
+#define WL_CONSOLIDATION_THRESHOLD (WL_WRITE_LOG_SIZE / 2)
+#endif
+
+#if !defined(WL_CONSOLIDATION_STEP_SIZE)
+// Number of bytes of the virtual storage written to flash in each background
+// consolidation step. Only used with `WL_DOUBLE_BANK`.
+#define WL_CONSOLIDATION_STEP_SIZE 256
+#endif
+
+_Static_assert(WL_CONSOLIDATION_STEP_SIZE % 4 == 0,
+               "WL_CONSOLIDATION_STEP_SIZE must be word-aligned.");
+
 //--------------------------------------------------------------------+
 // Wear Leveling Write Log Entry
 //--------------------------------------------------------------------+
@@ -54,6 +105,68 @@ typedef union __attribute__((packed)) {
 _Static_assert(sizeof(wl_log_entry_t) == WL_LOG_ENTRY_SIZE,
                "wl_log_entry_t must be 8 bytes.");
 
+// Value of `len` marking an extended entry, which holds the data in the words
+// following its header instead
+#define WL_EXTENDED_ENTRY 7
+#define WL_MAX_BYTES_PER_EXTENDED_ENTRY 128
+// Maximum number of words of a write log entry
+#define WL_MAX_ENTRY_WORDS (1 + WL_MAX_BYTES_PER_EXTENDED_ENTRY / 4)
+
+typedef union __attribute__((packed)) {
+  struct __attribute__((packed)) {
+    uint16_t addr : 13;
+    // Always `WL_EXTENDED_ENTRY`
+    uint8_t len : 3;
+    // Length of the data in bytes, padded with zeros to whole words
+    uint8_t data_len;
+    // Lowest byte of the CRC32 of the header, with this field set to zero,
+    // followed by the padded data
+    uint8_t crc;
+  } fields;
+  uint32_t raw;
+} wl_extended_log_entry_t;
+
+_Static_assert(sizeof(wl_extended_log_entry_t) == 4,
+               "wl_extended_log_entry_t must be 4 bytes.");
+_Static_assert(WL_MAX_BYTES_PER_EXTENDED_ENTRY % 4 == 0 &&
+                   WL_MAX_BYTES_PER_EXTENDED_ENTRY <= 255,
+               "Invalid WL_MAX_BYTES_PER_EXTENDED_ENTRY.");
+
+//--------------------------------------------------------------------+
+// Wear Leveling Batch Write
+//--------------------------------------------------------------------+
+
+// Write operation of a batch
+typedef struct {
+  // Address to write to
+  uint32_t addr;
+  // Buffer to write from
+  const void *buf;
+  // Length of the data in bytes
+  uint32_t len;
+} wl_write_t;
+
+//--------------------------------------------------------------------+
+// Wear Leveling Statistics
+//--------------------------------------------------------------------+
+
+// Wear statistics since the flash was first used. They are persisted when the
+// backing store is consolidated, and the write log appended since then is
+// accounted for when the module is initialized. The operations interrupted by
+// a power loss before they are persisted may not be accounted for.
+typedef struct __attribute__((packed)) {
+  // Number of flash sectors erased
+  uint32_t erases;
+  // Number of times the backing store was consolidated
+  uint32_t consolidations;
+  // Number of entries appended to the write log
+  uint32_t log_entries;
+  // Number of bytes programmed to flash
+  uint64_t flash_bytes;
+  // Number of bytes of the virtual storage committed to flash
+  uint64_t user_bytes;
+} wl_stats_t;
+
 //--------------------------------------------------------------------+
 // Wear Leveling Cache
 //--------------------------------------------------------------------+
@@ -92,9 +205,36 @@ bool wear_leveling_erase(void);
  */
 bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len);
 
+/**
+ * @brief Get the wear statistics
+ *
+ * The write amplification is the ratio of `flash_bytes` to `user_bytes`.
+ *
+ * @param stats Pointer to store the statistics
+ *
+ * @return None
+ */
+void wear_leveling_get_stats(wl_stats_t *stats);
+
+/**
+ * @brief Wear leveling task
+ *
+ * This function commits the pending writes to flash once no write has been
+ * performed for `WL_WRITE_BACK_TIMEOUT` milliseconds. With `WL_DOUBLE_BANK`,
+ * it also performs a step of the background consolidation if one is in
+ * progress.
+ *
+ * @return None
+ */
+void wear_leveling_task(void);
+
 /**
  * @brief Write data to the virtual storage
  *
+ * The data is immediately visible through the cache, but it is only committed
+ * to flash by `wear_leveling_task()`, `wear_leveling_flush()`, or once
+ * `WL_WRITE_BACK_THRESHOLD` bytes are pending.
+ *
  * @param addr Address to write to
  * @param buf Buffer to write from
  * @param len Length of the data in bytes
@@ -102,3 +242,26 @@ bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len);
  * @return true if the write was successful, false otherwise
  */
 bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len);
+
+/**
+ * @brief Write multiple data to the virtual storage
+ *
+ * The writes are applied in order and are committed like a single write.
+ *
+ * @param writes Write operations
+ * @param num_writes Number of write operations
+ *
+ * @return true if all the writes were successful, false otherwise
+ */
+bool wear_leveling_write_batch(const wl_write_t *writes, uint32_t num_writes);
+
+/**
+ * @brief Commit the pending writes to flash
+ *
+ * If the write log cannot hold all the pending writes, the backing store is
+ * consolidated once instead of possibly in the middle of the pending writes.
+ * This function must be called before resetting the device.
+ *
+ * @return true if successful, false otherwise
+ */
+bool wear_leveling_flush(void);
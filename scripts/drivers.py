@@ -89,13 +89,18 @@ class Flash:
                 return size
 
     # Round up the required size to the minimum number of flash sectors (from the end)
-    def round_up_to_flash_sectors(self, required_size: int):
-        assert required_size <= self.get_flash_size()
-        total = 0
+    # for each of the banks, and return the total size of the banks
+    def round_up_to_flash_sectors(self, required_size: int, num_banks: int = 1):
+        assert required_size * num_banks <= self.get_flash_size()
+        total = bank_size = 0
         for i in range(self.get_num_sectors() - 1, -1, -1):
             total += self.get_sector_size(i)
-            if total >= required_size:
-                return total
+            bank_size += self.get_sector_size(i)
+            if bank_size >= required_size:
+                num_banks -= 1
+                bank_size = 0
+                if num_banks == 0:
+                    return total
         return total
 
 
@@ -105,6 +110,8 @@ class ADC:
     max_resolution: int
     # ADC input pin names, in the same order as the ADC channels
     input_pins: list[str]
+    # ADC input channels of each ADC that can convert simultaneously with the first one
+    channels: list[list[int]]
     # Convert a list of ADC input pin names to a tuple of (GPIO port names, GPIO pin numbers)
     to_gpio_array: Callable[[list[str]], tuple[list[str], list[str]]]
 
@@ -183,6 +190,12 @@ STM32F446XX = Driver(
                 "C4",
                 "C5",
             ],
+            # ADC3 is not connected to PA4-PA7, PB0, PB1, PC4 and PC5
+            channels=[
+                list(range(16)),
+                list(range(16)),
+                [0, 1, 2, 3, 10, 11, 12, 13],
+            ],
             to_gpio_array=lambda pins: (
                 [f"GPIO{pin[0]}" for pin in pins],
                 [f"GPIO_PIN_{pin[1:]}" for pin in pins],
@@ -231,6 +244,7 @@ AT32F405XX = Driver(
                 "C4",
                 "C5",
             ],
+            channels=[list(range(16))],
             to_gpio_array=lambda pins: (
                 [f"GPIO{pin[0]}" for pin in pins],
                 [f"GPIO_PINS_{pin[1:]}" for pin in pins],
@@ -11,10 +11,29 @@
 # You should have received a copy of the GNU General Public License along with
 # this program. If not, see <https://www.gnu.org/licenses/>.
 
+import os
+import sys
 import utils
+from decimal import Decimal
 from drivers import *
 from schema.keyboard import KeyboardUSBPort
 
+sys.path.append("tools")
+import distance_lut
+
+DISTANCE_LUTS_TEMPLATE = """#pragma once
+
+#include "common.h"
+
+// DO NOT EDIT THIS FILE DIRECTLY
+// This file is automatically generated from `scripts/make.py`.
+
+// Distance lookup tables of each switch model. See `tools/distance_lut.py`.
+static const distance_t distance_luts[][DISTANCE_LUT_SIZE] = {{
+{distance_luts}
+}};
+"""
+
 Import("env")
 
 keyboard = env["PIOENV"]
@@ -80,6 +99,12 @@ if kb_json.analog.invert_adc:
 if kb_json.analog.delay is not None:
     build_flags.define("ADC_SAMPLE_DELAY", kb_json.analog.delay)
 
+# Simultaneous ADC Configuration
+num_adcs = kb_json.analog.simultaneous_adcs
+if num_adcs > 1:
+    utils.order_simultaneous_analog(kb_json.analog, driver.metadata.adc, num_adcs)
+    build_flags.define("ADC_NUM_SIMULTANEOUS", num_adcs)
+
 # Raw ADC Input Configuration
 if kb_json.analog.raw is not None:
     raw = kb_json.analog.raw
@@ -110,6 +135,10 @@ if kb_json.analog.mux is not None:
         "ADC_MUX_INPUT_MATRIX", utils.to_c_array(list(map(list, zip(*mux.matrix))))
     )
 
+# DMA Frame Configuration
+if kb_json.analog.dma_frame and kb_json.analog.mux is not None:
+    build_flags.define("ADC_DMA_FRAME")
+
 # Calibration Configuration
 build_flags.define(
     "DEFAULT_CALIBRATION", utils.to_c_struct(kb_json.calibration.model_dump())
@@ -121,12 +150,16 @@ wl_virtual_size = (wear_leveling and wear_leveling.virtual_size) or 8192
 wl_write_log_size = (wear_leveling and wear_leveling.write_log_size) or 65536
 wl_backing_store_size = wl_virtual_size + wl_write_log_size
 
+wl_double_bank = bool(wear_leveling and wear_leveling.double_bank)
+
 build_flags.define("WL_VIRTUAL_SIZE", wl_virtual_size)
 build_flags.define("WL_WRITE_LOG_SIZE", wl_write_log_size)
+if wl_double_bank:
+    build_flags.define("WL_DOUBLE_BANK")
 
 # Reserve flash for wear leveling (round up to whole sectors from the end)
 wl_base_address = flash_size - driver.metadata.flash.round_up_to_flash_sectors(
-    wl_backing_store_size
+    wl_backing_store_size, 2 if wl_double_bank else 1
 )
 build_flags.define("WL_BASE_ADDRESS", wl_base_address)
 build_flags.linker_defsym("WL_BASE_ADDRESS", wl_base_address)
@@ -137,6 +170,8 @@ build_flags.define("NUM_PROFILES", kb.num_profiles)
 build_flags.define("NUM_LAYERS", kb.num_layers)
 build_flags.define("NUM_KEYS", kb.num_keys)
 build_flags.define("NUM_ADVANCED_KEYS", kb.num_advanced_keys)
+if kb.compact_profiles:
+    build_flags.define("EECONFIG_COMPACT_PROFILES")
 
 # Default Keymaps (per profile)
 default_keymaps = utils.resolve_default_keymaps(kb_json)
@@ -148,5 +183,34 @@ if kb_json.actuation is not None:
     if actuation.actuation_point is not None:
         build_flags.define("ACTUATION_POINT", actuation.actuation_point)
 
+# Distance Configuration
+if kb_json.distance is not None:
+    distance = kb_json.distance
+    max_distance = 65535 if distance.high_resolution else 255
+
+    distance_luts = []
+    for switch in distance.switches:
+        if switch.a is not None:
+            a = Decimal(str(switch.a))
+        else:
+            trace = os.path.join("keyboards", keyboard, switch.trace)
+            a = distance_lut.fit(distance_lut.load_trace(trace))
+            print(f"Fitted distance curve of {switch.name}: a = {a}")
+        lut = ", ".join(
+            str(x) for x in distance_lut.generate_lut(a, max_value=max_distance)
+        )
+        distance_luts.append(f"    // {switch.name} (a = {a})\n    {{{lut}}},")
+
+    with open(os.path.join("include", "distance_luts.h"), "w") as f:
+        f.write(DISTANCE_LUTS_TEMPLATE.format(distance_luts="\n".join(distance_luts)))
+
+    build_flags.define("DISTANCE_NUM_LUTS", len(distance.switches))
+    if distance.high_resolution:
+        build_flags.define("DISTANCE_HIGH_RESOLUTION")
+    if distance.default_switches is not None:
+        build_flags.define(
+            "DEFAULT_SWITCH_MODELS", utils.to_c_array(distance.default_switches)
+        )
+
 # Add source build flags
 env.Append(BUILD_FLAGS=build_flags.get_flags())
@@ -62,6 +62,9 @@ def keyboard_metadata_def():
         "layout": kb_json.layout.model_dump(exclude_none=True),
         "defaultKeymaps": utils.resolve_default_keymaps(kb_json),
     }
+    if kb_json.distance is not None:
+        metadata["switches"] = [x.name for x in kb_json.distance.switches]
+        metadata["highResolutionDistance"] = kb_json.distance.high_resolution
 
     uncompressed = json.dumps(metadata).encode("utf-8")
     compressed = gzip.compress(uncompressed)
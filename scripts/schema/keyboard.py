@@ -35,6 +35,8 @@ class KeyboardKeyboard(BaseModel):
     num_layers: int = Field(ge=1, le=8)
     num_keys: int = Field(ge=1, le=256)
     num_advanced_keys: int = Field(ge=1, le=64)
+    # Whether to store each profile as a compressed delta against its default profile, so that more profiles fit in the virtual storage. Only the current profile is kept expanded in RAM.
+    compact_profiles: bool = False
 
 
 # Hardware Configuration
@@ -73,6 +75,10 @@ class KeyboardAnalog(BaseModel):
     delay: int | None = None
     raw: KeyboardAnalogRaw | None = None
     mux: KeyboardAnalogMux | None = None
+    # Whether the DMA writes the conversions of each multiplexer channel directly into a frame of all the channels, which is stored in the ADC values of the keys once per sweep. This shortens the interrupt handler of each multiplexer channel. Only used with multiplexers.
+    dma_frame: bool = False
+    # Number of ADCs converting the inputs simultaneously (STM32F446 only). The inputs are reordered so that each input is converted by an ADC connected to its channel.
+    simultaneous_adcs: int = Field(ge=1, le=3, default=1)
 
 
 # Calibration Configuration
@@ -83,12 +89,34 @@ class KeyboardCalibration(BaseModel):
     initial_bottom_out_threshold: NonNegativeInt
 
 
+# Switch model Configuration
+class KeyboardSwitch(BaseModel):
+    # Name of the switch model
+    name: str
+    # Constant of the distance curve. See `tools/distance_lut.py`. If not provided, it is fitted to `trace`.
+    a: PositiveFloat | None = None
+    # Path to a CSV trace of normalized (ADC value, distance) samples, relative to the keyboard directory
+    trace: str | None = None
+
+
+# Distance Configuration
+class KeyboardDistance(BaseModel):
+    # Switch models, each with its own distance lookup table
+    switches: list[KeyboardSwitch] = Field(min_length=1, max_length=255)
+    # Default switch model index of each key. If not provided, all keys use the first switch model.
+    default_switches: list[NonNegativeInt] | None = None
+    # Whether to use 16-bit travel distances for the actuation and Rapid Trigger. The lookup tables are generated with 16-bit values.
+    high_resolution: bool = False
+
+
 # Wear leveling Configuration
 class KeyboardWearLeveling(BaseModel):
     # Size of the virtual persistent storage in bytes. There must be enough RAM of this size to hold the entire virtual storage.
     virtual_size: int = Field(ge=1, le=8192)
     # Size of the write log in bytes
     write_log_size: int = Field(ge=1, le=65536)
+    # Whether to reserve a second copy of the backing store so that it can be consolidated in the background without stalling the main loop. It also keeps the data if the device loses power while consolidating.
+    double_bank: bool = False
 
 
 class KeyboardLayoutKey(BaseModel):
@@ -125,6 +153,7 @@ class Keyboard(BaseModel):
     hardware: KeyboardHardware
     analog: KeyboardAnalog
     calibration: KeyboardCalibration
+    distance: KeyboardDistance | None = None
     wear_leveling: KeyboardWearLeveling | None = None
     layout: KeyboardLayout
     # Default keymap
@@ -13,7 +13,7 @@
 
 import os
 from drivers import *
-from schema.keyboard import Keyboard
+from schema.keyboard import Keyboard, KeyboardAnalog
 
 
 class CompilerFlags:
@@ -84,6 +84,66 @@ def get_adc_resolution(kb_json: Keyboard, driver: Driver):
     return kb_json.analog.adc_resolution or driver.metadata.adc.max_resolution
 
 
+# Order the ADC inputs for simultaneous conversion. The input at position `i` is
+# converted by ADC `(offset + i) % len(adc_channels)`, so it must be one of the channels
+# of that ADC. Return the index of the input at each position, or None if there is no
+# such order.
+def order_simultaneous_inputs(
+    channels: list[int], adc_channels: list[list[int]], offset: int = 0
+):
+    num_adcs = len(adc_channels)
+
+    # Check whether the input can be converted at the position
+    def fits(input: int, pos: int):
+        return channels[input] in adc_channels[(offset + pos) % num_adcs]
+
+    # Input at each position, keeping the inputs that already fit in place
+    order: list[int | None] = [i if fits(i, i) else None for i in range(len(channels))]
+
+    # Find a position for the input, moving the inputs already placed if needed
+    def place(input: int, visited: set[int]):
+        for pos in range(len(channels)):
+            if pos in visited or not fits(input, pos):
+                continue
+            visited.add(pos)
+            if order[pos] is None or place(order[pos], visited):
+                order[pos] = input
+                return True
+        return False
+
+    for i in range(len(channels)):
+        if i not in order and not place(i, set()):
+            return None
+    return order
+
+
+# Reorder the multiplexer and the raw inputs of the analog configuration, along
+# with their key mappings, so that each ADC only converts its own channels when
+# `num_adcs` ADCs convert the inputs simultaneously. The multiplexer inputs come
+# first in the conversion sequence, followed by the raw inputs.
+def order_simultaneous_analog(analog: KeyboardAnalog, adc: ADC, num_adcs: int):
+    if num_adcs > len(adc.channels):
+        raise ValueError(
+            f"The MCU cannot convert with more than {len(adc.channels)} ADCs"
+        )
+    adc_channels = adc.channels[:num_adcs]
+
+    offset = 0
+    groups = [("mux", analog.mux, "matrix"), ("raw", analog.raw, "vector")]
+    for name, group, keys in groups:
+        if group is None:
+            continue
+        channels = adc.to_adc_inputs(group.input)
+        order = order_simultaneous_inputs(channels, adc_channels, offset)
+        if order is None:
+            raise ValueError(
+                f"The {name} inputs cannot be split between {num_adcs} ADCs"
+            )
+        group.input = [group.input[i] for i in order]
+        setattr(group, keys, [getattr(group, keys)[i] for i in order])
+        offset += len(channels)
+
+
 # Resolve per-profile default keymaps
 def resolve_default_keymaps(kb_json: Keyboard) -> list[list[list[str]]]:
     if kb_json.keymaps is not None:
@@ -41,3 +41,17 @@ for keymap in default_keymaps:
             raise ValueError(
                 f"Expected default keymaps to have {kb_json.keyboard.num_keys} keys"
             )
+
+# Validate distance configuration
+if kb_json.distance is not None:
+    for switch in kb_json.distance.switches:
+        if switch.a is None and switch.trace is None:
+            raise ValueError(f"Expected switch {switch.name} to have a or trace")
+    default_switches = kb_json.distance.default_switches
+    if default_switches is not None:
+        if len(default_switches) != kb_json.keyboard.num_keys:
+            raise ValueError(
+                f"Expected default switches to have {kb_json.keyboard.num_keys} keys"
+            )
+        if any(x >= len(kb_json.distance.switches) for x in default_switches):
+            raise ValueError("Expected default switches to be valid switch indices")
@@ -23,6 +23,9 @@
 #include "matrix.h"
 
 static advanced_key_state_t ak_states[NUM_ADVANCED_KEYS];
+// SOCD groups to resolve in `advanced_key_resolve()`. Bit i refers to the i-th
+// advanced key.
+static uint64_t socd_pending;
 
 static void advanced_key_null_bind(const advanced_key_event_t *event) {
   const null_bind_t *null_bind =
@@ -104,6 +107,190 @@ static void advanced_key_null_bind(const advanced_key_event_t *event) {
   }
 }
 
+/**
+ * @brief Get the members of an SOCD group
+ *
+ * @param ak SOCD group advanced key
+ * @param keys Array of `SOCD_GROUP_MAX_MEMBERS` to store the key index of each
+ * member
+ *
+ * @return Mask of the members that are in use
+ */
+static uint8_t advanced_key_socd_group_members(const advanced_key_t *ak,
+                                               uint8_t *keys) {
+  uint8_t members = 1;
+
+  keys[0] = ak->key;
+  for (uint32_t i = 1; i < SOCD_GROUP_MAX_MEMBERS; i++) {
+    keys[i] = ak->socd_group.keys[i - 1];
+    members |= (uint8_t)((keys[i] < NUM_KEYS) << i);
+  }
+
+  return members;
+}
+
+static void advanced_key_socd_group(const advanced_key_event_t *event) {
+  const advanced_key_t *ak = &CURRENT_PROFILE.advanced_keys[event->ak_index];
+  ak_state_socd_group_t *state = &ak_states[event->ak_index].socd_group;
+
+  uint8_t keys[SOCD_GROUP_MAX_MEMBERS];
+  const uint8_t members = advanced_key_socd_group_members(ak, keys);
+  const uint32_t num_pressed = (uint32_t)__builtin_popcount(state->pressed);
+  uint32_t index = 0;
+
+  while (index < SOCD_GROUP_MAX_MEMBERS &&
+         (((members >> index) & 1) == 0 || keys[index] != event->key))
+    index++;
+  if (index == SOCD_GROUP_MAX_MEMBERS)
+    return;
+
+  const uint8_t bit = (uint8_t)(1 << index);
+
+  // Only update the pressed members. The group is resolved once per matrix
+  // scan in `advanced_key_resolve()`.
+  switch (event->type) {
+  case AK_EVENT_TYPE_PRESS:
+    if (state->pressed & bit)
+      return;
+    memmove(&state->order[1], &state->order[0], num_pressed);
+    state->order[0] = (uint8_t)index;
+    state->pressed |= bit;
+    state->keycodes[index] = event->keycode;
+    break;
+
+  case AK_EVENT_TYPE_RELEASE:
+    if ((state->pressed & bit) == 0)
+      return;
+    if (state->registered & bit) {
+      // Also release the key if it is registered
+      layout_unregister(keys[index], state->keycodes[index]);
+      state->registered &= (uint8_t)~bit;
+    }
+    for (uint32_t i = 0; i < num_pressed; i++) {
+      if (state->order[i] == index) {
+        memmove(&state->order[i], &state->order[i + 1], num_pressed - i - 1);
+        break;
+      }
+    }
+    state->pressed &= (uint8_t)~bit;
+    state->keycodes[index] = KC_NO;
+    break;
+
+  default:
+    // The resolution only changes while the members are held if it depends on
+    // the distances.
+    if ((ak->socd_group.behavior != NB_BEHAVIOR_DISTANCE) &
+        (ak->socd_group.bottom_out_point == 0))
+      return;
+    break;
+  }
+
+  socd_pending |= 1ULL << event->ak_index;
+}
+
+/**
+ * @brief Resolve an SOCD group
+ *
+ * The Null Bind behavior is applied to the pressed members of each axis, and
+ * the members whose resolution changed are registered or unregistered.
+ *
+ * @param ak_index Advanced key index of the SOCD group
+ *
+ * @return None
+ */
+static void advanced_key_socd_group_resolve(uint32_t ak_index) {
+  const advanced_key_t *ak = &CURRENT_PROFILE.advanced_keys[ak_index];
+  const socd_group_t *socd_group = &ak->socd_group;
+  ak_state_socd_group_t *state = &ak_states[ak_index].socd_group;
+
+  if (ak->type != AK_TYPE_SOCD_GROUP)
+    return;
+
+  uint8_t keys[SOCD_GROUP_MAX_MEMBERS];
+  advanced_key_socd_group_members(ak, keys);
+
+  const uint32_t num_pressed = (uint32_t)__builtin_popcount(state->pressed);
+  const uint8_t first_axis =
+      socd_group->split ? (uint8_t)((1 << socd_group->split) - 1) : 0xFF;
+  const uint8_t axes[] = {
+      (uint8_t)(state->pressed & first_axis),
+      (uint8_t)(state->pressed & ~first_axis),
+  };
+
+  uint8_t bottomed_out = 0;
+  if (socd_group->bottom_out_point > 0)
+    for (uint32_t i = 0; i < num_pressed; i++)
+      bottomed_out |= (uint8_t)((key_matrix[keys[state->order[i]]].distance >=
+                                 socd_group->bottom_out_point)
+                                << state->order[i]);
+
+  uint8_t registered = 0;
+  for (uint32_t i = 0; i < M_ARRAY_SIZE(axes); i++) {
+    const uint8_t pressed = axes[i];
+
+    if (((pressed & (pressed - 1)) == 0) ||
+        ((socd_group->bottom_out_point > 0) &
+         ((bottomed_out & pressed) == pressed))) {
+      // At most one member is pressed, or input on all bottom out is enabled
+      // and all the pressed members are bottomed out so we register all of
+      // them.
+      registered |= pressed;
+      continue;
+    }
+
+    switch (socd_group->behavior) {
+    case NB_BEHAVIOR_PRIMARY:
+      // Prioritize the members in order
+      registered |= (uint8_t)(1 << __builtin_ctz(pressed));
+      break;
+
+    case NB_BEHAVIOR_NEUTRAL:
+      break;
+
+    case NB_BEHAVIOR_DISTANCE: {
+      // If there is a tie between the travel distances, the most recently
+      // pressed member is prioritized.
+      uint32_t winner = SOCD_GROUP_MAX_MEMBERS;
+      for (uint32_t j = 0; j < num_pressed; j++) {
+        const uint8_t member = state->order[j];
+
+        if (((pressed >> member) & 1) &&
+            (winner == SOCD_GROUP_MAX_MEMBERS ||
+             key_matrix[keys[member]].distance >
+                 key_matrix[keys[winner]].distance))
+          winner = member;
+      }
+      registered |= (uint8_t)(1 << winner);
+      break;
+    }
+
+    default:
+      // Prioritize the most recently pressed member
+      for (uint32_t j = 0; j < num_pressed; j++) {
+        if ((pressed >> state->order[j]) & 1) {
+          registered |= (uint8_t)(1 << state->order[j]);
+          break;
+        }
+      }
+      break;
+    }
+  }
+
+  // Update the key states. The only changes here are the results of the SOCD
+  // resolution.
+  uint8_t changed = registered ^ state->registered;
+  state->registered = registered;
+  while (changed) {
+    const uint32_t i = (uint32_t)__builtin_ctz(changed);
+
+    changed &= (uint8_t)(changed - 1);
+    if ((registered >> i) & 1)
+      layout_register(keys[i], state->keycodes[i]);
+    else
+      layout_unregister(keys[i], state->keycodes[i]);
+  }
+}
+
 static void advanced_key_dynamic_keystroke(const advanced_key_event_t *event) {
   static deferred_action_t deferred_action = {0};
 
@@ -243,12 +430,27 @@ void advanced_key_clear(void) {
         layout_unregister(ak->key, ak->toggle.keycode);
       break;
 
+    case AK_TYPE_SOCD_GROUP: {
+      uint8_t keys[SOCD_GROUP_MAX_MEMBERS];
+      uint8_t registered = state->socd_group.registered;
+
+      advanced_key_socd_group_members(ak, keys);
+      while (registered) {
+        const uint32_t j = (uint32_t)__builtin_ctz(registered);
+
+        registered &= (uint8_t)(registered - 1);
+        layout_unregister(keys[j], state->socd_group.keycodes[j]);
+      }
+      break;
+    }
+
     default:
       break;
     }
   }
   // Clear the advanced key states
   memset(ak_states, 0, sizeof(ak_states));
+  socd_pending = 0;
 }
 
 void advanced_key_process(const advanced_key_event_t *event) {
@@ -272,11 +474,24 @@ void advanced_key_process(const advanced_key_event_t *event) {
     advanced_key_toggle(event);
     break;
 
+  case AK_TYPE_SOCD_GROUP:
+    advanced_key_socd_group(event);
+    break;
+
   default:
     break;
   }
 }
 
+void advanced_key_resolve(void) {
+  while (socd_pending) {
+    const uint32_t i = (uint32_t)__builtin_ctzll(socd_pending);
+
+    socd_pending &= socd_pending - 1;
+    advanced_key_socd_group_resolve(i);
+  }
+}
+
 void advanced_key_tick(bool has_non_tap_hold_press) {
   for (uint32_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
     const advanced_key_t *ak = &CURRENT_PROFILE.advanced_keys[i];
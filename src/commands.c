@@ -16,11 +16,18 @@
 #include "commands.h"
 
 #include "advanced_keys.h"
+#include "crc32.h"
+#include "distance.h"
 #include "hardware/hardware.h"
+#include "idle.h"
 #include "layout.h"
+#include "lib/bitmap.h"
+#include "lib/trace.h"
 #include "matrix.h"
 #include "metadata.h"
+#include "noise.h"
 #include "tusb.h"
+#include "wear_leveling.h"
 
 // Helper macro to verify command parameters
 #define COMMAND_VERIFY(cond)                                                   \
@@ -29,9 +36,306 @@
     break;                                                                     \
   }
 
+// Helper macro to write to a field in the persistent configuration, or stage
+// the write if a transaction is in progress
+#define COMMAND_WRITE(field, value)                                            \
+  command_write(offsetof(eeconfig_t, field), value,                            \
+                sizeof(((eeconfig_t *)0)->field))
+
+#define COMMAND_WRITE_N(field, value, len)                                     \
+  command_write(offsetof(eeconfig_t, field), value, len)
+
+// Helper macro to check that a `bool` field received from the host is either 0
+// or 1, since reading any other value is undefined behavior
+#define COMMAND_IS_BOOL(field) (*(const uint8_t *)&(field) <= 1)
+
 static uint8_t out_buf[RAW_HID_EP_SIZE];
 static const uint8_t keyboard_metadata[] = {KEYBOARD_METADATA};
 
+// Transaction state
+static struct {
+  // Whether a transaction is in progress
+  bool active;
+  // Whether any of the staged commands failed
+  bool failed;
+  // Whether the advanced keys of the current profile are modified
+  bool reload_advanced_keys;
+  // Time of the last command received during the transaction
+  uint32_t last_command;
+  // Number of staged writes
+  uint32_t num_writes;
+  // Number of bytes used in the staging buffer
+  uint32_t buf_len;
+  wl_write_t writes[COMMAND_TRANSACTION_MAX_WRITES];
+  uint8_t buf[COMMAND_TRANSACTION_BUFFER_SIZE];
+} transaction;
+
+/**
+ * @brief Write to the persistent configuration
+ *
+ * If a transaction is in progress, the write is staged instead and will be
+ * applied when the transaction is committed.
+ *
+ * @param addr Address to write to
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool command_write(uint32_t addr, const void *buf, uint32_t len) {
+  if (!transaction.active)
+    return eeconfig_write(addr, buf, len);
+
+  if (transaction.num_writes >= COMMAND_TRANSACTION_MAX_WRITES ||
+      transaction.buf_len + len > COMMAND_TRANSACTION_BUFFER_SIZE)
+    return false;
+
+  uint8_t *staged = transaction.buf + transaction.buf_len;
+  memcpy(staged, buf, len);
+  transaction.writes[transaction.num_writes++] = (wl_write_t){
+      .addr = addr,
+      .buf = staged,
+      .len = len,
+  };
+  transaction.buf_len += len;
+
+  return true;
+}
+
+/**
+ * @brief Commit the staged writes of the transaction
+ *
+ * @return true if successful, false otherwise
+ */
+static bool command_commit_transaction(void) {
+  bool success = transaction.active && !transaction.failed;
+
+  if (success) {
+    if (transaction.reload_advanced_keys)
+      advanced_key_clear();
+    success = eeconfig_write_batch(transaction.writes, transaction.num_writes);
+    if (transaction.reload_advanced_keys)
+      layout_load_advanced_keys();
+  }
+  memset(&transaction, 0, sizeof(transaction));
+
+  return success;
+}
+
+/**
+ * @brief Verify the actuation configurations received from the host
+ *
+ * @param actuation_map Actuation configurations
+ * @param len Number of actuation configurations
+ *
+ * @return true if valid, false otherwise
+ */
+static bool command_verify_actuation_map(const actuation_t *actuation_map,
+                                         uint32_t len) {
+  bool valid = true;
+
+  for (uint32_t i = 0; i < len; i++)
+    valid &= COMMAND_IS_BOOL(actuation_map[i].continuous);
+
+  return valid;
+}
+
+/**
+ * @brief Verify the advanced key configurations received from the host
+ *
+ * @param advanced_keys Advanced key configurations
+ * @param len Number of advanced key configurations
+ *
+ * @return true if valid, false otherwise
+ */
+static bool command_verify_advanced_keys(const advanced_key_t *advanced_keys,
+                                         uint32_t len) {
+  bool valid = true;
+
+  for (uint32_t i = 0; i < len; i++) {
+    const advanced_key_t *ak = &advanced_keys[i];
+
+    valid &= (ak->type != AK_TYPE_TAP_HOLD) |
+             COMMAND_IS_BOOL(ak->tap_hold.hold_on_other_key_press);
+    if (ak->type == AK_TYPE_SOCD_GROUP) {
+      // Each member of an SOCD group must be a different key
+      uint8_t keys[SOCD_GROUP_MAX_MEMBERS];
+
+      keys[0] = ak->key;
+      memcpy(&keys[1], ak->socd_group.keys, sizeof(ak->socd_group.keys));
+      for (uint32_t j = 1; j < SOCD_GROUP_MAX_MEMBERS; j++)
+        for (uint32_t k = 0; k < j; k++)
+          valid &= (keys[j] >= NUM_KEYS) | (keys[j] != keys[k]);
+      valid &= (ak->socd_group.behavior <= NB_BEHAVIOR_DISTANCE) &
+               (ak->socd_group.behavior != NB_BEHAVIOR_SECONDARY);
+    }
+  }
+
+  return valid;
+}
+
+// Profile blob state, shared by `COMMAND_EXPORT_PROFILE` and
+// `COMMAND_IMPORT_PROFILE`
+static struct {
+  // Command that owns the blob buffer
+  uint8_t command_id;
+  uint8_t profile;
+  // Number of valid bytes in the blob buffer
+  uint32_t len;
+  uint8_t buf[COMMAND_PROFILE_BLOB_SIZE];
+} profile_blob;
+
+// Decompressed profile of the profile blob
+static eeconfig_profile_t blob_profile;
+
+/**
+ * @brief Encode a profile into the profile blob buffer
+ *
+ * @param profile Profile index
+ *
+ * @return true if successful, false otherwise
+ */
+static bool command_encode_profile_blob(uint8_t profile) {
+  command_profile_blob_header_t *header =
+      (command_profile_blob_header_t *)profile_blob.buf;
+  uint32_t len;
+
+  profile_blob.command_id = COMMAND_EXPORT_PROFILE;
+  profile_blob.profile = profile;
+  profile_blob.len = 0;
+  if (!EECONFIG_READ(profiles[profile], &blob_profile) ||
+      !compress_encode(profile_blob.buf + sizeof(*header),
+                       sizeof(profile_blob.buf) - sizeof(*header),
+                       (const uint8_t *)&blob_profile, sizeof(blob_profile),
+                       &len))
+    return false;
+
+  header->len = len;
+  header->crc = crc32_compute(&blob_profile, sizeof(blob_profile), 0);
+  profile_blob.len = sizeof(*header) + len;
+
+  return true;
+}
+
+/**
+ * @brief Decode the profile blob buffer into `blob_profile`
+ *
+ * The blob must be complete. The decoded profile is verified against the size
+ * and the CRC32 in the header.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool command_decode_profile_blob(void) {
+  const command_profile_blob_header_t *header =
+      (const command_profile_blob_header_t *)profile_blob.buf;
+  uint32_t len;
+
+  if (!compress_decode((uint8_t *)&blob_profile, sizeof(blob_profile),
+                       profile_blob.buf + sizeof(*header), header->len, &len))
+    return false;
+
+  return len == sizeof(blob_profile) &&
+         crc32_compute(&blob_profile, sizeof(blob_profile), 0) ==
+             header->crc;
+}
+
+// Analog stream state
+static struct {
+  // Interval between frames in milliseconds. Zero if the stream is disabled.
+  uint8_t interval;
+  // Minimum change in the filtered ADC value to report a key
+  uint8_t threshold;
+  // Frame counter
+  uint8_t frame;
+  // Whether a frame is being sent
+  bool in_frame;
+  // Number of consecutive frames without any change that were not sent
+  uint8_t empty_frames;
+  // Time when the last frame was started
+  uint32_t last_frame;
+  // Subscribed keys
+  bitmap_t keys[M_DIV_CEIL(NUM_KEYS, 32)];
+  // Keys that are yet to be sent in the current frame
+  bitmap_t pending[M_DIV_CEIL(NUM_KEYS, 32)];
+  // Last reported values of each key
+  uint16_t adc_values[NUM_KEYS];
+  uint8_t distances[NUM_KEYS];
+} analog_stream;
+
+static uint8_t analog_stream_buf[RAW_HID_EP_SIZE];
+
+// Trace capture state
+static struct {
+  // Interval between frames in milliseconds. Zero if the capture is disabled.
+  uint8_t interval;
+  // Report counter
+  uint8_t seq;
+  // Time when the last frame was captured
+  uint32_t last_frame;
+  // Number of bytes in the buffer
+  uint32_t len;
+  // Number of bytes in the buffer that have been sent
+  uint32_t pos;
+  // ADC values of each key in the last frame
+  uint16_t adc_values[NUM_KEYS];
+  // Trace header or frame being sent
+  uint8_t buf[TRACE_FRAME_MAX_SIZE(NUM_KEYS)];
+} trace_capture;
+
+static uint8_t trace_capture_buf[RAW_HID_EP_SIZE];
+
+/**
+ * @brief Start a new analog stream frame
+ *
+ * This function marks the subscribed keys that have changed since they were
+ * last reported as pending.
+ *
+ * @return true if any key is pending, false otherwise
+ */
+static bool command_analog_stream_start_frame(void) {
+  bool changed = false;
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    const uint16_t adc_value = key_matrix[i].adc_filtered;
+    const uint16_t last_adc_value = analog_stream.adc_values[i];
+    const uint16_t delta = adc_value > last_adc_value
+                               ? adc_value - last_adc_value
+                               : last_adc_value - adc_value;
+    const uint8_t pending =
+        bitmap_get(analog_stream.keys, i) &
+        ((delta > analog_stream.threshold) |
+         (key_matrix[i].distance != analog_stream.distances[i]));
+
+    bitmap_set(analog_stream.pending, i, pending);
+    changed |= pending;
+  }
+  analog_stream.last_frame = timer_read();
+
+  return changed;
+}
+
+/**
+ * @brief Capture a new trace frame
+ *
+ * The raw ADC values are captured as returned by `analog_read()`, so that a
+ * trace can be replayed by feeding them back through `analog_read()`.
+ *
+ * @return None
+ */
+static void command_trace_capture_frame(void) {
+  const uint32_t now = timer_read();
+  uint32_t len = trace_encode_varint(trace_capture.buf,
+                                     now - trace_capture.last_frame);
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    len += trace_encode_sample(trace_capture.buf + len,
+                               &trace_capture.adc_values[i],
+                               analog_read((uint8_t)i));
+  trace_capture.last_frame = now;
+  trace_capture.len = len;
+  trace_capture.pos = 0;
+}
+
 void command_init(void) {}
 
 void command_process(const uint8_t *buf) {
@@ -39,20 +343,32 @@ void command_process(const uint8_t *buf) {
   command_out_buffer_t *out = (command_out_buffer_t *)out_buf;
 
   bool success = true;
+  // Clear the reply of the previous command, so that the fields not set by
+  // this command are zero. The replies to the streaming commands rely on it to
+  // differ from the reports pushed by the streams.
+  memset(out_buf, 0, sizeof(out_buf));
+  // The host is interacting with the keyboard, e.g. to calibrate the keys
+  idle_wake();
+  transaction.last_command = timer_read();
   switch (in->command_id) {
   case COMMAND_FIRMWARE_VERSION: {
     out->firmware_version = FIRMWARE_VERSION;
     break;
   }
   case COMMAND_REBOOT: {
+    wear_leveling_flush();
     board_reset();
     break;
   }
   case COMMAND_BOOTLOADER: {
+    wear_leveling_flush();
     board_enter_bootloader();
     break;
   }
   case COMMAND_FACTORY_RESET: {
+    // The staged writes would be applied on top of the reset configuration
+    COMMAND_VERIFY(!transaction.active);
+
     advanced_key_clear();
     success = eeconfig_reset();
     layout_load_advanced_keys();
@@ -99,6 +415,8 @@ void command_process(const uint8_t *buf) {
     const command_in_reset_profile_t *p = &in->reset_profile;
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
+    // The staged writes would be applied on top of the reset profile
+    COMMAND_VERIFY(!transaction.active);
 
     if (p->profile == eeconfig->current_profile)
       advanced_key_clear();
@@ -112,11 +430,14 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->src_profile < NUM_PROFILES);
+    // The staged writes would be applied on top of the duplicated profile
+    COMMAND_VERIFY(!transaction.active);
+
+    COMMAND_VERIFY(EECONFIG_READ(profiles[p->src_profile], &blob_profile));
 
     if (p->profile == eeconfig->current_profile)
       advanced_key_clear();
-    success = EECONFIG_WRITE(profiles[p->profile],
-                             &eeconfig->profiles[p->src_profile]);
+    success = EECONFIG_WRITE(profiles[p->profile], &blob_profile);
     if (p->profile == eeconfig->current_profile)
       layout_load_advanced_keys();
     break;
@@ -128,10 +449,10 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->layer < NUM_LAYERS);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->keymap,
-           eeconfig->profiles[p->profile].keymap[p->layer] + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->keymap), (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(uint8_t));
+    success = EECONFIG_READ_N(
+        profiles[p->profile].keymap[p->layer][p->offset], out->keymap,
+        M_MIN(M_ARRAY_SIZE(out->keymap), (uint32_t)(NUM_KEYS - p->offset)) *
+            sizeof(uint8_t));
     break;
   }
   case COMMAND_GET_METADATA: {
@@ -145,10 +466,61 @@ void command_process(const uint8_t *buf) {
     break;
   }
   case COMMAND_GET_SERIAL: {
-    memset(out->serial, 0, sizeof(out->serial));
     board_serial(out->serial);
     break;
   }
+  case COMMAND_ANALOG_STREAM: {
+    const command_in_analog_stream_t *p = &in->analog_stream;
+
+    COMMAND_VERIFY(p->interval == 0 ||
+                   p->interval >= COMMAND_ANALOG_STREAM_MIN_INTERVAL);
+
+    memset(&analog_stream, 0, sizeof(analog_stream));
+    analog_stream.interval = p->interval;
+    analog_stream.threshold = p->threshold;
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+      bitmap_set(analog_stream.keys, i, (p->keys[i / 8] >> (i & 7)) & 1);
+      // Force the first frame to include every subscribed key
+      analog_stream.adc_values[i] = ~key_matrix[i].adc_filtered;
+    }
+    break;
+  }
+  case COMMAND_TRACE_CAPTURE: {
+    const command_in_trace_capture_t *p = &in->trace_capture;
+    const trace_header_t header = {
+        .magic = TRACE_MAGIC,
+        .version = TRACE_VERSION,
+        .adc_resolution = ADC_RESOLUTION,
+        .num_keys = NUM_KEYS,
+    };
+
+    COMMAND_VERIFY(p->interval == 0 ||
+                   p->interval >= COMMAND_TRACE_CAPTURE_MIN_INTERVAL);
+
+    memset(&trace_capture, 0, sizeof(trace_capture));
+    trace_capture.interval = p->interval;
+    trace_capture.last_frame = timer_read();
+    // Send the header before the first frame
+    memcpy(trace_capture.buf, &header, sizeof(header));
+    trace_capture.len = sizeof(header);
+    break;
+  }
+  case COMMAND_BEGIN_TRANSACTION: {
+    // Discard any transaction that was not committed
+    memset(&transaction, 0, sizeof(transaction));
+    transaction.active = true;
+    transaction.last_command = timer_read();
+    break;
+  }
+  case COMMAND_COMMIT_TRANSACTION: {
+    success = command_commit_transaction();
+    break;
+  }
+  case COMMAND_ABORT_TRANSACTION: {
+    success = transaction.active;
+    memset(&transaction, 0, sizeof(transaction));
+    break;
+  }
   case COMMAND_SAVE_CALIBRATION_THRESHOLD: {
     uint16_t bottom_out_threshold[NUM_KEYS];
 
@@ -161,6 +533,112 @@ void command_process(const uint8_t *buf) {
     }
     success = EECONFIG_WRITE(bottom_out_threshold, bottom_out_threshold);
     break;
+  }
+  case COMMAND_GET_SWITCH_MODELS: {
+    const command_in_switch_models_t *p = &in->switch_models;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+
+    memcpy(out->switch_models, eeconfig->switch_models + p->offset,
+           M_MIN(M_ARRAY_SIZE(out->switch_models),
+                 (uint32_t)(NUM_KEYS - p->offset)) *
+               sizeof(uint8_t));
+    break;
+  }
+  case COMMAND_SET_SWITCH_MODELS: {
+    const command_in_switch_models_t *p = &in->switch_models;
+    bool valid = true;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+    COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->switch_models) &&
+                   p->len <= NUM_KEYS - p->offset);
+    for (uint32_t i = 0; i < p->len; i++)
+      valid &= p->switch_models[i] < DISTANCE_NUM_LUTS;
+    COMMAND_VERIFY(valid);
+
+    success = EECONFIG_WRITE_N(switch_models[p->offset], p->switch_models,
+                               sizeof(uint8_t) * p->len);
+    break;
+  }
+  case COMMAND_GET_WEAR_STATS: {
+    command_out_wear_stats_t *o = &out->wear_stats;
+    wl_stats_t stats;
+
+    wear_leveling_get_stats(&stats);
+    o->stats = stats;
+    o->write_amplification =
+        stats.user_bytes > 0
+            ? (uint32_t)(stats.flash_bytes * 100 / stats.user_bytes)
+            : 0;
+    break;
+  }
+  case COMMAND_GET_IDLE_STATS: {
+    idle_stats_t stats;
+
+    idle_get_stats(&stats);
+    out->idle_stats = stats;
+    break;
+  }
+  case COMMAND_NOISE_DIAGNOSTICS: {
+    const command_in_noise_diagnostics_t *p = &in->noise_diagnostics;
+
+    COMMAND_VERIFY(COMMAND_IS_BOOL(p->save));
+
+    noise_start(p->duration, p->save);
+    break;
+  }
+  case COMMAND_GET_NOISE_STATS: {
+    const command_in_noise_stats_t *p = &in->noise_stats;
+    command_out_noise_stats_t *o = &out->noise_stats;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+
+    o->active = noise_is_active();
+    for (uint32_t i = 0;
+         i < M_ARRAY_SIZE(o->stats) && i + p->offset < NUM_KEYS; i++) {
+      noise_stats_t stats;
+
+      noise_get_stats(i + p->offset, &stats);
+      o->stats[i] = stats;
+    }
+    break;
+  }
+  case COMMAND_GET_CALIBRATION_EPSILON: {
+    const command_in_calibration_epsilon_t *p = &in->calibration_epsilon;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+
+    memcpy(out->calibration_epsilon, eeconfig->calibration_epsilon + p->offset,
+           M_MIN(M_ARRAY_SIZE(out->calibration_epsilon),
+                 (uint32_t)(NUM_KEYS - p->offset)) *
+               sizeof(uint8_t));
+    break;
+  }
+  case COMMAND_SET_CALIBRATION_EPSILON: {
+    const command_in_calibration_epsilon_t *p = &in->calibration_epsilon;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+    COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->calibration_epsilon) &&
+                   p->len <= NUM_KEYS - p->offset);
+
+    success =
+        EECONFIG_WRITE_N(calibration_epsilon[p->offset], p->calibration_epsilon,
+                         sizeof(uint8_t) * p->len);
+    break;
+  }
+  case COMMAND_GET_AUTO_TUNE: {
+    const command_in_auto_tune_t *p = &in->auto_tune;
+
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+
+    for (uint32_t i = 0;
+         i < M_ARRAY_SIZE(out->auto_tune) && i + p->offset < NUM_KEYS; i++) {
+      noise_tune_t tune;
+
+      noise_get_tune(i + p->offset, &tune);
+      out->auto_tune[i] = tune;
+    }
+    break;
   }
     //--------------------------------------------------------------------+
     // Per-profile commands
@@ -174,8 +652,8 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->keymap) &&
                    p->len <= NUM_KEYS - p->offset);
 
-    success = EECONFIG_WRITE_N(profiles[p->profile].keymap[p->layer][p->offset],
-                               p->keymap, sizeof(uint8_t) * p->len);
+    success = COMMAND_WRITE_N(profiles[p->profile].keymap[p->layer][p->offset],
+                              p->keymap, sizeof(uint8_t) * p->len);
     break;
   }
   case COMMAND_GET_ACTUATION_MAP: {
@@ -184,11 +662,11 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->actuation_map,
-           eeconfig->profiles[p->profile].actuation_map + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->actuation_map),
-                 (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(actuation_t));
+    success = EECONFIG_READ_N(profiles[p->profile].actuation_map[p->offset],
+                              out->actuation_map,
+                              M_MIN(M_ARRAY_SIZE(out->actuation_map),
+                                    (uint32_t)(NUM_KEYS - p->offset)) *
+                                  sizeof(actuation_t));
     break;
   }
   case COMMAND_SET_ACTUATION_MAP: {
@@ -198,9 +676,16 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->offset < NUM_KEYS);
     COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->actuation_map) &&
                    p->len <= NUM_KEYS - p->offset);
+    COMMAND_VERIFY(command_verify_actuation_map(p->actuation_map, p->len));
+
+    const actuation_fine_t actuation_fine_map[M_ARRAY_SIZE(p->actuation_map)] =
+        {0};
 
-    success = EECONFIG_WRITE_N(profiles[p->profile].actuation_map[p->offset],
-                               p->actuation_map, sizeof(actuation_t) * p->len);
+    success =
+        COMMAND_WRITE_N(profiles[p->profile].actuation_map[p->offset],
+                        p->actuation_map, sizeof(actuation_t) * p->len) &&
+        COMMAND_WRITE_N(profiles[p->profile].actuation_fine_map[p->offset],
+                        actuation_fine_map, sizeof(actuation_fine_t) * p->len);
     break;
   }
   case COMMAND_GET_ADVANCED_KEYS: {
@@ -209,11 +694,11 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_ADVANCED_KEYS);
 
-    memcpy(out->advanced_keys,
-           eeconfig->profiles[p->profile].advanced_keys + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->advanced_keys),
-                 (uint32_t)(NUM_ADVANCED_KEYS - p->offset)) *
-               sizeof(advanced_key_t));
+    success = EECONFIG_READ_N(profiles[p->profile].advanced_keys[p->offset],
+                              out->advanced_keys,
+                              M_MIN(M_ARRAY_SIZE(out->advanced_keys),
+                                    (uint32_t)(NUM_ADVANCED_KEYS - p->offset)) *
+                                  sizeof(advanced_key_t));
     break;
   }
   case COMMAND_SET_ADVANCED_KEYS: {
@@ -223,12 +708,23 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->offset < NUM_ADVANCED_KEYS);
     COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->advanced_keys) &&
                    p->len <= NUM_ADVANCED_KEYS - p->offset);
+    COMMAND_VERIFY(command_verify_advanced_keys(p->advanced_keys, p->len));
+
+    if (transaction.active) {
+      // The advanced keys will be reloaded when the transaction is committed
+      transaction.reload_advanced_keys |=
+          (p->profile == eeconfig->current_profile);
+      success =
+          COMMAND_WRITE_N(profiles[p->profile].advanced_keys[p->offset],
+                          p->advanced_keys, sizeof(advanced_key_t) * p->len);
+      break;
+    }
 
     if (p->profile == eeconfig->current_profile)
       advanced_key_clear();
     success =
-        EECONFIG_WRITE_N(profiles[p->profile].advanced_keys[p->offset],
-                         p->advanced_keys, sizeof(advanced_key_t) * p->len);
+        COMMAND_WRITE_N(profiles[p->profile].advanced_keys[p->offset],
+                        p->advanced_keys, sizeof(advanced_key_t) * p->len);
     if (p->profile == eeconfig->current_profile)
       layout_load_advanced_keys();
     break;
@@ -238,7 +734,7 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    out->tick_rate = eeconfig->profiles[p->profile].tick_rate;
+    success = EECONFIG_READ(profiles[p->profile].tick_rate, &out->tick_rate);
     break;
   }
   case COMMAND_SET_TICK_RATE: {
@@ -246,7 +742,7 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    success = EECONFIG_WRITE(profiles[p->profile].tick_rate, &p->tick_rate);
+    success = COMMAND_WRITE(profiles[p->profile].tick_rate, &p->tick_rate);
     break;
   }
   case COMMAND_GET_GAMEPAD_BUTTONS: {
@@ -255,11 +751,11 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
     COMMAND_VERIFY(p->offset < NUM_KEYS);
 
-    memcpy(out->gamepad_buttons,
-           eeconfig->profiles[p->profile].gamepad_buttons + p->offset,
-           M_MIN(M_ARRAY_SIZE(out->gamepad_buttons),
-                 (uint32_t)(NUM_KEYS - p->offset)) *
-               sizeof(uint8_t));
+    success = EECONFIG_READ_N(profiles[p->profile].gamepad_buttons[p->offset],
+                              out->gamepad_buttons,
+                              M_MIN(M_ARRAY_SIZE(out->gamepad_buttons),
+                                    (uint32_t)(NUM_KEYS - p->offset)) *
+                                  sizeof(uint8_t));
     break;
   }
   case COMMAND_SET_GAMEPAD_BUTTONS: {
@@ -270,8 +766,8 @@ void command_process(const uint8_t *buf) {
     COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->gamepad_buttons) &&
                    p->len <= NUM_KEYS - p->offset);
 
-    success = EECONFIG_WRITE_N(profiles[p->profile].gamepad_buttons[p->offset],
-                               p->gamepad_buttons, sizeof(uint8_t) * p->len);
+    success = COMMAND_WRITE_N(profiles[p->profile].gamepad_buttons[p->offset],
+                              p->gamepad_buttons, sizeof(uint8_t) * p->len);
     break;
   }
   case COMMAND_GET_GAMEPAD_OPTIONS: {
@@ -279,7 +775,8 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    out->gamepad_options = eeconfig->profiles[p->profile].gamepad_options;
+    success = EECONFIG_READ(profiles[p->profile].gamepad_options,
+                            &out->gamepad_options);
     break;
   }
   case COMMAND_SET_GAMEPAD_OPTIONS: {
@@ -287,8 +784,138 @@ void command_process(const uint8_t *buf) {
 
     COMMAND_VERIFY(p->profile < NUM_PROFILES);
 
-    success = EECONFIG_WRITE(profiles[p->profile].gamepad_options,
-                             &p->gamepad_options);
+    success = COMMAND_WRITE(profiles[p->profile].gamepad_options,
+                            &p->gamepad_options);
+    break;
+  }
+  case COMMAND_EXPORT_PROFILE: {
+    const command_in_export_profile_t *p = &in->export_profile;
+    command_out_export_profile_t *o = &out->export_profile;
+
+    COMMAND_VERIFY(p->profile < NUM_PROFILES);
+    // The profile is encoded once when the first chunk is requested
+    COMMAND_VERIFY(p->offset > 0 || command_encode_profile_blob(p->profile));
+    COMMAND_VERIFY(profile_blob.command_id == COMMAND_EXPORT_PROFILE &&
+                   profile_blob.profile == p->profile);
+    COMMAND_VERIFY(p->offset < profile_blob.len);
+
+    o->len = profile_blob.len;
+    memcpy(o->data, profile_blob.buf + p->offset,
+           M_MIN(M_ARRAY_SIZE(o->data), profile_blob.len - p->offset));
+    break;
+  }
+  case COMMAND_IMPORT_PROFILE: {
+    const command_in_import_profile_t *p = &in->import_profile;
+    const command_profile_blob_header_t *header =
+        (const command_profile_blob_header_t *)profile_blob.buf;
+
+    COMMAND_VERIFY(p->profile < NUM_PROFILES);
+    COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->data));
+    if (p->offset == 0) {
+      profile_blob.command_id = COMMAND_IMPORT_PROFILE;
+      profile_blob.profile = p->profile;
+      profile_blob.len = 0;
+    }
+    COMMAND_VERIFY(profile_blob.command_id == COMMAND_IMPORT_PROFILE &&
+                   profile_blob.profile == p->profile);
+    COMMAND_VERIFY(p->offset == profile_blob.len &&
+                   p->len <= sizeof(profile_blob.buf) - p->offset);
+
+    memcpy(profile_blob.buf + p->offset, p->data, p->len);
+    profile_blob.len += p->len;
+    if (profile_blob.len < sizeof(*header) ||
+        profile_blob.len < sizeof(*header) + header->len)
+      // Wait for the remaining chunks
+      break;
+
+    // The blob is complete so the buffer is released regardless of the result
+    profile_blob.command_id = COMMAND_UNKNOWN;
+    COMMAND_VERIFY(profile_blob.len == sizeof(*header) + header->len);
+    COMMAND_VERIFY(command_decode_profile_blob());
+    COMMAND_VERIFY(
+        command_verify_actuation_map(blob_profile.actuation_map, NUM_KEYS) &&
+        command_verify_advanced_keys(blob_profile.advanced_keys,
+                                     NUM_ADVANCED_KEYS));
+
+    if (transaction.active) {
+      // The advanced keys will be reloaded when the transaction is committed
+      transaction.reload_advanced_keys |=
+          (p->profile == eeconfig->current_profile);
+      success = COMMAND_WRITE(profiles[p->profile], &blob_profile);
+      break;
+    }
+
+    if (p->profile == eeconfig->current_profile)
+      advanced_key_clear();
+    success = COMMAND_WRITE(profiles[p->profile], &blob_profile);
+    if (p->profile == eeconfig->current_profile)
+      layout_load_advanced_keys();
+    break;
+  }
+  case COMMAND_GET_ACTUATION_MAP_WIDE: {
+    const command_in_actuation_map_wide_t *p = &in->actuation_map_wide;
+    actuation_t actuation_map[M_ARRAY_SIZE(out->actuation_map_wide)];
+    actuation_fine_t actuation_fine_map[M_ARRAY_SIZE(out->actuation_map_wide)];
+
+    COMMAND_VERIFY(p->profile < NUM_PROFILES);
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+
+    const uint32_t len = M_MIN(M_ARRAY_SIZE(out->actuation_map_wide),
+                               (uint32_t)(NUM_KEYS - p->offset));
+    success =
+        EECONFIG_READ_N(profiles[p->profile].actuation_map[p->offset],
+                        actuation_map, sizeof(actuation_t) * len) &&
+        EECONFIG_READ_N(profiles[p->profile].actuation_fine_map[p->offset],
+                        actuation_fine_map, sizeof(actuation_fine_t) * len);
+    for (uint32_t i = 0; success && i < len; i++) {
+      const actuation_t *a = &actuation_map[i];
+      const actuation_fine_t *f = &actuation_fine_map[i];
+
+      out->actuation_map_wide[i] = (actuation_wide_t){
+          .actuation_point = (uint16_t)(a->actuation_point << 8 |
+                                        f->actuation_point),
+          .rt_down = (uint16_t)(a->rt_down << 8 | f->rt_down),
+          .rt_up = (uint16_t)(a->rt_up << 8 | f->rt_up),
+          .continuous = a->continuous,
+      };
+    }
+    break;
+  }
+  case COMMAND_SET_ACTUATION_MAP_WIDE: {
+    const command_in_actuation_map_wide_t *p = &in->actuation_map_wide;
+    actuation_t actuation_map[M_ARRAY_SIZE(p->actuation_map)];
+    actuation_fine_t actuation_fine_map[M_ARRAY_SIZE(p->actuation_map)];
+    bool valid = true;
+
+    COMMAND_VERIFY(p->profile < NUM_PROFILES);
+    COMMAND_VERIFY(p->offset < NUM_KEYS);
+    COMMAND_VERIFY(p->len <= M_ARRAY_SIZE(p->actuation_map) &&
+                   p->len <= NUM_KEYS - p->offset);
+    for (uint32_t i = 0; i < p->len; i++)
+      valid &= COMMAND_IS_BOOL(p->actuation_map[i].continuous);
+    COMMAND_VERIFY(valid);
+
+    for (uint32_t i = 0; i < p->len; i++) {
+      const actuation_wide_t *w = &p->actuation_map[i];
+
+      actuation_map[i] = (actuation_t){
+          .actuation_point = (uint8_t)(w->actuation_point >> 8),
+          .rt_down = (uint8_t)(w->rt_down >> 8),
+          .rt_up = (uint8_t)(w->rt_up >> 8),
+          .continuous = w->continuous,
+      };
+      actuation_fine_map[i] = (actuation_fine_t){
+          .actuation_point = (uint8_t)w->actuation_point,
+          .rt_down = (uint8_t)w->rt_down,
+          .rt_up = (uint8_t)w->rt_up,
+      };
+    }
+
+    success =
+        COMMAND_WRITE_N(profiles[p->profile].actuation_map[p->offset],
+                        actuation_map, sizeof(actuation_t) * p->len) &&
+        COMMAND_WRITE_N(profiles[p->profile].actuation_fine_map[p->offset],
+                        actuation_fine_map, sizeof(actuation_fine_t) * p->len);
     break;
   }
   default: {
@@ -298,6 +925,26 @@ void command_process(const uint8_t *buf) {
   }
   }
 
+  if (transaction.active) {
+    switch (in->command_id) {
+    case COMMAND_SET_KEYMAP:
+    case COMMAND_SET_ACTUATION_MAP:
+    case COMMAND_SET_ADVANCED_KEYS:
+    case COMMAND_SET_TICK_RATE:
+    case COMMAND_SET_GAMEPAD_BUTTONS:
+    case COMMAND_SET_GAMEPAD_OPTIONS:
+    case COMMAND_IMPORT_PROFILE:
+    case COMMAND_SET_ACTUATION_MAP_WIDE:
+      // Staged commands are acknowledged once when the transaction is
+      // committed
+      transaction.failed |= !success;
+      return;
+
+    default:
+      break;
+    }
+  }
+
   // Echo the command ID back to the host if successful
   out->command_id = success ? in->command_id : COMMAND_UNKNOWN;
 
@@ -306,3 +953,103 @@ void command_process(const uint8_t *buf) {
     tud_task();
   tud_hid_n_report(USB_ITF_RAW_HID, 0, out_buf, RAW_HID_EP_SIZE);
 }
+
+/**
+ * @brief Send the next report of the analog stream if any
+ *
+ * @return None
+ */
+static void command_analog_stream_task(void) {
+  command_out_buffer_t *out = (command_out_buffer_t *)analog_stream_buf;
+  command_out_analog_stream_t *o = &out->analog_stream;
+
+  if (analog_stream.interval == 0 || !tud_hid_n_ready(USB_ITF_RAW_HID))
+    return;
+
+  if (!analog_stream.in_frame) {
+    if (timer_elapsed(analog_stream.last_frame) < analog_stream.interval)
+      return;
+
+    if (!command_analog_stream_start_frame() &&
+        ++analog_stream.empty_frames < COMMAND_ANALOG_STREAM_KEEPALIVE) {
+      // Skip the report since no subscribed key has changed, leaving the IN
+      // endpoint to the command replies
+      analog_stream.frame++;
+      return;
+    }
+    analog_stream.empty_frames = 0;
+    analog_stream.in_frame = true;
+  }
+
+  memset(analog_stream_buf, 0, sizeof(analog_stream_buf));
+  out->command_id = COMMAND_ANALOG_STREAM;
+  o->frame = analog_stream.frame;
+  o->last = true;
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    if (!bitmap_get(analog_stream.pending, i))
+      continue;
+
+    if (o->len == M_ARRAY_SIZE(o->entries)) {
+      // The remaining keys will be sent in the next report
+      o->last = false;
+      break;
+    }
+
+    bitmap_set(analog_stream.pending, i, 0);
+    analog_stream.adc_values[i] = key_matrix[i].adc_filtered;
+    analog_stream.distances[i] = key_matrix[i].distance;
+    o->entries[o->len++] = (command_out_analog_stream_entry_t){
+        .key = i,
+        .adc_value = analog_stream.adc_values[i],
+        .distance = analog_stream.distances[i],
+    };
+  }
+
+  if (o->last) {
+    analog_stream.frame++;
+    analog_stream.in_frame = false;
+  }
+  tud_hid_n_report(USB_ITF_RAW_HID, 0, analog_stream_buf, RAW_HID_EP_SIZE);
+}
+
+/**
+ * @brief Send the next report of the trace capture if any
+ *
+ * @return None
+ */
+static void command_trace_capture_task(void) {
+  command_out_buffer_t *out = (command_out_buffer_t *)trace_capture_buf;
+  command_out_trace_capture_t *o = &out->trace_capture;
+
+  if (trace_capture.interval == 0 || !tud_hid_n_ready(USB_ITF_RAW_HID))
+    return;
+
+  if (trace_capture.pos == trace_capture.len) {
+    if (timer_elapsed(trace_capture.last_frame) < trace_capture.interval)
+      return;
+    command_trace_capture_frame();
+  }
+
+  memset(trace_capture_buf, 0, sizeof(trace_capture_buf));
+  out->command_id = COMMAND_TRACE_CAPTURE;
+  o->seq = trace_capture.seq++;
+  o->len = (uint8_t)M_MIN(sizeof(o->data),
+                          trace_capture.len - trace_capture.pos);
+  memcpy(o->data, trace_capture.buf + trace_capture.pos, o->len);
+  trace_capture.pos += o->len;
+  tud_hid_n_report(USB_ITF_RAW_HID, 0, trace_capture_buf, RAW_HID_EP_SIZE);
+}
+
+void command_task(void) {
+  if (transaction.active &&
+      timer_elapsed(transaction.last_command) >= COMMAND_TRANSACTION_TIMEOUT)
+    // The host is no longer sending the commands of the transaction
+    memset(&transaction, 0, sizeof(transaction));
+
+  if (analog_stream.interval != 0 || trace_capture.interval != 0)
+    // The streams must sample the keys at full rate
+    idle_wake();
+
+  command_analog_stream_task();
+  command_trace_capture_task();
+}
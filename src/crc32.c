@@ -18,16 +18,56 @@
 // zlib's CRC32 polynomial
 #define CRC32_POLY 0xEDB88320
 
+#if CRC32_SLICES > 0
+// `crc32_table[n][i]` is the CRC32 of byte `i` followed by `n` zero bytes
+static uint32_t crc32_table[CRC32_SLICES][256];
+#endif
+
 __attribute__((always_inline)) static inline uint32_t crc32_update(uint32_t crc,
                                                                    uint32_t k) {
   crc ^= k;
+#if CRC32_SLICES >= 4
+  crc = crc32_table[3][crc & 0xFF] ^ crc32_table[2][(crc >> 8) & 0xFF] ^
+        crc32_table[1][(crc >> 16) & 0xFF] ^ crc32_table[0][crc >> 24];
+#elif CRC32_SLICES == 1
+  for (uint32_t i = 0; i < 4; i++)
+    crc = (crc >> 8) ^ crc32_table[0][crc & 0xFF];
+#else
   for (uint32_t i = 0; i < 32; i++)
     crc = (crc >> 1) ^ (CRC32_POLY & (uint32_t)(-(int32_t)(crc & 1)));
+#endif
 
   return crc;
 }
 
-__attribute__((weak)) void crc32_init(void) {}
+#if CRC32_SLICES == 8
+__attribute__((always_inline)) static inline uint32_t
+crc32_update2(uint32_t crc, uint32_t k0, uint32_t k1) {
+  crc ^= k0;
+
+  return crc32_table[7][crc & 0xFF] ^ crc32_table[6][(crc >> 8) & 0xFF] ^
+         crc32_table[5][(crc >> 16) & 0xFF] ^ crc32_table[4][crc >> 24] ^
+         crc32_table[3][k1 & 0xFF] ^ crc32_table[2][(k1 >> 8) & 0xFF] ^
+         crc32_table[1][(k1 >> 16) & 0xFF] ^ crc32_table[0][k1 >> 24];
+}
+#endif
+
+__attribute__((weak)) void crc32_init(void) {
+#if CRC32_SLICES > 0
+  for (uint32_t i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (uint32_t j = 0; j < 8; j++)
+      crc = (crc >> 1) ^ (CRC32_POLY & (uint32_t)(-(int32_t)(crc & 1)));
+    crc32_table[0][i] = crc;
+  }
+
+  for (uint32_t n = 1; n < CRC32_SLICES; n++) {
+    for (uint32_t i = 0; i < 256; i++)
+      crc32_table[n][i] = (crc32_table[n - 1][i] >> 8) ^
+                          crc32_table[0][crc32_table[n - 1][i] & 0xFF];
+  }
+#endif
+}
 
 __attribute__((weak)) uint32_t crc32_compute(const void *buf, uint32_t len,
                                              uint32_t crc) {
@@ -35,11 +75,27 @@ __attribute__((weak)) uint32_t crc32_compute(const void *buf, uint32_t len,
   uint32_t k;
 
   crc = ~crc;
+#if CRC32_SLICES == 8
+  for (uint32_t i = len >> 3; i; i--) {
+    uint32_t k1;
+
+    memcpy(&k, buf8, sizeof(k));
+    memcpy(&k1, buf8 + sizeof(k), sizeof(k1));
+    buf8 += sizeof(k) + sizeof(k1);
+    crc = crc32_update2(crc, k, k1);
+  }
+  if (len & 4) {
+    memcpy(&k, buf8, sizeof(k));
+    buf8 += sizeof(k);
+    crc = crc32_update(crc, k);
+  }
+#else
   for (uint32_t i = len >> 2; i; i--) {
     memcpy(&k, buf8, sizeof(k));
     buf8 += sizeof(k);
     crc = crc32_update(crc, k);
   }
+#endif
 
   if (len & 3) {
     k = 0;
@@ -49,3 +105,11 @@ __attribute__((weak)) uint32_t crc32_compute(const void *buf, uint32_t len,
 
   return ~crc;
 }
+
+__attribute__((weak)) bool crc32_compute_async(const void *buf, uint32_t len,
+                                               uint32_t crc,
+                                               crc32_callback_t callback) {
+  callback(crc32_compute(buf, len, crc));
+
+  return true;
+}
@@ -16,6 +16,7 @@
 #include "eeconfig.h"
 
 #include "keycodes.h"
+#include "lib/compress.h"
 #include "migration.h"
 
 const eeconfig_t *eeconfig;
@@ -25,11 +26,169 @@ static eeconfig_options_t default_options = DEFAULT_OPTIONS;
 static eeconfig_calibration_t default_calibration = DEFAULT_CALIBRATION;
 static const uint8_t
     default_keymaps[NUM_PROFILES][NUM_LAYERS][NUM_KEYS] = DEFAULT_KEYMAPS;
+static const uint8_t default_switch_models[NUM_KEYS] = DEFAULT_SWITCH_MODELS;
 static eeconfig_profile_t default_profile = {
     .gamepad_options = DEFAULT_GAMEPAD_OPTIONS,
     .tick_rate = DEFAULT_TICK_RATE,
 };
 
+#if defined(EECONFIG_COMPACT_PROFILES)
+// Expanded current profile
+static eeconfig_profile_t current_profile;
+const eeconfig_profile_t *const eeconfig_current_profile = &current_profile;
+
+// Expanded profile being read or modified
+static eeconfig_profile_t scratch_profile;
+// Compressed delta being written
+static eeconfig_profile_delta_t scratch_delta;
+
+_Static_assert(offsetof(eeconfig_profile_t, keymap) == 0,
+               "Keymap must be the first field of the profile.");
+
+/**
+ * @brief XOR a profile with its default profile
+ *
+ * @param profile Profile index
+ * @param buf Expanded profile
+ *
+ * @return None
+ */
+static void eeconfig_xor_default_profile(uint8_t profile,
+                                         eeconfig_profile_t *buf) {
+  const uint8_t *keymap = (const uint8_t *)default_keymaps[profile];
+  const uint8_t *others = (const uint8_t *)&default_profile;
+  uint8_t *dst = (uint8_t *)buf;
+
+  for (uint32_t i = 0; i < sizeof(eeconfig_profile_t); i++)
+    dst[i] ^= i < sizeof(default_profile.keymap) ? keymap[i] : others[i];
+}
+
+void eeconfig_get_default_profile(uint8_t profile, eeconfig_profile_t *dst) {
+  memcpy(dst, &default_profile, sizeof(*dst));
+  memcpy(dst->keymap, default_keymaps[profile], sizeof(dst->keymap));
+}
+
+/**
+ * @brief Expand a profile from its compressed delta
+ *
+ * @param profile Profile index
+ * @param dst Buffer to expand the profile into
+ *
+ * @return true if successful, false if the delta is malformed
+ */
+static bool eeconfig_expand_profile(uint8_t profile, eeconfig_profile_t *dst) {
+  const eeconfig_profile_delta_t *delta =
+      (const eeconfig_profile_delta_t *)(wl_cache +
+                                         EECONFIG_PROFILE_DELTA_ADDR(profile));
+  uint32_t len;
+
+  if (delta->len > sizeof(delta->data) ||
+      !compress_decode((uint8_t *)dst, sizeof(*dst), delta->data, delta->len,
+                       &len) ||
+      len != sizeof(*dst))
+    return false;
+  eeconfig_xor_default_profile(profile, dst);
+
+  return true;
+}
+
+bool eeconfig_store_profile(uint8_t profile, eeconfig_profile_t *buf) {
+  uint32_t len;
+
+  eeconfig_xor_default_profile(profile, buf);
+  const bool status =
+      compress_encode(scratch_delta.data, sizeof(scratch_delta.data),
+                      (const uint8_t *)buf, sizeof(*buf), &len);
+  eeconfig_xor_default_profile(profile, buf);
+  if (!status)
+    return false;
+
+  scratch_delta.len = len;
+  // Only the used part of the slot is written
+  return wear_leveling_write(EECONFIG_PROFILE_DELTA_ADDR(profile),
+                             &scratch_delta, sizeof(scratch_delta.len) + len);
+}
+
+/**
+ * @brief Expand the current profile
+ *
+ * If the delta of the current profile is malformed, the default profile is
+ * used instead.
+ *
+ * @return None
+ */
+static void eeconfig_load_current_profile(void) {
+  const uint8_t profile = eeconfig->current_profile;
+
+  if (profile < NUM_PROFILES &&
+      eeconfig_expand_profile(profile, &current_profile))
+    return;
+
+  if (profile < NUM_PROFILES)
+    eeconfig_get_default_profile(profile, &current_profile);
+  else
+    memcpy(&current_profile, &default_profile, sizeof(current_profile));
+}
+
+/**
+ * @brief Read from a profile
+ *
+ * @param profile Profile index
+ * @param offset Offset in `eeconfig_profile_t` to read from
+ * @param buf Buffer to read into
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool eeconfig_read_profile(uint8_t profile, uint32_t offset, void *buf,
+                                  uint32_t len) {
+  if (profile == eeconfig->current_profile) {
+    memcpy(buf, (const uint8_t *)&current_profile + offset, len);
+    return true;
+  }
+
+  if (!eeconfig_expand_profile(profile, &scratch_profile))
+    return false;
+  memcpy(buf, (const uint8_t *)&scratch_profile + offset, len);
+
+  return true;
+}
+
+/**
+ * @brief Write to a profile
+ *
+ * The profile is expanded, modified, and stored back as a compressed delta.
+ *
+ * @param profile Profile index
+ * @param offset Offset in `eeconfig_profile_t` to write to
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool eeconfig_write_profile(uint8_t profile, uint32_t offset,
+                                   const void *buf, uint32_t len) {
+  const bool is_current = profile == eeconfig->current_profile;
+
+  if (len < sizeof(eeconfig_profile_t)) {
+    // Expand the profile to keep the bytes that are not overwritten
+    if (is_current)
+      memcpy(&scratch_profile, &current_profile, sizeof(scratch_profile));
+    else if (!eeconfig_expand_profile(profile, &scratch_profile))
+      return false;
+  }
+
+  memcpy((uint8_t *)&scratch_profile + offset, buf, len);
+  if (!eeconfig_store_profile(profile, &scratch_profile))
+    return false;
+
+  if (is_current)
+    memcpy(&current_profile, &scratch_profile, sizeof(current_profile));
+
+  return true;
+}
+#endif
+
 static bool eeconfig_write_default_profile(uint8_t profile) {
   if (profile >= NUM_PROFILES)
     return false;
@@ -40,8 +199,11 @@ static bool eeconfig_write_default_profile(uint8_t profile) {
 }
 
 static bool eeconfig_is_latest_version(void) {
+  uint32_t magic_end;
+
   return eeconfig->magic_start == EECONFIG_MAGIC_START &&
-         eeconfig->magic_end == EECONFIG_MAGIC_END &&
+         EECONFIG_READ(magic_end, &magic_end) &&
+         magic_end == EECONFIG_MAGIC_END &&
          eeconfig->version == EECONFIG_VERSION;
 }
 
@@ -53,6 +215,9 @@ void eeconfig_init(void) {
   eeconfig = (const eeconfig_t *)wl_cache;
   if (!eeconfig_is_latest_version() && !migration_try_migrate())
     eeconfig_reset();
+#if defined(EECONFIG_COMPACT_PROFILES)
+  eeconfig_load_current_profile();
+#endif
 }
 
 // Helper macro for writing rvalue
@@ -64,6 +229,7 @@ void eeconfig_init(void) {
 
 bool eeconfig_reset(void) {
   uint16_t bottom_out_threshold[NUM_KEYS] = {0};
+  uint8_t calibration_epsilon[NUM_KEYS] = {0};
 
   // We must not perform any action here that requires reading from
   // the configuration as it may be in an invalid state.
@@ -75,6 +241,8 @@ bool eeconfig_reset(void) {
   status &= EECONFIG_WRITE(options, &default_options);
   EECONFIG_WRITE_LOCAL(current_profile, 0);
   EECONFIG_WRITE_LOCAL(last_non_default_profile, M_MIN(1, NUM_PROFILES - 1));
+  status &= EECONFIG_WRITE(switch_models, default_switch_models);
+  status &= EECONFIG_WRITE(calibration_epsilon, calibration_epsilon);
   for (uint32_t i = 0; i < NUM_PROFILES; i++)
     status &= eeconfig_write_default_profile(i);
   EECONFIG_WRITE_LOCAL(magic_end, EECONFIG_MAGIC_END);
@@ -90,3 +258,107 @@ bool eeconfig_reset_profile(uint8_t profile) {
 
   return eeconfig_write_default_profile(profile);
 }
+
+bool eeconfig_read(uint32_t addr, void *buf, uint32_t len) {
+#if defined(EECONFIG_COMPACT_PROFILES)
+  const uint32_t profiles_start = offsetof(eeconfig_t, profiles);
+  const uint32_t profiles_end = offsetof(eeconfig_t, magic_end);
+  uint8_t *dst = buf;
+
+  if (addr + len > sizeof(eeconfig_t))
+    return false;
+
+  while (len > 0) {
+    uint32_t n = len;
+
+    if (addr < profiles_start) {
+      // Global configurations are stored as they are
+      n = M_MIN(len, profiles_start - addr);
+      if (!wear_leveling_read(addr, dst, n))
+        return false;
+    } else if (addr < profiles_end) {
+      const uint8_t profile =
+          (addr - profiles_start) / sizeof(eeconfig_profile_t);
+      const uint32_t offset =
+          (addr - profiles_start) % sizeof(eeconfig_profile_t);
+
+      n = M_MIN(len, sizeof(eeconfig_profile_t) - offset);
+      if (!eeconfig_read_profile(profile, offset, dst, n))
+        return false;
+    } else if (!wear_leveling_read(
+                   addr - profiles_end +
+                       EECONFIG_PROFILE_DELTA_ADDR(NUM_PROFILES),
+                   dst, n))
+      return false;
+
+    addr += n;
+    dst += n;
+    len -= n;
+  }
+
+  return true;
+#else
+  return wear_leveling_read(addr, buf, len);
+#endif
+}
+
+bool eeconfig_write(uint32_t addr, const void *buf, uint32_t len) {
+#if defined(EECONFIG_COMPACT_PROFILES)
+  const uint32_t profiles_start = offsetof(eeconfig_t, profiles);
+  const uint32_t profiles_end = offsetof(eeconfig_t, magic_end);
+  const uint32_t current_profile_addr = offsetof(eeconfig_t, current_profile);
+  const uint8_t *src = buf;
+
+  if (addr + len > sizeof(eeconfig_t))
+    return false;
+
+  while (len > 0) {
+    uint32_t n = len;
+
+    if (addr < profiles_start) {
+      // Global configurations are stored as they are
+      n = M_MIN(len, profiles_start - addr);
+      if (!wear_leveling_write(addr, src, n))
+        return false;
+      if (addr <= current_profile_addr && current_profile_addr < addr + n)
+        // The current profile is changed
+        eeconfig_load_current_profile();
+    } else if (addr < profiles_end) {
+      const uint8_t profile =
+          (addr - profiles_start) / sizeof(eeconfig_profile_t);
+      const uint32_t offset =
+          (addr - profiles_start) % sizeof(eeconfig_profile_t);
+
+      n = M_MIN(len, sizeof(eeconfig_profile_t) - offset);
+      if (!eeconfig_write_profile(profile, offset, src, n))
+        return false;
+    } else if (!wear_leveling_write(
+                   addr - profiles_end +
+                       EECONFIG_PROFILE_DELTA_ADDR(NUM_PROFILES),
+                   src, n))
+      return false;
+
+    addr += n;
+    src += n;
+    len -= n;
+  }
+
+  return true;
+#else
+  return wear_leveling_write(addr, buf, len);
+#endif
+}
+
+bool eeconfig_write_batch(const wl_write_t *writes, uint32_t num_writes) {
+#if defined(EECONFIG_COMPACT_PROFILES)
+  // The profiles are stored as deltas, so the writes cannot be batched
+  for (uint32_t i = 0; i < num_writes; i++) {
+    if (!eeconfig_write(writes[i].addr, writes[i].buf, writes[i].len))
+      return false;
+  }
+
+  return true;
+#else
+  return wear_leveling_write_batch(writes, num_writes);
+#endif
+}
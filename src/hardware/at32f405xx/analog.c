@@ -87,11 +87,32 @@ static gpio_init_type gpio_init_struct;
 
 // Set to true when `adc_values` is filled for the first time
 static volatile bool adc_initialized = false;
+#if ADC_NUM_MUX_INPUTS > 0
+// Multiplexer channel being converted
+static uint8_t current_mux_channel = 0;
+#endif
+#if defined(ADC_DMA_FRAME)
+// Frames of the conversions of every multiplexer channel for DMA transfer. The
+// DMA writes one frame while the other one is stored in `adc_values`.
+__attribute__((aligned(8))) static volatile uint16_t
+    adc_frames[2][1 << ADC_NUM_MUX_SELECT_PINS]
+              [ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS];
+// Index of the frame being written by the DMA
+static uint8_t adc_frame = 0;
+// DMA destination of the conversions of the current multiplexer channel
+#define ADC_DMA_BUFFER adc_frames[adc_frame][current_mux_channel]
+#else
 // Buffer for DMA transfer
 __attribute__((aligned(8))) static volatile uint16_t
     adc_buffer[ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS];
+#define ADC_DMA_BUFFER adc_buffer
+#endif
 // ADC values for each key
 static volatile uint16_t adc_values[NUM_KEYS];
+// Set to false to stop the conversion loop after each sweep
+static volatile bool adc_continuous = true;
+// Set to true when the conversion loop is stopped after a sweep
+static volatile bool adc_paused = false;
 
 void analog_init(void) {
   // Enable peripheral clocks
@@ -164,7 +185,7 @@ void analog_init(void) {
   dma_default_para_init(&dma_init_struct);
   dma_init_struct.buffer_size = ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS;
   dma_init_struct.direction = DMA_DIR_PERIPHERAL_TO_MEMORY;
-  dma_init_struct.memory_base_addr = (uint32_t)adc_buffer;
+  dma_init_struct.memory_base_addr = (uint32_t)ADC_DMA_BUFFER;
   dma_init_struct.memory_data_width = DMA_MEMORY_DATA_WIDTH_HALFWORD;
   dma_init_struct.memory_inc_enable = TRUE;
   dma_init_struct.peripheral_base_addr = (uint32_t)&ADC1->odt;
@@ -222,19 +243,67 @@ void analog_task(void) {}
 
 uint16_t analog_read(uint8_t key) { return adc_values[key]; }
 
+void analog_set_continuous(bool continuous) {
+  adc_continuous = continuous;
+  if (continuous)
+    analog_start_sweep();
+}
+
+void analog_start_sweep(void) {
+  if (!adc_paused)
+    return;
+
+  adc_paused = false;
+#if ADC_NUM_MUX_INPUTS > 0
+  // The multiplexer select pins are already set to the first channel, but the
+  // outputs still need to settle after the pause.
+  tmr_counter_enable(TMR6, TRUE);
+#else
+  adc_ordinary_software_trigger_enable(ADC1, TRUE);
+#endif
+}
+
 //--------------------------------------------------------------------+
 // Interrupt Handlers
 //--------------------------------------------------------------------+
 
-void DMA1_Channel1_IRQHandler(void) {
-#if ADC_NUM_MUX_INPUTS > 0
-  static uint8_t current_mux_channel = 0;
+#if defined(ADC_DMA_FRAME)
+/**
+ * @brief Store a completed frame in the ADC values of the keys
+ *
+ * @param frame Index of the frame
+ *
+ * @return None
+ */
+static void analog_store_frame(uint8_t frame) {
+  for (uint32_t c = 0; c < (1 << ADC_NUM_MUX_SELECT_PINS); c++) {
+    for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
+      const uint16_t key = mux_input_matrix[c][i];
+      if (key)
+        adc_values[key - 1] = adc_frames[frame][c][i];
+    }
+  }
+
+#if ADC_NUM_RAW_INPUTS > 0
+  // The raw inputs are converted with every multiplexer channel, and the
+  // conversions of the last channel are the most recent.
+  for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
+    const uint16_t key = raw_input_vector[i];
+    if (key)
+      adc_values[key - 1] =
+          adc_frames[frame][(1 << ADC_NUM_MUX_SELECT_PINS) - 1]
+                    [ADC_NUM_MUX_INPUTS + i];
+  }
+#endif
+}
 #endif
 
+void DMA1_Channel1_IRQHandler(void) {
   if (dma_interrupt_flag_get(DMA1_FDT1_FLAG) == SET) {
     // Clear the DMA transfer complete flag
     dma_flag_clear(DMA1_FDT1_FLAG);
 
+#if !defined(ADC_DMA_FRAME)
 #if ADC_NUM_MUX_INPUTS > 0
     for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
       const uint16_t key = mux_input_matrix[current_mux_channel][i];
@@ -250,6 +319,7 @@ void DMA1_Channel1_IRQHandler(void) {
         adc_values[key - 1] = adc_buffer[ADC_NUM_MUX_INPUTS + i];
     }
 #endif
+#endif
 
 #if ADC_NUM_MUX_INPUTS > 0
     current_mux_channel =
@@ -257,19 +327,42 @@ void DMA1_Channel1_IRQHandler(void) {
     // We initialize all the ADC values when we have gone through all the
     // multiplexer input channels.
     adc_initialized |= (current_mux_channel == 0);
+#if defined(ADC_DMA_FRAME)
+    if (current_mux_channel == 0)
+      // The DMA writes the next frame while the completed one is stored
+      adc_frame ^= 1;
+    // Point the DMA to the slice of the next multiplexer channel. The channel
+    // must be disabled to change its memory address.
+    dma_channel_enable(DMA1_CHANNEL1, FALSE);
+    DMA1_CHANNEL1->maddr = (uint32_t)ADC_DMA_BUFFER;
+    dma_channel_enable(DMA1_CHANNEL1, TRUE);
+#endif
 
     // Set the multiplexer select pins
     for (uint32_t i = 0; i < ADC_NUM_MUX_SELECT_PINS; i++)
       gpio_bits_write(mux_select_ports[i], mux_select_pins[i],
                       (confirm_state)((current_mux_channel >> i) & 1));
 
-    // Delay to allow the multiplexer outputs to settle
-    tmr_counter_enable(TMR6, TRUE);
+    if (current_mux_channel == 0 && !adc_continuous)
+      // Stop the conversion loop until the next sweep is requested
+      adc_paused = true;
+    else
+      // Delay to allow the multiplexer outputs to settle
+      tmr_counter_enable(TMR6, TRUE);
+#if defined(ADC_DMA_FRAME)
+    if (current_mux_channel == 0)
+      // Store the completed frame while the multiplexer outputs settle
+      analog_store_frame((uint8_t)(adc_frame ^ 1));
+#endif
 #else
     // We initialize all the ADC values when we have read all the raw input.
     adc_initialized = true;
-    // Immediately start the next conversion
-    adc_ordinary_software_trigger_enable(ADC1, TRUE);
+    if (!adc_continuous)
+      // Stop the conversion loop until the next sweep is requested
+      adc_paused = true;
+    else
+      // Immediately start the next conversion
+      adc_ordinary_software_trigger_enable(ADC1, TRUE);
 #endif
   }
 }
@@ -238,6 +238,8 @@ uint32_t board_serial(char *buf) {
 
 uint32_t board_cycle_count(void) { return DWT->CYCCNT; }
 
+void board_idle(void) { __WFI(); }
+
 //--------------------------------------------------------------------+
 // Interrupt Handlers
 //--------------------------------------------------------------------+
@@ -80,7 +80,24 @@ _Static_assert(M_ARRAY_SIZE(raw_input_vector) == ADC_NUM_RAW_INPUTS,
                "Invalid number of ADC raw inputs");
 #endif
 
+// Number of ADC inputs
+#define ADC_NUM_INPUTS (ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS)
+// Number of conversions of each ADC for each multiplexer channel
+#define ADC_NUM_RANKS                                                          \
+  ((ADC_NUM_INPUTS + ADC_NUM_SIMULTANEOUS - 1) / ADC_NUM_SIMULTANEOUS)
+// Number of conversions for each multiplexer channel. Only the first
+// `ADC_NUM_INPUTS` conversions are used, and the rest pad the sequences of the
+// ADCs to the same length.
+#define ADC_NUM_CONVERSIONS (ADC_NUM_RANKS * ADC_NUM_SIMULTANEOUS)
+
+_Static_assert(ADC_NUM_INPUTS >= ADC_NUM_SIMULTANEOUS,
+               "There must be at least one input for each ADC");
+
 static ADC_HandleTypeDef adc_handle;
+#if ADC_NUM_SIMULTANEOUS > 1
+// ADC2 and ADC3, which follow ADC1 in simultaneous mode
+static ADC_HandleTypeDef adc_slave_handles[ADC_NUM_SIMULTANEOUS - 1];
+#endif
 static DMA_HandleTypeDef dma_handle;
 #if ADC_NUM_MUX_INPUTS > 0
 // We only need a timer to delay the multiplexer outputs
@@ -89,17 +106,60 @@ static TIM_HandleTypeDef tim_handle;
 
 // Set to true when `adc_values` is filled for the first time
 static volatile bool adc_initialized = false;
+#if ADC_NUM_MUX_INPUTS > 0
+// Multiplexer channel being converted
+static uint8_t current_mux_channel = 0;
+#endif
+#if defined(ADC_DMA_FRAME)
+// Frames of the conversions of every multiplexer channel for DMA transfer. The
+// DMA writes one frame while the other one is stored in `adc_values`.
+__attribute__((aligned(8))) static volatile uint16_t
+    adc_frames[2][1 << ADC_NUM_MUX_SELECT_PINS][ADC_NUM_CONVERSIONS];
+// Index of the frame being written by the DMA
+static uint8_t adc_frame = 0;
+// DMA destination of the conversions of the current multiplexer channel
+#define ADC_DMA_BUFFER adc_frames[adc_frame][current_mux_channel]
+#else
 // Buffer for DMA transfer
 __attribute__((aligned(8))) static volatile uint16_t
-    adc_buffer[ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS];
+    adc_buffer[ADC_NUM_CONVERSIONS];
+#define ADC_DMA_BUFFER adc_buffer
+#endif
 // ADC values for each key
 static volatile uint16_t adc_values[NUM_KEYS];
+// Set to false to stop the conversion loop after each sweep
+static volatile bool adc_continuous = true;
+// Set to true when the conversion loop is stopped after a sweep
+static volatile bool adc_paused = false;
+
+/**
+ * @brief Start the conversion of the ADC inputs
+ *
+ * @return None
+ */
+static void analog_start_conversion(void) {
+#if ADC_NUM_SIMULTANEOUS > 1
+  HAL_ADCEx_MultiModeStart_DMA(&adc_handle, (uint32_t *)ADC_DMA_BUFFER,
+                               ADC_NUM_CONVERSIONS);
+#else
+  HAL_ADC_Start_DMA(&adc_handle, (uint32_t *)ADC_DMA_BUFFER,
+                    ADC_NUM_CONVERSIONS);
+#endif
+}
 
 void analog_init(void) {
   ADC_ChannelConfTypeDef channel_config = {0};
+  // ADC channel of each conversion
+  uint8_t channels[ADC_NUM_CONVERSIONS];
 
   // Enable peripheral clocks
   __HAL_RCC_ADC1_CLK_ENABLE();
+#if ADC_NUM_SIMULTANEOUS > 1
+  __HAL_RCC_ADC2_CLK_ENABLE();
+#endif
+#if ADC_NUM_SIMULTANEOUS > 2
+  __HAL_RCC_ADC3_CLK_ENABLE();
+#endif
   __HAL_RCC_DMA2_CLK_ENABLE();
   __HAL_RCC_GPIOA_CLK_ENABLE();
   __HAL_RCC_GPIOB_CLK_ENABLE();
@@ -118,22 +178,41 @@ void analog_init(void) {
   adc_handle.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
   adc_handle.Init.ExternalTrigConv = ADC_SOFTWARE_START;
   adc_handle.Init.DataAlign = ADC_DATAALIGN_RIGHT;
-  adc_handle.Init.NbrOfConversion = ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS;
+  adc_handle.Init.NbrOfConversion = ADC_NUM_RANKS;
   adc_handle.Init.DMAContinuousRequests = DISABLE;
   adc_handle.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
   if (HAL_ADC_Init(&adc_handle) != HAL_OK)
     board_error_handler();
 
+#if ADC_NUM_SIMULTANEOUS > 1
+  {
+    ADC_MultiModeTypeDef multimode = {0};
+
+    // The other ADCs are triggered by ADC1 and share its configuration
+    for (uint32_t i = 0; i < ADC_NUM_SIMULTANEOUS - 1; i++) {
+      adc_slave_handles[i].Instance = i == 0 ? ADC2 : ADC3;
+      adc_slave_handles[i].Init = adc_handle.Init;
+      if (HAL_ADC_Init(&adc_slave_handles[i]) != HAL_OK)
+        board_error_handler();
+    }
+
+    // The DMA transfers the conversions of ADC1, ADC2 and ADC3 of each rank in
+    // turn, so the DMA buffer is in the same order as the inputs.
+    multimode.Mode = ADC_NUM_SIMULTANEOUS == 3 ? ADC_TRIPLEMODE_REGSIMULT
+                                               : ADC_DUALMODE_REGSIMULT;
+    multimode.DMAAccessMode = ADC_DMAACCESSMODE_1;
+    multimode.TwoSamplingDelay = ADC_TWOSAMPLINGDELAY_5CYCLES;
+    if (HAL_ADCEx_MultiModeConfigChannel(&adc_handle, &multimode) != HAL_OK)
+      board_error_handler();
+  }
+#endif
+
 #if ADC_NUM_MUX_INPUTS > 0
   // Initialize the multiplexer input channels
   for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
     GPIO_InitTypeDef gpio_init = {0};
 
-    channel_config.Channel = mux_input_channels[i];
-    channel_config.Rank = i + 1;
-    channel_config.SamplingTime = ADC_NUM_SAMPLE_CYCLES;
-    if (HAL_ADC_ConfigChannel(&adc_handle, &channel_config) != HAL_OK)
-      board_error_handler();
+    channels[i] = mux_input_channels[i];
 
     gpio_init.Pin = channel_pins[mux_input_channels[i]];
     gpio_init.Mode = GPIO_MODE_ANALOG;
@@ -160,11 +239,7 @@ void analog_init(void) {
   for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
     GPIO_InitTypeDef gpio_init = {0};
 
-    channel_config.Channel = raw_input_channels[i];
-    channel_config.Rank = ADC_NUM_MUX_INPUTS + i + 1;
-    channel_config.SamplingTime = ADC_NUM_SAMPLE_CYCLES;
-    if (HAL_ADC_ConfigChannel(&adc_handle, &channel_config) != HAL_OK)
-      board_error_handler();
+    channels[ADC_NUM_MUX_INPUTS + i] = raw_input_channels[i];
 
     gpio_init.Pin = channel_pins[raw_input_channels[i]];
     gpio_init.Mode = GPIO_MODE_ANALOG;
@@ -173,6 +248,28 @@ void analog_init(void) {
   }
 #endif
 
+  // Configure the conversion sequences. Conversion `i` is performed by ADC
+  // `i % ADC_NUM_SIMULTANEOUS + 1`. The padding conversions at the end convert
+  // the previous input of the same ADC again, and are discarded.
+  for (uint32_t i = 0; i < ADC_NUM_CONVERSIONS; i++) {
+#if ADC_NUM_SIMULTANEOUS > 1
+    ADC_HandleTypeDef *handle =
+        i % ADC_NUM_SIMULTANEOUS == 0
+            ? &adc_handle
+            : &adc_slave_handles[i % ADC_NUM_SIMULTANEOUS - 1];
+#else
+    ADC_HandleTypeDef *handle = &adc_handle;
+#endif
+
+    if (i >= ADC_NUM_INPUTS)
+      channels[i] = channels[i - ADC_NUM_SIMULTANEOUS];
+    channel_config.Channel = channels[i];
+    channel_config.Rank = i / ADC_NUM_SIMULTANEOUS + 1;
+    channel_config.SamplingTime = ADC_NUM_SAMPLE_CYCLES;
+    if (HAL_ADC_ConfigChannel(handle, &channel_config) != HAL_OK)
+      board_error_handler();
+  }
+
   // Initialize the DMA peripheral
   dma_handle.Instance = DMA2_Stream0;
   dma_handle.Init.Channel = DMA_CHANNEL_0;
@@ -208,9 +305,14 @@ void analog_init(void) {
   HAL_NVIC_EnableIRQ(TIM1_UP_TIM10_IRQn);
 #endif
 
+#if ADC_NUM_SIMULTANEOUS > 1
+  // Enable the other ADCs, which wait for ADC1 to start the conversions
+  for (uint32_t i = 0; i < ADC_NUM_SIMULTANEOUS - 1; i++)
+    HAL_ADC_Start(&adc_slave_handles[i]);
+#endif
+
   // Start the conversion loop
-  HAL_ADC_Start_DMA(&adc_handle, (uint32_t *)adc_buffer,
-                    ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS);
+  analog_start_conversion();
 
   // Wait for the ADC values to be initialized
   while (!adc_initialized)
@@ -221,10 +323,61 @@ void analog_task(void) {}
 
 uint16_t analog_read(uint8_t key) { return adc_values[key]; }
 
+void analog_set_continuous(bool continuous) {
+  adc_continuous = continuous;
+  if (continuous)
+    analog_start_sweep();
+}
+
+void analog_start_sweep(void) {
+  if (!adc_paused)
+    return;
+
+  adc_paused = false;
+#if ADC_NUM_MUX_INPUTS > 0
+  // The multiplexer select pins are already set to the first channel, but the
+  // outputs still need to settle after the pause.
+  HAL_TIM_Base_Start_IT(&tim_handle);
+#else
+  analog_start_conversion();
+#endif
+}
+
 //--------------------------------------------------------------------+
 // Interrupt Handlers
 //--------------------------------------------------------------------+
 
+#if defined(ADC_DMA_FRAME)
+/**
+ * @brief Store a completed frame in the ADC values of the keys
+ *
+ * @param frame Index of the frame
+ *
+ * @return None
+ */
+static void analog_store_frame(uint8_t frame) {
+  for (uint32_t c = 0; c < (1 << ADC_NUM_MUX_SELECT_PINS); c++) {
+    for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
+      const uint16_t key = mux_input_matrix[c][i];
+      if (key)
+        adc_values[key - 1] = adc_frames[frame][c][i];
+    }
+  }
+
+#if ADC_NUM_RAW_INPUTS > 0
+  // The raw inputs are converted with every multiplexer channel, and the
+  // conversions of the last channel are the most recent.
+  for (uint32_t i = 0; i < ADC_NUM_RAW_INPUTS; i++) {
+    const uint16_t key = raw_input_vector[i];
+    if (key)
+      adc_values[key - 1] =
+          adc_frames[frame][(1 << ADC_NUM_MUX_SELECT_PINS) - 1]
+                    [ADC_NUM_MUX_INPUTS + i];
+  }
+#endif
+}
+#endif
+
 void ADC_IRQHandler(void) { HAL_ADC_IRQHandler(&adc_handle); }
 
 void DMA2_Stream0_IRQHandler(void) { HAL_DMA_IRQHandler(&dma_handle); }
@@ -234,11 +387,8 @@ void TIM1_UP_TIM10_IRQHandler(void) { HAL_TIM_IRQHandler(&tim_handle); }
 #endif
 
 void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
-#if ADC_NUM_MUX_INPUTS > 0
-  static uint8_t current_mux_channel = 0;
-#endif
-
   if (hadc == &adc_handle) {
+#if !defined(ADC_DMA_FRAME)
 #if ADC_NUM_MUX_INPUTS > 0
     for (uint32_t i = 0; i < ADC_NUM_MUX_INPUTS; i++) {
       const uint16_t key = mux_input_matrix[current_mux_channel][i];
@@ -254,6 +404,7 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
         adc_values[key - 1] = adc_buffer[ADC_NUM_MUX_INPUTS + i];
     }
 #endif
+#endif
 
 #if ADC_NUM_MUX_INPUTS > 0
     current_mux_channel =
@@ -261,20 +412,37 @@ void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc) {
     // We initialize all the ADC values when we have gone through all the
     // multiplexer input channels.
     adc_initialized |= (current_mux_channel == 0);
+#if defined(ADC_DMA_FRAME)
+    if (current_mux_channel == 0)
+      // The DMA writes the next frame while the completed one is stored
+      adc_frame ^= 1;
+#endif
 
     // Set the multiplexer select pins
     for (uint32_t i = 0; i < ADC_NUM_MUX_SELECT_PINS; i++)
       HAL_GPIO_WritePin(mux_select_ports[i], mux_select_pins[i],
                         (current_mux_channel >> i) & 1);
 
-    // Delay to allow the multiplexer outputs to settle
-    HAL_TIM_Base_Start_IT(&tim_handle);
+    if (current_mux_channel == 0 && !adc_continuous)
+      // Stop the conversion loop until the next sweep is requested
+      adc_paused = true;
+    else
+      // Delay to allow the multiplexer outputs to settle
+      HAL_TIM_Base_Start_IT(&tim_handle);
+#if defined(ADC_DMA_FRAME)
+    if (current_mux_channel == 0)
+      // Store the completed frame while the multiplexer outputs settle
+      analog_store_frame((uint8_t)(adc_frame ^ 1));
+#endif
 #else
     // We initialize all the ADC values when we have read all the raw input.
     adc_initialized = true;
-    // Immediately start the next conversion
-    HAL_ADC_Start_DMA(&adc_handle, (uint32_t *)adc_buffer,
-                      ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS);
+    if (!adc_continuous)
+      // Stop the conversion loop until the next sweep is requested
+      adc_paused = true;
+    else
+      // Immediately start the next conversion
+      analog_start_conversion();
 #endif
   }
 }
@@ -286,8 +454,7 @@ void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {
     // ADC is still converting
     HAL_TIM_Base_Stop_IT(&tim_handle);
     // Start the next conversion
-    HAL_ADC_Start_DMA(&adc_handle, (uint32_t *)adc_buffer,
-                      ADC_NUM_MUX_INPUTS + ADC_NUM_RAW_INPUTS);
+    analog_start_conversion();
   }
 }
 #endif
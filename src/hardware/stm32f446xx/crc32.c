@@ -19,19 +19,75 @@
 #include "stm32f4xx_hal.h"
 
 static CRC_HandleTypeDef crc_handle;
+static DMA_HandleTypeDef dma_handle;
+
+// Asynchronous computation state
+static struct {
+  volatile bool busy;
+  // Whether the length of the buffer is not a multiple of 4
+  bool has_tail;
+  // Trailing bytes of the buffer padded with zeros
+  uint32_t tail;
+  crc32_callback_t callback;
+} crc_async;
+
+/**
+ * @brief Finish the asynchronous computation once the DMA transfer completes
+ *
+ * @param hdma DMA handle
+ *
+ * @return None
+ */
+static void crc32_dma_complete(DMA_HandleTypeDef *hdma) {
+  uint32_t crc = crc_handle.Instance->DR;
+
+  if (crc_async.has_tail)
+    crc = HAL_CRC_Accumulate(&crc_handle, &crc_async.tail, 1);
+  crc_async.busy = false;
+  crc_async.callback(crc);
+}
 
 void crc32_init(void) {
   __HAL_RCC_CRC_CLK_ENABLE();
+  __HAL_RCC_DMA2_CLK_ENABLE();
 
   crc_handle.Instance = CRC;
   if (HAL_CRC_Init(&crc_handle) != HAL_OK)
     board_error_handler();
+
+  // Only DMA2 supports memory-to-memory transfers. Stream 0 is used by the
+  // ADC. The source is on the peripheral port and the CRC data register is
+  // the destination on the memory port.
+  dma_handle.Instance = DMA2_Stream1;
+  dma_handle.Init.Channel = DMA_CHANNEL_0;
+  dma_handle.Init.Direction = DMA_MEMORY_TO_MEMORY;
+  dma_handle.Init.PeriphInc = DMA_PINC_ENABLE;
+  dma_handle.Init.MemInc = DMA_MINC_DISABLE;
+  dma_handle.Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+  dma_handle.Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+  dma_handle.Init.Mode = DMA_NORMAL;
+  dma_handle.Init.Priority = DMA_PRIORITY_LOW;
+  // Direct mode is not allowed for memory-to-memory transfers
+  dma_handle.Init.FIFOMode = DMA_FIFOMODE_ENABLE;
+  dma_handle.Init.FIFOThreshold = DMA_FIFO_THRESHOLD_FULL;
+  dma_handle.Init.MemBurst = DMA_MBURST_SINGLE;
+  dma_handle.Init.PeriphBurst = DMA_PBURST_SINGLE;
+  if (HAL_DMA_Init(&dma_handle) != HAL_OK ||
+      HAL_DMA_RegisterCallback(&dma_handle, HAL_DMA_XFER_CPLT_CB_ID,
+                               crc32_dma_complete) != HAL_OK)
+    board_error_handler();
+
+  HAL_NVIC_EnableIRQ(DMA2_Stream1_IRQn);
 }
 
 uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
   const uint8_t *buf8 = buf;
   uint32_t k = 0;
 
+  while (crc_async.busy)
+    // Wait for the asynchronous computation to release the CRC unit
+    ;
+
   HAL_CRC_Calculate(&crc_handle, &crc, 1);
   crc = HAL_CRC_Accumulate(&crc_handle, (void *)buf8, len >> 2);
   if (len & 3) {
@@ -41,3 +97,42 @@ uint32_t crc32_compute(const void *buf, uint32_t len, uint32_t crc) {
 
   return crc;
 }
+
+bool crc32_compute_async(const void *buf, uint32_t len, uint32_t crc,
+                         crc32_callback_t callback) {
+  const uint8_t *buf8 = buf;
+
+  if (crc_async.busy)
+    return false;
+
+  if (((uintptr_t)buf8 & 3) != 0 || len < 4) {
+    // The DMA transfer requires a word-aligned buffer, and short buffers are
+    // not worth the overhead
+    callback(crc32_compute(buf, len, crc));
+    return true;
+  }
+
+  crc_async.busy = true;
+  crc_async.has_tail = (len & 3) != 0;
+  crc_async.tail = 0;
+  if (crc_async.has_tail)
+    memcpy(&crc_async.tail, buf8 + (len & ~(uint32_t)3), len & 3);
+  crc_async.callback = callback;
+
+  // Reset the CRC unit and feed the initial value like `crc32_compute()`
+  HAL_CRC_Calculate(&crc_handle, &crc, 1);
+  if (HAL_DMA_Start_IT(&dma_handle, (uint32_t)buf8,
+                       (uint32_t)&crc_handle.Instance->DR,
+                       len >> 2) != HAL_OK) {
+    crc_async.busy = false;
+    return false;
+  }
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// Interrupt Handlers
+//--------------------------------------------------------------------+
+
+void DMA2_Stream1_IRQHandler(void) { HAL_DMA_IRQHandler(&dma_handle); }
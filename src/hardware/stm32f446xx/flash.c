@@ -48,6 +48,13 @@ bool flash_read(uint32_t addr, void *buf, uint32_t len) {
   return true;
 }
 
+const void *flash_map(uint32_t addr, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return NULL;
+
+  return (const void *)(FLASH_BASE + addr);
+}
+
 bool flash_write(uint32_t addr, const void *buf, uint32_t len) {
   if (addr + len * 4 > FLASH_SIZE)
     return false;
@@ -0,0 +1,168 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "idle.h"
+
+#include "hardware/hardware.h"
+#include "matrix.h"
+
+// Idle state
+static struct {
+  // Whether the low-power scan mode is active
+  bool active;
+  // Whether `idle_wake()` has been called since the last `idle_task()`
+  bool wake_requested;
+  // Time of the last activity
+  uint32_t last_activity;
+  // Time of the last activity check at full scan rate
+  uint32_t last_check;
+  // Time when the low-power scan mode was entered
+  uint32_t start;
+  // Time when the last sweep was started
+  uint32_t last_sweep;
+  // Cycle counts when the last two sweeps were started, the last one first
+  uint32_t sweep_cycles[2];
+} idle;
+
+// Distance of each key at the last activity
+static uint8_t ref_distances[NUM_KEYS];
+
+static idle_stats_t idle_stats;
+
+#if IDLE_TIMEOUT > 0
+/**
+ * @brief Check for activity since the last call
+ *
+ * A key is active if it is pressed, if the Rapid Trigger state machine is
+ * tracking it, or if its distance has changed by more than
+ * `IDLE_WAKE_THRESHOLD` since the last activity. In the low-power scan mode,
+ * the distance is computed from the unfiltered ADC value, since the filtered
+ * value is only updated once per main loop iteration and would delay the
+ * wake-up.
+ *
+ * @return true if there is activity, false otherwise
+ */
+static bool idle_check_activity(void) {
+  bool activity = idle.wake_requested;
+
+  idle.wake_requested = false;
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    const key_state_t *key = &key_matrix[i];
+    const uint8_t distance =
+        idle.active ? matrix_raw_distance((uint8_t)i) : key->distance;
+
+    if (key->is_pressed || key->key_dir != KEY_DIR_INACTIVE ||
+        distance > ref_distances[i] + IDLE_WAKE_THRESHOLD ||
+        distance + IDLE_WAKE_THRESHOLD < ref_distances[i]) {
+      ref_distances[i] = key->distance;
+      activity = true;
+    }
+  }
+
+  return activity;
+}
+
+/**
+ * @brief Enter the low-power scan mode
+ *
+ * The conversion loop stops after the sweep in progress, which is taken as the
+ * first sweep of the low-power scan mode. The activity is then checked against
+ * the unfiltered distances of that sweep, since the filtered distance of a key
+ * held down settles below the unfiltered one.
+ *
+ * @return None
+ */
+static void idle_enter(void) {
+  const uint32_t cycles = board_cycle_count();
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    ref_distances[i] = matrix_raw_distance((uint8_t)i);
+
+  idle.active = true;
+  idle.start = timer_read();
+  idle.last_sweep = idle.start;
+  idle.sweep_cycles[0] = cycles;
+  idle.sweep_cycles[1] = cycles;
+  analog_set_continuous(false);
+}
+
+/**
+ * @brief Return to the full scan rate
+ *
+ * The movement was not seen by the sweep before the last one, so it happened
+ * after that sweep was started.
+ *
+ * @return None
+ */
+static void idle_exit(void) {
+  const uint32_t latency = (board_cycle_count() - idle.sweep_cycles[1]) /
+                           (F_CPU / 1000000);
+
+  analog_set_continuous(true);
+  idle.active = false;
+  idle_stats.idle_time += timer_elapsed(idle.start);
+  idle_stats.wakeups++;
+  idle_stats.last_wake_latency = latency;
+  idle_stats.max_wake_latency = M_MAX(idle_stats.max_wake_latency, latency);
+}
+#endif
+
+void idle_init(void) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    ref_distances[i] = key_matrix[i].distance;
+  idle.last_activity = timer_read();
+  idle.last_check = idle.last_activity;
+}
+
+void idle_task(void) {
+#if IDLE_TIMEOUT > 0
+  const uint32_t now = timer_read();
+
+  if (!idle.active) {
+    // At full scan rate, checking once per millisecond is enough and keeps the
+    // overhead off the scan loop.
+    if (now == idle.last_check)
+      return;
+    idle.last_check = now;
+
+    if (idle_check_activity())
+      idle.last_activity = now;
+    else if (timer_elapsed(idle.last_activity) >= IDLE_TIMEOUT)
+      idle_enter();
+    return;
+  }
+
+  if (idle_check_activity()) {
+    idle_exit();
+    idle.last_activity = now;
+    idle.last_check = now;
+    return;
+  }
+
+  if (timer_elapsed(idle.last_sweep) >= IDLE_SCAN_INTERVAL) {
+    idle.last_sweep = now;
+    idle.sweep_cycles[1] = idle.sweep_cycles[0];
+    idle.sweep_cycles[0] = board_cycle_count();
+    analog_start_sweep();
+  }
+
+  // The system tick wakes the CPU at least every millisecond
+  board_idle();
+#endif
+}
+
+void idle_wake(void) { idle.wake_requested = true; }
+
+void idle_get_stats(idle_stats_t *stats) { *stats = idle_stats; }
@@ -23,6 +23,7 @@
 #include "keycodes.h"
 #include "lib/bitmap.h"
 #include "matrix.h"
+#include "wear_leveling.h"
 #include "xinput.h"
 
 // Layer mask. Each bit represents whether a layer is active or not.
@@ -44,7 +45,9 @@ layout_get_current_layer(void) {
 
 __attribute__((always_inline)) static inline void
 layout_layer_on(uint8_t layer) {
-  layer_mask |= (1 << layer);
+  // The keymap may refer to layers that do not exist on this keyboard
+  if (layer < NUM_LAYERS)
+    layer_mask |= (1 << layer);
 }
 
 __attribute__((always_inline)) static inline void
@@ -125,6 +128,11 @@ void layout_load_advanced_keys(void) {
     if (ak->type == AK_TYPE_NULL_BIND && ak->null_bind.secondary_key < NUM_KEYS)
       // Null Bind advanced keys also have a secondary key
       advanced_key_indices[ak->layer][ak->null_bind.secondary_key] = i + 1;
+    else if (ak->type == AK_TYPE_SOCD_GROUP)
+      // SOCD group advanced keys also have up to 7 other members
+      for (uint32_t j = 0; j < M_ARRAY_SIZE(ak->socd_group.keys); j++)
+        if (ak->socd_group.keys[j] < NUM_KEYS)
+          advanced_key_indices[ak->layer][ak->socd_group.keys[j]] = i + 1;
   }
 }
 
@@ -221,6 +229,9 @@ void layout_task(void) {
     bitmap_set(key_press_states, i, k->is_pressed);
   }
 
+  // Resolve the SOCD groups once after all the key events of this scan
+  advanced_key_resolve();
+
   if (has_non_tap_hold_press || timer_elapsed(last_ak_tick) > 0) {
     // We only need to tick the advanced keys every 1ms, or when there is a
     // non-Tap-Hold key press event since these are the only cases that
@@ -297,6 +308,7 @@ void layout_register(uint8_t key, uint8_t keycode) {
     break;
 
   case SP_BOOT:
+    wear_leveling_flush();
     board_enter_bootloader();
     break;
 
@@ -20,8 +20,10 @@
 #include "eeconfig.h"
 #include "hardware/hardware.h"
 #include "hid.h"
+#include "idle.h"
 #include "layout.h"
 #include "matrix.h"
+#include "noise.h"
 #include "tusb.h"
 #include "wear_leveling.h"
 #include "xinput.h"
@@ -46,6 +48,7 @@ int main(void) {
   xinput_init();
   layout_init();
   command_init();
+  idle_init();
 
   tud_init(BOARD_TUD_RHPORT);
 
@@ -54,8 +57,12 @@ int main(void) {
 
     analog_task();
     matrix_scan();
+    noise_task();
     layout_task();
     xinput_task();
+    command_task();
+    wear_leveling_task();
+    idle_task();
   }
 
   return 0;
@@ -26,6 +26,13 @@
     ((uint32_t)(y) * ((1 << MATRIX_EMA_ALPHA_EXPONENT) - 1))) >>               \
    MATRIX_EMA_ALPHA_EXPONENT)
 
+// Combine an 8-bit distance and its fractional part into a distance
+#if defined(DISTANCE_HIGH_RESOLUTION)
+#define MATRIX_DISTANCE(coarse, fine) ((distance_t)((coarse) << 8 | (fine)))
+#else
+#define MATRIX_DISTANCE(coarse, fine) ((void)(fine), (distance_t)(coarse))
+#endif
+
 __attribute__((always_inline)) static inline uint16_t
 matrix_analog_read(uint8_t key) {
 #if defined(MATRIX_INVERT_ADC_VALUES)
@@ -43,11 +50,114 @@ matrix_bottom_out_value(uint8_t key, uint16_t rest_value) {
                ADC_MAX_VALUE);
 }
 
+__attribute__((always_inline)) static inline uint8_t matrix_lut(uint8_t key) {
+  // Fall back to the first lookup table if the switch model is unknown
+  return eeconfig->switch_models[key] < DISTANCE_NUM_LUTS
+             ? eeconfig->switch_models[key]
+             : 0;
+}
+
+__attribute__((always_inline)) static inline uint16_t
+matrix_epsilon(uint8_t key) {
+  return eeconfig->calibration_epsilon[key] != 0
+             ? eeconfig->calibration_epsilon[key]
+             : MATRIX_CALIBRATION_EPSILON;
+}
+
 key_state_t key_matrix[NUM_KEYS];
 
 // Bitmap for tracking which keys have Rapid Trigger disabled
 static bitmap_t rapid_trigger_disabled[] = MAKE_BITMAP(NUM_KEYS);
 
+// Calibration state
+static struct {
+  // Whether the calibration is in progress
+  bool active;
+  // Time when the calibration was started
+  uint32_t start;
+} calibration;
+
+#if MATRIX_DRIFT_INTERVAL > 0
+// Time when the rest values were last corrected
+static uint32_t last_drift_correction;
+#endif
+
+/**
+ * @brief Perform a step of the calibration process
+ *
+ * Only the rest values are calibrated. The bottom-out values will be updated
+ * during the scan process. The keys are kept released.
+ *
+ * @return None
+ */
+static void matrix_calibrate(void) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    const uint16_t new_adc_filtered =
+        EMA(matrix_analog_read(i), key_matrix[i].adc_filtered);
+
+    key_matrix[i].adc_filtered = new_adc_filtered;
+
+    if (new_adc_filtered + matrix_epsilon(i) <= key_matrix[i].adc_rest_value)
+      // Only update the rest value if the new value is smaller and the
+      // difference is at least the calibration epsilon
+      key_matrix[i].adc_rest_value = new_adc_filtered;
+
+    // Update the bottom-out value to be the minimum bottom-out value based on
+    // the updated rest value
+    key_matrix[i].adc_bottom_out_value =
+        matrix_bottom_out_value(i, key_matrix[i].adc_rest_value);
+  }
+
+  if (timer_elapsed(calibration.start) >= MATRIX_CALIBRATION_DURATION) {
+    calibration.active = false;
+#if MATRIX_DRIFT_INTERVAL > 0
+    last_drift_correction = timer_read();
+#endif
+  }
+}
+
+#if MATRIX_DRIFT_INTERVAL > 0
+/**
+ * @brief Correct the rest values of the keys at rest
+ *
+ * A key is at rest if it is released and its filtered ADC value is within
+ * `MATRIX_DRIFT_THRESHOLD` of its rest value. The rest value and the bottom-out
+ * value are moved together by one ADC count towards the filtered ADC value.
+ *
+ * @return None
+ */
+static void matrix_correct_drift(void) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    key_state_t *key = &key_matrix[i];
+    const uint16_t epsilon = matrix_epsilon(i);
+
+    if (key->is_pressed || key->key_dir != KEY_DIR_INACTIVE)
+      continue;
+
+    if (key->adc_filtered >= key->adc_rest_value + epsilon &&
+        key->adc_filtered < key->adc_rest_value + MATRIX_DRIFT_THRESHOLD) {
+      // Drifted up
+      key->adc_rest_value++;
+      key->adc_bottom_out_value =
+          M_MIN(key->adc_bottom_out_value + 1, ADC_MAX_VALUE);
+    } else if (key->adc_filtered + epsilon <= key->adc_rest_value &&
+               key->adc_filtered + MATRIX_DRIFT_THRESHOLD >
+                   key->adc_rest_value) {
+      // Drifted down
+      key->adc_rest_value--;
+      key->adc_bottom_out_value--;
+    } else
+      continue;
+
+    // Keep the bottom-out value at least the minimum bottom-out value based
+    // on the corrected rest value
+    key->adc_bottom_out_value =
+        M_MAX(key->adc_bottom_out_value,
+              matrix_bottom_out_value(i, key->adc_rest_value));
+  }
+}
+#endif
+
 void matrix_init(void) { matrix_recalibrate(false); }
 
 void matrix_recalibrate(bool reset_bottom_out_threshold) {
@@ -67,102 +177,106 @@ void matrix_recalibrate(bool reset_bottom_out_threshold) {
     key_matrix[i].is_pressed = false;
   }
 
-  // We only calibrate the rest value. The bottom-out value will be updated
-  // during the scan process.
-  const uint32_t calibration_start = timer_read();
-  while (timer_elapsed(calibration_start) < MATRIX_CALIBRATION_DURATION) {
-    // Run the analog task to possibly update the ADC values
-    analog_task();
-
-    for (uint32_t i = 0; i < NUM_KEYS; i++) {
-      const uint16_t new_adc_filtered =
-          EMA(matrix_analog_read(i), key_matrix[i].adc_filtered);
-
-      key_matrix[i].adc_filtered = new_adc_filtered;
-
-      if (new_adc_filtered + MATRIX_CALIBRATION_EPSILON <=
-          key_matrix[i].adc_rest_value)
-        // Only update the rest value if the new value is smaller and the
-        // difference is at least the calibration epsilon
-        key_matrix[i].adc_rest_value = new_adc_filtered;
-
-      // Update the bottom-out value to be the minimum bottom-out value based on
-      // the updated rest value
-      key_matrix[i].adc_bottom_out_value =
-          matrix_bottom_out_value(i, key_matrix[i].adc_rest_value);
-    }
-  }
+  calibration.active = true;
+  calibration.start = timer_read();
 }
 
 void matrix_scan(void) {
+  if (calibration.active) {
+    matrix_calibrate();
+    return;
+  }
+
+#if MATRIX_DRIFT_INTERVAL > 0
+  if (timer_elapsed(last_drift_correction) >= MATRIX_DRIFT_INTERVAL) {
+    matrix_correct_drift();
+    last_drift_correction = timer_read();
+  }
+#endif
+
   for (uint32_t i = 0; i < NUM_KEYS; i++) {
     const uint16_t new_adc_filtered =
         EMA(matrix_analog_read(i), key_matrix[i].adc_filtered);
     const actuation_t *actuation = &CURRENT_PROFILE.actuation_map[i];
+    const actuation_fine_t *fine = &CURRENT_PROFILE.actuation_fine_map[i];
+    const uint8_t lut = matrix_lut(i);
+    const uint16_t epsilon = matrix_epsilon(i);
 
     key_matrix[i].adc_filtered = new_adc_filtered;
 
-    if (new_adc_filtered >=
-        key_matrix[i].adc_bottom_out_value + MATRIX_CALIBRATION_EPSILON)
+    if (new_adc_filtered >= key_matrix[i].adc_bottom_out_value + epsilon)
       // Only update the bottom-out value if the new value is larger and the
       // difference is at least the calibration epsilon.
       key_matrix[i].adc_bottom_out_value = new_adc_filtered;
 
-    key_matrix[i].distance =
-        adc_to_distance(new_adc_filtered, key_matrix[i].adc_rest_value,
+    // The Rapid Trigger state machine runs on the full resolution distance,
+    // while the rest of the firmware uses the 8-bit distance.
+    const distance_t distance =
+        adc_to_distance(lut, new_adc_filtered, key_matrix[i].adc_rest_value,
                         key_matrix[i].adc_bottom_out_value);
+    // The auto-tune raises the settings that are below the noise of the key,
+    // without modifying the stored configuration
+    const distance_t actuation_point = M_MAX(
+        MATRIX_DISTANCE(actuation->actuation_point, fine->actuation_point),
+        key_matrix[i].min_actuation_point);
+    const distance_t rt_down_value =
+        MATRIX_DISTANCE(actuation->rt_down, fine->rt_down);
+    const distance_t rt_down =
+        rt_down_value == 0 ? 0 : M_MAX(rt_down_value, key_matrix[i].min_rt);
+
+    key_matrix[i].distance = (uint8_t)(distance >> DISTANCE_FRACTION_BITS);
 
-    if (bitmap_get(rapid_trigger_disabled, i) | (actuation->rt_down == 0)) {
+    if (bitmap_get(rapid_trigger_disabled, i) | (rt_down == 0)) {
       key_matrix[i].key_dir = KEY_DIR_INACTIVE;
-      key_matrix[i].is_pressed =
-          (key_matrix[i].distance >= actuation->actuation_point);
+      key_matrix[i].is_pressed = (distance >= actuation_point);
     } else {
-      const uint8_t reset_point =
-          actuation->continuous ? 0 : actuation->actuation_point;
-      const uint8_t rt_up =
-          actuation->rt_up == 0 ? actuation->rt_down : actuation->rt_up;
+      const distance_t reset_point =
+          actuation->continuous ? 0 : actuation_point;
+      const distance_t rt_up_value =
+          MATRIX_DISTANCE(actuation->rt_up, fine->rt_up);
+      const distance_t rt_up =
+          rt_up_value == 0 ? rt_down : M_MAX(rt_up_value, key_matrix[i].min_rt);
 
       switch (key_matrix[i].key_dir) {
       case KEY_DIR_INACTIVE:
-        if (key_matrix[i].distance > actuation->actuation_point) {
+        if (distance > actuation_point) {
           // Pressed down past actuation point
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
           key_matrix[i].key_dir = KEY_DIR_DOWN;
           key_matrix[i].is_pressed = true;
         }
         break;
 
       case KEY_DIR_DOWN:
-        if (key_matrix[i].distance <= reset_point) {
+        if (distance <= reset_point) {
           // Released past reset point
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
           key_matrix[i].key_dir = KEY_DIR_INACTIVE;
           key_matrix[i].is_pressed = false;
-        } else if (key_matrix[i].distance + rt_up < key_matrix[i].extremum) {
+        } else if (distance + rt_up < key_matrix[i].extremum) {
           // Released by Rapid Trigger
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
           key_matrix[i].key_dir = KEY_DIR_UP;
           key_matrix[i].is_pressed = false;
-        } else if (key_matrix[i].distance > key_matrix[i].extremum)
+        } else if (distance > key_matrix[i].extremum)
           // Pressed down further
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
         break;
 
       case KEY_DIR_UP:
-        if (key_matrix[i].distance <= reset_point) {
+        if (distance <= reset_point) {
           // Released past reset point
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
           key_matrix[i].key_dir = KEY_DIR_INACTIVE;
           key_matrix[i].is_pressed = false;
-        } else if (key_matrix[i].extremum + actuation->rt_down <
-                   key_matrix[i].distance) {
+        } else if (key_matrix[i].extremum + rt_down < distance) {
           // Pressed by Rapid Trigger
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
           key_matrix[i].key_dir = KEY_DIR_DOWN;
           key_matrix[i].is_pressed = true;
-        } else if (key_matrix[i].distance < key_matrix[i].extremum)
+        } else if (distance < key_matrix[i].extremum)
           // Released further
-          key_matrix[i].extremum = key_matrix[i].distance;
+          key_matrix[i].extremum = distance;
         break;
 
       default:
@@ -172,6 +286,44 @@ void matrix_scan(void) {
   }
 }
 
+distance_t matrix_adc_to_distance(uint8_t key, uint16_t adc) {
+  return adc_to_distance(matrix_lut(key), adc, key_matrix[key].adc_rest_value,
+                         key_matrix[key].adc_bottom_out_value);
+}
+
+void matrix_get_actuation(uint8_t key, actuation_wide_t *actuation) {
+  const actuation_t *stored = &CURRENT_PROFILE.actuation_map[key];
+  const actuation_fine_t *fine = &CURRENT_PROFILE.actuation_fine_map[key];
+  const distance_t actuation_point =
+      M_MAX(MATRIX_DISTANCE(stored->actuation_point, fine->actuation_point),
+            key_matrix[key].min_actuation_point);
+  const distance_t rt_down_value =
+      MATRIX_DISTANCE(stored->rt_down, fine->rt_down);
+  const distance_t rt_up_value = MATRIX_DISTANCE(stored->rt_up, fine->rt_up);
+  distance_t rt_down = 0;
+  distance_t rt_up = 0;
+
+  // Same as `matrix_scan()`
+  if (!bitmap_get(rapid_trigger_disabled, key) && rt_down_value != 0) {
+    rt_down = M_MAX(rt_down_value, key_matrix[key].min_rt);
+    rt_up = rt_up_value == 0 ? rt_down
+                             : M_MAX(rt_up_value, key_matrix[key].min_rt);
+  }
+
+  actuation->actuation_point =
+      (uint16_t)(actuation_point << (8 - DISTANCE_FRACTION_BITS));
+  actuation->rt_down = (uint16_t)(rt_down << (8 - DISTANCE_FRACTION_BITS));
+  actuation->rt_up = (uint16_t)(rt_up << (8 - DISTANCE_FRACTION_BITS));
+  actuation->continuous = stored->continuous;
+}
+
+uint8_t matrix_raw_distance(uint8_t key) {
+  const distance_t distance =
+      matrix_adc_to_distance(key, matrix_analog_read(key));
+
+  return (uint8_t)(distance >> DISTANCE_FRACTION_BITS);
+}
+
 void matrix_disable_rapid_trigger(uint8_t key, bool disable) {
   bitmap_set(rapid_trigger_disabled, key, disable);
 }
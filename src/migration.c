@@ -16,23 +16,189 @@
 #include "migration.h"
 
 #include "eeconfig.h"
+#include "lib/compress.h"
 #include "wear_leveling.h"
 
-static bool v1_1_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_1_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
+static void v1_1_keymap_transform(uint8_t *buf, uint32_t len);
+static void v1_1_advanced_keys_transform(uint8_t *buf, uint32_t len);
 
-static bool v1_2_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_2_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
+static void v1_3_options_transform(uint8_t *buf, uint32_t len);
 
-static bool v1_3_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_3_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
+static void v1_4_options_transform(uint8_t *buf, uint32_t len);
 
-static bool v1_4_global_config_func(uint8_t *dst, const uint8_t *src);
-static bool v1_4_profile_config_func(uint8_t profile, uint8_t *dst,
-                                     const uint8_t *src);
+static void v1_8_options_transform(uint8_t *buf, uint32_t len);
+
+static const uint8_t default_switch_models[NUM_KEYS] = DEFAULT_SWITCH_MODELS;
+
+// v1.0 -> v1.1 migration operations
+static const migration_op_t v1_1_global_config_ops[] = {
+    // Copy `magic_start` to `calibration`
+    MIGRATION_COPY(10),
+    // Default `options` to 0
+    MIGRATION_FILL(0, 2),
+    // Copy `current_profile` and `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
+
+static const migration_op_t v1_1_profile_config_ops[] = {
+    // Update keycodes to include `KC_INT1` ... `KC_LNG6`
+    MIGRATION_TRANSFORM(NUM_LAYERS * NUM_KEYS, 1, v1_1_keymap_transform),
+    // Copy `actuation_map`
+    MIGRATION_COPY(NUM_KEYS * 4),
+    // Default `hold_on_other_key_press` to 0
+    MIGRATION_TRANSFORM(NUM_ADVANCED_KEYS * 12, 12,
+                        v1_1_advanced_keys_transform),
+    // Set `gamepad_buttons` to 0
+    MIGRATION_FILL(0, NUM_KEYS),
+    // Default `analog_curve` to linear, and default `keyboard_enabled` and
+    // `snappy_joystick` to true
+    MIGRATION_INSERT(4, 20, 85, 95, 165, 170, 255, 255, 0b00001001),
+    // Copy `tick_rate`
+    MIGRATION_COPY(1),
+};
+
+// v1.1 -> v1.2 migration operations
+static const migration_op_t v1_2_global_config_ops[] = {
+    // Copy `magic_start` to `calibration`
+    MIGRATION_COPY(10),
+    // Set `bottom_out_threshold` to 0
+    MIGRATION_FILL(0, NUM_KEYS * 2),
+    // Copy `options` to `last_non_default_profile`
+    MIGRATION_COPY(4),
+};
+
+static const migration_op_t v1_2_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.2 -> v1.3 migration operations
+static const migration_op_t v1_3_global_config_ops[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    // Default `save_bottom_out_threshold` to true
+    MIGRATION_TRANSFORM(2, 2, v1_3_options_transform),
+    // Copy `current_profile` to `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
+
+static const migration_op_t v1_3_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.3 -> v1.4 migration operations
+static const migration_op_t v1_4_global_config_ops[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    // Default `high_polling_rate_enabled` to true
+    MIGRATION_TRANSFORM(2, 2, v1_4_options_transform),
+    // Copy `current_profile` to `last_non_default_profile`
+    MIGRATION_COPY(2),
+};
+
+static const migration_op_t v1_4_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.4 -> v1.5 migration operations
+static const migration_op_t v1_5_global_config_ops[] = {
+    // Copy `magic_start` to `last_non_default_profile`
+    MIGRATION_COPY(14 + NUM_KEYS * 2),
+    // Set `switch_models` to the default switch models
+    MIGRATION_INSERT_ARRAY(default_switch_models),
+};
+
+static const migration_op_t v1_5_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.5 -> v1.6 migration operations
+static const migration_op_t v1_6_global_config_ops[] = {
+    // Copy the entire global configuration
+    MIGRATION_COPY(14 + NUM_KEYS * 2 + NUM_KEYS),
+};
+
+static const migration_op_t v1_6_profile_config_ops[] = {
+    // Copy `keymap` and `actuation_map`
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4),
+    // Set `actuation_fine_map` to 0
+    MIGRATION_FILL(0, NUM_KEYS * 3),
+    // Copy `advanced_keys` to `tick_rate`
+    MIGRATION_COPY(NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.6 -> v1.7 migration operations
+static const migration_op_t v1_7_global_config_ops[] = {
+    // Copy the entire global configuration
+    MIGRATION_COPY(14 + NUM_KEYS * 2 + NUM_KEYS),
+    // Set `calibration_epsilon` to 0
+    MIGRATION_FILL(0, NUM_KEYS),
+};
+
+static const migration_op_t v1_7_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 + NUM_KEYS * 3 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// v1.7 -> v1.8 migration operations
+static const migration_op_t v1_8_global_config_ops[] = {
+    // Copy `magic_start` to `bottom_out_threshold`
+    MIGRATION_COPY(10 + NUM_KEYS * 2),
+    // Default `auto_tune_enabled` to false
+    MIGRATION_TRANSFORM(2, 2, v1_8_options_transform),
+    // Copy `current_profile` to `calibration_epsilon`
+    MIGRATION_COPY(2 + NUM_KEYS + NUM_KEYS),
+};
+
+static const migration_op_t v1_8_profile_config_ops[] = {
+    // Copy the entire profile
+    MIGRATION_COPY(NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 + NUM_KEYS * 3 +
+                   NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1),
+};
+
+// Version and section sizes of the latest configuration. They must be moved to
+// the new entry of `migrations` whenever `EECONFIG_VERSION` is bumped.
+#define LATEST_VERSION 0x0108
+#define LATEST_GLOBAL_CONFIG_SIZE                                              \
+  (14             /* Other fields */                                           \
+   + NUM_KEYS * 2 /* Bottom-out threshold */                                   \
+   + NUM_KEYS     /* Switch models */                                          \
+   + NUM_KEYS     /* Calibration epsilon */                                    \
+  )
+#define LATEST_PROFILE_CONFIG_SIZE                                             \
+  (NUM_LAYERS * NUM_KEYS    /* Keymap */                                       \
+   + NUM_KEYS * 4           /* Actuation map */                                \
+   + NUM_KEYS * 3           /* Fine actuation map */                           \
+   + NUM_ADVANCED_KEYS * 12 /* Advanced keys */                                \
+   + NUM_KEYS               /* Gamepad buttons */                              \
+   + 9                      /* Gamepad options */                              \
+   + 1                      /* Tick rate */                                    \
+  )
+
+// The last migration must produce the current configuration layout
+_Static_assert(LATEST_VERSION == EECONFIG_VERSION,
+               "The last migration must be for EECONFIG_VERSION.");
+_Static_assert(LATEST_GLOBAL_CONFIG_SIZE == offsetof(eeconfig_t, profiles),
+               "The global configuration size of the last migration must "
+               "match eeconfig_t.");
+_Static_assert(LATEST_PROFILE_CONFIG_SIZE == sizeof(eeconfig_profile_t),
+               "The profile configuration size of the last migration must "
+               "match eeconfig_profile_t.");
+
+// Helper macro for the operations of a migration
+#define MIGRATION_OPS(version)                                                 \
+  .global_config_ops = version##_global_config_ops,                            \
+  .num_global_config_ops = M_ARRAY_SIZE(version##_global_config_ops),          \
+  .profile_config_ops = version##_profile_config_ops,                          \
+  .num_profile_config_ops = M_ARRAY_SIZE(version##_profile_config_ops)
 
 // Migration metadata for each configuration version. The first entry is
 // reserved for the initial version (v1.0) which does not require migration.
@@ -56,8 +222,7 @@ static const migration_t migrations[] = {
                                + 9                      // Gamepad options
                                + 1                      // Tick rate
         ,
-        .global_config_func = v1_1_global_config_func,
-        .profile_config_func = v1_1_profile_config_func,
+        MIGRATION_OPS(v1_1),
     },
     {
         .version = 0x0102,
@@ -71,8 +236,7 @@ static const migration_t migrations[] = {
                                + 9                      // Gamepad options
                                + 1                      // Tick rate
         ,
-        .global_config_func = v1_2_global_config_func,
-        .profile_config_func = v1_2_profile_config_func,
+        MIGRATION_OPS(v1_2),
     },
     {
         .version = 0x0103,
@@ -86,8 +250,7 @@ static const migration_t migrations[] = {
                                + 9                      // Gamepad options
                                + 1                      // Tick rate
         ,
-        .global_config_func = v1_3_global_config_func,
-        .profile_config_func = v1_3_profile_config_func,
+        MIGRATION_OPS(v1_3),
     },
     {
         .version = 0x0104,
@@ -101,235 +264,503 @@ static const migration_t migrations[] = {
                                + 9                      // Gamepad options
                                + 1                      // Tick rate
         ,
-        .global_config_func = v1_4_global_config_func,
-        .profile_config_func = v1_4_profile_config_func,
+        MIGRATION_OPS(v1_4),
+    },
+    {
+        .version = 0x0105,
+        .global_config_size = 14             // Other fields
+                              + NUM_KEYS * 2 // Bottom-out threshold
+                              + NUM_KEYS     // Switch models
+        ,
+        .profile_config_size = NUM_LAYERS * NUM_KEYS    // Keymap
+                               + NUM_KEYS * 4           // Actuation map
+                               + NUM_ADVANCED_KEYS * 12 // Advanced keys
+                               + NUM_KEYS               // Gamepad buttons
+                               + 9                      // Gamepad options
+                               + 1                      // Tick rate
+        ,
+        MIGRATION_OPS(v1_5),
+    },
+    {
+        .version = 0x0106,
+        .global_config_size = 14             // Other fields
+                              + NUM_KEYS * 2 // Bottom-out threshold
+                              + NUM_KEYS     // Switch models
+        ,
+        .profile_config_size = NUM_LAYERS * NUM_KEYS    // Keymap
+                               + NUM_KEYS * 4           // Actuation map
+                               + NUM_KEYS * 3           // Fine actuation map
+                               + NUM_ADVANCED_KEYS * 12 // Advanced keys
+                               + NUM_KEYS               // Gamepad buttons
+                               + 9                      // Gamepad options
+                               + 1                      // Tick rate
+        ,
+        MIGRATION_OPS(v1_6),
+    },
+    {
+        .version = 0x0107,
+        .global_config_size = 14             // Other fields
+                              + NUM_KEYS * 2 // Bottom-out threshold
+                              + NUM_KEYS     // Switch models
+                              + NUM_KEYS     // Calibration epsilon
+        ,
+        .profile_config_size = NUM_LAYERS * NUM_KEYS    // Keymap
+                               + NUM_KEYS * 4           // Actuation map
+                               + NUM_KEYS * 3           // Fine actuation map
+                               + NUM_ADVANCED_KEYS * 12 // Advanced keys
+                               + NUM_KEYS               // Gamepad buttons
+                               + 9                      // Gamepad options
+                               + 1                      // Tick rate
+        ,
+        MIGRATION_OPS(v1_7),
+    },
+    {
+        .version = LATEST_VERSION,
+        .global_config_size = LATEST_GLOBAL_CONFIG_SIZE,
+        .profile_config_size = LATEST_PROFILE_CONFIG_SIZE,
+        MIGRATION_OPS(v1_8),
     },
 };
 
+static bool migration_migrate_section(const migration_op_t *ops,
+                                      uint32_t num_ops, uint32_t src,
+                                      uint32_t src_size, uint32_t dst,
+                                      uint32_t dst_size);
+
+#if defined(EECONFIG_COMPACT_PROFILES)
+// First version that can have compact profiles
+#define COMPACT_PROFILES_VERSION 0x0104
+
+// Profile being migrated, and the default profile of its version. The
+// profiles of the previous versions are never larger than the latest one.
+static eeconfig_profile_t migration_profile;
+static eeconfig_profile_t migration_default_profile;
+
+static bool migration_migrate_compact_profiles(uint32_t from);
+#endif
+
 bool migration_try_migrate(void) {
   if (eeconfig->magic_start != EECONFIG_MAGIC_START)
     // The magic start is always the same for any version.
     return false;
 
   const uint16_t config_version = eeconfig->version;
-  // We alternate between two buffers to save the memory.
-  uint8_t current_buf = 0;
-  uint8_t bufs[2][sizeof(eeconfig_t)];
-
-  // Let `bufs[0]` be the current configuration.
-  memcpy(bufs[0], eeconfig, sizeof(eeconfig_t));
-  // Skip v1.0 migration since it is the initial version
-  for (uint32_t i = 1; i < M_ARRAY_SIZE(migrations); i++) {
+  uint32_t i = 0;
+
+  while (i < M_ARRAY_SIZE(migrations) &&
+         migrations[i].version != config_version)
+    i++;
+  if (i == M_ARRAY_SIZE(migrations))
+    // Unknown version
+    return false;
+
+#if defined(EECONFIG_COMPACT_PROFILES)
+  // The compact profiles are migrated to the latest version at once, before
+  // their slots are overwritten by the growing global configuration.
+  if (!migration_migrate_compact_profiles(i))
+    return false;
+#endif
+
+  // The configuration is migrated in place, one migration at a time. Since
+  // each section can only grow, the sections are migrated from the last
+  // profile to the global configuration, so that the source of a section is
+  // never overwritten before it is migrated.
+  for (i++; i < M_ARRAY_SIZE(migrations); i++) {
     const migration_t *m = &migrations[i];
     const migration_t *prev_m = &migrations[i - 1];
 
-    if (m->version <= config_version)
-      // Skip migrations that are not applicable
-      continue;
-
-    const uint8_t *src = bufs[current_buf];
-    uint8_t *dst = bufs[current_buf ^ 1];
+#if !defined(EECONFIG_COMPACT_PROFILES)
+    for (uint32_t p = NUM_PROFILES; p-- > 0;) {
+      // Offsets of the profile configuration in each version
+      const uint32_t src =
+          prev_m->global_config_size + p * prev_m->profile_config_size;
+      const uint32_t dst = m->global_config_size + p * m->profile_config_size;
+
+      if (!migration_migrate_section(
+              m->profile_config_ops, m->num_profile_config_ops, src,
+              prev_m->profile_config_size, dst, m->profile_config_size))
+        // Migration failed for the profile configuration
+        return false;
+    }
+#endif
 
-    if (m->global_config_func && !m->global_config_func(dst, src))
+    if (!migration_migrate_section(m->global_config_ops,
+                                   m->num_global_config_ops, 0,
+                                   prev_m->global_config_size, 0,
+                                   m->global_config_size))
       // Migration failed for the global configuration
       return false;
 
-    if (m->profile_config_func) {
-      for (uint8_t p = 0; p < NUM_PROFILES; p++) {
-        // Move the pointers to the start of each profile configuration
-        const uint8_t *profile_src =
-            src + prev_m->global_config_size + p * prev_m->profile_config_size;
-        uint8_t *profile_dst =
-            dst + m->global_config_size + p * m->profile_config_size;
-
-        if (!m->profile_config_func(p, profile_dst, profile_src))
-          // Migration failed for the profile configuration
-          return false;
-      }
-    }
-
-    // Update the version in the destination buffer
-    ((eeconfig_t *)dst)->version = m->version;
-    // Switch to the next buffer for the next migration
-    current_buf ^= 1;
+    // Update the version after the migration is complete
+    if (!EECONFIG_WRITE(version, &m->version))
+      return false;
   }
 
   // Make sure the configuration is valid after migration
-  ((eeconfig_t *)bufs[current_buf])->magic_end = EECONFIG_MAGIC_END;
-  // We reflect the update in the flash.
-  return wear_leveling_write(0, &bufs[current_buf], sizeof(eeconfig_t));
+  const uint32_t magic_end = EECONFIG_MAGIC_END;
+  return EECONFIG_WRITE(magic_end, &magic_end);
 }
 
 //--------------------------------------------------------------------+
 // Helper Functions
 //--------------------------------------------------------------------+
 
-static void migration_memcpy(uint8_t **dst, const uint8_t **src, uint32_t len) {
-  memcpy(*dst, *src, len);
-  *dst += len;
-  *src += len;
-}
+/**
+ * @brief Apply a migration operation
+ *
+ * The bytes are streamed through a small window from the end to the start, so
+ * that the source bytes are never overwritten before they are read as long as
+ * the destination is not before the source.
+ *
+ * @param op Migration operation
+ * @param src Address of the source bytes
+ * @param dst Address of the destination bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool migration_apply_op(const migration_op_t *op, uint32_t src,
+                               uint32_t dst) {
+  uint8_t window[MIGRATION_WINDOW_SIZE];
+  uint32_t window_size = MIGRATION_WINDOW_SIZE;
+
+  if (op->type == MIGRATION_OP_COPY && src == dst)
+    // Nothing to move
+    return true;
+
+  if (op->type == MIGRATION_OP_TRANSFORM) {
+    if (op->stride == 0 || op->stride > MIGRATION_WINDOW_SIZE ||
+        op->len % op->stride != 0)
+      // Invalid stride
+      return false;
+    // Only pass whole records to the transform function
+    window_size -= window_size % op->stride;
+  }
 
-static void migration_memset(uint8_t **dst, uint8_t value, uint32_t len) {
-  memset(*dst, value, len);
-  *dst += len;
-}
+  uint32_t remaining = op->len;
+  while (remaining > 0) {
+    const uint32_t len = M_MIN(remaining, window_size);
+    remaining -= len;
+
+    switch (op->type) {
+    case MIGRATION_OP_COPY:
+    case MIGRATION_OP_TRANSFORM:
+      if (!wear_leveling_read(src + remaining, window, len))
+        return false;
+      if (op->type == MIGRATION_OP_TRANSFORM)
+        op->transform(window, len);
+      break;
+
+    case MIGRATION_OP_FILL:
+      memset(window, op->value, len);
+      break;
+
+    case MIGRATION_OP_INSERT:
+      memcpy(window, op->data + remaining, len);
+      break;
+
+    default:
+      return false;
+    }
 
-#define MAKE_MIGRATION_ASSIGN(type)                                            \
-  static void migration_assign_##type(uint8_t **dst, type value) {             \
-    *(type *)(*dst) = value;                                                   \
-    *dst = (uint8_t *)((type *)(*dst) + 1);                                    \
+    if (!wear_leveling_write(dst + remaining, window, len))
+      return false;
   }
 
-MAKE_MIGRATION_ASSIGN(uint8_t)
-MAKE_MIGRATION_ASSIGN(uint16_t)
+  return true;
+}
 
-//--------------------------------------------------------------------+
-// v1.0 -> v1.1 Migration
-//--------------------------------------------------------------------+
+/**
+ * @brief Migrate a section of the configuration
+ *
+ * @param ops Migration operations
+ * @param num_ops Number of migration operations
+ * @param src Address of the section in the previous version
+ * @param src_size Size of the section in the previous version
+ * @param dst Address of the section in the new version
+ * @param dst_size Size of the section in the new version
+ *
+ * @return true if successful, false otherwise
+ */
+static bool migration_migrate_section(const migration_op_t *ops,
+                                      uint32_t num_ops, uint32_t src,
+                                      uint32_t src_size, uint32_t dst,
+                                      uint32_t dst_size) {
+  // The operations are applied from the last one for the same reason as the
+  // bytes in `migration_apply_op()`.
+  for (uint32_t i = num_ops; i-- > 0;) {
+    const migration_op_t *op = &ops[i];
+
+    if (op->len > dst_size)
+      return false;
+    dst_size -= op->len;
 
-bool v1_1_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0100)
-    // Expected version v1.0
-    return false;
+    if (op->type == MIGRATION_OP_COPY || op->type == MIGRATION_OP_TRANSFORM) {
+      if (op->len > src_size)
+        return false;
+      src_size -= op->len;
+    }
 
-  // Copy `magic_start` to `calibration`
-  migration_memcpy(&dst, &src, 10);
-  // Default `options` to 0
-  migration_assign_uint16_t(&dst, 0);
-  // Copy `current_profile` and `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
+    if (src + src_size > dst + dst_size)
+      // The operation would overwrite the source bytes that are not migrated
+      return false;
 
-  return true;
+    if (!migration_apply_op(op, src + src_size, dst + dst_size))
+      return false;
+  }
+
+  // The operations must cover both sections entirely
+  return src_size == 0 && dst_size == 0;
 }
 
-bool v1_1_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Save the `keymap` offset
-  uint8_t *keymap = dst;
-  // Copy `keymap` to `actuation_map`
-  migration_memcpy(&dst, &src, (NUM_LAYERS * NUM_KEYS) + (NUM_KEYS * 4));
-  // Update keycodes to include `KC_INT1` ... `KC_LNG6`
-  for (uint32_t i = 0; i < NUM_LAYERS * NUM_KEYS; i++) {
-    if (0x70 <= keymap[i] && keymap[i] <= 0x71)
-      // `KC_LNG1` and `KC_LNG2`
-      keymap[i] += 0x06;
-    else if (0x72 <= keymap[i] && keymap[i] <= 0x96)
-      // `KC_LEFT_CTRL` ... `SP_MOUSE_BUTTON_5`
-      keymap[i] += 0x09;
+#if defined(EECONFIG_COMPACT_PROFILES)
+/**
+ * @brief Migrate a section of the configuration in a buffer
+ *
+ * @param ops Migration operations
+ * @param num_ops Number of migration operations
+ * @param buf Buffer of the section, large enough for the new version
+ * @param src_size Size of the section in the previous version
+ * @param dst_size Size of the section in the new version
+ *
+ * @return true if successful, false otherwise
+ */
+static bool migration_migrate_buffer(const migration_op_t *ops,
+                                     uint32_t num_ops, uint8_t *buf,
+                                     uint32_t src_size, uint32_t dst_size) {
+  // The operations are applied from the last one as in
+  // `migration_migrate_section()`.
+  for (uint32_t i = num_ops; i-- > 0;) {
+    const migration_op_t *op = &ops[i];
+
+    if (op->len > dst_size)
+      return false;
+    dst_size -= op->len;
+
+    if (op->type == MIGRATION_OP_COPY || op->type == MIGRATION_OP_TRANSFORM) {
+      if (op->len > src_size)
+        return false;
+      src_size -= op->len;
+    }
+
+    if (src_size > dst_size)
+      // The operation would overwrite the source bytes that are not migrated
+      return false;
+
+    switch (op->type) {
+    case MIGRATION_OP_COPY:
+      memmove(buf + dst_size, buf + src_size, op->len);
+      break;
+
+    case MIGRATION_OP_TRANSFORM:
+      if (op->stride == 0 || op->len % op->stride != 0)
+        // Invalid stride
+        return false;
+      memmove(buf + dst_size, buf + src_size, op->len);
+      op->transform(buf + dst_size, op->len);
+      break;
+
+    case MIGRATION_OP_FILL:
+      memset(buf + dst_size, op->value, op->len);
+      break;
+
+    case MIGRATION_OP_INSERT:
+      memcpy(buf + dst_size, op->data, op->len);
+      break;
+
+    default:
+      return false;
+    }
   }
-  // Save the `advanced_keys` offset
-  uint8_t *advanced_keys = dst;
-  // Copy `advanced_keys`
-  migration_memcpy(&dst, &src, NUM_ADVANCED_KEYS * 12);
-  // Default `hold_on_other_key_press` to 0
-  for (uint8_t i = 0; i < NUM_ADVANCED_KEYS; i++) {
-    uint8_t *ak = advanced_keys + i * 12;
-    if (ak[2] == AK_TYPE_TAP_HOLD)
-      ak[7] = 0;
+
+  return src_size == 0 && dst_size == 0;
+}
+
+/**
+ * @brief Revert a section of the configuration in a buffer
+ *
+ * This is the inverse of `migration_migrate_buffer()`. The inserted bytes are
+ * dropped, and the copied bytes are moved back to the previous version.
+ *
+ * @param ops Migration operations
+ * @param num_ops Number of migration operations
+ * @param buf Buffer of the section
+ * @param src_size Size of the section in the previous version
+ * @param dst_size Size of the section in the new version
+ *
+ * @return true if successful, false if the section has transformed bytes
+ */
+static bool migration_revert_buffer(const migration_op_t *ops,
+                                    uint32_t num_ops, uint8_t *buf,
+                                    uint32_t src_size, uint32_t dst_size) {
+  uint32_t src = 0, dst = 0;
+
+  // The bytes only move towards the start, so the operations are reverted
+  // from the first one.
+  for (uint32_t i = 0; i < num_ops; i++) {
+    const migration_op_t *op = &ops[i];
+
+    if (op->len > dst_size - dst)
+      return false;
+
+    switch (op->type) {
+    case MIGRATION_OP_COPY:
+      if (op->len > src_size - src)
+        return false;
+      memmove(buf + src, buf + dst, op->len);
+      src += op->len;
+      break;
+
+    case MIGRATION_OP_FILL:
+    case MIGRATION_OP_INSERT:
+      break;
+
+    default:
+      // The bytes before a transform are unknown
+      return false;
+    }
+    dst += op->len;
   }
-  // Set `gamepad_buttons` to 0
-  migration_memset(&dst, 0, NUM_KEYS);
-  // Default `analog_curve` to linear
-  migration_assign_uint8_t(&dst, 4), migration_assign_uint8_t(&dst, 20);
-  migration_assign_uint8_t(&dst, 85), migration_assign_uint8_t(&dst, 95);
-  migration_assign_uint8_t(&dst, 165), migration_assign_uint8_t(&dst, 170);
-  migration_assign_uint8_t(&dst, 255), migration_assign_uint8_t(&dst, 255);
-  // Default `keyboard_enabled` and `snappy_joystick` to true
-  migration_assign_uint8_t(&dst, 0b00001001);
-  // Copy `tick_rate`
-  migration_memcpy(&dst, &src, 1);
 
-  return true;
+  return src == src_size && dst == dst_size;
 }
 
-//--------------------------------------------------------------------+
-// v1.1 -> v1.2 Migration
-//--------------------------------------------------------------------+
+/**
+ * @brief Migrate the compact profiles to the latest version
+ *
+ * Each profile is expanded against the default profile of its version, which
+ * is the latest default profile reverted to that version. It is then migrated
+ * in RAM and stored again in its slot of the latest layout. The profiles are
+ * migrated from the last one, as the slots move towards the end of the virtual
+ * storage with the global configuration.
+ *
+ * @param from Index of the version of the configuration in `migrations`
+ *
+ * @return true if successful, false otherwise
+ */
+static bool migration_migrate_compact_profiles(uint32_t from) {
+  const migration_t *from_m = &migrations[from];
+  const uint32_t slot_size =
+      EECONFIG_PROFILE_DELTA_SIZE_OF(from_m->global_config_size);
+  const uint32_t slots = from_m->global_config_size;
+  uint8_t *const profile = (uint8_t *)&migration_profile;
+  uint8_t *const default_profile = (uint8_t *)&migration_default_profile;
+  uint32_t magic_end;
+  uint16_t len;
+
+  if (from_m->version < COMPACT_PROFILES_VERSION)
+    // The configuration cannot have compact profiles
+    return false;
 
-bool v1_2_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0101)
-    // Expected version v1.1
+  if (!wear_leveling_read(slots + NUM_PROFILES * slot_size, &magic_end,
+                          sizeof(magic_end)) ||
+      magic_end != EECONFIG_MAGIC_END)
+    // The slots do not match the layout of the version
     return false;
 
-  // Copy `magic_start` to `calibration`
-  migration_memcpy(&dst, &src, 10);
-  // Set `bottom_out_threshold` to 0
-  migration_memset(&dst, 0, NUM_KEYS * 2);
-  // Copy `options` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 4);
+  for (uint32_t p = NUM_PROFILES; p-- > 0;) {
+    const uint32_t src = slots + p * slot_size;
+    uint32_t size;
 
-  return true;
-}
+    if (p > 0) {
+      // The new slot must not overwrite the delta of the previous profile
+      memcpy(&len, wl_cache + src - slot_size, sizeof(len));
+      if (EECONFIG_PROFILE_DELTA_ADDR(p) < src - slot_size + sizeof(len) + len)
+        return false;
+    }
+
+    memcpy(&len, wl_cache + src, sizeof(len));
+    if (len > slot_size - sizeof(len) ||
+        !compress_decode(profile, from_m->profile_config_size,
+                         wl_cache + src + sizeof(len), len, &size) ||
+        size != from_m->profile_config_size)
+      // Malformed delta
+      return false;
 
-bool v1_2_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src,
-                   NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
-                       NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1);
+    eeconfig_get_default_profile(p, &migration_default_profile);
+    for (uint32_t i = M_ARRAY_SIZE(migrations) - 1; i > from; i--) {
+      if (!migration_revert_buffer(migrations[i].profile_config_ops,
+                                   migrations[i].num_profile_config_ops,
+                                   default_profile,
+                                   migrations[i - 1].profile_config_size,
+                                   migrations[i].profile_config_size))
+        return false;
+    }
+    for (uint32_t i = 0; i < size; i++)
+      profile[i] ^= default_profile[i];
+
+    for (uint32_t i = from + 1; i < M_ARRAY_SIZE(migrations); i++) {
+      if (!migration_migrate_buffer(migrations[i].profile_config_ops,
+                                    migrations[i].num_profile_config_ops,
+                                    profile,
+                                    migrations[i - 1].profile_config_size,
+                                    migrations[i].profile_config_size))
+        return false;
+    }
+
+    if (!eeconfig_store_profile(p, &migration_profile))
+      // The delta does not fit in the new slot
+      return false;
+  }
 
   return true;
 }
+#endif
 
 //--------------------------------------------------------------------+
-// v1.2 -> v1.3 Migration
+// v1.0 -> v1.1 Migration
 //--------------------------------------------------------------------+
 
-bool v1_3_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0102)
-    // Expected version v1.2
-    return false;
-
-  // Copy `magic_start` to `bottom_out_threshold`
-  migration_memcpy(&dst, &src, 10 + NUM_KEYS * 2);
-  // Default `save_bottom_out_threshold` to true
-  uint16_t options = *((uint16_t *)src) | (1 << 1);
-  migration_assign_uint16_t(&dst, options);
-  src += sizeof(options);
-  // Copy `current_profile` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
+static void v1_1_keymap_transform(uint8_t *buf, uint32_t len) {
+  for (uint32_t i = 0; i < len; i++) {
+    if (0x70 <= buf[i] && buf[i] <= 0x71)
+      // `KC_LNG1` and `KC_LNG2`
+      buf[i] += 0x06;
+    else if (0x72 <= buf[i] && buf[i] <= 0x96)
+      // `KC_LEFT_CTRL` ... `SP_MOUSE_BUTTON_5`
+      buf[i] += 0x09;
+  }
+}
 
-  return true;
+static void v1_1_advanced_keys_transform(uint8_t *buf, uint32_t len) {
+  for (uint32_t i = 0; i < len; i += 12) {
+    uint8_t *ak = buf + i;
+    if (ak[2] == AK_TYPE_TAP_HOLD)
+      ak[7] = 0;
+  }
 }
 
-bool v1_3_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src,
-                   NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
-                       NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1);
+//--------------------------------------------------------------------+
+// v1.2 -> v1.3 Migration
+//--------------------------------------------------------------------+
 
-  return true;
+static void v1_3_options_transform(uint8_t *buf, uint32_t len) {
+  uint16_t options;
+
+  memcpy(&options, buf, sizeof(options));
+  options |= (1 << 1);
+  memcpy(buf, &options, sizeof(options));
 }
 
 //--------------------------------------------------------------------+
 // v1.3 -> v1.4 Migration
 //--------------------------------------------------------------------+
 
-bool v1_4_global_config_func(uint8_t *dst, const uint8_t *src) {
-  if (((eeconfig_t *)src)->version != 0x0103)
-    // Expected version v1.3
-    return false;
-
-  // Copy `magic_start` to `bottom_out_threshold`
-  migration_memcpy(&dst, &src, 10 + NUM_KEYS * 2);
-  // Default `high_polling_rate_enabled` to true
-  uint16_t options = *((uint16_t *)src) | (1 << 2);
-  migration_assign_uint16_t(&dst, options);
-  src += sizeof(options);
-  // Copy `current_profile` to `last_non_default_profile`
-  migration_memcpy(&dst, &src, 2);
+static void v1_4_options_transform(uint8_t *buf, uint32_t len) {
+  uint16_t options;
 
-  return true;
+  memcpy(&options, buf, sizeof(options));
+  options |= (1 << 2);
+  memcpy(buf, &options, sizeof(options));
 }
 
-bool v1_4_profile_config_func(uint8_t profile, uint8_t *dst,
-                              const uint8_t *src) {
-  // Copy the entire profile
-  migration_memcpy(&dst, &src,
-                   NUM_LAYERS * NUM_KEYS + NUM_KEYS * 4 +
-                       NUM_ADVANCED_KEYS * 12 + NUM_KEYS + 9 + 1);
+//--------------------------------------------------------------------+
+// v1.7 -> v1.8 Migration
+//--------------------------------------------------------------------+
 
-  return true;
+static void v1_8_options_transform(uint8_t *buf, uint32_t len) {
+  uint16_t options;
+
+  memcpy(&options, buf, sizeof(options));
+  options &= (uint16_t)~(1 << 3);
+  memcpy(buf, &options, sizeof(options));
 }
@@ -0,0 +1,447 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "noise.h"
+
+#include "eeconfig.h"
+#include "hardware/hardware.h"
+#include "idle.h"
+#include "matrix.h"
+
+// Phase of a key for the measurement of the drift over a press
+typedef enum {
+  // The key has not been at rest yet
+  NOISE_PHASE_UNKNOWN = 0,
+  NOISE_PHASE_REST,
+  NOISE_PHASE_PRESSED,
+  // The key has been released, and the filtered ADC value is settling
+  NOISE_PHASE_SETTLING,
+} noise_phase_t;
+
+// Accumulated samples of a key in one position
+typedef struct {
+  // Number of samples
+  uint16_t count;
+  // Range of the unfiltered ADC values
+  uint16_t min;
+  uint16_t max;
+  // Range of the filtered ADC values
+  uint16_t filtered_min;
+  uint16_t filtered_max;
+  // Sum of the unfiltered ADC values
+  uint32_t sum;
+  // Sum of the squares of the unfiltered ADC values
+  uint64_t sum_sq;
+} noise_accumulator_t;
+
+// Time of the last sample
+static uint32_t last_sample;
+
+// Measurement state
+static struct {
+  // Whether a measurement is in progress
+  bool active;
+  // Whether to save the calibration epsilons when the measurement completes
+  bool save;
+  // Duration of the measurement in milliseconds
+  uint16_t duration;
+  // Time when the measurement was started
+  uint32_t start;
+} noise;
+
+// Measurement state of each key
+static struct {
+  noise_accumulator_t rest;
+  noise_accumulator_t bottom_out;
+  // Rest value at the start of the measurement
+  uint16_t initial_rest_value;
+  // Filtered ADC value at rest before the last press
+  uint16_t pre_press_value;
+  // Maximum change of the filtered ADC value at rest over a press
+  uint16_t press_drift;
+  uint8_t phase;
+  // Time when the key was released
+  uint32_t release_time;
+} noise_keys[NUM_KEYS];
+
+// Auto-tune state
+static struct {
+  // Whether the minimum values of the keys may be non-zero
+  bool applied;
+  // Time when the current window was started
+  uint32_t window_start;
+} tune;
+
+// Auto-tune state of each key
+static struct {
+  // Whether the key has been sampled at rest in the current window
+  bool sampled;
+  // Whether the key has left the rest position in the current window
+  bool moved;
+  // Whether `adc_noise` has been measured
+  bool valid;
+  // Range of the filtered ADC value in the current window
+  uint16_t min;
+  uint16_t max;
+  // Estimated peak-to-peak noise of the filtered ADC value at rest
+  uint16_t adc_noise;
+} tune_keys[NUM_KEYS];
+
+/**
+ * @brief Check whether a key is at rest
+ *
+ * @param key Key state
+ *
+ * @return true if the key is at rest, false otherwise
+ */
+static bool noise_is_at_rest(const key_state_t *key) {
+  return !key->is_pressed && key->key_dir == KEY_DIR_INACTIVE &&
+         key->adc_filtered + MATRIX_DRIFT_THRESHOLD > key->adc_rest_value &&
+         key->adc_filtered < key->adc_rest_value + MATRIX_DRIFT_THRESHOLD;
+}
+
+/**
+ * @brief Add a sample to an accumulator
+ *
+ * @param acc Accumulator
+ * @param value Unfiltered ADC value
+ * @param filtered Filtered ADC value
+ *
+ * @return None
+ */
+static void noise_accumulate(noise_accumulator_t *acc, uint16_t value,
+                             uint16_t filtered) {
+  if (acc->count == UINT16_MAX)
+    return;
+
+  if (acc->count == 0) {
+    acc->min = acc->max = value;
+    acc->filtered_min = acc->filtered_max = filtered;
+  }
+  acc->count++;
+  acc->min = M_MIN(acc->min, value);
+  acc->max = M_MAX(acc->max, value);
+  acc->filtered_min = M_MIN(acc->filtered_min, filtered);
+  acc->filtered_max = M_MAX(acc->filtered_max, filtered);
+  acc->sum += value;
+  acc->sum_sq += (uint32_t)value * value;
+}
+
+/**
+ * @brief Compute the variance of the samples of an accumulator
+ *
+ * @param acc Accumulator
+ *
+ * @return Variance in 1/256 ADC counts squared
+ */
+static uint32_t noise_variance(const noise_accumulator_t *acc) {
+  if (acc->count == 0)
+    return 0;
+
+  // n * sum(x^2) - sum(x)^2 = n^2 * variance, which is non-negative
+  const uint64_t n = acc->count;
+  const uint64_t scaled =
+      (n * acc->sum_sq - (uint64_t)acc->sum * acc->sum) / n * 256 / n;
+
+  return (uint32_t)M_MIN(scaled, UINT32_MAX);
+}
+
+/**
+ * @brief Sample the ADC values of every key
+ *
+ * @param now Current time
+ *
+ * @return None
+ */
+static void noise_sample(uint32_t now) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    const key_state_t *key = &key_matrix[i];
+    const uint16_t value = analog_read((uint8_t)i);
+    const uint16_t filtered = key->adc_filtered;
+
+    if (noise_is_at_rest(key)) {
+      noise_accumulate(&noise_keys[i].rest, value, filtered);
+
+      switch (noise_keys[i].phase) {
+      case NOISE_PHASE_PRESSED:
+        noise_keys[i].phase = NOISE_PHASE_SETTLING;
+        noise_keys[i].release_time = now;
+        break;
+
+      case NOISE_PHASE_SETTLING:
+        if (now - noise_keys[i].release_time < NOISE_SETTLE_TIME)
+          break;
+        noise_keys[i].press_drift =
+            M_MAX(noise_keys[i].press_drift,
+                  filtered > noise_keys[i].pre_press_value
+                      ? filtered - noise_keys[i].pre_press_value
+                      : noise_keys[i].pre_press_value - filtered);
+        noise_keys[i].phase = NOISE_PHASE_REST;
+        break;
+
+      default:
+        noise_keys[i].pre_press_value = filtered;
+        noise_keys[i].phase = NOISE_PHASE_REST;
+        break;
+      }
+    } else {
+      if (filtered + MATRIX_DRIFT_THRESHOLD > key->adc_bottom_out_value)
+        noise_accumulate(&noise_keys[i].bottom_out, value, filtered);
+
+      if (key->is_pressed && noise_keys[i].phase != NOISE_PHASE_UNKNOWN)
+        noise_keys[i].phase = NOISE_PHASE_PRESSED;
+    }
+  }
+}
+
+/**
+ * @brief Find the smallest ADC value of a key at a distance
+ *
+ * @param key Key index
+ * @param distance Key travel distance (0-DISTANCE_MAX)
+ *
+ * @return ADC value
+ */
+static uint16_t noise_distance_to_adc(uint8_t key, distance_t distance) {
+  uint16_t low = key_matrix[key].adc_rest_value;
+  uint16_t high = M_MAX(key_matrix[key].adc_bottom_out_value, low);
+
+  // The distance is non-decreasing in the ADC value
+  while (low < high) {
+    const uint16_t mid = low + (high - low) / 2;
+
+    if (matrix_adc_to_distance(key, mid) < distance)
+      low = mid + 1;
+    else
+      high = mid;
+  }
+
+  return low;
+}
+
+/**
+ * @brief Update the minimum values of a key from its estimated noise
+ *
+ * @param key Key index
+ *
+ * @return None
+ */
+static void noise_tune_apply(uint8_t key) {
+  key_state_t *state = &key_matrix[key];
+  const uint16_t adc_noise = tune_keys[key].adc_noise;
+  const uint32_t margin = NOISE_TUNE_MARGIN << DISTANCE_FRACTION_BITS;
+  actuation_wide_t actuation;
+
+  if (!tune_keys[key].valid) {
+    state->min_actuation_point = 0;
+    state->min_rt = 0;
+    return;
+  }
+
+  // The distance is steepest at rest, so the actuation point must clear the
+  // noise there
+  const distance_t rest_noise =
+      matrix_adc_to_distance(key, state->adc_rest_value + adc_noise);
+  state->min_actuation_point =
+      (distance_t)M_MIN(rest_noise + margin, DISTANCE_MAX);
+
+  // Rapid Trigger only runs past the actuation point, unless Continuous Rapid
+  // Trigger is enabled
+  matrix_get_actuation(key, &actuation);
+  distance_t rt_noise = rest_noise;
+  if (!actuation.continuous) {
+    const uint16_t adc = noise_distance_to_adc(
+        key, (distance_t)(actuation.actuation_point >>
+                          (8 - DISTANCE_FRACTION_BITS)));
+
+    rt_noise = matrix_adc_to_distance(key, adc + adc_noise) -
+               matrix_adc_to_distance(key, adc);
+  }
+  state->min_rt = (distance_t)M_MIN(rt_noise + margin, DISTANCE_MAX);
+}
+
+/**
+ * @brief Sample the filtered ADC values of the keys for the auto-tune
+ *
+ * The noise of the keys is updated at the end of each window.
+ *
+ * @param now Current time
+ *
+ * @return None
+ */
+static void noise_tune_sample(uint32_t now) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    const key_state_t *key = &key_matrix[i];
+
+    if (!noise_is_at_rest(key))
+      tune_keys[i].moved = true;
+    else if (!tune_keys[i].sampled) {
+      tune_keys[i].sampled = true;
+      tune_keys[i].min = tune_keys[i].max = key->adc_filtered;
+    } else {
+      tune_keys[i].min = M_MIN(tune_keys[i].min, key->adc_filtered);
+      tune_keys[i].max = M_MAX(tune_keys[i].max, key->adc_filtered);
+    }
+  }
+
+  if (now - tune.window_start < NOISE_TUNE_WINDOW)
+    return;
+  tune.window_start = now;
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    if (tune_keys[i].sampled && !tune_keys[i].moved) {
+      const uint16_t peak_to_peak = tune_keys[i].max - tune_keys[i].min;
+      const uint16_t estimate = tune_keys[i].adc_noise;
+
+      if (!tune_keys[i].valid || peak_to_peak >= estimate)
+        tune_keys[i].adc_noise = peak_to_peak;
+      else
+        tune_keys[i].adc_noise =
+            estimate - ((estimate - peak_to_peak +
+                         (1 << NOISE_TUNE_DECAY_EXPONENT) - 1) >>
+                        NOISE_TUNE_DECAY_EXPONENT);
+      tune_keys[i].valid = true;
+    }
+    tune_keys[i].sampled = false;
+    tune_keys[i].moved = false;
+
+    // The actuation configuration and the calibration values may have changed
+    // since the last window
+    noise_tune_apply((uint8_t)i);
+  }
+  tune.applied = true;
+}
+
+/**
+ * @brief Clear the minimum values of the keys and the noise estimates
+ *
+ * @return None
+ */
+static void noise_tune_clear(void) {
+  memset(tune_keys, 0, sizeof(tune_keys));
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    key_matrix[i].min_actuation_point = 0;
+    key_matrix[i].min_rt = 0;
+  }
+  tune.applied = false;
+}
+
+void noise_start(uint16_t duration, bool save) {
+  if (duration == 0) {
+    noise.active = false;
+    return;
+  }
+
+  memset(noise_keys, 0, sizeof(noise_keys));
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    noise_keys[i].initial_rest_value = key_matrix[i].adc_rest_value;
+  noise.active = true;
+  noise.save = save;
+  noise.duration = duration;
+  noise.start = timer_read();
+}
+
+bool noise_is_active(void) { return noise.active; }
+
+void noise_task(void) {
+  const bool tune_enabled = eeconfig->options.auto_tune_enabled;
+
+  if (!tune_enabled && tune.applied)
+    noise_tune_clear();
+
+  if (!noise.active && !tune_enabled)
+    return;
+
+  if (noise.active)
+    // The keys must be scanned at full rate during the measurement
+    idle_wake();
+
+  const uint32_t now = timer_read();
+  if (now == last_sample)
+    return;
+  last_sample = now;
+
+  if (tune_enabled)
+    noise_tune_sample(now);
+
+  if (noise.active) {
+    noise_sample(now);
+    if (timer_elapsed(noise.start) >= noise.duration) {
+      noise.active = false;
+      if (noise.save)
+        noise_save_epsilon();
+    }
+  }
+}
+
+void noise_get_stats(uint8_t key, noise_stats_t *stats) {
+  const noise_accumulator_t *rest = &noise_keys[key].rest;
+  const noise_accumulator_t *bottom_out = &noise_keys[key].bottom_out;
+
+  stats->rest_samples = rest->count;
+  stats->rest_peak_to_peak = rest->max - rest->min;
+  stats->rest_variance = noise_variance(rest);
+  stats->rest_filtered_peak_to_peak = rest->filtered_max - rest->filtered_min;
+  stats->rest_drift = (int16_t)(key_matrix[key].adc_rest_value -
+                                noise_keys[key].initial_rest_value);
+  stats->bottom_out_samples = bottom_out->count;
+  stats->bottom_out_peak_to_peak = bottom_out->max - bottom_out->min;
+  stats->bottom_out_variance = noise_variance(bottom_out);
+  stats->bottom_out_filtered_peak_to_peak =
+      bottom_out->filtered_max - bottom_out->filtered_min;
+  stats->press_drift = noise_keys[key].press_drift;
+
+  stats->epsilon = 0;
+  if (rest->count >= NOISE_MIN_SAMPLES) {
+    // The calibration values are only updated by changes of the filtered ADC
+    // value that are larger than its noise, both at rest and bottomed out
+    uint32_t peak_to_peak = stats->rest_filtered_peak_to_peak;
+
+    if (bottom_out->count >= NOISE_MIN_SAMPLES)
+      peak_to_peak =
+          M_MAX(peak_to_peak, stats->bottom_out_filtered_peak_to_peak);
+    stats->epsilon =
+        (uint8_t)M_MIN(peak_to_peak + NOISE_EPSILON_MARGIN, UINT8_MAX);
+  }
+}
+
+void noise_get_tune(uint8_t key, noise_tune_t *tune) {
+  actuation_wide_t actuation;
+
+  matrix_get_actuation(key, &actuation);
+  tune->adc_noise = tune_keys[key].adc_noise;
+  tune->min_actuation_point = (uint16_t)(key_matrix[key].min_actuation_point
+                                         << (8 - DISTANCE_FRACTION_BITS));
+  tune->min_rt =
+      (uint16_t)(key_matrix[key].min_rt << (8 - DISTANCE_FRACTION_BITS));
+  tune->actuation_point = actuation.actuation_point;
+  tune->rt_down = actuation.rt_down;
+  tune->rt_up = actuation.rt_up;
+}
+
+bool noise_save_epsilon(void) {
+  uint8_t calibration_epsilon[NUM_KEYS];
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    noise_stats_t stats;
+
+    noise_get_stats((uint8_t)i, &stats);
+    calibration_epsilon[i] = stats.epsilon != 0
+                                 ? stats.epsilon
+                                 : eeconfig->calibration_epsilon[i];
+  }
+
+  return EECONFIG_WRITE(calibration_epsilon, calibration_epsilon);
+}
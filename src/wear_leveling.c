@@ -26,35 +26,161 @@ typedef enum {
   WL_STATUS_CONSOLIDATED,
 } wear_leveling_status_t;
 
+// Range of the virtual storage that is yet to be committed to flash
+typedef struct {
+  uint32_t start;
+  uint32_t end;
+} wl_dirty_range_t;
+
+#if defined(WL_DOUBLE_BANK)
+// The write log starts after the consolidated data, its CRC32 checksum, and
+// the bank header
+#define WL_LOG_START (WL_VIRTUAL_SIZE + 8)
+#else
+// The write log starts after the consolidated data and its CRC32 checksum
+#define WL_LOG_START (WL_VIRTUAL_SIZE + 4)
+#endif
+// The write log ends before the wear statistics
+#define WL_LOG_END (WL_BACKING_STORE_SIZE - WL_STATS_SIZE)
+
+_Static_assert(WL_LOG_END - WL_LOG_START >= WL_MAX_ENTRY_WORDS * 4,
+               "WL_WRITE_LOG_SIZE is too small to hold a write log entry.");
+
+// Wear statistics stored at the end of each bank, written before the checksum
+// when the backing store is consolidated
+typedef struct __attribute__((packed, aligned(4))) {
+  wl_stats_t stats;
+  // Address of the write log up to which the statistics account for
+  uint32_t log_address;
+  // CRC32 checksum of the fields above
+  uint32_t crc;
+} wl_stats_record_t;
+
+_Static_assert(sizeof(wl_stats_record_t) == WL_STATS_SIZE,
+               "wl_stats_record_t must be WL_STATS_SIZE bytes.");
+
+// Flash region holding a copy of the backing store
+typedef struct {
+  // First sector of the bank
+  uint32_t starting_sector;
+  // Sector following the last sector of the bank
+  uint32_t ending_sector;
+  // Flash address of the bank
+  uint32_t base_address;
+} wl_bank_t;
+
+#if defined(WL_DOUBLE_BANK)
+// Bank header, written after the rest of the consolidated data so that a bank
+// is only valid once it is complete
+typedef union {
+  struct {
+    // Incremented every time the backing store is consolidated
+    uint16_t sequence;
+    // Bitwise complement of the sequence number
+    uint16_t check;
+  };
+  uint32_t raw;
+} wl_bank_header_t;
+
+typedef enum {
+  WL_CONSOLIDATION_IDLE = 0,
+  // Erasing the inactive bank one sector at a time
+  WL_CONSOLIDATION_ERASE,
+  // Writing the cache to the inactive bank one chunk at a time
+  WL_CONSOLIDATION_WRITE,
+  // Computing the checksum of the inactive bank one chunk at a time
+  WL_CONSOLIDATION_CHECKSUM,
+  // Logging the changes made since the chunks were written, then writing the
+  // checksum and the bank header
+  WL_CONSOLIDATION_COMMIT,
+} wl_consolidation_state_t;
+#endif
+
 uint8_t wl_cache[WL_VIRTUAL_SIZE];
 
-static uint32_t starting_sector;
-static uint32_t base_address;
+static wl_bank_t banks[WL_NUM_BANKS];
+static uint32_t active_bank;
 static uint32_t write_address;
 
+#if defined(WL_DOUBLE_BANK)
+// Sequence number of the active bank
+static uint16_t sequence;
+
+// Background consolidation state
+static struct {
+  wl_consolidation_state_t state;
+  // Next sector to erase
+  uint32_t sector;
+  // Next offset of the virtual storage to write or to checksum
+  uint32_t offset;
+  // Whether a chunk is being checksummed asynchronously
+  volatile bool crc_busy;
+  // Checksum of the chunks so far
+  uint32_t crc;
+  // Chunk being checksummed, read back from flash
+  uint32_t chunk[WL_CONSOLIDATION_STEP_SIZE / 4];
+} consolidation;
+#endif
+
+// Wear statistics since the flash was first used
+static wl_stats_t wear_stats;
+
+// Pending ranges, which are disjoint and in no particular order
+static wl_dirty_range_t dirty_ranges[WL_DIRTY_RANGES];
+static uint32_t num_dirty_ranges;
+// Time of the last write operation
+static uint32_t last_write;
+
+__attribute__((always_inline)) static inline bool
+wear_leveling_sector_erase(uint32_t sector) {
+  wear_stats.erases++;
+  return flash_erase(sector);
+}
+
 /**
- * @brief Erase the flash memory used by the wear leveling module
+ * @brief Erase a bank of the backing store
+ *
+ * @param bank Bank index
  *
  * @return true if the erase was successful, false otherwise
  */
 __attribute__((always_inline)) static inline bool
-wear_leveling_flash_erase(void) {
-  for (uint32_t i = starting_sector; i < FLASH_NUM_SECTORS; i++) {
-    if (!flash_erase(i))
+wear_leveling_bank_erase(uint32_t bank) {
+  for (uint32_t i = banks[bank].starting_sector; i < banks[bank].ending_sector;
+       i++) {
+    if (!wear_leveling_sector_erase(i))
       return false;
   }
 
   return true;
 }
 
+__attribute__((always_inline)) static inline bool
+wear_leveling_bank_read(uint32_t bank, uint32_t addr, void *buf,
+                        uint32_t len) {
+  return flash_read(banks[bank].base_address + addr, buf, len);
+}
+
+__attribute__((always_inline)) static inline bool
+wear_leveling_bank_write(uint32_t bank, uint32_t addr, const void *buf,
+                         uint32_t len) {
+  wear_stats.flash_bytes += len * 4;
+  return flash_write(banks[bank].base_address + addr, buf, len);
+}
+
 __attribute__((always_inline)) static inline bool
 wear_leveling_flash_read(uint32_t addr, void *buf, uint32_t len) {
-  return flash_read(base_address + addr, buf, len);
+  return wear_leveling_bank_read(active_bank, addr, buf, len);
+}
+
+__attribute__((always_inline)) static inline const uint32_t *
+wear_leveling_flash_map(uint32_t addr, uint32_t len) {
+  return flash_map(banks[active_bank].base_address + addr, len);
 }
 
 __attribute__((always_inline)) static inline bool
 wear_leveling_flash_write(uint32_t addr, const void *buf, uint32_t len) {
-  return flash_write(base_address + addr, buf, len);
+  return wear_leveling_bank_write(active_bank, addr, buf, len);
 }
 
 static void wear_leveling_clear_cache(void) {
@@ -62,8 +188,130 @@ static void wear_leveling_clear_cache(void) {
   uint32_t *wl_cache32 = (uint32_t *)wl_cache;
   for (uint32_t i = 0; i < WL_VIRTUAL_SIZE / 4; i++)
     wl_cache32[i] = FLASH_EMPTY_VAL;
-  // Skip the first 4 bytes reserved for CRC32 checksum of the consolidated data
-  write_address = WL_VIRTUAL_SIZE + 4;
+  // Skip the words reserved before the write log
+  write_address = WL_LOG_START;
+}
+
+/**
+ * @brief Get the number of words of a write log entry
+ *
+ * @param len Length of the data in bytes, at most
+ * `WL_MAX_BYTES_PER_EXTENDED_ENTRY`
+ *
+ * @return Number of words of the entry
+ */
+static uint32_t wear_leveling_entry_words(uint32_t len) {
+  if (len > WL_MAX_BYTES_PER_ENTRY)
+    // Extended entries are at least as compact for longer data
+    return 1 + M_DIV_CEIL(len, 4);
+
+  // More data in the second word if the first word is not enough
+  return len > 2 ? 2 : 1;
+}
+
+/**
+ * @brief Get the length of the next write log entry for some data
+ *
+ * Entries are written one word at a time, so an entry torn by a power loss
+ * ends with empty words. The length is shortened by one byte if the last word
+ * of the entry would be empty, so that the replay can tell a torn entry from
+ * a complete one by its last word. The padding bytes are zeros, so only an
+ * entry ending with 4 data bytes can end with an empty word.
+ *
+ * @param buf Data to log
+ * @param len Length of the data in bytes, at least 1
+ *
+ * @return Length of the data of the entry in bytes
+ */
+static uint32_t wear_leveling_entry_len(const uint8_t *buf, uint32_t len) {
+  uint32_t entry_len = M_MIN(len, WL_MAX_BYTES_PER_EXTENDED_ENTRY);
+
+  if (entry_len == WL_MAX_BYTES_PER_ENTRY ||
+      (entry_len > WL_MAX_BYTES_PER_ENTRY && entry_len % 4 == 0)) {
+    uint32_t last_word;
+
+    memcpy(&last_word, buf + entry_len - 4, 4);
+    if (last_word == FLASH_EMPTY_VAL)
+      entry_len--;
+  }
+
+  return entry_len;
+}
+
+/**
+ * @brief Compute the CRC32 byte of an extended write log entry
+ *
+ * @param words Words of the entry, with the CRC32 byte set to zero
+ * @param num_words Number of words of the entry
+ *
+ * @return CRC32 byte
+ */
+static uint8_t wear_leveling_entry_crc(const uint32_t *words,
+                                       uint32_t num_words) {
+  return crc32_compute(words, num_words * 4, 0) & 0xFF;
+}
+
+/**
+ * @brief Encode a write log entry
+ *
+ * @param words Buffer of at least `WL_MAX_ENTRY_WORDS` words to store the entry
+ * @param addr Address of the data in the virtual storage
+ * @param buf Data of the entry
+ * @param len Length of the data in bytes, at most
+ * `WL_MAX_BYTES_PER_EXTENDED_ENTRY`
+ *
+ * @return Number of words of the entry
+ */
+static uint32_t wear_leveling_encode_entry(uint32_t *words, uint32_t addr,
+                                           const uint8_t *buf, uint32_t len) {
+  const uint32_t num_words = wear_leveling_entry_words(len);
+
+  if (len <= WL_MAX_BYTES_PER_ENTRY) {
+    wl_log_entry_t entry = {0};
+
+    entry.fields.addr = addr;
+    entry.fields.len = len;
+    memcpy(entry.fields.data, buf, len);
+    memcpy(words, &entry, num_words * 4);
+
+    return num_words;
+  }
+
+  wl_extended_log_entry_t header = {0};
+  header.fields.addr = addr;
+  header.fields.len = WL_EXTENDED_ENTRY;
+  header.fields.data_len = len;
+
+  words[0] = header.raw;
+  // Pad the data with zeros
+  words[num_words - 1] = 0;
+  memcpy(&words[1], buf, len);
+  header.fields.crc = wear_leveling_entry_crc(words, num_words);
+  words[0] = header.raw;
+
+  return num_words;
+}
+
+/**
+ * @brief Compute the CRC32 checksum of the cache
+ *
+ * @return CRC32 checksum
+ */
+static uint32_t wear_leveling_checksum(void) {
+#if defined(WL_DOUBLE_BANK)
+  // The checksum is chained over the consolidation chunks so that it can also
+  // be computed from flash one chunk at a time
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < WL_VIRTUAL_SIZE;
+       offset += WL_CONSOLIDATION_STEP_SIZE)
+    crc = crc32_compute(
+        wl_cache + offset,
+        M_MIN(WL_CONSOLIDATION_STEP_SIZE, WL_VIRTUAL_SIZE - offset), crc);
+
+  return crc;
+#else
+  return crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
+#endif
 }
 
 /**
@@ -82,7 +330,7 @@ static wear_leveling_status_t wear_leveling_read_consolidated(void) {
 
   if (status != WL_STATUS_FAILED) {
     // Check the CRC32 checksum
-    const uint32_t expected = crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
+    const uint32_t expected = wear_leveling_checksum();
     uint32_t actual;
 
     if (!wear_leveling_flash_read(WL_VIRTUAL_SIZE, &actual, 1) ||
@@ -97,10 +345,275 @@ static wear_leveling_status_t wear_leveling_read_consolidated(void) {
   return status;
 }
 
+/**
+ * @brief Write the wear statistics to a bank
+ *
+ * The bank must be complete once the checksum and the bank header are written
+ * after the statistics, which are accounted for in advance.
+ *
+ * @param bank Bank index
+ * @param log_address Address of the write log up to which the statistics
+ * account for
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_write_stats(uint32_t bank, uint32_t log_address) {
+  wl_stats_record_t record = {
+      .stats = wear_stats,
+      .log_address = log_address,
+  };
+
+  record.stats.flash_bytes +=
+      sizeof(record) + (WL_LOG_START - WL_VIRTUAL_SIZE);
+  record.crc = crc32_compute(&record, offsetof(wl_stats_record_t, crc), 0);
+
+  return wear_leveling_bank_write(bank, WL_LOG_END, &record,
+                                  sizeof(record) / 4);
+}
+
+/**
+ * @brief Load the wear statistics of the active bank
+ *
+ * The statistics are reset if they are missing or corrupted.
+ *
+ * @param log_address Set to the address of the write log up to which the
+ * statistics account for
+ *
+ * @return true if the statistics were loaded, false if they were reset
+ */
+static bool wear_leveling_read_stats(uint32_t *log_address) {
+  wl_stats_record_t record;
+
+  if (!wear_leveling_flash_read(WL_LOG_END, &record, sizeof(record) / 4) ||
+      crc32_compute(&record, offsetof(wl_stats_record_t, crc), 0) !=
+          record.crc ||
+      record.log_address < WL_LOG_START || record.log_address > WL_LOG_END) {
+    memset(&wear_stats, 0, sizeof(wear_stats));
+    *log_address = WL_LOG_START;
+    return false;
+  }
+  wear_stats = record.stats;
+  *log_address = record.log_address;
+
+  return true;
+}
+
+#if defined(WL_DOUBLE_BANK)
+/**
+ * @brief Start consolidating the cache into the inactive bank
+ *
+ * @return None
+ */
+static void wear_leveling_consolidation_start(void) {
+  consolidation.state = WL_CONSOLIDATION_ERASE;
+  consolidation.sector = banks[active_bank ^ 1].starting_sector;
+  consolidation.offset = 0;
+}
+
+/**
+ * @brief Finish the background consolidation
+ *
+ * The chunks written to the inactive bank may be outdated, so the bytes that
+ * differ from the cache are logged in the write log of the inactive bank. The
+ * bank header is written last to make the inactive bank the active one. If the
+ * write log cannot hold the changes, the consolidation is started over.
+ *
+ * @return true if successful or started over, false otherwise
+ */
+static bool wear_leveling_consolidation_commit(void) {
+  const uint32_t bank = active_bank ^ 1;
+  uint32_t chunk[WL_CONSOLIDATION_STEP_SIZE / 4];
+  const uint8_t *chunk8 = (const uint8_t *)chunk;
+  uint32_t log_address = WL_LOG_START;
+
+  for (uint32_t offset = 0; offset < WL_VIRTUAL_SIZE;
+       offset += WL_CONSOLIDATION_STEP_SIZE) {
+    const uint32_t len =
+        M_MIN(WL_CONSOLIDATION_STEP_SIZE, WL_VIRTUAL_SIZE - offset);
+
+    if (!wear_leveling_bank_read(bank, offset, chunk, len / 4))
+      return false;
+
+    for (uint32_t i = 0; i < len;) {
+      if (chunk8[i] == wl_cache[offset + i]) {
+        i++;
+        continue;
+      }
+
+      // Log the outdated bytes one entry at a time
+      uint32_t entry_len = 1;
+      while (entry_len < WL_MAX_BYTES_PER_EXTENDED_ENTRY &&
+             i + entry_len < len &&
+             chunk8[i + entry_len] != wl_cache[offset + i + entry_len])
+        entry_len++;
+      entry_len = wear_leveling_entry_len(wl_cache + offset + i, entry_len);
+
+      uint32_t words[WL_MAX_ENTRY_WORDS];
+      const uint32_t num_words = wear_leveling_encode_entry(
+          words, offset + i, wl_cache + offset + i, entry_len);
+
+      if (log_address + num_words * 4 > WL_LOG_END) {
+        // The chunks are too outdated for the changes to fit in the write
+        // log, so the consolidation is started over with the current cache
+        wear_leveling_consolidation_start();
+        return true;
+      }
+      if (!wear_leveling_bank_write(bank, log_address, words, num_words))
+        return false;
+      wear_stats.log_entries++;
+      log_address += num_words * 4;
+      i += entry_len;
+    }
+  }
+
+  const uint16_t next_sequence = sequence + 1;
+  const wl_bank_header_t header = {
+      .sequence = next_sequence,
+      .check = ~next_sequence,
+  };
+  wear_stats.consolidations++;
+  if (!wear_leveling_write_stats(bank, log_address) ||
+      !wear_leveling_bank_write(bank, WL_VIRTUAL_SIZE, &consolidation.crc,
+                                1) ||
+      !wear_leveling_bank_write(bank, WL_VIRTUAL_SIZE + 4, &header.raw, 1))
+    return false;
+
+  // The inactive bank is now identical to the cache
+  active_bank = bank;
+  sequence = next_sequence;
+  write_address = log_address;
+  num_dirty_ranges = 0;
+  consolidation.state = WL_CONSOLIDATION_IDLE;
+
+  return true;
+}
+
+/**
+ * @brief Store the checksum of the chunks so far
+ *
+ * This function may be called from an interrupt handler.
+ *
+ * @param crc Checksum of the chunks so far
+ *
+ * @return None
+ */
+static void wear_leveling_checksum_callback(uint32_t crc) {
+  consolidation.crc = crc;
+  consolidation.crc_busy = false;
+}
+
+/**
+ * @brief Perform a step of the background consolidation
+ *
+ * If the step fails, the consolidation is aborted and will be started over.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_consolidation_step(void) {
+  const uint32_t bank = active_bank ^ 1;
+  bool status = true;
+
+  switch (consolidation.state) {
+  case WL_CONSOLIDATION_ERASE:
+    status = wear_leveling_sector_erase(consolidation.sector);
+    if (++consolidation.sector == banks[bank].ending_sector)
+      consolidation.state = WL_CONSOLIDATION_WRITE;
+    break;
+
+  case WL_CONSOLIDATION_WRITE: {
+    const uint32_t len = M_MIN(WL_CONSOLIDATION_STEP_SIZE,
+                               WL_VIRTUAL_SIZE - consolidation.offset);
+
+    status = wear_leveling_bank_write(bank, consolidation.offset,
+                                      wl_cache + consolidation.offset, len / 4);
+    consolidation.offset += len;
+    if (consolidation.offset == WL_VIRTUAL_SIZE) {
+      consolidation.state = WL_CONSOLIDATION_CHECKSUM;
+      consolidation.offset = 0;
+    }
+    break;
+  }
+
+  case WL_CONSOLIDATION_CHECKSUM: {
+    if (consolidation.crc_busy)
+      // Wait for the previous chunk
+      break;
+
+    if (consolidation.offset == WL_VIRTUAL_SIZE) {
+      consolidation.state = WL_CONSOLIDATION_COMMIT;
+      break;
+    }
+
+    // The checksum is computed from flash since the cache may have changed
+    // since the chunks were written. It is chained over the chunks like
+    // `wear_leveling_checksum()`.
+    const uint32_t len = M_MIN(WL_CONSOLIDATION_STEP_SIZE,
+                               WL_VIRTUAL_SIZE - consolidation.offset);
+    if (consolidation.offset == 0)
+      consolidation.crc = 0;
+    status = wear_leveling_bank_read(bank, consolidation.offset,
+                                     consolidation.chunk, len / 4);
+    if (!status)
+      break;
+
+    consolidation.crc_busy = true;
+    if (!crc32_compute_async(consolidation.chunk, len, consolidation.crc,
+                             wear_leveling_checksum_callback)) {
+      // The CRC unit is busy so we retry in the next step
+      consolidation.crc_busy = false;
+      break;
+    }
+    consolidation.offset += len;
+    break;
+  }
+
+  case WL_CONSOLIDATION_COMMIT:
+    status = wear_leveling_consolidation_commit();
+    break;
+
+  default:
+    break;
+  }
+
+  if (!status)
+    consolidation.state = WL_CONSOLIDATION_IDLE;
+
+  return status;
+}
+
+static wear_leveling_status_t wear_leveling_consolidate_force(void) {
+  // Complete the background consolidation synchronously. The progress of an
+  // ongoing consolidation is kept since outdated chunks are fixed up when
+  // committing. If they are too outdated, the commit starts over, and the
+  // second pass succeeds since the cache does not change in the meantime.
+  if (consolidation.state == WL_CONSOLIDATION_IDLE)
+    wear_leveling_consolidation_start();
+  while (consolidation.state != WL_CONSOLIDATION_IDLE) {
+    if (!wear_leveling_consolidation_step())
+      return WL_STATUS_FAILED;
+  }
+
+  return WL_STATUS_CONSOLIDATED;
+}
+
+static wear_leveling_status_t wear_leveling_consolidate_if_needed(void) {
+  if (write_address >= WL_LOG_END)
+    // Consolidate the cache if the write log is full
+    return wear_leveling_consolidate_force();
+
+  if (write_address - WL_LOG_START >= WL_CONSOLIDATION_THRESHOLD &&
+      consolidation.state == WL_CONSOLIDATION_IDLE)
+    // Start consolidating in the background before the write log is full
+    wear_leveling_consolidation_start();
+
+  return WL_STATUS_OK;
+}
+#else
 /**
  * @brief Consolidate the cache with the flash memory
  *
- * This function writes the cache to flash and updates the CRC32 checksum.
+ * This function writes the cache and the wear statistics to flash, and updates
+ * the CRC32 checksum.
  * The flash memory must be erased before calling this function.
  *
  * @return Wear leveling status
@@ -108,13 +621,15 @@ static wear_leveling_status_t wear_leveling_read_consolidated(void) {
 static wear_leveling_status_t wear_leveling_write_consolidated(void) {
   wear_leveling_status_t status = WL_STATUS_CONSOLIDATED;
 
-  // Write the cache to flash
-  if (!wear_leveling_flash_write(0, wl_cache, WL_VIRTUAL_SIZE / 4))
+  // Write the cache and the wear statistics to flash
+  wear_stats.consolidations++;
+  if (!wear_leveling_flash_write(0, wl_cache, WL_VIRTUAL_SIZE / 4) ||
+      !wear_leveling_write_stats(active_bank, WL_LOG_START))
     status = WL_STATUS_FAILED;
 
   if (status != WL_STATUS_FAILED) {
     // Write the CRC32 checksum
-    const uint32_t checksum = crc32_compute(wl_cache, WL_VIRTUAL_SIZE, 0);
+    const uint32_t checksum = wear_leveling_checksum();
 
     if (!wear_leveling_flash_write(WL_VIRTUAL_SIZE, &checksum, 1))
       status = WL_STATUS_FAILED;
@@ -124,50 +639,105 @@ static wear_leveling_status_t wear_leveling_write_consolidated(void) {
 }
 
 static wear_leveling_status_t wear_leveling_consolidate_force(void) {
-  if (!wear_leveling_flash_erase())
+  if (!wear_leveling_bank_erase(active_bank))
     return WL_STATUS_FAILED;
 
   const wear_leveling_status_t status = wear_leveling_write_consolidated();
-  write_address = WL_VIRTUAL_SIZE + 4;
+  write_address = WL_LOG_START;
+  // The whole cache has been committed
+  num_dirty_ranges = 0;
 
   return status;
 }
 
 static wear_leveling_status_t wear_leveling_consolidate_if_needed(void) {
-  if (write_address >= WL_BACKING_STORE_SIZE)
+  if (write_address >= WL_LOG_END)
     // Consolidate the cache if the write log is full
     return wear_leveling_consolidate_force();
 
   return WL_STATUS_OK;
 }
+#endif
 
 /**
  * @brief Replay the write log
  *
  * This function replays the write log to update the cache with the latest
- * changes. The cache must be consolidated before calling this function.
+ * changes. The cache must be consolidated before calling this function. The
+ * entries from `stats_address` are accounted for in the wear statistics.
+ *
+ * The backing store of an older firmware has no wear statistics, and its
+ * write log extends over them up to `WL_BACKING_STORE_SIZE`. It is replayed
+ * up to there, then consolidated to make room for the wear statistics.
+ *
+ * @param stats_address Address of the write log up to which the wear
+ * statistics account for
+ * @param log_end Address of the end of the write log
  *
  * @return Wear leveling status
  */
-static wear_leveling_status_t wear_leveling_replay_log(void) {
+static wear_leveling_status_t wear_leveling_replay_log(uint32_t stats_address,
+                                                       uint32_t log_end) {
   wear_leveling_status_t status = WL_STATUS_OK;
-  uint32_t addr = WL_VIRTUAL_SIZE + 4;
+  uint32_t addr = WL_LOG_START;
+  // The write log is read in place, indexed by the backing store address
+  const uint32_t *log = wear_leveling_flash_map(0, log_end / 4);
 
-  while (addr < WL_BACKING_STORE_SIZE) {
-    uint32_t value;
+  if (log == NULL)
+    status = WL_STATUS_FAILED;
+
+  while (status != WL_STATUS_FAILED && addr < log_end) {
+    uint32_t value = log[addr / 4];
 
-    if (!wear_leveling_flash_read(addr, &value, 1)) {
-      status = WL_STATUS_FAILED;
-      break;
-    }
     if (value == FLASH_EMPTY_VAL)
       // No more entries in the write log
       break;
+    // Whether the entry is accounted for in the wear statistics
+    const bool new_entry = addr >= stats_address;
+    wear_stats.log_entries += new_entry;
     addr += 4;
 
     wl_log_entry_t entry;
     entry.raw[0] = value;
 
+    if (entry.fields.len == WL_EXTENDED_ENTRY) {
+      uint32_t words[WL_MAX_ENTRY_WORDS];
+      wl_extended_log_entry_t header = {.raw = value};
+      const uint32_t data_len = header.fields.data_len;
+      const uint32_t num_words = wear_leveling_entry_words(data_len);
+
+      if (data_len <= WL_MAX_BYTES_PER_ENTRY ||
+          data_len > WL_MAX_BYTES_PER_EXTENDED_ENTRY ||
+          header.fields.addr + data_len > WL_VIRTUAL_SIZE) {
+        // The entry is invalid
+        status = WL_STATUS_FAILED;
+        break;
+      }
+
+      for (uint32_t i = 1; i < num_words; i++, addr += 4)
+        // The entry may be truncated by the end of the write log
+        words[i] = addr < log_end ? log[addr / 4] : FLASH_EMPTY_VAL;
+
+      if (words[num_words - 1] == FLASH_EMPTY_VAL)
+        // The device lost power while the entry was being written, so the
+        // entry is skipped. The following entries are still replayed.
+        continue;
+
+      const uint8_t crc = header.fields.crc;
+      header.fields.crc = 0;
+      words[0] = header.raw;
+      if (wear_leveling_entry_crc(words, num_words) != crc) {
+        // The entry is corrupted
+        status = WL_STATUS_FAILED;
+        break;
+      }
+
+      // Update the cache with the entry
+      memcpy(wl_cache + header.fields.addr, &words[1], data_len);
+      wear_stats.user_bytes += new_entry ? data_len : 0;
+      continue;
+    }
+
     if (entry.fields.addr + entry.fields.len > WL_VIRTUAL_SIZE) {
       // The entry is invalid
       status = WL_STATUS_FAILED;
@@ -175,21 +745,28 @@ static wear_leveling_status_t wear_leveling_replay_log(void) {
     }
 
     if (entry.fields.len > 2) {
-      // More data in the second word
-      if (!wear_leveling_flash_read(addr, &entry.raw[1], 1)) {
-        status = WL_STATUS_FAILED;
-        break;
-      }
+      // More data in the second word, unless the entry is truncated by the
+      // end of the write log
+      value = addr < log_end ? log[addr / 4] : FLASH_EMPTY_VAL;
+      entry.raw[1] = value;
       addr += 4;
+
+      if (value == FLASH_EMPTY_VAL)
+        // The device lost power while the entry was being written
+        continue;
     }
 
     // Update the cache with the entry
     memcpy(wl_cache + entry.fields.addr, entry.fields.data, entry.fields.len);
+    wear_stats.user_bytes += new_entry ? entry.fields.len : 0;
   }
 
   write_address = addr;
-  if (status == WL_STATUS_FAILED)
-    // If the replay failed, we stick with the current cache
+  if (write_address > stats_address)
+    wear_stats.flash_bytes += write_address - stats_address;
+  if (status == WL_STATUS_FAILED || log_end != WL_LOG_END)
+    // If the replay failed, we stick with the current cache. The write log of
+    // an older firmware is consolidated to write the wear statistics.
     status = wear_leveling_consolidate_force();
   else
     // Otherwise, we consolidate the cache if needed
@@ -198,6 +775,28 @@ static wear_leveling_status_t wear_leveling_replay_log(void) {
   return status;
 }
 
+/**
+ * @brief Get the size of the write log entries for a write operation
+ *
+ * @param buf Data to write
+ * @param len Length of the data in bytes
+ *
+ * @return Size of the write log entries in bytes
+ */
+static uint32_t wear_leveling_log_size(const uint8_t *buf, uint32_t len) {
+  uint32_t size = 0;
+
+  while (len > 0) {
+    const uint32_t entry_len = wear_leveling_entry_len(buf, len);
+
+    size += wear_leveling_entry_words(entry_len) * 4;
+    buf += entry_len;
+    len -= entry_len;
+  }
+
+  return size;
+}
+
 static wear_leveling_status_t wear_leveling_append(uint32_t value) {
   // Append the value to the write log
   if (!wear_leveling_flash_write(write_address, &value, 1))
@@ -212,24 +811,17 @@ wear_leveling_write_raw(uint32_t addr, const void *buf, uint32_t len) {
   const uint8_t *buf8 = buf;
 
   while (len > 0) {
-    const uint32_t write_len = M_MIN(len, WL_MAX_BYTES_PER_ENTRY);
-    wl_log_entry_t entry = {0};
+    const uint32_t write_len = wear_leveling_entry_len(buf8, len);
+    uint32_t words[WL_MAX_ENTRY_WORDS];
+    const uint32_t num_words =
+        wear_leveling_encode_entry(words, addr, buf8, write_len);
 
-    entry.fields.addr = addr;
-    entry.fields.len = write_len;
-    memcpy(entry.fields.data, buf8, write_len);
-
-    wear_leveling_status_t status = wear_leveling_append(entry.raw[0]);
-    if (status != WL_STATUS_OK)
-      // If we consolidate the cache, the changes have been applied to the
-      // consolidated data so no need to continue the write operation.
-      return status;
-
-    if (write_len > 2) {
-      // More data in the second word
-      status = wear_leveling_append(entry.raw[1]);
+    wear_stats.log_entries++;
+    for (uint32_t i = 0; i < num_words; i++) {
+      const wear_leveling_status_t status = wear_leveling_append(words[i]);
       if (status != WL_STATUS_OK)
-        // Same as above
+        // If we consolidate the cache, the changes have been applied to the
+        // consolidated data so no need to continue the write operation.
         return status;
     }
 
@@ -241,23 +833,162 @@ wear_leveling_write_raw(uint32_t addr, const void *buf, uint32_t len) {
   return WL_STATUS_OK;
 }
 
-void wear_leveling_init(void) {
-  // Find the first sector from the end of the flash that is large enough to
-  // hold the backing store
-  uint32_t reserved_size = 0;
-  for (uint32_t i = FLASH_NUM_SECTORS; i-- > 0;) {
-    reserved_size += flash_sector_size(i);
-    if (reserved_size >= WL_BACKING_STORE_SIZE) {
-      starting_sector = i;
-      break;
+/**
+ * @brief Mark a range of the virtual storage as pending
+ *
+ * The range is merged with every pending range that overlaps with it or is at
+ * most `WL_DIRTY_MERGE_GAP` bytes apart. If all the slots are used, the
+ * pending writes are committed first, since merging distant ranges would log
+ * the unchanged bytes between them.
+ *
+ * @param start Start address of the range
+ * @param end End address of the range (exclusive)
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_mark_dirty(uint32_t start, uint32_t end) {
+  bool status = true;
+
+  for (uint32_t i = 0; i < num_dirty_ranges;) {
+    const wl_dirty_range_t *r = &dirty_ranges[i];
+
+    if (start > r->end + WL_DIRTY_MERGE_GAP ||
+        r->start > end + WL_DIRTY_MERGE_GAP) {
+      i++;
+      continue;
     }
+    start = M_MIN(start, r->start);
+    end = M_MAX(end, r->end);
+    // Remove the merged range. The range moved into its slot is checked next.
+    dirty_ranges[i] = dirty_ranges[--num_dirty_ranges];
   }
-  base_address = FLASH_SIZE - reserved_size;
+
+  if (num_dirty_ranges == WL_DIRTY_RANGES)
+    // The new range is already in the cache but it is not committed since it
+    // is not marked as pending yet
+    status = wear_leveling_flush();
+
+  dirty_ranges[num_dirty_ranges++] = (wl_dirty_range_t){
+      .start = start,
+      .end = end,
+  };
+
+  return status;
+}
+
+/**
+ * @brief Write data to the cache and mark it as pending
+ *
+ * The address range must be valid.
+ *
+ * @param addr Address to write to
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_write_cache(uint32_t addr, const void *buf,
+                                      uint32_t len) {
+  const uint8_t *buf8 = buf;
+
+  // Trim the start and end of the buffer
+  while (len > 0 && *buf8 == wl_cache[addr]) {
+    buf8++;
+    addr++;
+    len--;
+  }
+  while (len > 0 && buf8[len - 1] == wl_cache[addr + len - 1])
+    len--;
+
+  if (len == 0)
+    // No need to write anything
+    return true;
+
+  memcpy(wl_cache + addr, buf8, len);
+
+  return wear_leveling_mark_dirty(addr, addr + len);
+}
+
+/**
+ * @brief Commit the pending writes if required by the write-back policy
+ *
+ * @return true if successful, false otherwise
+ */
+static bool wear_leveling_commit_if_needed(void) {
+  uint32_t pending = 0;
+
+  for (uint32_t i = 0; i < num_dirty_ranges; i++)
+    pending += dirty_ranges[i].end - dirty_ranges[i].start;
+
+  last_write = timer_read();
+  if (WL_WRITE_BACK_TIMEOUT == 0 || pending >= WL_WRITE_BACK_THRESHOLD)
+    return wear_leveling_flush();
+
+  return true;
+}
+
+/**
+ * @brief Find the bank holding the most recent consolidated data
+ *
+ * @return true if a valid bank is found, false otherwise
+ */
+static bool wear_leveling_find_active_bank(void) {
+#if defined(WL_DOUBLE_BANK)
+  bool found = false;
+
+  for (uint32_t i = 0; i < WL_NUM_BANKS; i++) {
+    wl_bank_header_t header;
+
+    if (!wear_leveling_bank_read(i, WL_VIRTUAL_SIZE + 4, &header.raw, 1) ||
+        (header.sequence ^ header.check) != 0xFFFF)
+      // The bank has not been completely consolidated
+      continue;
+
+    if (!found || (int16_t)(header.sequence - sequence) > 0) {
+      active_bank = i;
+      sequence = header.sequence;
+      found = true;
+    }
+  }
+
+  return found;
+#else
+  return true;
+#endif
+}
+
+void wear_leveling_init(void) {
+  // Reserve the banks from the end of the flash. Each bank starts at the first
+  // sector that makes it large enough to hold the backing store.
+  uint32_t sector = FLASH_NUM_SECTORS, reserved_size = 0;
+  for (uint32_t i = WL_NUM_BANKS; i-- > 0;) {
+    uint32_t bank_size = 0;
+
+    banks[i].ending_sector = sector;
+    while (sector > 0 && bank_size < WL_BACKING_STORE_SIZE)
+      bank_size += flash_sector_size(--sector);
+    banks[i].starting_sector = sector;
+    reserved_size += bank_size;
+    banks[i].base_address = FLASH_SIZE - reserved_size;
+  }
+  // Discard the state of any previous initialization, like after a reset
+  num_dirty_ranges = 0;
+#if defined(WL_DOUBLE_BANK)
+  memset(&consolidation, 0, sizeof(consolidation));
+#endif
   wear_leveling_clear_cache();
 
-  wear_leveling_status_t status = wear_leveling_read_consolidated();
+  wear_leveling_status_t status = WL_STATUS_FAILED;
+  uint32_t stats_address = WL_LOG_START, log_end = WL_LOG_END;
+  if (wear_leveling_find_active_bank()) {
+    if (!wear_leveling_read_stats(&stats_address))
+      // Written by an older firmware, whose write log ends with the bank
+      log_end = WL_BACKING_STORE_SIZE;
+    status = wear_leveling_read_consolidated();
+  }
+
   if (status != WL_STATUS_FAILED)
-    status = wear_leveling_replay_log();
+    status = wear_leveling_replay_log(stats_address, log_end);
   else
     // If the consolidated data is corrupted, we clear the virtual storage
     status = wear_leveling_erase();
@@ -281,32 +1012,71 @@ bool wear_leveling_read(uint32_t addr, void *buf, uint32_t len) {
   return true;
 }
 
+void wear_leveling_get_stats(wl_stats_t *stats) { *stats = wear_stats; }
+
+void wear_leveling_task(void) {
+#if WL_WRITE_BACK_TIMEOUT > 0
+  if (num_dirty_ranges > 0 &&
+      timer_elapsed(last_write) >= WL_WRITE_BACK_TIMEOUT)
+    wear_leveling_flush();
+#endif
+
+#if defined(WL_DOUBLE_BANK)
+  if (consolidation.state != WL_CONSOLIDATION_IDLE)
+    // A failed step is started over once the write log fills up further
+    wear_leveling_consolidation_step();
+#endif
+}
+
 bool wear_leveling_write(uint32_t addr, const void *buf, uint32_t len) {
   if (addr + len > WL_VIRTUAL_SIZE)
     return false;
 
-  const uint8_t *buf8 = buf;
+  const bool status = wear_leveling_write_cache(addr, buf, len);
 
-  // Trim the start and end of the buffer
-  while (len > 0 && *buf8 == wl_cache[addr]) {
-    buf8++;
-    addr++;
-    len--;
+  return wear_leveling_commit_if_needed() && status;
+}
+
+bool wear_leveling_write_batch(const wl_write_t *writes, uint32_t num_writes) {
+  for (uint32_t i = 0; i < num_writes; i++) {
+    if (writes[i].addr + writes[i].len > WL_VIRTUAL_SIZE)
+      return false;
   }
-  while (len > 0 && buf8[len - 1] == wl_cache[addr + len - 1])
-    len--;
 
-  if (len == 0)
-    // No need to write anything
+  bool status = true;
+  for (uint32_t i = 0; i < num_writes; i++)
+    status &=
+        wear_leveling_write_cache(writes[i].addr, writes[i].buf, writes[i].len);
+
+  return wear_leveling_commit_if_needed() && status;
+}
+
+bool wear_leveling_flush(void) {
+  if (num_dirty_ranges == 0)
     return true;
 
-  // Update the cache first so if the cache is consolidated, we don't need to
-  // continue the write operation
-  memcpy(wl_cache + addr, buf8, len);
+  uint32_t log_size = 0;
+  for (uint32_t i = 0; i < num_dirty_ranges; i++) {
+    const uint32_t len = dirty_ranges[i].end - dirty_ranges[i].start;
 
-  wear_leveling_status_t status = wear_leveling_write_raw(addr, buf8, len);
-  if (status == WL_STATUS_OK)
-    status = wear_leveling_consolidate_if_needed();
+    log_size += wear_leveling_log_size(wl_cache + dirty_ranges[i].start, len);
+    wear_stats.user_bytes += len;
+  }
+
+  wear_leveling_status_t status = WL_STATUS_OK;
+  if (write_address + log_size >= WL_LOG_END) {
+    // The write log cannot hold all the pending writes so we consolidate the
+    // cache once instead
+    status = wear_leveling_consolidate_force();
+  } else {
+    // If we consolidate the cache, all the pending writes have been committed
+    // and the loop terminates since the pending ranges are cleared.
+    for (uint32_t i = 0; i < num_dirty_ranges && status == WL_STATUS_OK; i++)
+      status = wear_leveling_write_raw(
+          dirty_ranges[i].start, wl_cache + dirty_ranges[i].start,
+          dirty_ranges[i].end - dirty_ranges[i].start);
+  }
+  num_dirty_ranges = 0;
 
   return status != WL_STATUS_FAILED;
 }
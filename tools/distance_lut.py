@@ -14,29 +14,99 @@
 # https://www.desmos.com/calculator/nzl6twp6ui
 
 from decimal import Decimal
-from math import log2
+from math import log10, sqrt
 import argparse
+import csv
+
+LUT_SIZE = 1024
+
+# Search range of the fit constant, as powers of 10
+FIT_MIN_EXP = -6
+FIT_MAX_EXP = 3
+
+
+# Generate the distance LUT for the curve
+# max_value * log(1 + ax) / log(1 + a * size)
+def generate_lut(
+    a: Decimal, size: int = LUT_SIZE, max_value: int = 255
+) -> list[int]:
+    lut = []
+    for x in range(size):
+        numer = Decimal(max_value) * (Decimal(1) + a * Decimal(x)).log10()
+        denom = (Decimal(1) + a * Decimal(size)).log10()
+        lut.append(round(numer / denom))
+
+    return lut
+
+
+# Load a captured trace. Each row contains the ADC value and the distance, both
+# normalized to the range [0, 1] from rest to bottom-out.
+def load_trace(path: str) -> list[tuple[float, float]]:
+    with open(path, "r", newline="") as f:
+        return [
+            (float(row[0]), float(row[1]))
+            for row in csv.reader(f)
+            if row and not row[0].startswith("#")
+        ]
+
+
+# Fit the constant of the curve to a trace by minimizing the squared error
+def fit(trace: list[tuple[float, float]], size: int = LUT_SIZE) -> Decimal:
+    if not trace:
+        raise ValueError("Trace is empty")
+
+    def error(exp: float) -> float:
+        a = 10**exp
+        denom = log10(1 + a * size)
+        return sum(
+            (log10(1 + a * adc * size) / denom - distance) ** 2
+            for adc, distance in trace
+        )
+
+    # Golden-section search over the exponent of the constant
+    ratio = (sqrt(5) - 1) / 2
+    lo, hi = float(FIT_MIN_EXP), float(FIT_MAX_EXP)
+    while hi - lo > 1e-6:
+        m1 = hi - ratio * (hi - lo)
+        m2 = lo + ratio * (hi - lo)
+        if error(m1) < error(m2):
+            hi = m2
+        else:
+            lo = m1
+
+    return Decimal(10 ** ((lo + hi) / 2)).quantize(Decimal("1e-9"))
+
 
 if __name__ == "__main__":
     parser = argparse.ArgumentParser()
-    parser.add_argument(
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument(
         "-a",
         type=Decimal,
-        required=True,
-        description="Constant obtained from fitting the curve",
+        help="Constant obtained from fitting the curve",
+    )
+    source.add_argument(
+        "-t",
+        "--trace",
+        help="CSV trace of normalized (ADC value, distance) samples to fit the constant from",
     )
     parser.add_argument(
-        "-i", type=int, default=1024, description="Number of entries in the LUT"
+        "-i", type=int, default=LUT_SIZE, help="Number of entries in the LUT"
+    )
+    parser.add_argument(
+        "-m",
+        type=int,
+        default=255,
+        help="Maximum distance, 65535 for high-resolution distance",
     )
     parser = parser.parse_args()
 
-    a: Decimal = parser.a
     i: int = parser.i
+    a: Decimal = (
+        parser.a if parser.a is not None else fit(load_trace(parser.trace), i)
+    )
+    if parser.trace is not None:
+        print(f"// a = {a}")
 
-    lut = []
-    for x in range(i):
-        numer = Decimal(255) * (Decimal(1) + a * Decimal(x)).log10()
-        denom = (Decimal(1) + a * Decimal(i)).log10()
-        lut.append(round(numer / denom))
-
-    print(f"{{{", ".join(str(x) for x in lut)}}}")
+    lut = ", ".join(str(x) for x in generate_lut(a, i, parser.m))
+    print(f"{{{lut}}}")
@@ -0,0 +1,39 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+#include "usb_descriptors.h"
+
+//--------------------------------------------------------------------+
+// Fuzz Target
+//--------------------------------------------------------------------+
+
+// Size of a record of the input, the number of 16 ms periods to advance the
+// timer by followed by a raw HID report
+#define FUZZ_RECORD_SIZE (1 + RAW_HID_EP_SIZE)
+
+/**
+ * @brief Run an input of the fuzz target
+ *
+ * This is the entry point of libFuzzer.
+ *
+ * @param data Input
+ * @param size Size of the input in bytes
+ *
+ * @return 0
+ */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
@@ -0,0 +1,121 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+
+# Builds and runs the raw HID command fuzz target in `fuzz_commands.c` with
+# AddressSanitizer and UndefinedBehaviorSanitizer. With Clang, the target is
+# linked with libFuzzer, otherwise with the standalone driver. The corpus is
+# seeded with inputs for every `command_id_t` if it is empty.
+
+from pathlib import Path
+import argparse
+import os
+import random
+import re
+import subprocess
+import sys
+
+ROOT = Path(__file__).resolve().parents[2]
+
+sys.path.append(str(ROOT / "tools" / "host"))
+import build
+
+RAW_HID_EP_SIZE = 64
+
+
+# Parse the values of `command_id_t` from `include/commands.h`
+def get_command_ids() -> dict[str, int]:
+    header = (ROOT / "include" / "commands.h").read_text()
+    body = re.search(r"typedef enum \{(.*?)\} command_id_t;", header, re.S)
+    if body is None:
+        raise RuntimeError("command_id_t not found")
+
+    command_ids = {}
+    value = 0
+    for name, explicit in re.findall(
+        r"^\s*(COMMAND_\w+)\s*(?:=\s*(\d+))?\s*,", body.group(1), re.M
+    ):
+        value = int(explicit) if explicit else value
+        command_ids[name] = value
+        value += 1
+    return command_ids
+
+
+# Encode a record of the fuzz input, with the number of 16 ms periods to wait
+# before the report
+def record(report: bytes, delay: int = 0) -> bytes:
+    return bytes([delay]) + report.ljust(RAW_HID_EP_SIZE, b"\x00")
+
+
+def seed_corpus(path: Path):
+    path.mkdir(parents=True, exist_ok=True)
+    rng = random.Random(0)
+    command_ids = get_command_ids()
+
+    for name, command_id in command_ids.items():
+        name = name.removeprefix("COMMAND_").lower()
+        payload = bytes(rng.randrange(256) for _ in range(RAW_HID_EP_SIZE - 1))
+        (path / f"{name}").write_bytes(record(bytes([command_id])))
+        (path / f"{name}_random").write_bytes(
+            record(bytes([command_id]) + payload)
+        )
+        # Staged in a transaction, after the calibration
+        (path / f"{name}_transaction").write_bytes(
+            record(bytes([command_ids["COMMAND_BEGIN_TRANSACTION"]]), 32)
+            + record(bytes([command_id]) + payload)
+            + record(bytes([command_ids["COMMAND_COMMIT_TRANSACTION"]]))
+        )
+
+
+if __name__ == "__main__":
+    keyboards = sorted(p.name for p in (ROOT / "keyboards").iterdir() if p.is_dir())
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument(
+        "-k", "--keyboard", choices=keyboards, default="he60", help="Keyboard"
+    )
+    parser.add_argument(
+        "-D",
+        dest="defines",
+        action="append",
+        default=[],
+        help="Additional preprocessor definition, NAME or NAME=VALUE",
+    )
+    parser.add_argument(
+        "--corpus", type=Path, help="Corpus directory, seeded if it does not exist"
+    )
+    parser.add_argument(
+        "fuzzer_args", nargs="*", help="Arguments of the fuzzer, e.g. -runs=N"
+    )
+    args = parser.parse_args()
+
+    defines = {}
+    for define in args.defines:
+        name, _, value = define.partition("=")
+        defines[name] = value or None
+
+    libfuzzer = "clang" in os.environ.get("CC", "")
+    exe = build.build(
+        "fuzz_commands",
+        args.keyboard,
+        sanitize=True,
+        defines=defines,
+        extra_flags=["-fsanitize=fuzzer", "-DFUZZ_LIBFUZZER"] if libfuzzer else [],
+    )
+
+    corpus = args.corpus or build.BUILD / args.keyboard / "corpus"
+    if not corpus.exists():
+        seed_corpus(corpus)
+    print(f"Fuzzing {exe} with the corpus in {corpus}")
+    sys.exit(subprocess.run([str(exe), *args.fuzzer_args, str(corpus)]).returncode)
@@ -0,0 +1,196 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "advanced_keys.h"
+#include "commands.h"
+#include "crc32.h"
+#include "deferred_actions.h"
+#include "eeconfig.h"
+#include "fuzz.h"
+#include "hardware/hardware.h"
+#include "hid.h"
+#include "host.h"
+#include "idle.h"
+#include "layout.h"
+#include "matrix.h"
+#include "noise.h"
+#include "tusb.h"
+#include "wear_leveling.h"
+#include "xinput.h"
+
+//--------------------------------------------------------------------+
+// Raw HID Command Fuzzing
+//
+// Fuzz target of `command_process()` on the simulated flash, linked either
+// with libFuzzer or with the standalone driver in `standalone.c`. An input is
+// a sequence of records, each of them the number of 16 ms periods to advance
+// the timer by, followed by a raw HID report, which is zero-padded if
+// truncated. The scan tasks run after each report.
+//
+// Every input starts from a freshly reset configuration, and the target
+// aborts if a command produces a malformed report, if the configuration
+// header is corrupted, or if the configuration does not survive
+// `wear_leveling_init()`, in addition to the sanitizer reports.
+//--------------------------------------------------------------------+
+
+static bool initialized;
+
+/**
+ * @brief Abort the fuzz target with a message
+ *
+ * @param msg Reason of the failure
+ *
+ * @return None
+ */
+static void fuzz_fail(const char *msg) {
+  fprintf(stderr, "%s\n", msg);
+  abort();
+}
+
+//--------------------------------------------------------------------+
+// Stubs
+//--------------------------------------------------------------------+
+
+void tud_task(void) {}
+
+bool tud_hid_n_ready(uint8_t instance) { return true; }
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report,
+                      uint16_t len) {
+  if (instance != USB_ITF_RAW_HID || report_id != 0 || len != RAW_HID_EP_SIZE)
+    fuzz_fail("Malformed raw HID report");
+
+  return true;
+}
+
+void hid_init(void) {}
+
+void hid_keycode_add(uint8_t keycode) {}
+
+void hid_keycode_remove(uint8_t keycode) {}
+
+void hid_send_reports(void) {}
+
+void xinput_init(void) {}
+
+void xinput_process(uint8_t key) {}
+
+void xinput_task(void) {}
+
+//--------------------------------------------------------------------+
+// Fuzz Target
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Stop the commands that keep running across inputs
+ *
+ * @return None
+ */
+static void fuzz_stop_commands(void) {
+  static const uint8_t command_ids[] = {
+      COMMAND_ABORT_TRANSACTION,
+      COMMAND_ANALOG_STREAM,
+      COMMAND_TRACE_CAPTURE,
+      COMMAND_NOISE_DIAGNOSTICS,
+  };
+
+  for (uint32_t i = 0; i < M_ARRAY_SIZE(command_ids); i++) {
+    // A zero interval or duration stops the command
+    uint8_t buf[RAW_HID_EP_SIZE] = {command_ids[i]};
+
+    command_process(buf);
+  }
+}
+
+/**
+ * @brief Reset the configuration and the core modules
+ *
+ * The modules do not have any way to clear all of their state, so what is not
+ * cleared by the commands and the initialization functions carries over to the
+ * next input.
+ *
+ * @return None
+ */
+static void fuzz_reset(void) {
+  if (initialized) {
+    fuzz_stop_commands();
+    advanced_key_clear();
+  } else {
+    crc32_init();
+    initialized = true;
+  }
+
+  host_flash_reset();
+  wear_leveling_init();
+  eeconfig_init();
+
+  matrix_init();
+  deferred_action_init();
+  advanced_key_init();
+  layout_init();
+  command_init();
+  idle_init();
+}
+
+/**
+ * @brief Check the configuration after an input
+ *
+ * @return None
+ */
+static void fuzz_check(void) {
+  static uint8_t before[WL_VIRTUAL_SIZE], after[WL_VIRTUAL_SIZE];
+  uint32_t magic_end;
+
+  if (eeconfig->magic_start != EECONFIG_MAGIC_START ||
+      eeconfig->version != EECONFIG_VERSION ||
+      !EECONFIG_READ(magic_end, &magic_end) || magic_end != EECONFIG_MAGIC_END)
+    fuzz_fail("Configuration header corrupted");
+
+  if (!wear_leveling_flush() ||
+      !wear_leveling_read(0, before, sizeof(before)))
+    fuzz_fail("Failed to flush the configuration");
+  wear_leveling_init();
+  if (!wear_leveling_read(0, after, sizeof(after)) ||
+      memcmp(before, after, sizeof(before)) != 0)
+    fuzz_fail("Configuration lost after wear_leveling_init()");
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  fuzz_reset();
+
+  for (size_t pos = 0; pos < size; pos += FUZZ_RECORD_SIZE) {
+    uint8_t buf[RAW_HID_EP_SIZE] = {0};
+
+    host_timer_advance(data[pos] * 16u);
+    memcpy(buf, data + pos + 1, M_MIN(size - pos - 1, sizeof(buf)));
+    if (buf[0] == COMMAND_REBOOT)
+      // `board_reset()` does not return
+      continue;
+    command_process(buf);
+
+    matrix_scan();
+    noise_task();
+    layout_task();
+    command_task();
+    wear_leveling_task();
+    idle_task();
+  }
+
+  fuzz_check();
+
+  return 0;
+}
@@ -0,0 +1,253 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#if !defined(FUZZ_LIBFUZZER)
+
+#include <dirent.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <sys/stat.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+#include "fuzz.h"
+
+//--------------------------------------------------------------------+
+// Standalone Fuzzing Driver
+//
+// Replacement of libFuzzer for compilers without it. The inputs of the corpus
+// are run first, then random mutations of them, e.g.
+//
+//   fuzz_commands [-runs=N] [-seed=N] <corpus file or directory>...
+//
+// The input that made the fuzz target fail is saved as `crash-<run>` in the
+// current directory. Unlike libFuzzer, the driver is not guided by coverage.
+//--------------------------------------------------------------------+
+
+// Maximum size of an input in bytes
+#define MAX_INPUT_SIZE 4096
+// Maximum number of inputs in the corpus
+#define MAX_CORPUS_SIZE 4096
+
+typedef struct {
+  uint8_t *data;
+  size_t size;
+} input_t;
+
+static input_t corpus[MAX_CORPUS_SIZE];
+static uint32_t corpus_size;
+
+// Input being run, saved if the fuzz target fails
+static uint8_t current[MAX_INPUT_SIZE];
+static size_t current_size;
+static uint32_t current_run;
+
+static uint64_t rng_state = 1;
+
+static uint32_t rng(void) {
+  // xorshift64*
+  rng_state ^= rng_state >> 12;
+  rng_state ^= rng_state << 25;
+  rng_state ^= rng_state >> 27;
+
+  return (uint32_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 32);
+}
+
+#if defined(__SANITIZE_ADDRESS__)
+// Also report `abort()`, so that the input is saved
+const char *__asan_default_options(void) { return "handle_abort=1"; }
+
+static void save_crash(void) {
+  char path[32];
+  FILE *f;
+
+  snprintf(path, sizeof(path), "crash-%" PRIu32, current_run);
+  if ((f = fopen(path, "wb")) != NULL) {
+    fwrite(current, 1, current_size, f);
+    fclose(f);
+    fprintf(stderr, "Input saved to %s\n", path);
+  }
+}
+#endif
+
+static void run(const uint8_t *data, size_t size) {
+  memcpy(current, data, size);
+  current_size = size;
+  LLVMFuzzerTestOneInput(current, current_size);
+  current_run++;
+}
+
+static void load_file(const char *path) {
+  FILE *f = fopen(path, "rb");
+  uint8_t *data;
+
+  if (f == NULL || corpus_size == MAX_CORPUS_SIZE ||
+      (data = malloc(MAX_INPUT_SIZE)) == NULL) {
+    if (f != NULL)
+      fclose(f);
+    return;
+  }
+
+  corpus[corpus_size].data = data;
+  corpus[corpus_size].size = fread(data, 1, MAX_INPUT_SIZE, f);
+  corpus_size++;
+  fclose(f);
+}
+
+static void load(const char *path) {
+  struct stat st;
+  DIR *dir;
+
+  if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) {
+    load_file(path);
+    return;
+  }
+
+  if ((dir = opendir(path)) == NULL)
+    return;
+  for (struct dirent *entry; (entry = readdir(dir)) != NULL;) {
+    char file[4096];
+
+    if (entry->d_name[0] == '.')
+      continue;
+    snprintf(file, sizeof(file), "%s/%s", path, entry->d_name);
+    load_file(file);
+  }
+  closedir(dir);
+}
+
+/**
+ * @brief Mutate an input in place
+ *
+ * The mutations are aware of the records of the fuzz target, so that whole
+ * reports can be duplicated, removed or spliced from other inputs.
+ *
+ * @param data Input to mutate, of `MAX_INPUT_SIZE` bytes
+ * @param size Size of the input in bytes
+ *
+ * @return Size of the mutated input in bytes
+ */
+static size_t mutate(uint8_t *data, size_t size) {
+  const size_t record_size = FUZZ_RECORD_SIZE;
+  const uint32_t num_mutations = 1 + rng() % 4;
+
+  for (uint32_t i = 0; i < num_mutations; i++) {
+    const size_t num_records = size / record_size;
+    const size_t record = num_records > 0 ? rng() % num_records : 0;
+    uint8_t *r = data + record * record_size;
+
+    switch (rng() % 6) {
+    case 0:
+      // Flip a bit
+      if (size > 0)
+        data[rng() % size] ^= (uint8_t)(1 << (rng() % 8));
+      break;
+
+    case 1:
+      // Set a byte to a random or an interesting value, more often in the
+      // first fields of a report
+      if (size > 0) {
+        static const uint8_t values[] = {0, 1, 0x7F, 0x80, 0xFE, 0xFF};
+        const size_t pos = num_records > 0 && rng() % 2
+                               ? record * record_size + 2 + rng() % 8
+                               : rng() % size;
+
+        data[pos] = rng() % 2 ? (uint8_t)rng() : values[rng() % sizeof(values)];
+      }
+      break;
+
+    case 2:
+      // Change the command of a report
+      if (num_records > 0)
+        r[1] = (uint8_t)(rng() % 2 ? rng() % 64 : 128 + rng() % 32);
+      break;
+
+    case 3:
+      // Duplicate a report
+      if (num_records > 0 && size + record_size <= MAX_INPUT_SIZE) {
+        memmove(r + record_size, r, size - record * record_size);
+        size += record_size;
+      }
+      break;
+
+    case 4:
+      // Remove a report
+      if (num_records > 1) {
+        memmove(r, r + record_size, size - (record + 1) * record_size);
+        size -= record_size;
+      }
+      break;
+
+    case 5:
+    default: {
+      // Insert a report from another input
+      const input_t *other = &corpus[rng() % corpus_size];
+      const size_t other_records = other->size / record_size;
+
+      if (other_records > 0 && size + record_size <= MAX_INPUT_SIZE) {
+        const size_t at = num_records > 0 ? record * record_size : size;
+
+        memmove(data + at + record_size, data + at, size - at);
+        memcpy(data + at,
+               other->data + (rng() % other_records) * record_size,
+               record_size);
+        size += record_size;
+      }
+      break;
+    }
+    }
+  }
+
+  return size;
+}
+
+int main(int argc, char **argv) {
+  static uint8_t data[MAX_INPUT_SIZE];
+  uint32_t runs = 10000;
+
+  for (int i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "-runs=", 6) == 0)
+      runs = (uint32_t)strtoul(argv[i] + 6, NULL, 0);
+    else if (strncmp(argv[i], "-seed=", 6) == 0)
+      rng_state = strtoull(argv[i] + 6, NULL, 0) | 1;
+    else
+      load(argv[i]);
+  }
+  if (corpus_size == 0) {
+    fprintf(stderr, "usage: %s [-runs=N] [-seed=N] <corpus>...\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+#if defined(__SANITIZE_ADDRESS__)
+  __sanitizer_set_death_callback(save_crash);
+#endif
+
+  for (uint32_t i = 0; i < corpus_size; i++)
+    run(corpus[i].data, corpus[i].size);
+  fprintf(stderr, "Ran %" PRIu32 " corpus inputs\n", corpus_size);
+
+  for (uint32_t i = 0; i < runs; i++) {
+    const input_t *input = &corpus[rng() % corpus_size];
+
+    memcpy(data, input->data, input->size);
+    run(data, mutate(data, input->size));
+  }
+  fprintf(stderr, "Ran %" PRIu32 " mutated inputs\n", runs);
+
+  return EXIT_SUCCESS;
+}
+
+#endif
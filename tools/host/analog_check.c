@@ -0,0 +1,147 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "hardware/hardware.h"
+#include "host.h"
+#include "stm32f4xx_hal.h"
+
+//--------------------------------------------------------------------+
+// Analog Driver Check
+//
+// Built with the analog driver of the STM32F4 on the modeled ADCs. The value
+// converted on each ADC channel is a hash of the channel, of the multiplexer
+// channel selected by the select pins, and of the index of the conversion
+// sequence. After `analog_init()`, runs `<sweeps>` sweeps and half of the next
+// one, stops the conversion loop, runs 2 single sweeps and resumes the
+// conversion loop for another sweep. Prints the number of completed conversion
+// sequences and the ADC value of every key after each sequence, and when the
+// conversion loop is stopped, for the tests to compare against their reference
+// model.
+//
+//   analog_check <sweeps>
+//--------------------------------------------------------------------+
+
+#if ADC_NUM_MUX_INPUTS > 0
+// Number of conversion sequences of a sweep
+#define NUM_SEQUENCES (1 << ADC_NUM_MUX_SELECT_PINS)
+
+static GPIO_TypeDef *const mux_select_ports[] = ADC_MUX_SELECT_PORTS;
+static const uint16_t mux_select_pins[] = ADC_MUX_SELECT_PINS;
+#else
+#define NUM_SEQUENCES 1
+#endif
+
+// Number of completed conversion sequences
+static uint32_t num_sequences;
+
+static uint16_t signal(uint8_t channel, uint32_t sequence) {
+  uint32_t mux_channel = 0;
+
+#if ADC_NUM_MUX_INPUTS > 0
+  for (uint32_t i = 0; i < ADC_NUM_MUX_SELECT_PINS; i++)
+    if (mux_select_ports[i]->ODR & mux_select_pins[i])
+      mux_channel |= 1u << i;
+#endif
+  num_sequences = sequence + 1;
+
+  return (uint16_t)((((sequence * 16 + channel) * 16 + mux_channel) *
+                     2654435761u) >>
+                    20) &
+         ADC_MAX_VALUE;
+}
+
+static void print_values(void) {
+  printf("%" PRIu32, num_sequences);
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    printf(" %u", analog_read((uint8_t)i));
+  printf("\n");
+}
+
+/**
+ * @brief Run the next interrupt of the modeled ADCs
+ *
+ * @return true if an interrupt was run, false if the ADCs are stopped
+ */
+static bool step(void) {
+  const uint32_t n = num_sequences;
+
+  if (!host_adc_run())
+    return false;
+  if (num_sequences != n)
+    print_values();
+
+  return true;
+}
+
+/**
+ * @brief Run the interrupts until a number of sequences have completed
+ *
+ * @param end Number of completed sequences to reach
+ *
+ * @return None
+ */
+static void run(uint32_t end) {
+  while (num_sequences < end)
+    if (!step()) {
+      fprintf(stderr, "The conversion loop stopped after %" PRIu32 "\n",
+              num_sequences);
+      exit(EXIT_FAILURE);
+    }
+}
+
+/**
+ * @brief Run the interrupts until the conversion loop stops
+ *
+ * @return None
+ */
+static void run_until_stopped(void) {
+  const uint32_t end = num_sequences + 2 * NUM_SEQUENCES;
+
+  while (step())
+    if (num_sequences > end) {
+      fprintf(stderr, "The conversion loop never stopped\n");
+      exit(EXIT_FAILURE);
+    }
+  printf("stopped %" PRIu32 "\n", num_sequences);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <sweeps>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  const uint32_t sweeps = (uint32_t)strtoul(argv[1], NULL, 0);
+
+  host_adc_signal = signal;
+  // `analog_init()` waits for the first sweep
+  host_adc_sync_sequences = NUM_SEQUENCES;
+  analog_init();
+  print_values();
+
+  run(num_sequences + sweeps * NUM_SEQUENCES + NUM_SEQUENCES / 2);
+  analog_set_continuous(false);
+  run_until_stopped();
+  for (uint32_t i = 0; i < 2; i++) {
+    analog_start_sweep();
+    run_until_stopped();
+  }
+  analog_set_continuous(true);
+  run(num_sequences + NUM_SEQUENCES);
+
+  return EXIT_SUCCESS;
+}
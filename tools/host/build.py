@@ -0,0 +1,372 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host builds of the firmware modules for tests, benchmarks and fuzzing. The
+# keyboard configuration is derived from `keyboard.json` like `scripts/make.py`
+# does, except that every key has its own raw ADC input. Only the standard
+# library is needed, so that the host builds work without PlatformIO.
+
+from pathlib import Path
+import argparse
+import json
+import os
+import shlex
+import subprocess
+import sys
+
+ROOT = Path(__file__).resolve().parents[2]
+HOST = ROOT / "tools" / "host"
+BUILD = ROOT / ".host"
+
+sys.path.append(str(ROOT / "scripts"))
+from drivers import *
+
+DRIVERS = {"stm32f446xx": STM32F446XX, "at32f405xx": AT32F405XX}
+
+# Same warnings as the firmware, see `setup.py`
+WARNINGS = [
+    "-Werror",
+    "-Wall",
+    "-Wextra",
+    "-Wsign-conversion",
+    "-Wswitch-default",
+    "-Wswitch",
+    "-Wdouble-promotion",
+    "-Wstrict-prototypes",
+    "-Wno-unused-parameter",
+]
+
+SANITIZERS = [
+    "-fsanitize=address,undefined",
+    "-fno-sanitize-recover=all",
+    "-fno-omit-frame-pointer",
+]
+
+# Simulated hardware of the host programs
+HAL = [
+    "tools/host/hal/board.c",
+    "tools/host/hal/flash.c",
+    "tools/host/hal/timer.c",
+    "src/flash.c",
+]
+
+# Source files of each host program, relative to the repository root
+TARGETS = {
+    "profile_blob": ["tools/host/profile_blob.c", "src/crc32.c"],
+    "wl_replay_bench": [
+        "tools/host/wl_replay_bench.c",
+        "src/crc32.c",
+        "src/wear_leveling.c",
+        *HAL,
+    ],
+    "crc32_check": [
+        "tools/host/crc32_check.c",
+        "src/crc32.c",
+        "tools/host/hal/crc_unit.c",
+        *HAL,
+    ],
+    # The drivers override the default implementation like in the firmware
+    **{
+        f"crc32_check_{driver}": [
+            "tools/host/crc32_check.c",
+            "src/crc32.c",
+            f"src/hardware/{driver}/crc32.c",
+            "tools/host/hal/crc_unit.c",
+            *HAL,
+        ]
+        for driver in DRIVERS
+    },
+    "analog_check_stm32f446xx": [
+        "tools/host/analog_check.c",
+        "src/hardware/stm32f446xx/analog.c",
+        "tools/host/hal/adc_unit.c",
+        "tools/host/hal/crc_unit.c",
+        *HAL,
+    ],
+    "fuzz_commands": [
+        "tools/fuzz/fuzz_commands.c",
+        "tools/fuzz/standalone.c",
+        "src/advanced_keys.c",
+        "src/commands.c",
+        "src/crc32.c",
+        "src/deferred_actions.c",
+        "src/eeconfig.c",
+        "src/idle.c",
+        "src/layout.c",
+        "src/matrix.c",
+        "src/migration.c",
+        "src/noise.c",
+        "src/wear_leveling.c",
+        "tools/host/hal/analog.c",
+        *HAL,
+    ],
+    "eeconfig_test": [
+        "tools/host/eeconfig_test.c",
+        "src/crc32.c",
+        "src/eeconfig.c",
+        "src/migration.c",
+        "src/wear_leveling.c",
+        *HAL,
+    ],
+    "idle_test": [
+        "tools/host/idle_test.c",
+        "src/crc32.c",
+        "src/eeconfig.c",
+        "src/idle.c",
+        "src/matrix.c",
+        "src/migration.c",
+        "src/wear_leveling.c",
+        "tools/host/hal/analog.c",
+        *HAL,
+    ],
+    "matrix_test": [
+        "tools/host/matrix_test.c",
+        "src/crc32.c",
+        "src/eeconfig.c",
+        "src/matrix.c",
+        "src/migration.c",
+        "src/wear_leveling.c",
+        "tools/host/hal/analog.c",
+        *HAL,
+    ],
+    "migration_test": [
+        "tools/host/migration_test.c",
+        "src/crc32.c",
+        "src/eeconfig.c",
+        "src/migration.c",
+        "src/wear_leveling.c",
+        *HAL,
+    ],
+    # The program replaces the layout and the matrix modules
+    "socd_test": [
+        "tools/host/socd_test.c",
+        "src/advanced_keys.c",
+        "src/deferred_actions.c",
+        *HAL,
+    ],
+    "trace_replay_run": [
+        "tools/host/trace_replay_run.c",
+        "tools/trace_replay/trace_replay.c",
+        "src/advanced_keys.c",
+        "src/commands.c",
+        "src/crc32.c",
+        "src/deferred_actions.c",
+        "src/eeconfig.c",
+        "src/idle.c",
+        "src/layout.c",
+        "src/matrix.c",
+        "src/migration.c",
+        "src/noise.c",
+        "src/wear_leveling.c",
+        # The trace replay driver implements the analog and timer APIs
+        "tools/host/hal/board.c",
+        "tools/host/hal/flash.c",
+        "src/flash.c",
+    ],
+    "wl_power_cut": [
+        "tools/host/wl_power_cut.c",
+        "src/crc32.c",
+        "src/wear_leveling.c",
+        *HAL,
+    ],
+    "wl_test": [
+        "tools/host/wl_test.c",
+        "src/crc32.c",
+        "src/wear_leveling.c",
+        *HAL,
+    ],
+}
+
+
+# Additional flags of some host programs
+TARGET_FLAGS = {
+    # The STM32F4 CRC driver passes the buffer address to the DMA as a 32-bit
+    # integer, so the static buffers must be in the low 4 GiB
+    "crc32_check_stm32f446xx": ["-no-pie", "-Wno-pointer-to-int-cast"],
+    # `board_def.h` sets the sampling time and the resolution of the ADCs
+    "analog_check_stm32f446xx": [f"-I{ROOT / 'hardware' / 'stm32f446xx'}"],
+    "fuzz_commands": [f"-I{ROOT / 'tools' / 'fuzz'}"],
+    "trace_replay_run": [f"-I{ROOT / 'tools' / 'trace_replay'}"],
+}
+
+
+# Same as the distance lookup tables generated by `scripts/make.py`
+DISTANCE_LUTS_TEMPLATE = """#pragma once
+
+#include "common.h"
+
+// DO NOT EDIT THIS FILE DIRECTLY
+// This file is automatically generated from `tools/host/build.py`.
+
+static const distance_t distance_luts[][DISTANCE_LUT_SIZE] = {{
+{distance_luts}
+}};
+"""
+
+
+# Convert a Python list to a C array initializer
+def to_c_array(arr: list):
+    return f"{{{', '.join(to_c_array(x) if isinstance(x, list) else str(x) for x in arr)}}}"
+
+
+def get_defines(keyboard: str) -> dict[str, object]:
+    kb_json = json.loads((ROOT / "keyboards" / keyboard / "keyboard.json").read_text())
+    driver = DRIVERS[kb_json["hardware"]["driver"]]
+    flash = driver.metadata.flash
+    kb = kb_json["keyboard"]
+    analog = kb_json["analog"]
+    calibration = kb_json["calibration"]
+    num_keys = kb["num_keys"]
+
+    defines: dict[str, object] = {
+        "CFG_TUSB_MCU": 0,
+        "BOARD_USB_FS": None,
+        # `board_cycle_count()` counts nanoseconds
+        "F_CPU": 1000000000,
+        "FLASH_SIZE": flash.get_flash_size(),
+        "FLASH_NUM_SECTORS": flash.get_num_sectors(),
+        "FLASH_EMPTY_VAL": flash.empty_value,
+        "ADC_NUM_CHANNELS": num_keys,
+        "ADC_RESOLUTION": analog.get("adc_resolution")
+        or driver.metadata.adc.max_resolution,
+        "ADC_NUM_RAW_INPUTS": num_keys,
+        "ADC_RAW_INPUT_CHANNELS": to_c_array(list(range(num_keys))),
+        "ADC_RAW_INPUT_VECTOR": to_c_array(list(range(1, num_keys + 1))),
+        "DEFAULT_CALIBRATION": "{"
+        + ", ".join(f".{k} = {v}" for k, v in calibration.items())
+        + "}",
+        "NUM_PROFILES": kb["num_profiles"],
+        "NUM_LAYERS": kb["num_layers"],
+        "NUM_KEYS": num_keys,
+        "NUM_ADVANCED_KEYS": kb["num_advanced_keys"],
+    }
+
+    match flash.sector_sizes:
+        case NonUniformSectors(sizes):
+            defines["FLASH_SECTOR_SIZES"] = to_c_array(sizes)
+        case UniformSectors(size, _):
+            defines["FLASH_SECTOR_SIZE"] = size
+
+    if analog.get("invert_adc"):
+        defines["MATRIX_INVERT_ADC_VALUES"] = None
+
+    wear_leveling = kb_json.get("wear_leveling") or {}
+    wl_virtual_size = wear_leveling.get("virtual_size") or 8192
+    wl_write_log_size = wear_leveling.get("write_log_size") or 65536
+    wl_double_bank = bool(wear_leveling.get("double_bank"))
+    defines["WL_VIRTUAL_SIZE"] = wl_virtual_size
+    defines["WL_WRITE_LOG_SIZE"] = wl_write_log_size
+    if wl_double_bank:
+        defines["WL_DOUBLE_BANK"] = None
+    defines["WL_BASE_ADDRESS"] = flash.get_flash_size() - (
+        flash.round_up_to_flash_sectors(
+            wl_virtual_size + wl_write_log_size, 2 if wl_double_bank else 1
+        )
+    )
+
+    if kb.get("compact_profiles"):
+        defines["EECONFIG_COMPACT_PROFILES"] = None
+
+    keymaps = kb_json.get("keymaps") or [kb_json["keymap"]] * kb["num_profiles"]
+    defines["DEFAULT_KEYMAPS"] = to_c_array(keymaps)
+
+    actuation = kb_json.get("actuation") or {}
+    if actuation.get("actuation_point") is not None:
+        defines["ACTUATION_POINT"] = actuation["actuation_point"]
+
+    return defines
+
+
+def build(
+    target: str,
+    keyboard: str = "he60",
+    sanitize: bool = False,
+    defines: dict[str, object] | None = None,
+    output: Path | None = None,
+    extra_flags: list[str] | None = None,
+    distance_luts: list[list[int]] | None = None,
+) -> Path:
+    cc = os.environ.get("CC", "gcc")
+    output = output or BUILD / keyboard / target
+    output.parent.mkdir(parents=True, exist_ok=True)
+
+    flags = ["-std=gnu11", "-O2", "-g", *WARNINGS]
+    if sanitize:
+        flags += SANITIZERS
+    # The host headers replace the generated and the TinyUSB headers. The
+    # driver headers are not included since the host implements the hardware.
+    flags += [
+        f"-I{HOST / 'include'}",
+        f"-I{HOST}",
+        f"-I{ROOT / 'keyboards' / keyboard}",
+        f"-I{ROOT / 'include'}",
+    ]
+    defines = {**get_defines(keyboard), **(defines or {})}
+    # The generated distance lookup tables replace the default one. They are
+    # 16-bit if `DISTANCE_HIGH_RESOLUTION` is defined.
+    if distance_luts is not None:
+        include = output.parent / f"{output.name}.include"
+        include.mkdir(exist_ok=True)
+        (include / "distance_luts.h").write_text(
+            DISTANCE_LUTS_TEMPLATE.format(
+                distance_luts="\n".join(
+                    f"    {to_c_array(lut)}," for lut in distance_luts
+                )
+            )
+        )
+        flags.append(f"-I{include}")
+        defines["DISTANCE_NUM_LUTS"] = len(distance_luts)
+    for name, value in defines.items():
+        flags.append(f"-D{name}" if value is None else f"-D{name}={value}")
+
+    flags += TARGET_FLAGS.get(target, []) + (extra_flags or [])
+
+    sources = [str(ROOT / source) for source in TARGETS[target]]
+    cmd = [cc, *flags, *sources, "-o", str(output)]
+    result = subprocess.run(cmd, capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(f"{shlex.join(cmd)}\n{result.stderr}")
+
+    return output
+
+
+if __name__ == "__main__":
+    keyboards = sorted(p.name for p in (ROOT / "keyboards").iterdir() if p.is_dir())
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument("target", choices=TARGETS.keys(), help="Host program")
+    parser.add_argument(
+        "-k", "--keyboard", choices=keyboards, default="he60", help="Keyboard"
+    )
+    parser.add_argument(
+        "-s",
+        "--sanitize",
+        action="store_true",
+        help="Build with AddressSanitizer and UndefinedBehaviorSanitizer",
+    )
+    parser.add_argument(
+        "-D",
+        dest="defines",
+        action="append",
+        default=[],
+        help="Additional preprocessor definition, NAME or NAME=VALUE",
+    )
+    parser.add_argument("-o", "--output", type=Path, help="Output executable")
+    args = parser.parse_args()
+
+    defines = {}
+    for define in args.defines:
+        name, _, value = define.partition("=")
+        defines[name] = value or None
+    print(build(args.target, args.keyboard, args.sanitize, defines, args.output))
@@ -0,0 +1,118 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "crc32.h"
+#include "host.h"
+
+//--------------------------------------------------------------------+
+// CRC32 Cross-Check and Benchmark
+//
+// Built with either the default implementation in `src/crc32.c` or one of the
+// drivers on the modeled CRC unit. `check` prints the CRC32 of test buffers of
+// every length up to 64 bytes at every alignment, with and without an initial
+// value, through both the synchronous and the asynchronous API, for the tests
+// to compare against their reference models. `bench` prints the throughput
+// over the size of the virtual storage.
+//
+//   crc32_check check|bench [repetitions]
+//--------------------------------------------------------------------+
+
+// Test data, regenerated by the tests
+static uint8_t data[8192 + 4];
+
+static volatile bool async_done;
+static uint32_t async_crc;
+
+static void async_callback(uint32_t crc) {
+  async_crc = crc;
+  async_done = true;
+}
+
+static uint32_t compute_async(const void *buf, uint32_t len, uint32_t crc) {
+  async_done = false;
+  if (!crc32_compute_async(buf, len, crc, async_callback)) {
+    fprintf(stderr, "crc32_compute_async() failed\n");
+    exit(EXIT_FAILURE);
+  }
+  // Complete the DMA transfer if the computation is asynchronous
+  while (!async_done)
+    if (!host_dma_run()) {
+      fprintf(stderr, "Asynchronous computation never completed\n");
+      exit(EXIT_FAILURE);
+    }
+
+  return async_crc;
+}
+
+static void check(void) {
+  static const uint32_t inits[] = {0, 0xDEADBEEF};
+
+  for (uint32_t i = 0; i < M_ARRAY_SIZE(inits); i++)
+    for (uint32_t offset = 0; offset < 4; offset++)
+      for (uint32_t len = 0; len <= 64; len++) {
+        const uint8_t *buf = data + offset;
+
+        printf("sync %" PRIu32 " %" PRIu32 " %08" PRIx32 " %08" PRIx32 "\n",
+               offset, len, inits[i], crc32_compute(buf, len, inits[i]));
+        printf("async %" PRIu32 " %" PRIu32 " %08" PRIx32 " %08" PRIx32 "\n",
+               offset, len, inits[i], compute_async(buf, len, inits[i]));
+      }
+
+  // Large buffers chained over chunks like the wear leveling checksum
+  uint32_t crc = 0;
+  for (uint32_t offset = 0; offset < 8192; offset += 256)
+    crc = crc32_compute(data + offset, 256, crc);
+  printf("chain 0 8192 00000000 %08" PRIx32 "\n", crc);
+  printf("sync 0 8192 00000000 %08" PRIx32 "\n", crc32_compute(data, 8192, 0));
+  printf("async 0 8192 00000000 %08" PRIx32 "\n", compute_async(data, 8192, 0));
+}
+
+static void bench(uint32_t repetitions) {
+  const uint32_t len = 8192;
+  uint64_t best = UINT64_MAX;
+  uint32_t crc = 0;
+
+  for (uint32_t i = 0; i < repetitions; i++) {
+    const uint64_t start = host_time_ns();
+
+    crc ^= crc32_compute(data, len, crc);
+    best = M_MIN(best, host_time_ns() - start);
+  }
+  printf("%" PRIu32 " bytes in %" PRIu64 " ns, %.1f MiB/s (%08" PRIx32 ")\n",
+         len, best, (double)len * 1e9 / (double)best / 1048576, crc);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s check|bench [repetitions]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  for (uint32_t i = 0; i < sizeof(data); i++)
+    data[i] = (uint8_t)(i * 167 + 13);
+  crc32_init();
+
+  if (strcmp(argv[1], "check") == 0)
+    check();
+  else if (strcmp(argv[1], "bench") == 0)
+    bench(argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1000);
+  else
+    return EXIT_FAILURE;
+
+  return EXIT_SUCCESS;
+}
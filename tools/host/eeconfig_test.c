@@ -0,0 +1,305 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "crc32.h"
+#include "eeconfig.h"
+#include "host.h"
+
+//--------------------------------------------------------------------+
+// Compact Profile Scenarios
+//
+// Runs a scenario of the compact profiles on the simulated flash, and exits
+// with a non-zero status if the configuration does not match a copy of it
+// afterwards or after it is loaded again from the flash. Each scenario prints
+// the length of the delta of each profile and the size of the slots.
+//
+//   eeconfig_test <scenario>
+//--------------------------------------------------------------------+
+
+#if !defined(EECONFIG_COMPACT_PROFILES)
+#error "EECONFIG_COMPACT_PROFILES must be defined"
+#endif
+
+// Copy of the logical configuration
+static eeconfig_t expected;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+  // xorshift32
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+/**
+ * @brief Persist the configuration, and load it again from the flash
+ *
+ * @return true if successful, false otherwise
+ */
+static bool reload(void) {
+  if (!wear_leveling_flush())
+    return false;
+  wear_leveling_init();
+  eeconfig_init();
+
+  return true;
+}
+
+/**
+ * @brief Check the configuration against the copy
+ *
+ * @param when Description of the check for the error message
+ *
+ * @return true if the configuration matches, false otherwise
+ */
+static bool check(const char *when) {
+  static eeconfig_t actual;
+
+  if (!eeconfig_read(0, &actual, sizeof(actual)) ||
+      memcmp(&actual, &expected, sizeof(actual)) != 0) {
+    fprintf(stderr, "Configuration mismatch %s\n", when);
+    return false;
+  }
+  if (memcmp(&CURRENT_PROFILE, &expected.profiles[expected.current_profile],
+             sizeof(CURRENT_PROFILE)) != 0) {
+    fprintf(stderr, "Current profile mismatch %s\n", when);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Write to a profile and to the copy
+ *
+ * @param profile Profile index
+ * @param offset Offset in `eeconfig_profile_t` to write to
+ * @param buf Buffer to write from
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool write_profile(uint8_t profile, uint32_t offset, const void *buf,
+                          uint32_t len) {
+  if (!eeconfig_write(offsetof(eeconfig_t, profiles[profile]) + offset, buf,
+                      len)) {
+    fprintf(stderr, "Failed to write %u bytes at %u of profile %u\n", len,
+            offset, profile);
+    return false;
+  }
+  memcpy((uint8_t *)&expected.profiles[profile] + offset, buf, len);
+
+  return true;
+}
+
+/**
+ * @brief Get the length of the delta of a profile
+ *
+ * @param profile Profile index
+ *
+ * @return Length of the delta in bytes
+ */
+static uint16_t delta_len(uint8_t profile) {
+  uint16_t len;
+
+  wear_leveling_read(EECONFIG_PROFILE_DELTA_ADDR(profile), &len, sizeof(len));
+
+  return len;
+}
+
+//--------------------------------------------------------------------+
+// Scenarios
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Change a few bytes of every profile with writes of random lengths,
+ * and switch the current profile
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_round_trip(void) {
+  for (uint32_t i = 0; i < 200; i++) {
+    const uint8_t profile = (uint8_t)(rng() % NUM_PROFILES);
+    const uint32_t offset = rng() % sizeof(eeconfig_profile_t);
+    const uint32_t len =
+        1 + rng() % M_MIN(16, sizeof(eeconfig_profile_t) - offset);
+    uint8_t buf[16];
+
+    for (uint32_t j = 0; j < len; j++)
+      buf[j] = (uint8_t)rng();
+    if (!write_profile(profile, offset, buf, len))
+      return false;
+
+    if (i % 50 == 0) {
+      expected.current_profile = profile;
+      if (!EECONFIG_WRITE(current_profile, &profile) ||
+          !check("after switching the profile"))
+        return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * @brief Write a random profile that does not fit in its slot
+ *
+ * The write must fail and leave the stored profile unchanged.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_overflow(void) {
+  static eeconfig_profile_t profile;
+  const uint8_t tick_rate = 50;
+
+  if (!write_profile(1, offsetof(eeconfig_profile_t, tick_rate), &tick_rate,
+                     sizeof(tick_rate)))
+    return false;
+
+  for (uint32_t i = 0; i < sizeof(profile); i++)
+    ((uint8_t *)&profile)[i] = (uint8_t)rng();
+  if (EECONFIG_WRITE(profiles[1], &profile)) {
+    fprintf(stderr, "The write of a random profile succeeded\n");
+    return false;
+  }
+
+  return check("after the failed write");
+}
+
+/**
+ * @brief Corrupt the deltas of two profiles
+ *
+ * The current profile falls back to its default profile, and the other
+ * profile cannot be read or patched until it is written entirely.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_malformed(void) {
+  static eeconfig_profile_t profile;
+  const uint8_t tick_rate = 50;
+  uint16_t len;
+
+  for (uint8_t p = 0; p < 2; p++) {
+    if (!write_profile(p, offsetof(eeconfig_profile_t, tick_rate), &tick_rate,
+                       sizeof(tick_rate)))
+      return false;
+  }
+
+  // Length larger than the slot
+  len = EECONFIG_PROFILE_DELTA_SIZE;
+  wear_leveling_write(EECONFIG_PROFILE_DELTA_ADDR(0), &len, sizeof(len));
+  // Truncated delta
+  len = delta_len(1) - 1;
+  wear_leveling_write(EECONFIG_PROFILE_DELTA_ADDR(1), &len, sizeof(len));
+  if (!reload())
+    return false;
+
+  eeconfig_get_default_profile(0, &expected.profiles[0]);
+  if (memcmp(&CURRENT_PROFILE, &expected.profiles[0],
+             sizeof(CURRENT_PROFILE)) != 0) {
+    fprintf(stderr, "The current profile is not the default profile\n");
+    return false;
+  }
+  if (EECONFIG_READ(profiles[1], &profile) ||
+      eeconfig_write(offsetof(eeconfig_t, profiles[1].tick_rate), &tick_rate,
+                     sizeof(tick_rate))) {
+    fprintf(stderr, "The malformed profile was read or patched\n");
+    return false;
+  }
+
+  // Writing the profiles entirely replaces the malformed deltas
+  for (uint8_t p = 0; p < 2; p++) {
+    eeconfig_get_default_profile(p, &profile);
+    profile.tick_rate = tick_rate;
+    if (!write_profile(p, 0, &profile, sizeof(profile)))
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Customize every profile as a heavily edited profile would be
+ *
+ * Each profile gets a fully remapped layer, a different actuation point and
+ * Rapid Trigger sensitivities for every key, and four advanced keys.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_budget(void) {
+  static eeconfig_profile_t profile;
+
+  for (uint8_t p = 0; p < NUM_PROFILES; p++) {
+    eeconfig_get_default_profile(p, &profile);
+    for (uint32_t i = 0; i < NUM_KEYS; i++) {
+      profile.keymap[1 + p % (NUM_LAYERS - 1)][i] = (uint8_t)rng();
+      profile.actuation_map[i].actuation_point = (uint8_t)rng();
+      profile.actuation_map[i].rt_down = (uint8_t)rng();
+      profile.actuation_map[i].rt_up = (uint8_t)rng();
+      profile.actuation_map[i].continuous = rng() & 1;
+    }
+    for (uint32_t i = 0; i < 4; i++) {
+      for (uint32_t j = 0; j < sizeof(advanced_key_t); j++)
+        ((uint8_t *)&profile.advanced_keys[i])[j] = (uint8_t)rng();
+    }
+    if (!write_profile(p, 0, &profile, sizeof(profile)))
+      return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool (*scenario)(void) = NULL;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <scenario>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(argv[1], "round_trip") == 0)
+    scenario = scenario_round_trip;
+  if (strcmp(argv[1], "overflow") == 0)
+    scenario = scenario_overflow;
+  if (strcmp(argv[1], "malformed") == 0)
+    scenario = scenario_malformed;
+  if (strcmp(argv[1], "budget") == 0)
+    scenario = scenario_budget;
+  if (scenario == NULL) {
+    fprintf(stderr, "Unknown scenario: %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  crc32_init();
+  host_flash_reset();
+  wear_leveling_init();
+  eeconfig_init();
+  if (!eeconfig_read(0, &expected, sizeof(expected)))
+    return EXIT_FAILURE;
+
+  if (!scenario() || !check("after the scenario") || !reload() ||
+      !check("after loading the configuration"))
+    return EXIT_FAILURE;
+
+  printf("slot size: %u\n", (unsigned)EECONFIG_PROFILE_DELTA_SIZE);
+  for (uint8_t p = 0; p < NUM_PROFILES; p++)
+    printf("profile %u: %u\n", p, delta_len(p));
+
+  return EXIT_SUCCESS;
+}
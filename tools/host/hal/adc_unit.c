@@ -0,0 +1,251 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "host.h"
+#include "stm32f4xx_hal.h"
+
+//--------------------------------------------------------------------+
+// ADC Unit
+//
+// The ADCs of the STM32F4 convert a sequence of up to 16 channels started by
+// software, and the DMA transfers the conversions to memory before the
+// completion callback is called. In regular simultaneous mode, ADC1 also
+// starts the sequences of ADC2 and ADC3, and the DMA transfers the conversions
+// of each rank in ADC order. ADC3 is not connected to every channel. The timer
+// only calls its period elapsed callback, and the GPIO ports only hold their
+// output data.
+//
+// Nothing happens until `host_adc_run()` is called, which completes the
+// conversion sequence in progress or the timer period like their interrupts.
+//--------------------------------------------------------------------+
+
+// Channels that ADC3 is connected to, see `scripts/drivers.py`
+#define ADC3_CHANNELS 0x3C0F
+
+ADC_TypeDef host_adcs[3];
+TIM_TypeDef host_tim10;
+GPIO_TypeDef host_gpios[3];
+uint32_t host_dma2_stream0;
+
+uint16_t (*host_adc_signal)(uint8_t channel, uint32_t sequence);
+uint32_t host_adc_sync_sequences;
+
+// Configuration of each ADC
+static struct {
+  bool initialized;
+  // Whether ADC2 or ADC3 is waiting for ADC1 to start the conversions
+  bool enabled;
+  uint32_t num_ranks;
+  // Bitmap of the configured ranks
+  uint32_t ranks;
+  uint8_t channels[16];
+} adcs[3];
+
+// Number of ADCs converting simultaneously
+static uint32_t num_simultaneous = 1;
+
+// Conversion sequence in progress
+static struct {
+  ADC_HandleTypeDef *hadc;
+  volatile uint16_t *dst;
+} conversion;
+
+// Timer counting, if any
+static TIM_HandleTypeDef *timer;
+
+// Number of completed conversion sequences
+static uint32_t num_sequences;
+// Depth of the interrupt handlers being run
+static uint32_t interrupt_depth;
+
+static uint32_t adc_index(const ADC_HandleTypeDef *hadc) {
+  return (uint32_t)(hadc->Instance - host_adcs);
+}
+
+static void adc_complete(void) {
+  ADC_HandleTypeDef *hadc = conversion.hadc;
+
+  for (uint32_t rank = 0; rank < adcs[0].num_ranks; rank++)
+    for (uint32_t i = 0; i < num_simultaneous; i++)
+      conversion.dst[rank * num_simultaneous + i] =
+          host_adc_signal(adcs[i].channels[rank], num_sequences);
+  conversion.hadc = NULL;
+  num_sequences++;
+
+  interrupt_depth++;
+  HAL_ADC_ConvCpltCallback(hadc);
+  interrupt_depth--;
+}
+
+static HAL_StatusTypeDef adc_start(ADC_HandleTypeDef *hadc, uint32_t *pData,
+                                   uint32_t Length, bool multimode) {
+  if (conversion.hadc != NULL)
+    return HAL_BUSY;
+
+  if (adc_index(hadc) != 0 || multimode != (num_simultaneous > 1) ||
+      Length != adcs[0].num_ranks * num_simultaneous)
+    return HAL_ERROR;
+  for (uint32_t i = 0; i < num_simultaneous; i++) {
+    if (!adcs[i].initialized || (i > 0 && !adcs[i].enabled) ||
+        adcs[i].num_ranks != adcs[0].num_ranks ||
+        adcs[i].ranks != (1u << adcs[i].num_ranks) - 1)
+      return HAL_ERROR;
+  }
+
+  conversion.hadc = hadc;
+  conversion.dst = (volatile uint16_t *)pData;
+
+  if (interrupt_depth == 0 && host_adc_sync_sequences > 0) {
+    // The CPU waits for the conversions
+    const uint32_t end = num_sequences + host_adc_sync_sequences;
+
+    host_adc_sync_sequences = 0;
+    while (num_sequences < end && host_adc_run())
+      ;
+  }
+
+  return HAL_OK;
+}
+
+bool host_adc_run(void) {
+  if (conversion.hadc != NULL) {
+    adc_complete();
+    return true;
+  }
+
+  if (timer != NULL) {
+    interrupt_depth++;
+    HAL_TIM_PeriodElapsedCallback(timer);
+    interrupt_depth--;
+    return true;
+  }
+
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// STM32F4 HAL
+//--------------------------------------------------------------------+
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc) {
+  const ADC_InitTypeDef *init = &hadc->Init;
+  const uint32_t i = adc_index(hadc);
+
+  // Only sequences started by software are modeled
+  if (init->NbrOfConversion < 1 || init->NbrOfConversion > 16 ||
+      init->ScanConvMode != ENABLE || init->ContinuousConvMode != DISABLE ||
+      init->DiscontinuousConvMode != DISABLE ||
+      init->ExternalTrigConv != ADC_SOFTWARE_START)
+    return HAL_ERROR;
+
+  adcs[i].initialized = true;
+  adcs[i].num_ranks = init->NbrOfConversion;
+  adcs[i].ranks = 0;
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc,
+                                        ADC_ChannelConfTypeDef *sConfig) {
+  const uint32_t i = adc_index(hadc);
+
+  if (!adcs[i].initialized || sConfig->Rank < 1 ||
+      sConfig->Rank > adcs[i].num_ranks || sConfig->Channel >= 16 ||
+      (i == 2 && !((ADC3_CHANNELS >> sConfig->Channel) & 1)))
+    return HAL_ERROR;
+
+  adcs[i].channels[sConfig->Rank - 1] = (uint8_t)sConfig->Channel;
+  adcs[i].ranks |= 1u << (sConfig->Rank - 1);
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc) {
+  const uint32_t i = adc_index(hadc);
+
+  // Only ADC2 and ADC3 waiting for ADC1 are modeled
+  if (i == 0 || !adcs[i].initialized)
+    return HAL_ERROR;
+  adcs[i].enabled = true;
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData,
+                                    uint32_t Length) {
+  return adc_start(hadc, pData, Length, false);
+}
+
+void HAL_ADC_IRQHandler(ADC_HandleTypeDef *hadc) {}
+
+HAL_StatusTypeDef
+HAL_ADCEx_MultiModeConfigChannel(ADC_HandleTypeDef *hadc,
+                                 ADC_MultiModeTypeDef *multimode) {
+  // Only the DMA access mode 1 of the regular simultaneous mode is modeled
+  if (adc_index(hadc) != 0 || multimode->DMAAccessMode != ADC_DMAACCESSMODE_1)
+    return HAL_ERROR;
+
+  switch (multimode->Mode) {
+  case ADC_DUALMODE_REGSIMULT:
+    num_simultaneous = 2;
+    break;
+  case ADC_TRIPLEMODE_REGSIMULT:
+    num_simultaneous = 3;
+    break;
+  default:
+    return HAL_ERROR;
+  }
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_ADCEx_MultiModeStart_DMA(ADC_HandleTypeDef *hadc,
+                                               uint32_t *pData,
+                                               uint32_t Length) {
+  return adc_start(hadc, pData, Length, true);
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim) { return HAL_OK; }
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim) {
+  if (timer != NULL)
+    return HAL_ERROR;
+  timer = htim;
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim) {
+  if (timer == htim)
+    timer = NULL;
+
+  return HAL_OK;
+}
+
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim) {}
+
+// Overridden by the drivers that use a timer, like in the HAL
+__attribute__((weak)) void
+HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim) {}
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init) {}
+
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState) {
+  if (PinState == GPIO_PIN_RESET)
+    GPIOx->ODR &= ~(uint32_t)GPIO_Pin;
+  else
+    GPIOx->ODR |= GPIO_Pin;
+}
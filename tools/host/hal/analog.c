@@ -0,0 +1,52 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hardware/hardware.h"
+#include "host.h"
+
+uint16_t host_adc_values[NUM_KEYS];
+
+static host_analog_stats_t stats = {.continuous = true};
+// ADC values of the last sweep, read while the conversion loop is stopped
+static uint16_t sweep_values[NUM_KEYS];
+
+void analog_init(void) {}
+
+void analog_task(void) {}
+
+uint16_t analog_read(uint8_t key) {
+  if (key >= NUM_KEYS)
+    return 0;
+
+  return stats.continuous ? host_adc_values[key] : sweep_values[key];
+}
+
+void analog_set_continuous(bool continuous) {
+  if (!continuous && stats.continuous)
+    // The sweep in progress completes
+    memcpy(sweep_values, host_adc_values, sizeof(sweep_values));
+  stats.continuous = continuous;
+}
+
+void analog_start_sweep(void) {
+  if (stats.continuous)
+    return;
+
+  // The sweep completes before the next read
+  memcpy(sweep_values, host_adc_values, sizeof(sweep_values));
+  stats.sweeps++;
+}
+
+host_analog_stats_t *host_analog_stats(void) { return &stats; }
@@ -0,0 +1,53 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <time.h>
+
+#include "hardware/hardware.h"
+#include "host.h"
+
+uint64_t host_time_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000 + (uint64_t)ts.tv_nsec;
+}
+
+void board_init(void) {}
+
+void board_error_handler(void) {
+  fprintf(stderr, "board_error_handler()\n");
+  abort();
+}
+
+void board_reset(void) {
+  fprintf(stderr, "board_reset()\n");
+  exit(EXIT_SUCCESS);
+}
+
+void board_enter_bootloader(void) {}
+
+uint32_t board_serial(char *buf) {
+  memcpy(buf, "HOST", 4);
+
+  return 4;
+}
+
+// `F_CPU` is 1 GHz on the host, so a cycle is a nanosecond
+uint32_t board_cycle_count(void) { return (uint32_t)host_time_ns(); }
+
+void board_idle(void) {}
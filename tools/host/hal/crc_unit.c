@@ -0,0 +1,175 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "at32f402_405.h"
+#include "host.h"
+#include "stm32f4xx_hal.h"
+
+//--------------------------------------------------------------------+
+// CRC Unit
+//
+// The CRC units of the STM32F4 and the AT32F405 compute the CRC-32/MPEG-2 of
+// 32-bit words: the polynomial is 0x04C11DB7, the data register is reset to
+// 0xFFFFFFFF, and each word is processed MSB-first without any reflection or
+// final XOR.
+//--------------------------------------------------------------------+
+
+#define CRC_UNIT_POLY 0x04C11DB7
+
+CRC_TypeDef host_crc;
+uint32_t host_dma2_stream1;
+
+// Pending memory-to-memory DMA transfer
+static struct {
+  DMA_HandleTypeDef *hdma;
+  uint32_t src;
+  uint32_t dst;
+  uint32_t len;
+} dma;
+
+static void crc_unit_reset(void) { host_crc.DR = 0xFFFFFFFF; }
+
+static uint32_t crc_unit_write(uint32_t data) {
+  uint32_t crc = host_crc.DR ^ data;
+
+  for (uint32_t i = 0; i < 32; i++)
+    crc = (crc << 1) ^ (CRC_UNIT_POLY & (uint32_t)(-(int32_t)(crc >> 31)));
+  host_crc.DR = crc;
+
+  return crc;
+}
+
+bool host_dma_run(void) {
+  DMA_HandleTypeDef *hdma = dma.hdma;
+
+  if (hdma == NULL)
+    return false;
+
+  if (dma.dst != (uint32_t)(uintptr_t)&host_crc.DR) {
+    fprintf(stderr, "DMA transfer to an unmodeled address\n");
+    abort();
+  }
+  // The source is incremented and the destination is fixed
+  for (uint32_t i = 0; i < dma.len; i++) {
+    uint32_t data;
+
+    memcpy(&data, (const void *)(uintptr_t)(dma.src + i * 4), 4);
+    crc_unit_write(data);
+  }
+  dma.hdma = NULL;
+  if (hdma->XferCpltCallback != NULL)
+    hdma->XferCpltCallback(hdma);
+
+  return true;
+}
+
+//--------------------------------------------------------------------+
+// STM32F4 HAL
+//--------------------------------------------------------------------+
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc) {
+  crc_unit_reset();
+
+  return HAL_OK;
+}
+
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength) {
+  crc_unit_reset();
+
+  return HAL_CRC_Accumulate(hcrc, pBuffer, BufferLength);
+}
+
+uint32_t HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                            uint32_t BufferLength) {
+  for (uint32_t i = 0; i < BufferLength; i++) {
+    uint32_t data;
+
+    // The buffer may be unaligned
+    memcpy(&data, (const uint8_t *)pBuffer + i * 4, 4);
+    crc_unit_write(data);
+  }
+
+  return host_crc.DR;
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma) {
+  const DMA_InitTypeDef *init = &hdma->Init;
+
+  // Only the configurations of the CRC and the ADC drivers are modeled. The
+  // transfers of the ADC driver are modeled in `hal/adc_unit.c`.
+  if (init->Direction == DMA_MEMORY_TO_MEMORY &&
+      init->PeriphInc == DMA_PINC_ENABLE && init->MemInc == DMA_MINC_DISABLE &&
+      init->PeriphDataAlignment == DMA_PDATAALIGN_WORD &&
+      init->MemDataAlignment == DMA_MDATAALIGN_WORD)
+    return HAL_OK;
+  if (init->Direction == DMA_PERIPH_TO_MEMORY &&
+      init->PeriphInc == DMA_PINC_DISABLE && init->MemInc == DMA_MINC_ENABLE &&
+      init->PeriphDataAlignment == DMA_PDATAALIGN_HALFWORD &&
+      init->MemDataAlignment == DMA_MDATAALIGN_HALFWORD &&
+      init->Mode == DMA_CIRCULAR)
+    return HAL_OK;
+
+  return HAL_ERROR;
+}
+
+HAL_StatusTypeDef
+HAL_DMA_RegisterCallback(DMA_HandleTypeDef *hdma,
+                         HAL_DMA_CallbackIDTypeDef CallbackID,
+                         void (*pCallback)(DMA_HandleTypeDef *_hdma)) {
+  if (CallbackID != HAL_DMA_XFER_CPLT_CB_ID)
+    return HAL_ERROR;
+  hdma->XferCpltCallback = pCallback;
+
+  return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength) {
+  if (dma.hdma != NULL || SrcAddress % 4 != 0)
+    return HAL_ERROR;
+
+  dma.hdma = hdma;
+  dma.src = SrcAddress;
+  dma.dst = DstAddress;
+  dma.len = DataLength;
+
+  return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma) {
+  if (dma.hdma == hdma)
+    host_dma_run();
+}
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn) {}
+
+//--------------------------------------------------------------------+
+// AT32F402/405 Firmware Library
+//--------------------------------------------------------------------+
+
+void crm_periph_clock_enable(crm_periph_clock_type value,
+                             confirm_state new_state) {}
+
+void crc_data_reset(void) { crc_unit_reset(); }
+
+uint32_t crc_one_word_calculate(uint32_t data) { return crc_unit_write(data); }
+
+uint32_t crc_block_calculate(uint32_t *pbuffer, uint32_t length) {
+  // Same as the STM32F4 HAL, including unaligned buffers
+  return HAL_CRC_Accumulate(NULL, pbuffer, length);
+}
@@ -0,0 +1,158 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "hardware/hardware.h"
+#include "host.h"
+
+uint8_t host_flash[FLASH_SIZE];
+
+static host_flash_stats_t stats;
+
+// Power cut state
+static struct {
+  // Number of operations to complete before the power cut
+  uint32_t num_ops;
+  // Function called on the power cut, or NULL if disarmed
+  void (*handler)(void);
+  // State of the xorshift32 generator of the interrupted erases
+  uint32_t rng;
+} power_cut = {.rng = 1};
+
+/**
+ * @brief Check whether the power is cut before the next operation completes
+ *
+ * The power cut is disarmed once it happens.
+ *
+ * @return true if the operation is interrupted, false otherwise
+ */
+static bool host_flash_is_power_cut(void) {
+  if (power_cut.handler == NULL || power_cut.num_ops-- > 0)
+    return false;
+
+  power_cut.rng ^= power_cut.rng << 13;
+  power_cut.rng ^= power_cut.rng >> 17;
+  power_cut.rng ^= power_cut.rng << 5;
+
+  return true;
+}
+
+/**
+ * @brief Call the power cut handler
+ *
+ * @return None
+ */
+static void host_flash_call_power_cut_handler(void) {
+  void (*handler)(void) = power_cut.handler;
+
+  power_cut.handler = NULL;
+  handler();
+}
+
+/**
+ * @brief Get the address of a flash sector
+ *
+ * @param sector Sector index
+ *
+ * @return Address of the sector
+ */
+static uint32_t host_flash_sector_address(uint32_t sector) {
+  uint32_t addr = 0;
+
+  for (uint32_t i = 0; i < sector; i++)
+    addr += flash_sector_size(i);
+
+  return addr;
+}
+
+void host_flash_reset(void) {
+  memset(host_flash, 0xFF, sizeof(host_flash));
+  memset(&stats, 0, sizeof(stats));
+}
+
+void host_flash_power_cut(uint32_t num_ops, void (*handler)(void)) {
+  power_cut.num_ops = num_ops;
+  power_cut.handler = handler;
+}
+
+host_flash_stats_t *host_flash_stats(void) { return &stats; }
+
+void flash_init(void) {}
+
+bool flash_erase(uint32_t sector) {
+  if (sector >= FLASH_NUM_SECTORS)
+    return false;
+
+  uint32_t len = flash_sector_size(sector);
+  const bool is_power_cut = host_flash_is_power_cut();
+
+  if (is_power_cut)
+    // Only the start of the sector is erased
+    len = power_cut.rng % len;
+  memset(host_flash + host_flash_sector_address(sector), 0xFF, len);
+  stats.erases++;
+  stats.sector_erases[sector]++;
+
+  if (is_power_cut) {
+    host_flash_call_power_cut_handler();
+    return false;
+  }
+
+  return true;
+}
+
+bool flash_read(uint32_t addr, void *buf, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return false;
+
+  memcpy(buf, host_flash + addr, len * 4);
+
+  return true;
+}
+
+const void *flash_map(uint32_t addr, uint32_t len) {
+  if (addr + len * 4 > FLASH_SIZE)
+    return NULL;
+
+  return host_flash + addr;
+}
+
+bool flash_write(uint32_t addr, const void *buf, uint32_t len) {
+  if (addr % 4 != 0 || addr + len * 4 > FLASH_SIZE)
+    return false;
+
+  const uint8_t *buf8 = buf;
+
+  for (uint32_t i = 0; i < len * 4; i += 4) {
+    uint32_t word, value;
+
+    memcpy(&word, host_flash + addr + i, 4);
+    memcpy(&value, buf8 + i, 4);
+    if (word != FLASH_EMPTY_VAL)
+      // Like the MCUs, a word can only be programmed once after an erase
+      return false;
+
+    if (host_flash_is_power_cut()) {
+      // The word is not programmed, since the write log relies on programming
+      // a word being atomic
+      host_flash_call_power_cut_handler();
+      return false;
+    }
+
+    memcpy(host_flash + addr + i, &value, 4);
+    stats.programs++;
+  }
+
+  return true;
+}
@@ -0,0 +1,138 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Host Hardware
+//
+// Host implementation of the hardware API in `tools/host/hal/`, built by
+// `tools/host/build.py`. The flash is simulated in memory with the sector
+// layout of the keyboard's MCU, and the timer only advances when told to, so
+// that the host programs are deterministic. The ADC values are set by the
+// host programs, and only sampled at each sweep while the conversion loop is
+// stopped. The CRC unit of the MCUs is modeled for the CRC32 drivers, and the
+// ADCs of the STM32F4 for its analog driver.
+//--------------------------------------------------------------------+
+
+// Simulated flash statistics
+typedef struct {
+  // Number of sector erases
+  uint32_t erases;
+  // Number of programmed words
+  uint32_t programs;
+  // Number of erases of each sector
+  uint32_t sector_erases[FLASH_NUM_SECTORS];
+} host_flash_stats_t;
+
+// Simulated ADC statistics
+typedef struct {
+  // Whether the conversion loop is continuous
+  bool continuous;
+  // Number of sweeps started by `analog_start_sweep()` while the conversion
+  // loop is stopped
+  uint32_t sweeps;
+} host_analog_stats_t;
+
+// Value converted by the modeled ADCs of `hal/adc_unit.c` on an ADC channel,
+// given the index of the conversion sequence. Set by the host programs.
+extern uint16_t (*host_adc_signal)(uint8_t channel, uint32_t sequence);
+
+// Number of conversion sequences completed when a conversion is started
+// outside of the interrupt handlers, like the first sweep waited for by
+// `analog_init()`. Reset to 0 once they are completed.
+extern uint32_t host_adc_sync_sequences;
+
+// Raw ADC value of each key, as returned by `analog_read()` while the
+// conversion loop is continuous. Otherwise, `analog_read()` returns the values
+// of the last sweep.
+extern uint16_t host_adc_values[NUM_KEYS];
+
+// Contents of the simulated flash
+extern uint8_t host_flash[FLASH_SIZE];
+
+/**
+ * @brief Erase the whole simulated flash and clear its statistics
+ *
+ * @return None
+ */
+void host_flash_reset(void);
+
+/**
+ * @brief Cut the power during a later flash operation
+ *
+ * The operation after the next `num_ops` programmed words and sector erases
+ * is interrupted. The word is not programmed, or only the start of the sector
+ * is erased, and `handler` is called, e.g. to `longjmp()` out of the firmware
+ * to simulate a reset. If the handler returns, the operation fails.
+ *
+ * @param num_ops Number of operations to complete before the power cut
+ * @param handler Function called on the power cut, or NULL to disarm
+ *
+ * @return None
+ */
+void host_flash_power_cut(uint32_t num_ops, void (*handler)(void));
+
+/**
+ * @brief Get the statistics of the simulated flash
+ *
+ * @return Pointer to the statistics
+ */
+host_flash_stats_t *host_flash_stats(void);
+
+/**
+ * @brief Get the statistics of the simulated ADC
+ *
+ * @return Pointer to the statistics
+ */
+host_analog_stats_t *host_analog_stats(void);
+
+/**
+ * @brief Advance the timer
+ *
+ * @param ms Time to advance in milliseconds
+ *
+ * @return None
+ */
+void host_timer_advance(uint32_t ms);
+
+/**
+ * @brief Get the time of a monotonic clock in nanoseconds
+ *
+ * @return Time in nanoseconds
+ */
+uint64_t host_time_ns(void);
+
+/**
+ * @brief Complete the pending DMA transfer to the CRC unit
+ *
+ * This is what the DMA interrupt does on the MCU.
+ *
+ * @return true if a transfer was completed, false if none was pending
+ */
+bool host_dma_run(void);
+
+/**
+ * @brief Complete the conversion sequence in progress or the timer period of
+ * the modeled ADCs
+ *
+ * This is what the DMA and the timer interrupts do on the MCU.
+ *
+ * @return true if an interrupt was run, false if the ADCs and the timer are
+ * stopped
+ */
+bool host_adc_run(void);
@@ -0,0 +1,105 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "crc32.h"
+#include "eeconfig.h"
+#include "hardware/hardware.h"
+#include "host.h"
+#include "idle.h"
+#include "matrix.h"
+
+//--------------------------------------------------------------------+
+// Idle Trace
+//
+// Calibrates the matrix with every key at rest. Then, for each ADC value read
+// from the standard input, one per line and after the inversion of
+// `MATRIX_INVERT_ADC_VALUES`, sets the first key to the value, advances the
+// timer by 1 ms and runs several iterations of the main loop. In the low-power
+// scan mode, the CPU sleeps until the next system tick, or until the end of
+// the sweep started by the iteration.
+// `idle_wake()` is called before the iterations at the given times. After the
+// iterations, prints the time, whether the conversion loop is continuous, the
+// number of sweeps started, the idle time and the number of wake-ups.
+//
+//   idle_test [wake_time...] < adc_values
+//--------------------------------------------------------------------+
+
+// Iterations of the main loop per millisecond at full scan rate
+#define LOOPS_PER_MS 4
+
+/**
+ * @brief Set the ADC value of a key
+ *
+ * @param key Key index
+ * @param value ADC value after the inversion
+ *
+ * @return None
+ */
+static void set_adc_value(uint8_t key, uint16_t value) {
+#if defined(MATRIX_INVERT_ADC_VALUES)
+  host_adc_values[key] = ADC_MAX_VALUE - value;
+#else
+  host_adc_values[key] = value;
+#endif
+}
+
+int main(int argc, char **argv) {
+  unsigned value;
+
+  crc32_init();
+  host_flash_reset();
+  wear_leveling_init();
+  eeconfig_init();
+
+  matrix_init();
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+    set_adc_value((uint8_t)i, eeconfig->calibration.initial_rest_value);
+  for (uint32_t t = 0; t <= MATRIX_CALIBRATION_DURATION; t++) {
+    host_timer_advance(1);
+    matrix_scan();
+  }
+  idle_init();
+
+  while (scanf("%u", &value) == 1) {
+    set_adc_value(0, (uint16_t)M_MIN(value, ADC_MAX_VALUE));
+    host_timer_advance(1);
+
+    const uint32_t now = timer_read();
+    for (int i = 1; i < argc; i++) {
+      if (strtoul(argv[i], NULL, 0) == now)
+        idle_wake();
+    }
+    const host_analog_stats_t *analog = host_analog_stats();
+
+    for (uint32_t i = 0; i < LOOPS_PER_MS; i++) {
+      const uint32_t sweeps = analog->sweeps;
+
+      matrix_scan();
+      idle_task();
+      if (!analog->continuous && analog->sweeps == sweeps)
+        break;
+    }
+    idle_stats_t stats;
+
+    idle_get_stats(&stats);
+    printf("%lu %u %lu %lu %lu\n", (unsigned long)now, analog->continuous,
+           (unsigned long)analog->sweeps, (unsigned long)stats.idle_time,
+           (unsigned long)stats.wakeups);
+  }
+
+  return EXIT_SUCCESS;
+}
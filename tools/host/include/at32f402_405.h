@@ -0,0 +1,41 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// AT32F402/405 Firmware Library Subset
+//
+// Only the CRC unit used by `src/hardware/at32f405xx/crc32.c` is modeled, see
+// `hal/crc_unit.c`.
+//--------------------------------------------------------------------+
+
+typedef enum {
+  FALSE = 0,
+  TRUE = !FALSE,
+} confirm_state;
+
+typedef enum {
+  CRM_CRC_PERIPH_CLOCK = 0,
+} crm_periph_clock_type;
+
+void crm_periph_clock_enable(crm_periph_clock_type value,
+                             confirm_state new_state);
+
+void crc_data_reset(void);
+uint32_t crc_one_word_calculate(uint32_t data);
+uint32_t crc_block_calculate(uint32_t *pbuffer, uint32_t length);
@@ -0,0 +1,304 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// STM32F4 HAL Subset
+//
+// Only the CRC unit and the memory-to-memory DMA used by
+// `src/hardware/stm32f446xx/crc32.c` are modeled, see `hal/crc_unit.c`, and
+// the ADCs, the timer and the GPIOs used by `src/hardware/stm32f446xx/analog.c`,
+// see `hal/adc_unit.c`. The DMA addresses are 32-bit, so the host programs
+// using them are linked without PIE to keep their static buffers in the low
+// 4 GiB.
+//--------------------------------------------------------------------+
+
+typedef enum {
+  HAL_OK = 0,
+  HAL_ERROR,
+  HAL_BUSY,
+} HAL_StatusTypeDef;
+
+typedef enum {
+  DISABLE = 0,
+  ENABLE = !DISABLE,
+} FunctionalState;
+
+typedef struct {
+  volatile uint32_t DR;
+} CRC_TypeDef;
+
+typedef struct {
+  CRC_TypeDef *Instance;
+} CRC_HandleTypeDef;
+
+typedef struct {
+  uint32_t Channel;
+  uint32_t Direction;
+  uint32_t PeriphInc;
+  uint32_t MemInc;
+  uint32_t PeriphDataAlignment;
+  uint32_t MemDataAlignment;
+  uint32_t Mode;
+  uint32_t Priority;
+  uint32_t FIFOMode;
+  uint32_t FIFOThreshold;
+  uint32_t MemBurst;
+  uint32_t PeriphBurst;
+} DMA_InitTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+  void *Instance;
+  DMA_InitTypeDef Init;
+  void *Parent;
+  void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+} DMA_HandleTypeDef;
+
+typedef enum {
+  HAL_DMA_XFER_CPLT_CB_ID = 0,
+} HAL_DMA_CallbackIDTypeDef;
+
+typedef enum {
+  ADC_IRQn = 18,
+  TIM1_UP_TIM10_IRQn = 25,
+  DMA2_Stream0_IRQn = 56,
+  DMA2_Stream1_IRQn = 57,
+} IRQn_Type;
+
+enum {
+  DMA_CHANNEL_0 = 0,
+  DMA_MEMORY_TO_MEMORY,
+  DMA_PINC_ENABLE,
+  DMA_MINC_DISABLE,
+  DMA_PDATAALIGN_WORD,
+  DMA_MDATAALIGN_WORD,
+  DMA_NORMAL,
+  DMA_PRIORITY_LOW,
+  DMA_FIFOMODE_ENABLE,
+  DMA_FIFO_THRESHOLD_FULL,
+  DMA_MBURST_SINGLE,
+  DMA_PBURST_SINGLE,
+  DMA_PERIPH_TO_MEMORY,
+  DMA_PINC_DISABLE,
+  DMA_MINC_ENABLE,
+  DMA_PDATAALIGN_HALFWORD,
+  DMA_MDATAALIGN_HALFWORD,
+  DMA_CIRCULAR,
+  DMA_PRIORITY_HIGH,
+  DMA_FIFOMODE_DISABLE,
+};
+
+// Modeled ADC, see `hal/adc_unit.c`
+typedef struct {
+  uint32_t reserved;
+} ADC_TypeDef;
+
+typedef struct {
+  uint32_t ClockPrescaler;
+  uint32_t Resolution;
+  uint32_t DataAlign;
+  FunctionalState ScanConvMode;
+  uint32_t EOCSelection;
+  FunctionalState ContinuousConvMode;
+  uint32_t NbrOfConversion;
+  FunctionalState DiscontinuousConvMode;
+  uint32_t NbrOfDiscConversion;
+  uint32_t ExternalTrigConv;
+  uint32_t ExternalTrigConvEdge;
+  FunctionalState DMAContinuousRequests;
+} ADC_InitTypeDef;
+
+typedef struct {
+  ADC_TypeDef *Instance;
+  ADC_InitTypeDef Init;
+  DMA_HandleTypeDef *DMA_Handle;
+} ADC_HandleTypeDef;
+
+typedef struct {
+  uint32_t Channel;
+  uint32_t Rank;
+  uint32_t SamplingTime;
+  uint32_t Offset;
+} ADC_ChannelConfTypeDef;
+
+typedef struct {
+  uint32_t Mode;
+  uint32_t DMAAccessMode;
+  uint32_t TwoSamplingDelay;
+} ADC_MultiModeTypeDef;
+
+enum {
+  ADC_CLOCK_SYNC_PCLK_DIV4 = 0,
+  ADC_RESOLUTION_12B,
+  ADC_RESOLUTION_10B,
+  ADC_RESOLUTION_8B,
+  ADC_RESOLUTION_6B,
+  ADC_EXTERNALTRIGCONVEDGE_NONE,
+  ADC_SOFTWARE_START,
+  ADC_DATAALIGN_RIGHT,
+  ADC_EOC_SINGLE_CONV,
+  ADC_SAMPLETIME_3CYCLES,
+  ADC_DUALMODE_REGSIMULT,
+  ADC_TRIPLEMODE_REGSIMULT,
+  ADC_DMAACCESSMODE_1,
+  ADC_TWOSAMPLINGDELAY_5CYCLES,
+};
+
+// Modeled timer, see `hal/adc_unit.c`
+typedef struct {
+  uint32_t reserved;
+} TIM_TypeDef;
+
+typedef struct {
+  uint32_t Prescaler;
+  uint32_t CounterMode;
+  uint32_t Period;
+  uint32_t ClockDivision;
+  uint32_t RepetitionCounter;
+  uint32_t AutoReloadPreload;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+  TIM_TypeDef *Instance;
+  TIM_Base_InitTypeDef Init;
+} TIM_HandleTypeDef;
+
+enum {
+  TIM_COUNTERMODE_UP = 0,
+  TIM_CLOCKDIVISION_DIV1,
+  TIM_AUTORELOAD_PRELOAD_DISABLE,
+};
+
+// Modeled GPIO port, see `hal/adc_unit.c`
+typedef struct {
+  // Output data register
+  volatile uint32_t ODR;
+} GPIO_TypeDef;
+
+typedef struct {
+  uint32_t Pin;
+  uint32_t Mode;
+  uint32_t Pull;
+  uint32_t Speed;
+  uint32_t Alternate;
+} GPIO_InitTypeDef;
+
+typedef enum {
+  GPIO_PIN_RESET = 0,
+  GPIO_PIN_SET,
+} GPIO_PinState;
+
+enum {
+  GPIO_MODE_ANALOG = 0,
+  GPIO_MODE_OUTPUT_PP,
+  GPIO_NOPULL,
+  GPIO_SPEED_FREQ_VERY_HIGH,
+};
+
+#define GPIO_PIN_0 ((uint16_t)0x0001)
+#define GPIO_PIN_1 ((uint16_t)0x0002)
+#define GPIO_PIN_2 ((uint16_t)0x0004)
+#define GPIO_PIN_3 ((uint16_t)0x0008)
+#define GPIO_PIN_4 ((uint16_t)0x0010)
+#define GPIO_PIN_5 ((uint16_t)0x0020)
+#define GPIO_PIN_6 ((uint16_t)0x0040)
+#define GPIO_PIN_7 ((uint16_t)0x0080)
+#define GPIO_PIN_8 ((uint16_t)0x0100)
+#define GPIO_PIN_9 ((uint16_t)0x0200)
+#define GPIO_PIN_10 ((uint16_t)0x0400)
+#define GPIO_PIN_11 ((uint16_t)0x0800)
+#define GPIO_PIN_12 ((uint16_t)0x1000)
+#define GPIO_PIN_13 ((uint16_t)0x2000)
+#define GPIO_PIN_14 ((uint16_t)0x4000)
+#define GPIO_PIN_15 ((uint16_t)0x8000)
+
+extern CRC_TypeDef host_crc;
+extern uint32_t host_dma2_stream0;
+extern uint32_t host_dma2_stream1;
+extern ADC_TypeDef host_adcs[3];
+extern TIM_TypeDef host_tim10;
+extern GPIO_TypeDef host_gpios[3];
+
+#define CRC (&host_crc)
+#define DMA2_Stream0 ((void *)&host_dma2_stream0)
+#define DMA2_Stream1 ((void *)&host_dma2_stream1)
+#define ADC1 (&host_adcs[0])
+#define ADC2 (&host_adcs[1])
+#define ADC3 (&host_adcs[2])
+#define TIM10 (&host_tim10)
+#define GPIOA (&host_gpios[0])
+#define GPIOB (&host_gpios[1])
+#define GPIOC (&host_gpios[2])
+
+#define __HAL_RCC_CRC_CLK_ENABLE()
+#define __HAL_RCC_DMA2_CLK_ENABLE()
+#define __HAL_RCC_ADC1_CLK_ENABLE()
+#define __HAL_RCC_ADC2_CLK_ENABLE()
+#define __HAL_RCC_ADC3_CLK_ENABLE()
+#define __HAL_RCC_TIM10_CLK_ENABLE()
+#define __HAL_RCC_GPIOA_CLK_ENABLE()
+#define __HAL_RCC_GPIOB_CLK_ENABLE()
+#define __HAL_RCC_GPIOC_CLK_ENABLE()
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__)           \
+  do {                                                                         \
+    (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__);                       \
+    (__DMA_HANDLE__).Parent = (__HANDLE__);                                    \
+  } while (0)
+
+HAL_StatusTypeDef HAL_CRC_Init(CRC_HandleTypeDef *hcrc);
+uint32_t HAL_CRC_Calculate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                           uint32_t BufferLength);
+uint32_t HAL_CRC_Accumulate(CRC_HandleTypeDef *hcrc, uint32_t pBuffer[],
+                            uint32_t BufferLength);
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef
+HAL_DMA_RegisterCallback(DMA_HandleTypeDef *hdma,
+                         HAL_DMA_CallbackIDTypeDef CallbackID,
+                         void (*pCallback)(DMA_HandleTypeDef *_hdma));
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress,
+                                   uint32_t DstAddress, uint32_t DataLength);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+void HAL_NVIC_EnableIRQ(IRQn_Type IRQn);
+
+HAL_StatusTypeDef HAL_ADC_Init(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_ConfigChannel(ADC_HandleTypeDef *hadc,
+                                        ADC_ChannelConfTypeDef *sConfig);
+HAL_StatusTypeDef HAL_ADC_Start(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef HAL_ADC_Start_DMA(ADC_HandleTypeDef *hadc, uint32_t *pData,
+                                    uint32_t Length);
+void HAL_ADC_IRQHandler(ADC_HandleTypeDef *hadc);
+void HAL_ADC_ConvCpltCallback(ADC_HandleTypeDef *hadc);
+HAL_StatusTypeDef
+HAL_ADCEx_MultiModeConfigChannel(ADC_HandleTypeDef *hadc,
+                                 ADC_MultiModeTypeDef *multimode);
+HAL_StatusTypeDef HAL_ADCEx_MultiModeStart_DMA(ADC_HandleTypeDef *hadc,
+                                               uint32_t *pData,
+                                               uint32_t Length);
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+void HAL_TIM_IRQHandler(TIM_HandleTypeDef *htim);
+void HAL_TIM_PeriodElapsedCallback(TIM_HandleTypeDef *htim);
+
+void HAL_GPIO_Init(GPIO_TypeDef *GPIOx, GPIO_InitTypeDef *GPIO_Init);
+void HAL_GPIO_WritePin(GPIO_TypeDef *GPIOx, uint16_t GPIO_Pin,
+                       GPIO_PinState PinState);
@@ -0,0 +1,56 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+#include "tusb_config.h"
+
+//--------------------------------------------------------------------+
+// TinyUSB Subset
+//
+// Only the HID device API used by the core modules is declared. The host
+// programs that link `commands.c` implement it, e.g. to capture the raw HID
+// reports.
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Run the TinyUSB device task
+ *
+ * @return None
+ */
+void tud_task(void);
+
+/**
+ * @brief Check whether a HID interface can send a report
+ *
+ * @param instance HID interface
+ *
+ * @return true if ready, false otherwise
+ */
+bool tud_hid_n_ready(uint8_t instance);
+
+/**
+ * @brief Send a report on a HID interface
+ *
+ * @param instance HID interface
+ * @param report_id Report ID, or 0 if the interface has none
+ * @param report Report data
+ * @param len Length of the report in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report,
+                      uint16_t len);
@@ -0,0 +1,117 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "crc32.h"
+#include "eeconfig.h"
+#include "hardware/hardware.h"
+#include "host.h"
+#include "matrix.h"
+
+//--------------------------------------------------------------------+
+// Key Matrix Trace
+//
+// Configures every key with the same actuation settings, given as 16-bit
+// distances like `actuation_wide_t`, and calibrates the matrix. Then, for each
+// ADC value read from the standard input, one per line and after the inversion
+// of `MATRIX_INVERT_ADC_VALUES`, sets every key to the value, advances the
+// timer by 1 ms and scans the matrix. After each scan, prints the 8-bit
+// distance, the distance as a 16-bit distance, and the state of the first key.
+// The fractional parts of the settings are ignored without
+// `DISTANCE_HIGH_RESOLUTION`.
+//
+//   matrix_test <actuation_point> <rt_down> <rt_up> <continuous> < adc_values
+//--------------------------------------------------------------------+
+
+static actuation_t actuation_map[NUM_KEYS];
+static actuation_fine_t actuation_fine_map[NUM_KEYS];
+
+/**
+ * @brief Set every key to an ADC value
+ *
+ * @param value ADC value after the inversion
+ *
+ * @return None
+ */
+static void set_adc_values(uint16_t value) {
+  for (uint32_t i = 0; i < NUM_KEYS; i++)
+#if defined(MATRIX_INVERT_ADC_VALUES)
+    host_adc_values[i] = ADC_MAX_VALUE - value;
+#else
+    host_adc_values[i] = value;
+#endif
+}
+
+int main(int argc, char **argv) {
+  uint16_t wide[3];
+  unsigned value;
+
+  if (argc < 5) {
+    fprintf(stderr,
+            "usage: %s <actuation_point> <rt_down> <rt_up> <continuous>\n",
+            argv[0]);
+    return EXIT_FAILURE;
+  }
+  for (uint32_t i = 0; i < 3; i++)
+    wide[i] = (uint16_t)strtoul(argv[i + 1], NULL, 0);
+
+  for (uint32_t i = 0; i < NUM_KEYS; i++) {
+    actuation_map[i] = (actuation_t){
+        .actuation_point = (uint8_t)(wide[0] >> 8),
+        .rt_down = (uint8_t)(wide[1] >> 8),
+        .rt_up = (uint8_t)(wide[2] >> 8),
+        .continuous = strtoul(argv[4], NULL, 0) != 0,
+    };
+    actuation_fine_map[i] = (actuation_fine_t){
+        .actuation_point = (uint8_t)wide[0],
+        .rt_down = (uint8_t)wide[1],
+        .rt_up = (uint8_t)wide[2],
+    };
+  }
+
+  crc32_init();
+  host_flash_reset();
+  wear_leveling_init();
+  eeconfig_init();
+  if (!EECONFIG_WRITE(profiles[eeconfig->current_profile].actuation_map,
+                      actuation_map) ||
+      !EECONFIG_WRITE(profiles[eeconfig->current_profile].actuation_fine_map,
+                      actuation_fine_map)) {
+    fprintf(stderr, "Failed to write the actuation settings\n");
+    return EXIT_FAILURE;
+  }
+
+  matrix_init();
+  set_adc_values(eeconfig->calibration.initial_rest_value);
+  for (uint32_t t = 0; t <= MATRIX_CALIBRATION_DURATION; t++) {
+    host_timer_advance(1);
+    matrix_scan();
+  }
+
+  while (scanf("%u", &value) == 1) {
+    set_adc_values((uint16_t)M_MIN(value, ADC_MAX_VALUE));
+    host_timer_advance(1);
+    matrix_scan();
+
+    const distance_t distance =
+        matrix_adc_to_distance(0, key_matrix[0].adc_filtered);
+    printf("%u %u %u\n", key_matrix[0].distance,
+           (unsigned)(distance << (8 - DISTANCE_FRACTION_BITS)),
+           key_matrix[0].is_pressed);
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "crc32.h"
+#include "eeconfig.h"
+#include "host.h"
+
+//--------------------------------------------------------------------+
+// Configuration Migration
+//
+// Writes a configuration image of any version from the standard input to the
+// virtual storage of the simulated flash, initializes the persistent
+// configuration, which migrates it to the latest version, and prints the
+// resulting `eeconfig_t` to the standard output. The configuration is loaded
+// again from the flash before it is printed, so that the migration must have
+// been persisted.
+//
+//   migration_test < image > eeconfig
+//--------------------------------------------------------------------+
+
+int main(void) {
+  static uint8_t image[WL_VIRTUAL_SIZE];
+  static uint8_t config[sizeof(eeconfig_t)];
+  const uint32_t len = (uint32_t)fread(image, 1, sizeof(image), stdin);
+
+  host_flash_reset();
+  crc32_init();
+  wear_leveling_init();
+  if (!wear_leveling_write(0, image, len) || !wear_leveling_flush()) {
+    fprintf(stderr, "Failed to write the image\n");
+    return EXIT_FAILURE;
+  }
+
+  eeconfig_init();
+  if (!wear_leveling_flush()) {
+    fprintf(stderr, "Failed to persist the configuration\n");
+    return EXIT_FAILURE;
+  }
+  wear_leveling_init();
+  eeconfig_init();
+
+  if (!eeconfig_read(0, config, sizeof(config))) {
+    fprintf(stderr, "Failed to read the configuration\n");
+    return EXIT_FAILURE;
+  }
+  fwrite(config, 1, sizeof(config), stdout);
+
+  return EXIT_SUCCESS;
+}
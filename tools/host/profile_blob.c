@@ -0,0 +1,103 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "commands.h"
+#include "crc32.h"
+
+//--------------------------------------------------------------------+
+// Profile Blob Codec
+//
+// Encodes or decodes a profile blob from the standard input to the standard
+// output with the same steps as `COMMAND_EXPORT_PROFILE` and
+// `COMMAND_IMPORT_PROFILE`. The profile size defaults to the size of
+// `eeconfig_profile_t`, which `size` prints.
+//
+//   profile_blob encode|decode|size [size]
+//
+// The exit status tells why a blob was rejected.
+//--------------------------------------------------------------------+
+
+enum {
+  EXIT_MALFORMED = 2,
+  EXIT_LENGTH,
+  EXIT_CRC,
+};
+
+// Large enough for any profile of the tests
+#define MAX_PROFILE_SIZE 16384
+
+static uint8_t profile[MAX_PROFILE_SIZE];
+static uint8_t blob[sizeof(command_profile_blob_header_t) +
+                    COMPRESS_BOUND(MAX_PROFILE_SIZE)];
+
+static int encode(uint32_t size) {
+  command_profile_blob_header_t *header = (command_profile_blob_header_t *)blob;
+  uint32_t len;
+
+  if (fread(profile, 1, size, stdin) != size)
+    return EXIT_LENGTH;
+  if (!compress_encode(blob + sizeof(*header), sizeof(blob) - sizeof(*header),
+                       profile, size, &len))
+    return EXIT_MALFORMED;
+
+  header->len = (uint16_t)len;
+  header->crc = crc32_compute(profile, size, 0);
+  fwrite(blob, 1, sizeof(*header) + len, stdout);
+
+  return EXIT_SUCCESS;
+}
+
+static int decode(uint32_t size) {
+  const command_profile_blob_header_t *header =
+      (const command_profile_blob_header_t *)blob;
+  const uint32_t blob_len = (uint32_t)fread(blob, 1, sizeof(blob), stdin);
+  uint32_t len;
+
+  if (blob_len < sizeof(*header) || blob_len != sizeof(*header) + header->len)
+    return EXIT_LENGTH;
+  if (!compress_decode(profile, size, blob + sizeof(*header), header->len,
+                       &len))
+    return EXIT_MALFORMED;
+  if (len != size)
+    return EXIT_LENGTH;
+  if (crc32_compute(profile, size, 0) != header->crc)
+    return EXIT_CRC;
+  fwrite(profile, 1, size, stdout);
+
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char **argv) {
+  const uint32_t size = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0)
+                                  : sizeof(eeconfig_profile_t);
+
+  crc32_init();
+  if (argc < 2 || size > MAX_PROFILE_SIZE) {
+    fprintf(stderr, "usage: %s encode|decode|size [size]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+
+  if (strcmp(argv[1], "encode") == 0)
+    return encode(size);
+  if (strcmp(argv[1], "decode") == 0)
+    return decode(size);
+  if (strcmp(argv[1], "size") == 0)
+    return printf("%" PRIu32 "\n", size) < 0;
+
+  return EXIT_FAILURE;
+}
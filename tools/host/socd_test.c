@@ -0,0 +1,324 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "advanced_keys.h"
+#include "eeconfig.h"
+#include "keycodes.h"
+#include "layout.h"
+#include "matrix.h"
+
+//--------------------------------------------------------------------+
+// SOCD Group Scenarios
+//
+// Runs a scenario of key events through an SOCD group advanced key, and exits
+// with a non-zero status if the registered members do not match the expected
+// ones after a scan. The layout module is replaced by a record of the
+// registered keys, and the key matrix by the distances of the events.
+//
+//   socd_test <scenario>
+//--------------------------------------------------------------------+
+
+// Advanced key index of the group
+#define AK_INDEX 3
+// Key index of the first member. The members are the next keys.
+#define FIRST_KEY 10
+
+static eeconfig_t config;
+const eeconfig_t *eeconfig = &config;
+key_state_t key_matrix[NUM_KEYS];
+
+// Keycode registered for each key, or `KC_NO`
+static uint8_t registered[NUM_KEYS];
+// Whether a key was registered twice or unregistered with another keycode
+static bool mismatch;
+
+void layout_register(uint8_t key, uint8_t keycode) {
+  mismatch |= registered[key] != KC_NO;
+  registered[key] = keycode;
+}
+
+void layout_unregister(uint8_t key, uint8_t keycode) {
+  mismatch |= registered[key] != keycode;
+  registered[key] = KC_NO;
+}
+
+void matrix_disable_rapid_trigger(uint8_t key, bool disable) {}
+
+//--------------------------------------------------------------------+
+// Helper Functions
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Configure the SOCD group
+ *
+ * @param num_members Number of members
+ * @param behavior Null Bind behavior
+ * @param split Number of members on the first axis
+ * @param bottom_out_point Bottom-out point, or 0 to disable it
+ *
+ * @return None
+ */
+static void configure(uint8_t num_members, uint8_t behavior, uint8_t split,
+                      uint8_t bottom_out_point) {
+  advanced_key_t *ak = &config.profiles[0].advanced_keys[AK_INDEX];
+
+  advanced_key_clear();
+  memset(registered, KC_NO, sizeof(registered));
+  memset(key_matrix, 0, sizeof(key_matrix));
+
+  ak->layer = 0;
+  ak->key = FIRST_KEY;
+  ak->type = AK_TYPE_SOCD_GROUP;
+  for (uint8_t i = 1; i < SOCD_GROUP_MAX_MEMBERS; i++)
+    ak->socd_group.keys[i - 1] = i < num_members ? FIRST_KEY + i : 255;
+  ak->socd_group.behavior = behavior & 0xF;
+  ak->socd_group.split = split & 0xF;
+  ak->socd_group.bottom_out_point = bottom_out_point;
+}
+
+/**
+ * @brief Send an event of a member to the SOCD group
+ *
+ * @param type Event type
+ * @param member Member index
+ * @param distance Travel distance of the member
+ *
+ * @return None
+ */
+static void event(uint8_t type, uint8_t member, uint8_t distance) {
+  const advanced_key_event_t ak_event = {
+      .type = type,
+      .key = FIRST_KEY + member,
+      .keycode = KC_A + member,
+      .ak_index = AK_INDEX,
+  };
+
+  key_matrix[FIRST_KEY + member].distance = distance;
+  advanced_key_process(&ak_event);
+}
+
+static void press(uint8_t member, uint8_t distance) {
+  event(AK_EVENT_TYPE_PRESS, member, distance);
+}
+
+static void hold(uint8_t member, uint8_t distance) {
+  event(AK_EVENT_TYPE_HOLD, member, distance);
+}
+
+static void release(uint8_t member) { event(AK_EVENT_TYPE_RELEASE, member, 0); }
+
+/**
+ * @brief Check the registered members
+ *
+ * @param members Mask of the members that must be registered
+ * @param when Description of the check for the error message
+ *
+ * @return true if the registered members match, false otherwise
+ */
+static bool expect(uint8_t members, const char *when) {
+  bool match = !mismatch;
+
+  for (uint8_t key = 0; key < NUM_KEYS; key++) {
+    const uint8_t member = key - FIRST_KEY;
+    const bool is_member = FIRST_KEY <= key && member < SOCD_GROUP_MAX_MEMBERS;
+
+    if (is_member && ((members >> member) & 1))
+      match &= registered[key] == KC_A + member;
+    else
+      match &= registered[key] == KC_NO;
+  }
+  if (!match) {
+    fprintf(stderr, "Registered members mismatch %s\n", when);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Resolve the SOCD groups and check the registered members
+ *
+ * @param members Mask of the members that must be registered
+ * @param when Description of the check for the error message
+ *
+ * @return true if the registered members match, false otherwise
+ */
+static bool scan(uint8_t members, const char *when) {
+  advanced_key_resolve();
+
+  return expect(members, when);
+}
+
+//--------------------------------------------------------------------+
+// Scenarios
+//--------------------------------------------------------------------+
+
+/**
+ * @brief W, S, A and D split into two axes with the last behavior
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_axes(void) {
+  // Members: W, S | A, D
+  configure(4, NB_BEHAVIOR_LAST, 2, 0);
+
+  press(0, 100);
+  press(2, 100);
+  if (!scan(0b0101, "after W and A (diagonal)"))
+    return false;
+  press(1, 100);
+  if (!scan(0b0110, "after S"))
+    return false;
+  press(3, 100);
+  if (!scan(0b1010, "after D"))
+    return false;
+  release(1);
+  release(3);
+  return scan(0b0101, "after releasing S and D");
+}
+
+/**
+ * @brief Three members pressed on the same axis with each behavior
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_behaviors(void) {
+  static const struct {
+    uint8_t behavior;
+    // Registered members after the presses, and after the distance change
+    uint8_t pressed, held;
+  } cases[] = {
+      {NB_BEHAVIOR_LAST, 0b010, 0b010},
+      {NB_BEHAVIOR_PRIMARY, 0b001, 0b001},
+      {NB_BEHAVIOR_NEUTRAL, 0b000, 0b000},
+      {NB_BEHAVIOR_DISTANCE, 0b100, 0b010},
+  };
+
+  for (uint32_t i = 0; i < M_ARRAY_SIZE(cases); i++) {
+    configure(3, cases[i].behavior, 0, 0);
+
+    // Pressed in the order 0, 2, 1, with member 2 pressed the furthest
+    press(0, 100);
+    press(2, 200);
+    press(1, 50);
+    if (!scan(cases[i].pressed, "after the presses"))
+      return false;
+    hold(1, 250);
+    if (!scan(cases[i].held, "after member 1 is pressed further"))
+      return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Bottom-out point over three members on the same axis
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_bottom_out(void) {
+  configure(3, NB_BEHAVIOR_PRIMARY, 0, 200);
+
+  press(0, 250);
+  press(1, 250);
+  press(2, 100);
+  if (!scan(0b001, "with a member above the bottom-out point"))
+    return false;
+  hold(2, 220);
+  if (!scan(0b111, "with all the members bottomed out"))
+    return false;
+  hold(0, 150);
+  if (!scan(0b001, "after the first member is released partially"))
+    return false;
+  release(0);
+  return scan(0b110, "after the first member is released");
+}
+
+/**
+ * @brief Release of a registered member
+ *
+ * The member is unregistered by the release event, before the next scan
+ * registers the previously pressed member.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_release(void) {
+  configure(3, NB_BEHAVIOR_LAST, 0, 0);
+
+  press(0, 100);
+  press(1, 100);
+  press(2, 100);
+  if (!scan(0b100, "after the presses"))
+    return false;
+  release(2);
+  if (!expect(0b000, "after the release event"))
+    return false;
+  if (!scan(0b010, "after the release"))
+    return false;
+  // Releasing a member that is not registered does not change the resolution
+  release(0);
+  return scan(0b010, "after releasing the first member");
+}
+
+/**
+ * @brief Clear of the advanced keys with registered members
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_clear(void) {
+  configure(4, NB_BEHAVIOR_LAST, 2, 0);
+
+  press(0, 100);
+  press(3, 100);
+  if (!scan(0b1001, "after the presses"))
+    return false;
+  advanced_key_clear();
+  if (!expect(0b0000, "after the clear"))
+    return false;
+  // The group is not pending anymore, and the members pressed before the clear
+  // are forgotten
+  if (!scan(0b0000, "after the clear"))
+    return false;
+  release(0);
+  press(1, 100);
+  return scan(0b0010, "after a new press");
+}
+
+int main(int argc, char **argv) {
+  bool (*scenario)(void) = NULL;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <scenario>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (strcmp(argv[1], "axes") == 0)
+    scenario = scenario_axes;
+  if (strcmp(argv[1], "behaviors") == 0)
+    scenario = scenario_behaviors;
+  if (strcmp(argv[1], "bottom_out") == 0)
+    scenario = scenario_bottom_out;
+  if (strcmp(argv[1], "release") == 0)
+    scenario = scenario_release;
+  if (strcmp(argv[1], "clear") == 0)
+    scenario = scenario_clear;
+  if (scenario == NULL) {
+    fprintf(stderr, "Unknown scenario: %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  return scenario() ? EXIT_SUCCESS : EXIT_FAILURE;
+}
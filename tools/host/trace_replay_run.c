@@ -0,0 +1,168 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "advanced_keys.h"
+#include "commands.h"
+#include "crc32.h"
+#include "deferred_actions.h"
+#include "eeconfig.h"
+#include "hardware/hardware.h"
+#include "hid.h"
+#include "host.h"
+#include "idle.h"
+#include "layout.h"
+#include "matrix.h"
+#include "noise.h"
+#include "trace_replay.h"
+#include "tusb.h"
+#include "wear_leveling.h"
+#include "xinput.h"
+
+//--------------------------------------------------------------------+
+// Trace Replay
+//
+// Replays a trace of `tools/trace.py` through the scan loop of the firmware
+// with the default configuration, and prints the keycodes registered and
+// unregistered in HID reports with the time of their frame.
+//
+// The raw HID reports of an optional command file are processed once the
+// replay reaches their time, and the reports sent back are printed in
+// hexadecimal. Each line of the command file is the time in milliseconds and
+// the report in hexadecimal, zero-padded to `RAW_HID_EP_SIZE` bytes.
+//
+//   trace_replay_run <trace> [commands]
+//
+// Output lines:
+//
+//   <time> add|remove <keycode>
+//   <time> report <hex>
+//--------------------------------------------------------------------+
+
+void tud_task(void) {}
+
+bool tud_hid_n_ready(uint8_t instance) { return true; }
+
+bool tud_hid_n_report(uint8_t instance, uint8_t report_id, void const *report,
+                      uint16_t len) {
+  const uint8_t *buf = report;
+
+  printf("%" PRIu32 " report ", timer_read());
+  for (uint32_t i = 0; i < len; i++)
+    printf("%02x", buf[i]);
+  printf("\n");
+
+  return true;
+}
+
+void hid_init(void) {}
+
+void hid_keycode_add(uint8_t keycode) {
+  printf("%" PRIu32 " add %u\n", timer_read(), keycode);
+}
+
+void hid_keycode_remove(uint8_t keycode) {
+  printf("%" PRIu32 " remove %u\n", timer_read(), keycode);
+}
+
+void hid_send_reports(void) {}
+
+void xinput_init(void) {}
+
+void xinput_process(uint8_t key) {}
+
+void xinput_task(void) {}
+
+/**
+ * @brief Read the next command of the command file
+ *
+ * @param f Command file
+ * @param time Set to the time of the command
+ * @param buf Set to the raw HID report of the command
+ *
+ * @return true if a command was read, false at the end of the file
+ */
+static bool read_command(FILE *f, uint32_t *time, uint8_t *buf) {
+  char hex[2 * RAW_HID_EP_SIZE + 1];
+
+  if (f == NULL || fscanf(f, "%" SCNu32 " %128s", time, hex) != 2)
+    return false;
+
+  memset(buf, 0, RAW_HID_EP_SIZE);
+  for (uint32_t i = 0; hex[2 * i] != '\0' && hex[2 * i + 1] != '\0'; i++) {
+    unsigned int byte;
+
+    if (sscanf(&hex[2 * i], "%2x", &byte) != 1)
+      return false;
+    buf[i] = (uint8_t)byte;
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  FILE *commands = NULL;
+  uint8_t buf[RAW_HID_EP_SIZE];
+  uint32_t command_time;
+  bool has_command;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <trace> [commands]\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+  if (!trace_replay_open(argv[1])) {
+    fprintf(stderr, "Failed to open the trace %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+  if (argc > 2 && (commands = fopen(argv[2], "r")) == NULL) {
+    fprintf(stderr, "Failed to open the commands %s\n", argv[2]);
+    return EXIT_FAILURE;
+  }
+
+  crc32_init();
+  host_flash_reset();
+  wear_leveling_init();
+  eeconfig_init();
+
+  analog_init();
+  matrix_init();
+  deferred_action_init();
+  advanced_key_init();
+  layout_init();
+  command_init();
+  idle_init();
+
+  has_command = read_command(commands, &command_time, buf);
+  while (trace_replay_next_frame()) {
+    analog_task();
+    while (has_command && command_time <= timer_read()) {
+      command_process(buf);
+      has_command = read_command(commands, &command_time, buf);
+    }
+    matrix_scan();
+    noise_task();
+    layout_task();
+    command_task();
+    wear_leveling_task();
+    idle_task();
+  }
+  trace_replay_close();
+  if (commands != NULL)
+    fclose(commands);
+
+  return EXIT_SUCCESS;
+}
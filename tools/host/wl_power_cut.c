@@ -0,0 +1,219 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <setjmp.h>
+#include <stdio.h>
+
+#include "crc32.h"
+#include "host.h"
+#include "wear_leveling.h"
+
+//--------------------------------------------------------------------+
+// Wear Leveling Power Cuts
+//
+// Makes random writes to the virtual storage on the simulated flash, and cuts
+// the power during some of them, including during consolidations. After a
+// power cut, `wear_leveling_init()` is called like after a reset, and each
+// byte of the virtual storage must have its value from before or after the
+// interrupted write. A single bank may also be cleared if the power is cut
+// during a consolidation, which a double bank must never be. Prints the write
+// amplification and the wear of the flash sectors as CSV, and exits with a
+// non-zero status on data loss. The byte counts are the wear statistics of
+// the backing store, which are lost with it when a single bank is cleared.
+//
+//   wl_power_cut [steps] [seed]
+//--------------------------------------------------------------------+
+
+// Maximum length of the small writes, which make most of the steps
+#define MAX_SMALL_WRITE_LEN 32
+
+// Copy of the virtual storage
+static uint8_t expected[WL_VIRTUAL_SIZE];
+// Virtual storage read back after an initialization
+static uint8_t actual[WL_VIRTUAL_SIZE];
+
+// State to return to on a power cut
+static jmp_buf reset;
+
+// Current write, kept out of the stack frame that `longjmp()` returns to
+static struct {
+  uint32_t addr;
+  uint32_t len;
+  uint8_t buf[WL_VIRTUAL_SIZE];
+} pending;
+
+// Totals of the steps
+static uint32_t num_power_cuts, num_cleared, consolidations;
+// Number of consolidations of the wear leveling statistics before the step
+static uint32_t prev_consolidations;
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+  // xorshift32
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+static void on_power_cut(void) { longjmp(reset, 1); }
+
+/**
+ * @brief Check the virtual storage after a power cut and update the copy
+ *
+ * @return true if no data was lost, false otherwise
+ */
+static bool check_power_cut(void) {
+  bool is_empty = true;
+
+  wear_leveling_read(0, actual, sizeof(actual));
+  for (uint32_t i = 0; i < WL_VIRTUAL_SIZE && is_empty; i++)
+    is_empty = actual[i] == 0xFF;
+
+#if !defined(WL_DOUBLE_BANK)
+  if (is_empty) {
+    // Lost during a consolidation, which a single bank does not prevent
+    num_cleared++;
+    memcpy(expected, actual, sizeof(expected));
+    return true;
+  }
+#endif
+
+  for (uint32_t i = 0; i < WL_VIRTUAL_SIZE; i++) {
+    const uint32_t offset = i - pending.addr;
+
+    // Either the old value or the one of the interrupted write
+    if (actual[i] == expected[i] ||
+        (offset < pending.len && actual[i] == pending.buf[offset]))
+      continue;
+
+    fprintf(stderr,
+            "Virtual storage mismatch at %" PRIu32 " after a power cut: "
+            "0x%02X instead of 0x%02X\n",
+            i, actual[i], expected[i]);
+    return false;
+  }
+  memcpy(expected, actual, sizeof(expected));
+
+  return true;
+}
+
+/**
+ * @brief Make a random write, and cut the power during some of them
+ *
+ * @param step Index of the step
+ *
+ * @return true if no data was lost, false otherwise
+ */
+static bool run_step(uint32_t step) {
+  wl_stats_t stats;
+
+  // Mostly small writes, with a few large ones to consolidate more often
+  pending.len = rng() % 64 == 0 ? 1 + rng() % WL_VIRTUAL_SIZE
+                                : 1 + rng() % MAX_SMALL_WRITE_LEN;
+  pending.addr = rng() % (WL_VIRTUAL_SIZE - pending.len + 1);
+  for (uint32_t i = 0; i < pending.len; i++)
+    pending.buf[i] = (uint8_t)rng();
+
+  if (setjmp(reset) != 0) {
+    num_power_cuts++;
+    wear_leveling_init();
+    return check_power_cut();
+  }
+
+  if (rng() % 4 == 0)
+    host_flash_power_cut(rng() % 2 ? rng() % 16 : rng() % 4096, on_power_cut);
+  wear_leveling_get_stats(&stats);
+  prev_consolidations = stats.consolidations;
+  if (!wear_leveling_write(pending.addr, pending.buf, pending.len) ||
+      !wear_leveling_flush()) {
+    fprintf(stderr, "Write of %" PRIu32 " bytes at %" PRIu32 " failed\n",
+            pending.len, pending.addr);
+    return false;
+  }
+  // Leave time for the background consolidation
+  for (uint32_t i = rng() % 4; i > 0; i--) {
+    host_timer_advance(10);
+    wear_leveling_task();
+  }
+  host_flash_power_cut(0, NULL);
+  memcpy(expected + pending.addr, pending.buf, pending.len);
+  wear_leveling_get_stats(&stats);
+  consolidations += stats.consolidations - prev_consolidations;
+
+  if (step % 256 == 255) {
+    // Reset without a power cut
+    wear_leveling_init();
+    wear_leveling_read(0, actual, sizeof(actual));
+    if (memcmp(actual, expected, sizeof(actual)) != 0) {
+      fprintf(stderr, "Virtual storage mismatch after initialization\n");
+      return false;
+    }
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  const uint32_t num_steps =
+      argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 20000;
+  const host_flash_stats_t *flash_stats = host_flash_stats();
+  uint32_t max_erases = 0, min_erases = UINT32_MAX;
+  wl_stats_t stats;
+
+  if (argc > 2)
+    rng_state = (uint32_t)strtoul(argv[2], NULL, 0);
+  if (rng_state == 0)
+    // xorshift32 is stuck at zero
+    rng_state = 1;
+
+  crc32_init();
+  host_flash_reset();
+  wear_leveling_init();
+  wear_leveling_read(0, expected, sizeof(expected));
+
+  for (uint32_t step = 0; step < num_steps; step++)
+    if (!run_step(step))
+      return EXIT_FAILURE;
+
+  // Only the sectors of the backing store wear
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS; i++) {
+    if (flash_stats->sector_erases[i] == 0)
+      continue;
+    if (flash_stats->sector_erases[i] > max_erases)
+      max_erases = flash_stats->sector_erases[i];
+    if (flash_stats->sector_erases[i] < min_erases)
+      min_erases = flash_stats->sector_erases[i];
+  }
+  if (max_erases == 0)
+    min_erases = 0;
+
+  wear_leveling_get_stats(&stats);
+  printf("writes,power cuts,cleared,consolidations,writes/consolidation,"
+         "user bytes,flash bytes,write amplification,erases,"
+         "max sector erases,min sector erases\n");
+  printf("%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%.1f,%" PRIu64
+         ",%" PRIu64 ",%.2f,%" PRIu32 ",%" PRIu32 ",%" PRIu32 "\n",
+         num_steps, num_power_cuts, num_cleared, consolidations,
+         consolidations ? (double)num_steps / consolidations : 0.0,
+         stats.user_bytes, stats.flash_bytes,
+         stats.user_bytes ? (double)stats.flash_bytes / stats.user_bytes : 0.0,
+         flash_stats->erases, max_erases, min_erases);
+
+  return EXIT_SUCCESS;
+}
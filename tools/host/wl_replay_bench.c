@@ -0,0 +1,125 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "crc32.h"
+#include "host.h"
+#include "wear_leveling.h"
+
+//--------------------------------------------------------------------+
+// Write Log Replay Benchmark
+//
+// Fills the write log of a freshly consolidated backing store with small
+// writes up to each fill level, then measures `wear_leveling_init()`, which
+// reads the consolidated data and replays the write log in place. The replay
+// time is the initialization time minus the one of an empty write log. The
+// virtual storage is checked against a copy after each initialization.
+//
+//   wl_replay_bench [repetitions]
+//--------------------------------------------------------------------+
+
+// Copy of the virtual storage
+static uint8_t expected[WL_VIRTUAL_SIZE];
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+  // xorshift32
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+/**
+ * @brief Initialize the wear leveling module and check the virtual storage
+ *
+ * @return Time of the initialization in nanoseconds
+ */
+static uint64_t init(void) {
+  static uint8_t actual[WL_VIRTUAL_SIZE];
+  const uint64_t start = host_time_ns();
+
+  wear_leveling_init();
+
+  const uint64_t elapsed = host_time_ns() - start;
+
+  wear_leveling_read(0, actual, sizeof(actual));
+  if (memcmp(actual, expected, sizeof(actual)) != 0) {
+    fprintf(stderr, "Virtual storage mismatch after replay\n");
+    exit(EXIT_FAILURE);
+  }
+
+  return elapsed;
+}
+
+int main(int argc, char **argv) {
+  const uint32_t repetitions =
+      argc > 1 ? (uint32_t)strtoul(argv[1], NULL, 0) : 100;
+  uint64_t baseline = 0;
+
+  crc32_init();
+  printf("fill %%,log bytes,entries,init us,replay us,replay ns/entry\n");
+  for (uint32_t fill = 0; fill <= 95; fill += 5) {
+    const uint32_t target = WL_WRITE_LOG_SIZE / 100 * fill;
+    wl_stats_t stats;
+
+    host_flash_reset();
+    memset(expected, 0xFF, sizeof(expected));
+    wear_leveling_init();
+    wear_leveling_get_stats(&stats);
+
+    const uint32_t consolidations = stats.consolidations;
+    const uint32_t log_entries = stats.log_entries;
+    const uint32_t programs = host_flash_stats()->programs;
+
+    while ((host_flash_stats()->programs - programs) * 4 < target) {
+      uint8_t buf[8];
+      const uint32_t len = 1 + rng() % sizeof(buf);
+      const uint32_t addr = rng() % (WL_VIRTUAL_SIZE - len + 1);
+
+      for (uint32_t i = 0; i < len; i++)
+        buf[i] = (uint8_t)rng();
+      memcpy(expected + addr, buf, len);
+      wear_leveling_write(addr, buf, len);
+      wear_leveling_flush();
+    }
+
+    wear_leveling_get_stats(&stats);
+    if (stats.consolidations != consolidations) {
+      fprintf(stderr, "The write log was consolidated at %" PRIu32 "%%\n",
+              fill);
+      return EXIT_FAILURE;
+    }
+
+    const uint32_t entries = stats.log_entries - log_entries;
+    const uint32_t log_bytes = (host_flash_stats()->programs - programs) * 4;
+    uint64_t best = UINT64_MAX;
+    for (uint32_t i = 0; i < repetitions; i++)
+      best = M_MIN(best, init());
+    if (fill == 0)
+      baseline = best;
+
+    const uint64_t replay = best > baseline ? best - baseline : 0;
+    printf("%" PRIu32 ",%" PRIu32 ",%" PRIu32 ",%.1f,%.1f,%.1f\n", fill,
+           log_bytes, entries, (double)best / 1000, (double)replay / 1000,
+           entries ? (double)replay / entries : 0.0);
+  }
+
+  return EXIT_SUCCESS;
+}
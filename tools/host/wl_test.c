@@ -0,0 +1,384 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include "crc32.h"
+#include "hardware/hardware.h"
+#include "host.h"
+#include "wear_leveling.h"
+
+//--------------------------------------------------------------------+
+// Wear Leveling Scenarios
+//
+// Runs a scenario of the wear leveling module on the simulated flash, and
+// exits with a non-zero status if the virtual storage does not match a copy
+// of it afterwards or after `wear_leveling_init()`.
+//
+//   wl_test <scenario>
+//--------------------------------------------------------------------+
+
+// Copy of the virtual storage
+static uint8_t expected[WL_VIRTUAL_SIZE];
+
+static uint32_t rng_state = 1;
+
+static uint32_t rng(void) {
+  // xorshift32
+  rng_state ^= rng_state << 13;
+  rng_state ^= rng_state >> 17;
+  rng_state ^= rng_state << 5;
+
+  return rng_state;
+}
+
+/**
+ * @brief Check the virtual storage against the copy
+ *
+ * @param when Description of the check for the error message
+ *
+ * @return true if the virtual storage matches, false otherwise
+ */
+static bool check(const char *when) {
+  static uint8_t actual[WL_VIRTUAL_SIZE];
+
+  wear_leveling_read(0, actual, sizeof(actual));
+  if (memcmp(actual, expected, sizeof(actual)) != 0) {
+    fprintf(stderr, "Virtual storage mismatch %s\n", when);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Write random data to the virtual storage and to the copy
+ *
+ * @param addr Address to write to
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool write_random(uint32_t addr, uint32_t len) {
+  uint8_t buf[WL_VIRTUAL_SIZE];
+
+  for (uint32_t i = 0; i < len; i++)
+    buf[i] = (uint8_t)rng();
+  memcpy(expected + addr, buf, len);
+  if (!wear_leveling_write(addr, buf, len) || !wear_leveling_flush()) {
+    fprintf(stderr, "Write of %u bytes at %u failed\n", (unsigned)len,
+            (unsigned)addr);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Write to the virtual storage without committing the write
+ *
+ * Every byte is changed, so that the write is not trimmed.
+ *
+ * @param addr Address to write to
+ * @param len Length of the data in bytes
+ *
+ * @return true if successful, false otherwise
+ */
+static bool write_pending(uint32_t addr, uint32_t len) {
+  uint8_t buf[WL_VIRTUAL_SIZE];
+
+  wear_leveling_read(addr, buf, len);
+  for (uint32_t i = 0; i < len; i++)
+    buf[i] ^= 0xFF;
+  if (!wear_leveling_write(addr, buf, len)) {
+    fprintf(stderr, "Write of %u bytes at %u failed\n", (unsigned)len,
+            (unsigned)addr);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Check the number of bytes committed since a previous point
+ *
+ * @param user_bytes Committed bytes at the previous point
+ * @param expected_bytes Expected number of bytes committed since then
+ * @param when Description of the check for the error message
+ *
+ * @return true if the number of bytes matches, false otherwise
+ */
+static bool check_committed(uint64_t user_bytes, uint64_t expected_bytes,
+                            const char *when) {
+  wl_stats_t stats;
+
+  wear_leveling_get_stats(&stats);
+  if (stats.user_bytes - user_bytes != expected_bytes) {
+    fprintf(stderr, "%u bytes committed %s, expected %u\n",
+            (unsigned)(stats.user_bytes - user_bytes), when,
+            (unsigned)expected_bytes);
+    return false;
+  }
+
+  return true;
+}
+
+/**
+ * @brief Merge overlapping and adjacent pending writes
+ *
+ * Overlapping writes and writes at most `WL_DIRTY_MERGE_GAP` bytes apart are
+ * committed as one range, including the unchanged bytes between them. Writes
+ * further apart are committed separately.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_merge(void) {
+  _Static_assert(WL_DIRTY_MERGE_GAP >= 2 && WL_DIRTY_RANGES >= 3,
+                 "The scenario needs a merge gap and three ranges");
+  wl_stats_t stats;
+
+  wear_leveling_get_stats(&stats);
+  const uint32_t programs = host_flash_stats()->programs;
+
+  // Overlapping: [100, 120)
+  if (!write_pending(100, 10) || !write_pending(105, 15) ||
+      // Contained in the previous range
+      !write_pending(108, 4) ||
+      // Adjacent with a gap of 2 bytes: [200, 220)
+      !write_pending(200, 10) || !write_pending(212, 8) ||
+      // Too far apart: [300, 310) and [310 + GAP + 1, 320 + GAP + 1)
+      !write_pending(300, 10) ||
+      !write_pending(310 + WL_DIRTY_MERGE_GAP + 1, 10))
+    return false;
+  if (host_flash_stats()->programs != programs) {
+    fprintf(stderr, "The pending writes were committed before the flush\n");
+    return false;
+  }
+  if (!check_committed(stats.user_bytes, 0, "before the flush"))
+    return false;
+
+  if (!wear_leveling_flush())
+    return false;
+  wear_leveling_read(0, expected, sizeof(expected));
+
+  return check_committed(stats.user_bytes, 20 + 20 + 10 + 10,
+                         "after the flush");
+}
+
+/**
+ * @brief Write more disjoint ranges than can be pending
+ *
+ * The pending ranges are committed when a write needs another slot, and the
+ * new write stays pending.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_dirty_overflow(void) {
+  const uint32_t stride = 16 + WL_DIRTY_MERGE_GAP;
+  wl_stats_t stats;
+
+  _Static_assert((WL_DIRTY_RANGES + 1) * (16 + WL_DIRTY_MERGE_GAP) <=
+                     WL_VIRTUAL_SIZE,
+                 "The ranges must fit in the virtual storage");
+  wear_leveling_get_stats(&stats);
+
+  for (uint32_t i = 0; i < WL_DIRTY_RANGES; i++)
+    if (!write_pending(i * stride, 8))
+      return false;
+  if (!check_committed(stats.user_bytes, 0, "with all the slots used"))
+    return false;
+
+  if (!write_pending(WL_DIRTY_RANGES * stride, 8) ||
+      !check_committed(stats.user_bytes, WL_DIRTY_RANGES * 8,
+                       "after the overflowing write"))
+    return false;
+
+  if (!wear_leveling_flush())
+    return false;
+  wear_leveling_read(0, expected, sizeof(expected));
+
+  return check_committed(stats.user_bytes, (WL_DIRTY_RANGES + 1) * 8,
+                         "after the flush");
+}
+
+/**
+ * @brief Lose the pending writes on a power cut
+ *
+ * The module is initialized again without flushing, as after a reset. Only the
+ * committed writes are restored.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_power_cut(void) {
+  for (uint32_t i = 0; i < 16; i++)
+    if (!write_random(rng() % (WL_VIRTUAL_SIZE - 4), 4))
+      return false;
+
+  // The writes fit in the pending ranges
+  for (uint32_t i = 0; i < WL_DIRTY_RANGES; i++)
+    if (!write_pending(rng() % (WL_VIRTUAL_SIZE - 4), 4))
+      return false;
+  wear_leveling_init();
+
+  return check("after the power cut");
+}
+
+#if defined(WL_DOUBLE_BANK)
+/**
+ * @brief Outdate the consolidation chunks by more than the write log holds
+ *
+ * The background consolidation writes the chunks of the inactive bank, then
+ * the whole virtual storage changes. The changes are logged in the write log
+ * of the inactive bank when the consolidation is committed, which overflows
+ * unless the consolidation is started over.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_overflow(void) {
+  _Static_assert(WL_VIRTUAL_SIZE > WL_WRITE_LOG_SIZE,
+                 "The changes must not fit in the write log");
+  wl_stats_t stats;
+
+  // Fill the write log up to the consolidation threshold
+  wear_leveling_get_stats(&stats);
+  const uint64_t flash_bytes = stats.flash_bytes;
+  while (stats.flash_bytes - flash_bytes < WL_CONSOLIDATION_THRESHOLD) {
+    if (!write_random(rng() % (WL_VIRTUAL_SIZE - 4), 4))
+      return false;
+    wear_leveling_get_stats(&stats);
+  }
+
+  // Erase the inactive bank and write all the chunks in the background
+  for (uint32_t i = 0; i < FLASH_NUM_SECTORS + WL_VIRTUAL_SIZE /
+                                                   WL_CONSOLIDATION_STEP_SIZE;
+       i++)
+    wear_leveling_task();
+
+  if (!write_random(0, WL_VIRTUAL_SIZE))
+    return false;
+  wear_leveling_get_stats(&stats);
+  if (stats.consolidations == 0) {
+    fprintf(stderr, "The backing store was not consolidated\n");
+    return false;
+  }
+
+  return true;
+}
+#endif
+
+/**
+ * @brief Write an older backing store, whose write log has no wear statistics
+ *
+ * The statistics record is erased, and the write log is filled with entries
+ * up to the end of the backing store, where the record was added.
+ *
+ * @return true if successful, false otherwise
+ */
+static bool scenario_legacy(void) {
+  uint8_t *bank = NULL;
+  wl_stats_t stats;
+
+  for (uint32_t i = 0; i < 16; i++)
+    if (!write_random(rng() % (WL_VIRTUAL_SIZE - 4), 4))
+      return false;
+
+  // Only one bank was consolidated, which holds the statistics record
+  uint32_t sector = FLASH_NUM_SECTORS, reserved_size = 0;
+  for (uint32_t i = 0; i < WL_NUM_BANKS; i++) {
+    uint32_t bank_size = 0;
+
+    while (sector > 0 && bank_size < WL_BACKING_STORE_SIZE)
+      bank_size += flash_sector_size(--sector);
+    reserved_size += bank_size;
+
+    uint8_t *const record =
+        host_flash + FLASH_SIZE - reserved_size + WL_BACKING_STORE_SIZE -
+        WL_STATS_SIZE;
+    for (uint32_t j = 0; j < WL_STATS_SIZE && bank == NULL; j++)
+      if (record[j] != 0xFF)
+        bank = host_flash + FLASH_SIZE - reserved_size;
+  }
+  if (bank == NULL) {
+    fprintf(stderr, "The wear statistics were not found\n");
+    return false;
+  }
+  memset(bank + WL_BACKING_STORE_SIZE - WL_STATS_SIZE, 0xFF, WL_STATS_SIZE);
+
+  // Append to the write log after its last entry
+  uint32_t addr = WL_BACKING_STORE_SIZE - WL_STATS_SIZE;
+  while (bank[addr - 1] == 0xFF)
+    addr--;
+  addr = (addr + 3) & ~3u;
+  while (addr < WL_BACKING_STORE_SIZE) {
+    // Entries of 5 bytes, whose second word is never empty, or of 1 byte
+    const uint32_t len = WL_BACKING_STORE_SIZE - addr >= 8 ? 5 : 1;
+    wl_log_entry_t entry = {0};
+
+    entry.fields.addr = rng() % (WL_VIRTUAL_SIZE - len);
+    entry.fields.len = len;
+    for (uint32_t i = 0; i < len; i++)
+      entry.fields.data[i] = (uint8_t)rng();
+    memcpy(expected + entry.fields.addr, entry.fields.data, len);
+    memcpy(bank + addr, &entry, len > 2 ? 8 : 4);
+    addr += len > 2 ? 8 : 4;
+  }
+
+  wear_leveling_init();
+  if (!check("after replaying the write log"))
+    return false;
+  wear_leveling_get_stats(&stats);
+  if (stats.consolidations != 1) {
+    fprintf(stderr, "The backing store was not consolidated\n");
+    return false;
+  }
+
+  return true;
+}
+
+int main(int argc, char **argv) {
+  bool (*scenario)(void) = NULL;
+
+  if (argc < 2) {
+    fprintf(stderr, "usage: %s <scenario>\n", argv[0]);
+    return EXIT_FAILURE;
+  }
+#if defined(WL_DOUBLE_BANK)
+  if (strcmp(argv[1], "overflow") == 0)
+    scenario = scenario_overflow;
+#endif
+  if (strcmp(argv[1], "legacy") == 0)
+    scenario = scenario_legacy;
+  if (strcmp(argv[1], "merge") == 0)
+    scenario = scenario_merge;
+  if (strcmp(argv[1], "dirty_overflow") == 0)
+    scenario = scenario_dirty_overflow;
+  if (strcmp(argv[1], "power_cut") == 0)
+    scenario = scenario_power_cut;
+  if (scenario == NULL) {
+    fprintf(stderr, "Unknown scenario: %s\n", argv[1]);
+    return EXIT_FAILURE;
+  }
+
+  crc32_init();
+  host_flash_reset();
+  memset(expected, 0xFF, sizeof(expected));
+  wear_leveling_init();
+
+  if (!scenario() || !check("after the scenario"))
+    return EXIT_FAILURE;
+  wear_leveling_init();
+
+  return check("after initialization") ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,150 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Encoder and decoder for the profile blobs of `COMMAND_EXPORT_PROFILE` and
+# `COMMAND_IMPORT_PROFILE`. See `include/lib/compress.h` for the format.
+
+from pathlib import Path
+import argparse
+import struct
+import zlib
+
+MIN_MATCH = 3
+MAX_MATCH = 0x7F + MIN_MATCH
+MAX_LITERAL = 128
+WINDOW_SIZE = 256
+
+HEADER = struct.Struct("<HI")
+
+
+def crc32_software(data: bytes) -> int:
+    # The firmware zero-pads the data to a multiple of 4 bytes
+    data = data + bytes(-len(data) % 4)
+    return zlib.crc32(data)
+
+
+def crc32_hardware(data: bytes) -> int:
+    # The STM32 and AT32 CRC units process little-endian words MSB-first,
+    # starting from 0xFFFFFFFF and feeding the initial value 0 first
+    data = data + bytes(-len(data) % 4)
+    crc = 0xFFFFFFFF
+    for word in [0] + [w for (w,) in struct.iter_unpack("<I", data)]:
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else crc << 1
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+CRC32 = {"software": crc32_software, "hardware": crc32_hardware}
+
+
+def compress(src: bytes) -> bytes:
+    dst = bytearray()
+    literal_start = i = 0
+
+    def emit_literals(literals: bytes):
+        for j in range(0, len(literals), MAX_LITERAL):
+            chunk = literals[j : j + MAX_LITERAL]
+            dst.append(len(chunk) - 1)
+            dst.extend(chunk)
+
+    while i < len(src):
+        max_len = min(len(src) - i, MAX_MATCH)
+        best_len = best_dist = 0
+        for dist in range(1, min(i, WINDOW_SIZE) + 1):
+            if best_len >= max_len:
+                break
+            n = 0
+            while n < max_len and src[i + n] == src[i + n - dist]:
+                n += 1
+            if n > best_len:
+                best_len, best_dist = n, dist
+
+        if best_len < MIN_MATCH:
+            i += 1
+            continue
+
+        emit_literals(src[literal_start:i])
+        dst.append(0x80 | (best_len - MIN_MATCH))
+        dst.append(best_dist - 1)
+        i += best_len
+        literal_start = i
+
+    emit_literals(src[literal_start:])
+    return bytes(dst)
+
+
+def decompress(src: bytes) -> bytes:
+    dst = bytearray()
+    i = 0
+
+    while i < len(src):
+        token = src[i]
+        i += 1
+        if token < 0x80:
+            n = token + 1
+            if i + n > len(src):
+                raise ValueError("Truncated literal run")
+            dst.extend(src[i : i + n])
+            i += n
+        else:
+            if i >= len(src):
+                raise ValueError("Truncated copy")
+            n = (token & 0x7F) + MIN_MATCH
+            dist = src[i] + 1
+            i += 1
+            if dist > len(dst):
+                raise ValueError("Copy distance out of range")
+            for _ in range(n):
+                dst.append(dst[-dist])
+
+    return bytes(dst)
+
+
+def encode(profile: bytes, crc: str) -> bytes:
+    payload = compress(profile)
+    return HEADER.pack(len(payload), CRC32[crc](profile)) + payload
+
+
+def decode(blob: bytes, crc: str) -> bytes:
+    length, expected_crc = HEADER.unpack_from(blob)
+    if len(blob) != HEADER.size + length:
+        raise ValueError("Invalid blob length")
+    profile = decompress(blob[HEADER.size :])
+    if CRC32[crc](profile) != expected_crc:
+        raise ValueError("CRC mismatch")
+    return profile
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    parser.add_argument("mode", choices=["encode", "decode"])
+    parser.add_argument("input", type=Path, help="Input file")
+    parser.add_argument("output", type=Path, help="Output file")
+    parser.add_argument(
+        "--crc",
+        choices=CRC32.keys(),
+        default="software",
+        help="CRC32 implementation of the target firmware",
+    )
+    args = parser.parse_args()
+
+    data = args.input.read_bytes()
+    if args.mode == "encode":
+        out = encode(data, args.crc)
+    else:
+        out = decode(data, args.crc)
+    args.output.write_bytes(out)
+    print(f"{len(data)} bytes -> {len(out)} bytes")
@@ -0,0 +1,104 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of the SOCD group advanced keys of `src/advanced_keys.c`, and of
+# their validation by the raw HID commands.
+
+from pathlib import Path
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parent))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+from test_trace_replay import SAMPLES, run
+
+COMMAND_GET_ADVANCED_KEYS = 132
+COMMAND_SET_ADVANCED_KEYS = 133
+COMMAND_UNKNOWN = 255
+
+AK_TYPE_SOCD_GROUP = 5
+
+NB_BEHAVIOR_LAST = 0
+NB_BEHAVIOR_SECONDARY = 2
+NB_BEHAVIOR_DISTANCE = 4
+
+
+def socd_group(keys: list[int], behavior: int, split: int = 0) -> bytes:
+    members = keys[1:] + [255] * (8 - len(keys))
+    return bytes([0, keys[0], AK_TYPE_SOCD_GROUP, *members, behavior | split << 4, 0])
+
+
+class SocdGroupTest(unittest.TestCase):
+    def run_scenario(self, scenario: str):
+        exe = build.build("socd_test", "he60", sanitize=True)
+        result = subprocess.run([str(exe), scenario], capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+
+    def test_axes(self):
+        self.run_scenario("axes")
+
+    def test_behaviors(self):
+        self.run_scenario("behaviors")
+
+    def test_bottom_out(self):
+        self.run_scenario("bottom_out")
+
+    def test_release(self):
+        self.run_scenario("release")
+
+    def test_clear(self):
+        self.run_scenario("clear")
+
+    def test_validation(self):
+        valid = socd_group([10, 11, 12, 13], NB_BEHAVIOR_LAST, 2)
+        groups = [
+            (valid, True),
+            # The primary key is also a member
+            (socd_group([10, 11, 10], NB_BEHAVIOR_LAST), False),
+            (socd_group([10, 11, 12, 11], NB_BEHAVIOR_LAST), False),
+            (socd_group([10, 11], NB_BEHAVIOR_SECONDARY), False),
+            (socd_group([10, 11], NB_BEHAVIOR_DISTANCE + 1), False),
+            (socd_group([10, 11], NB_BEHAVIOR_DISTANCE), True),
+        ]
+        commands = []
+        for i, (group, _) in enumerate(groups):
+            commands.append(
+                (100 + i * 10, bytes([COMMAND_SET_ADVANCED_KEYS, 0, 0, 1]) + group)
+            )
+            commands.append((105 + i * 10, bytes([COMMAND_GET_ADVANCED_KEYS, 0, 0, 1])))
+        reports = [
+            bytes.fromhex(data)
+            for _, event, data in run("he60", SAMPLES / "he60.trace", commands)
+            if event == "report"
+        ]
+        self.assertEqual(len(reports), len(commands))
+
+        # A rejected group leaves the previous one in the profile
+        stored = bytes(12)
+        for i, (group, accepted) in enumerate(groups):
+            with self.subTest(group=group.hex()):
+                reply, get_reply = reports[2 * i : 2 * i + 2]
+                if accepted:
+                    self.assertEqual(reply[0], COMMAND_SET_ADVANCED_KEYS)
+                    stored = group
+                else:
+                    self.assertEqual(reply[0], COMMAND_UNKNOWN)
+                self.assertEqual(get_reply[0], COMMAND_GET_ADVANCED_KEYS)
+                self.assertEqual(get_reply[1:13], stored)
+
+
+if __name__ == "__main__":
+    unittest.main()
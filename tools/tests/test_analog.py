@@ -0,0 +1,169 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of the analog driver of the STM32F4 on a model of its ADCs, see
+# `tools/host/hal/adc_unit.c`: the simultaneous conversions, the multiplexer
+# sweeps, the DMA frames and the single sweeps of the low-power scan mode.
+
+from pathlib import Path
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+sys.path.append(str(Path(__file__).resolve().parent))
+import build
+from schema.keyboard import Keyboard, KeyboardAnalogRaw
+from test_make import ADC, get_make_defines, load_keyboard
+
+KEYBOARD = "he60"
+TARGET = "analog_check_stm32f446xx"
+ADC_MAX_VALUE = (1 << 12) - 1
+
+# Number of sweeps of the conversion loop before it is stopped
+NUM_SWEEPS = 3
+
+
+def signal(sequence: int, channel: int, mux_channel: int) -> int:
+    # Value converted on an ADC channel, see `tools/host/analog_check.c`
+    x = ((sequence * 16 + channel) * 16 + mux_channel) * 2654435761
+    return ((x & 0xFFFFFFFF) >> 20) & ADC_MAX_VALUE
+
+
+def get_inputs(kb_json: Keyboard) -> tuple[int, list, list]:
+    """Get the inputs of a keyboard configuration.
+
+    Returns the number of multiplexer channels, the ADC channel, multiplexer
+    channel and key of the multiplexer inputs, and the ADC channel and key of
+    the raw inputs. Keys are 1-based, 0 meaning not connected.
+    """
+    mux, raw = kb_json.analog.mux, kb_json.analog.raw
+    num_mux_channels = 1
+    mux_keys = []
+    if mux is not None:
+        num_mux_channels = 1 << len(mux.select)
+        for channel, row in zip(ADC.to_adc_inputs(mux.input), mux.matrix):
+            mux_keys += [(channel, c, key) for c, key in enumerate(row) if key]
+    raw_keys = []
+    if raw is not None:
+        raw_keys = [
+            (channel, key)
+            for channel, key in zip(ADC.to_adc_inputs(raw.input), raw.vector)
+            if key
+        ]
+    return num_mux_channels, mux_keys, raw_keys
+
+
+def build_check(name: str, kb_json: Keyboard) -> Path:
+    defines = {
+        k: v for k, v in get_make_defines(KEYBOARD, kb_json).items() if "ADC" in k
+    }
+    # The host builds default to a raw input for each key
+    defines.setdefault("ADC_NUM_RAW_INPUTS", 0)
+    output = build.BUILD / KEYBOARD / f"analog_check-{name}"
+    return build.build(TARGET, KEYBOARD, True, defines, output, [])
+
+
+def run(exe: Path) -> tuple[dict, list]:
+    result = subprocess.run([str(exe), str(NUM_SWEEPS)], capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(result.stderr)
+
+    # ADC values of the keys after each number of completed sequences, and
+    # number of completed sequences when the conversion loop stopped
+    values, stops = {}, []
+    for line in result.stdout.splitlines():
+        if line.startswith("stopped"):
+            stops.append(int(line.split()[1]))
+        else:
+            n, *adc_values = map(int, line.split())
+            values[n] = adc_values
+    return values, stops
+
+
+class AnalogTest(unittest.TestCase):
+    def check(self, name: str, kb_json: Keyboard):
+        num_mux_channels, mux_keys, raw_keys = get_inputs(kb_json)
+        dma_frame = kb_json.analog.dma_frame and kb_json.analog.mux is not None
+        values, stops = run(build_check(name, kb_json))
+
+        # `analog_init()` returns after the first sweep, the conversion loop
+        # stops at the end of the sweep in progress, and then after each of the
+        # 2 single sweeps
+        m = num_mux_channels
+        self.assertEqual(min(values), m)
+        self.assertEqual(stops, [(NUM_SWEEPS + i) * m for i in (2, 3, 4)])
+        self.assertEqual(list(values), list(range(m, (NUM_SWEEPS + 5) * m + 1)))
+
+        # Reference model of the ADC values of the keys
+        expected = [0] * kb_json.keyboard.num_keys
+        for s in range(max(values)):
+            c = s % m
+            if not dma_frame:
+                for channel, mux_channel, key in mux_keys:
+                    if mux_channel == c:
+                        expected[key - 1] = signal(s, channel, c)
+                for channel, key in raw_keys:
+                    expected[key - 1] = signal(s, channel, c)
+            elif c == m - 1:
+                # The frame is stored when the last multiplexer channel is
+                # converted, and the raw inputs of this channel are kept
+                for channel, mux_channel, key in mux_keys:
+                    expected[key - 1] = signal(
+                        s - c + mux_channel, channel, mux_channel
+                    )
+                for channel, key in raw_keys:
+                    expected[key - 1] = signal(s, channel, c)
+            if s + 1 in values:
+                self.assertEqual(values[s + 1], expected, f"sequence {s}")
+
+    def test_mux(self):
+        for num_adcs in (1, 2, 3):
+            for dma_frame in (False, True):
+                with self.subTest(num_adcs=num_adcs, dma_frame=dma_frame):
+                    kb_json = load_keyboard(KEYBOARD)
+                    kb_json.analog.simultaneous_adcs = num_adcs
+                    kb_json.analog.dma_frame = dma_frame
+                    self.check(f"mux-{num_adcs}-{int(dma_frame)}", kb_json)
+
+    def test_mux_and_raw(self):
+        # B0 is converted without multiplexer, for 3 of the keys of its
+        # multiplexer, and B1 and C0 are padded with other raw inputs
+        kb_json = load_keyboard(KEYBOARD)
+        mux = kb_json.analog.mux
+        keys = [key for key in mux.matrix[-1] if key][:3]
+        mux.input, mux.matrix = mux.input[:-1], mux.matrix[:-1]
+        kb_json.analog.raw = KeyboardAnalogRaw(input=["B0", "B1", "C0"], vector=keys)
+        kb_json.analog.simultaneous_adcs = 3
+        for dma_frame in (False, True):
+            with self.subTest(dma_frame=dma_frame):
+                kb_json.analog.dma_frame = dma_frame
+                self.check(f"mux-raw-{int(dma_frame)}", kb_json)
+
+    def test_raw(self):
+        # Every ADC channel is converted without multiplexer, which pads the
+        # conversion sequences of the simultaneous ADCs
+        for num_adcs in (1, 3):
+            with self.subTest(num_adcs=num_adcs):
+                kb_json = load_keyboard(KEYBOARD)
+                kb_json.analog.mux = None
+                kb_json.analog.raw = KeyboardAnalogRaw(
+                    input=ADC.input_pins, vector=list(range(1, 17))
+                )
+                kb_json.analog.simultaneous_adcs = num_adcs
+                self.check(f"raw-{num_adcs}", kb_json)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,170 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Replay of synthetic ADC traces through the scan loop, to test the background
+# calibration and the drift correction of `src/matrix.c`.
+
+from pathlib import Path
+import struct
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parent))
+from test_noise import (
+    COMMAND_ANALOG_STREAM,
+    COMMAND_GET_NOISE_STATS,
+    COMMAND_NOISE_DIAGNOSTICS,
+    COMMAND_SET_ACTUATION_MAP,
+    NOISE_STATS_PER_REPORT,
+    NUM_KEYS,
+    REST_VALUE,
+    get_noise_stats,
+    replay,
+)
+from test_trace_replay import ANALOG_STREAM_ENTRY
+
+COMMAND_RECALIBRATE = 4
+
+# Defaults of `matrix.h`
+MATRIX_CALIBRATION_DURATION = 500
+MATRIX_DRIFT_INTERVAL = 1000
+
+
+# Keycode of the keys 1 to 9 of the HE60, i.e. `KC_1` to `KC_9`
+def keycode(key: int) -> int:
+    return 0x1B + key
+
+
+def stream_command(keys: list[int]) -> bytes:
+    bitmap = bytearray(9)
+    for key in keys:
+        bitmap[key // 8] |= 1 << key % 8
+    return bytes([COMMAND_ANALOG_STREAM, 1, 0]) + bitmap
+
+
+class CalibrationTest(unittest.TestCase):
+    def test_recalibrate(self):
+        # The fourth key is held down across the recalibration, and the fifth
+        # key is pressed during and after it
+        held_key, key = 4, 5
+        start = 1000
+        values = []
+        for time in range(1, 3001):
+            frame = [REST_VALUE] * NUM_KEYS
+            if 700 <= time <= 2500:
+                frame[held_key] += 600
+            if 1100 <= time <= 1300 or 2000 <= time <= 2200:
+                frame[key] += 600
+            values.append(frame)
+
+        events, reports = replay(
+            values,
+            [
+                (600, stream_command([held_key, key])),
+                (start, bytes([COMMAND_RECALIBRATE])),
+            ],
+        )
+        end = start + MATRIX_CALIBRATION_DURATION
+
+        # The held key is released by the recalibration, and pressed again
+        # once it completes. The key pressed during the recalibration is only
+        # reported once it completes.
+        held_events = [(t, e) for t, e, kc in events if kc == keycode(held_key)]
+        self.assertEqual(
+            [e for _, e in held_events], ["add", "remove", "add", "remove"]
+        )
+        self.assertLess(held_events[0][0], start)
+        self.assertEqual(held_events[1][0], start)
+        self.assertGreater(held_events[2][0], end)
+        key_events = [(t, e) for t, e, kc in events if kc == keycode(key)]
+        self.assertEqual([e for _, e in key_events], ["add", "remove"])
+        self.assertGreaterEqual(key_events[0][0], 2000)
+
+        # The scan loop keeps running during the recalibration: the analog
+        # stream follows the filtered ADC value of the pressed key, at zero
+        # distance
+        entries = []
+        for time, report in reports:
+            if report[0] != COMMAND_ANALOG_STREAM or not start < time < end:
+                continue
+            for i in range(report[2]):
+                entries.append(
+                    (time, *ANALOG_STREAM_ENTRY.unpack_from(report, 4 + i * 4))
+                )
+        pressed = [
+            (time, adc_value, distance)
+            for time, k, adc_value, distance in entries
+            if k == key
+        ]
+        self.assertGreater(len(pressed), 100)
+        self.assertGreater(
+            max(adc_value for _, adc_value, _ in pressed), REST_VALUE + 500
+        )
+        self.assertTrue(all(distance == 0 for _, _, distance in pressed))
+        times = sorted({time for time, *_ in pressed})
+        self.assertLess(times[0], 1110)
+        self.assertGreater(times[-1], 1300)
+
+    def test_drift(self):
+        # The first three keys are held slightly down, within the drift
+        # threshold of their rest value once filtered: the filtered ADC value
+        # settles 15 counts below a rising ADC value since the filter rounds
+        # down, and on a falling one. The first key is released, the second key
+        # is pressed, and the third key is released by Rapid Trigger after being
+        # pressed further.
+        offset = 40
+        values = []
+        for time in range(1, 14001):
+            frame = [REST_VALUE] * NUM_KEYS
+            if time >= 1000:
+                frame[1] += offset
+                frame[2] += offset
+                frame[3] += 100 if time < 1100 else 25
+            values.append(frame)
+
+        measurement_start, duration, read_time = 2000, 10000, 13000
+        commands = [
+            # Actuation point of 1/255, without and with Rapid Trigger
+            (600, bytes([COMMAND_SET_ACTUATION_MAP, 0, 2, 2, 1, 0, 0, 0, 1, 1, 1, 0])),
+            # The noise statistics report the change of the rest values
+            (
+                measurement_start,
+                bytes([COMMAND_NOISE_DIAGNOSTICS, *struct.pack("<H", duration), 0]),
+            ),
+        ]
+        for i in range(0, 4, NOISE_STATS_PER_REPORT):
+            commands.append((read_time, bytes([COMMAND_GET_NOISE_STATS, i])))
+        events, reports = replay(values, commands)
+        stats = get_noise_stats([report for _, report in reports])
+
+        self.assertEqual(
+            [(e, kc) for _, e, kc in events],
+            [("add", keycode(2)), ("add", keycode(3)), ("remove", keycode(3))],
+        )
+        rest_drift = [stats[key][4] for key in range(4)]
+
+        # The released key is corrected by one ADC count per interval, up to
+        # the time of the statistics
+        self.assertEqual(rest_drift[0], 0)
+        self.assertEqual(
+            rest_drift[1], (read_time - measurement_start) // MATRIX_DRIFT_INTERVAL
+        )
+        # The rest values of the pressed key, and of the key released by Rapid
+        # Trigger, are never moved
+        self.assertEqual(rest_drift[2], 0)
+        self.assertEqual(rest_drift[3], 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
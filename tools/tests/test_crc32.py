@@ -0,0 +1,113 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+
+# Cross-check of the default CRC32 implementation against zlib, and of the
+# CRC32 drivers on the modeled CRC unit against the CRC-32/MPEG-2 reference.
+
+from pathlib import Path
+import struct
+import subprocess
+import sys
+import unittest
+import zlib
+
+sys.path.append(str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import profile_blob
+
+# Same test data as `tools/host/crc32_check.c`
+DATA = bytes((i * 167 + 13) & 0xFF for i in range(8192 + 4))
+
+
+def crc32_software(data: bytes, crc: int) -> int:
+    # The default implementation zero-pads the data to a multiple of 4 bytes
+    return zlib.crc32(data + bytes(-len(data) % 4), crc)
+
+
+def crc32_hardware(data: bytes, crc: int) -> int:
+    # The CRC unit is reset to 0xFFFFFFFF and fed the initial value first, then
+    # the zero-padded little-endian words MSB-first
+    data = data + bytes(-len(data) % 4)
+    words = [crc] + [w for (w,) in struct.iter_unpack("<I", data)]
+    crc = 0xFFFFFFFF
+    for word in words:
+        crc ^= word
+        for _ in range(32):
+            crc = ((crc << 1) ^ 0x04C11DB7) if crc & 0x80000000 else crc << 1
+            crc &= 0xFFFFFFFF
+    return crc
+
+
+class Crc32Test(unittest.TestCase):
+    def check(self, exe: Path, reference):
+        result = subprocess.run([str(exe), "check"], capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        lines = result.stdout.splitlines()
+        # Every length up to 64 bytes at every alignment with 2 initial values
+        # through both APIs, and the 8 KiB buffers
+        self.assertEqual(len(lines), 2 * 4 * 65 * 2 + 3)
+
+        for line in lines:
+            mode, offset, length, init, crc = line.split()
+            offset, length = int(offset), int(length)
+            init, crc = int(init, 16), int(crc, 16)
+            with self.subTest(line):
+                data = DATA[offset : offset + length]
+                if mode == "chain":
+                    expected = init
+                    for i in range(0, length, 256):
+                        expected = reference(data[i : i + 256], expected)
+                else:
+                    expected = reference(data, init)
+                self.assertEqual(crc, expected)
+
+    def test_default(self):
+        for slices in (0, 1, 4, 8):
+            with self.subTest(slices=slices):
+                exe = build.build(
+                    "crc32_check",
+                    sanitize=True,
+                    defines={"CRC32_SLICES": slices},
+                    output=build.BUILD / "he60" / f"crc32_check_{slices}",
+                )
+                self.check(exe, crc32_software)
+
+    def test_drivers(self):
+        for driver in build.DRIVERS:
+            with self.subTest(driver):
+                exe = build.build(f"crc32_check_{driver}", sanitize=True)
+                self.check(exe, crc32_hardware)
+
+    def test_profile_blob(self):
+        # The profile blob CRC32 of the drivers has an initial value of 0
+        for length in (0, 1, 5, 1198):
+            data = DATA[:length]
+            self.assertEqual(profile_blob.crc32_hardware(data), crc32_hardware(data, 0))
+            self.assertEqual(profile_blob.crc32_software(data), crc32_software(data, 0))
+
+    def test_bench(self):
+        for target in ("crc32_check", *(f"crc32_check_{d}" for d in build.DRIVERS)):
+            with self.subTest(target):
+                exe = build.build(target)
+                result = subprocess.run(
+                    [str(exe), "bench", "1"], capture_output=True, text=True
+                )
+                self.assertEqual(result.returncode, 0, result.stderr)
+                self.assertIn("MiB/s", result.stdout)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,234 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of the compact profiles of `src/eeconfig.c`, and of their migration
+# from the previous versions.
+
+import json
+from pathlib import Path
+import random
+import struct
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import profile_blob
+
+MAGIC_START = 0x0A42494C
+MAGIC_END = 0x0A4B4D48
+LATEST_VERSION = 0x0108
+
+# `auto_tune_enabled`, cleared by the v1.8 migration
+AUTO_TUNE_ENABLED = 1 << 3
+
+
+def compact_defines(keyboard: str, num_profiles: int) -> dict[str, object]:
+    kb_json = json.loads(
+        (build.ROOT / "keyboards" / keyboard / "keyboard.json").read_text()
+    )
+    keymap = (kb_json.get("keymaps") or [kb_json["keymap"]])[0]
+    return {
+        "EECONFIG_COMPACT_PROFILES": None,
+        "NUM_PROFILES": num_profiles,
+        "DEFAULT_KEYMAPS": build.to_c_array([keymap] * num_profiles),
+    }
+
+
+# Keyboard and definitions of each tested configuration. The first one is the
+# 67-key, 4-layer board with 8 profiles in the same 8 KiB of virtual storage.
+# The second one has slots smaller than a random profile.
+CONFIGS = {
+    "he60-8-profiles": ("he60", compact_defines("he60", 8)),
+    "he16": (
+        "he16",
+        {**compact_defines("he16", 4), "EECONFIG_PROFILE_DELTA_SIZE": 512},
+    ),
+}
+
+
+def build_config(target: str, config: str) -> Path:
+    keyboard, defines = CONFIGS[config]
+    output = build.BUILD / keyboard / f"{target}-compact-{config}"
+    return build.build(target, keyboard, True, defines, output)
+
+
+class ScenarioTest(unittest.TestCase):
+    def run_scenario(self, scenario: str) -> dict[str, dict[str, int]]:
+        sizes = {}
+        for config in CONFIGS:
+            with self.subTest(config):
+                exe = build_config("eeconfig_test", config)
+                result = subprocess.run(
+                    [str(exe), scenario], capture_output=True, text=True
+                )
+                self.assertEqual(result.returncode, 0, result.stderr)
+                sizes[config] = {
+                    key: int(value)
+                    for key, value in (
+                        line.split(": ") for line in result.stdout.splitlines()
+                    )
+                }
+        return sizes
+
+    def test_round_trip(self):
+        self.run_scenario("round_trip")
+
+    def test_overflow(self):
+        self.run_scenario("overflow")
+
+    def test_malformed(self):
+        self.run_scenario("malformed")
+
+    def test_budget(self):
+        sizes = self.run_scenario("budget")["he60-8-profiles"]
+        self.assertEqual(len(sizes), 1 + 8)
+        for p in range(8):
+            # Every profile is customized
+            self.assertGreater(sizes[f"profile {p}"], 300)
+            self.assertLessEqual(sizes[f"profile {p}"] + 2, sizes["slot size"])
+
+
+class MigrationTest(unittest.TestCase):
+    def layout(self, defines: dict[str, object], version: int) -> tuple[int, int]:
+        num_keys = defines["NUM_KEYS"]
+        global_size = 14 + num_keys * 2
+        if version >= 0x0105:
+            # Switch models
+            global_size += num_keys
+        if version >= 0x0107:
+            # Calibration epsilon
+            global_size += num_keys
+        profile_size = (
+            defines["NUM_LAYERS"] * num_keys
+            + num_keys * 4
+            + defines["NUM_ADVANCED_KEYS"] * 12
+            + num_keys
+            + 9
+            + 1
+        )
+        if version >= 0x0106:
+            # Fine actuation map
+            profile_size += num_keys * 3
+        return global_size, profile_size
+
+    def slot_size(self, defines: dict[str, object], global_size: int) -> int:
+        return (
+            defines.get("EECONFIG_PROFILE_DELTA_SIZE")
+            or (defines["WL_VIRTUAL_SIZE"] - global_size - 4) // defines["NUM_PROFILES"]
+        )
+
+    def run_image(self, config: str, image: bytes) -> bytes:
+        exe = build_config("migration_test", config)
+        result = subprocess.run([str(exe)], input=image, capture_output=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        return result.stdout
+
+    def migrate(self, config: str, version: int, seed: int):
+        keyboard, extra_defines = CONFIGS[config]
+        defines = {**build.get_defines(keyboard), **extra_defines}
+        num_profiles = defines["NUM_PROFILES"]
+        num_layers = defines["NUM_LAYERS"]
+        num_keys = defines["NUM_KEYS"]
+        rng = random.Random(seed)
+
+        def rand(n: int) -> bytes:
+            return bytes(rng.randrange(256) for _ in range(n))
+
+        # The default profiles of the latest version, from a reset configuration
+        latest_global_size, latest_profile_size = self.layout(defines, LATEST_VERSION)
+        reset = self.run_image(config, b"")
+        defaults = [
+            reset[latest_global_size + p * latest_profile_size :][:latest_profile_size]
+            for p in range(num_profiles)
+        ]
+
+        global_size, profile_size = self.layout(defines, version)
+        calibration = rand(4)
+        bottom_out_threshold = rand(num_keys * 2)
+        options = rng.randrange(1 << 16)
+        current_profile = rng.randrange(num_profiles)
+        switch_models = rand(num_keys) if version >= 0x0105 else bytes(num_keys)
+        calibration_epsilon = rand(num_keys) if version >= 0x0107 else bytes(num_keys)
+        image = struct.pack("<IH4s", MAGIC_START, version, calibration)
+        image += bottom_out_threshold
+        image += struct.pack("<HBB", options, current_profile, 0)
+        if version >= 0x0105:
+            image += switch_models
+        if version >= 0x0107:
+            image += calibration_epsilon
+        self.assertEqual(len(image), global_size)
+
+        slot_size = self.slot_size(defines, global_size)
+        profiles = []
+        for default in defaults:
+            profile = bytearray(default)
+            # Remap a layer and change the actuation map
+            layer = rng.randrange(num_layers)
+            profile[layer * num_keys : (layer + 1) * num_keys] = rand(num_keys)
+            actuation_map = num_layers * num_keys
+            profile[actuation_map : actuation_map + num_keys * 4] = rand(num_keys * 4)
+            profiles.append(bytes(profile))
+
+            if version < 0x0106:
+                # Remove the fine actuation map
+                fine_map = actuation_map + num_keys * 4
+                profile = profile[:fine_map] + profile[fine_map + num_keys * 3 :]
+                default = default[:fine_map] + default[fine_map + num_keys * 3 :]
+            self.assertEqual(len(profile), profile_size)
+            delta = profile_blob.compress(
+                bytes(a ^ b for a, b in zip(profile, default))
+            )
+            slot = struct.pack("<H", len(delta)) + delta
+            self.assertLessEqual(len(slot), slot_size)
+            image += slot + bytes(slot_size - len(slot))
+        image += struct.pack("<I", MAGIC_END)
+
+        config_bytes = self.run_image(config, image)
+
+        expected = struct.pack("<IH4s", MAGIC_START, LATEST_VERSION, calibration)
+        expected += bottom_out_threshold
+        expected += struct.pack(
+            "<HBB", options & ~AUTO_TUNE_ENABLED, current_profile, 0
+        )
+        expected += switch_models + calibration_epsilon
+        expected += b"".join(profiles)
+        expected += struct.pack("<I", MAGIC_END)
+        self.assertEqual(config_bytes, expected)
+
+    def test_versions(self):
+        for config in CONFIGS:
+            for version in range(0x0104, LATEST_VERSION):
+                with self.subTest(config=config, version=hex(version)):
+                    self.migrate(config, version, version)
+
+    def test_malformed(self):
+        # A malformed delta resets the configuration
+        keyboard, extra_defines = CONFIGS["he16"]
+        defines = {**build.get_defines(keyboard), **extra_defines}
+        global_size, _ = self.layout(defines, 0x0107)
+        slot_size = self.slot_size(defines, global_size)
+        image = struct.pack("<IH", MAGIC_START, 0x0107)
+        image += bytes(global_size - len(image))
+        image += struct.pack("<H", 0xFFFF) + bytes(slot_size - 2)
+        image += bytes(slot_size * (defines["NUM_PROFILES"] - 1))
+        image += struct.pack("<I", MAGIC_END)
+        reset = self.run_image("he16", b"")
+        self.assertEqual(self.run_image("he16", image), reset)
+
+
+if __name__ == "__main__":
+    unittest.main()
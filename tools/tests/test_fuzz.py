@@ -0,0 +1,68 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+
+# Short run of the raw HID command fuzz target over its seed corpus, with and
+# without compact profiles.
+
+from pathlib import Path
+import subprocess
+import sys
+import tempfile
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "fuzz"))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import fuzz
+
+CONFIGS = {
+    "default": ("he60", {}),
+    "compact": ("he16", {"EECONFIG_COMPACT_PROFILES": None}),
+    "double_bank": ("he60", {"WL_DOUBLE_BANK": None}),
+}
+
+
+class FuzzTest(unittest.TestCase):
+    def test_seed_corpus(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            fuzz.seed_corpus(Path(tmp))
+            names = {p.name for p in Path(tmp).iterdir()}
+        for name in fuzz.get_command_ids():
+            self.assertIn(name.removeprefix("COMMAND_").lower(), names)
+
+    def test_fuzz(self):
+        with tempfile.TemporaryDirectory() as tmp:
+            corpus = Path(tmp) / "corpus"
+            fuzz.seed_corpus(corpus)
+            for name, (keyboard, defines) in CONFIGS.items():
+                with self.subTest(name):
+                    exe = build.build(
+                        "fuzz_commands",
+                        keyboard,
+                        sanitize=True,
+                        defines=defines,
+                        output=build.BUILD / keyboard / f"fuzz_commands_{name}",
+                    )
+                    result = subprocess.run(
+                        [str(exe), "-runs=1000", str(corpus)],
+                        cwd=tmp,
+                        capture_output=True,
+                        text=True,
+                    )
+                    self.assertEqual(result.returncode, 0, result.stderr[-4096:])
+
+
+if __name__ == "__main__":
+    unittest.main()
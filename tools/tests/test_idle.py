@@ -0,0 +1,168 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of the low-power scan mode of `src/idle.c`: the inactivity
+# timeout, the sweeps at a reduced rate and the return to the full scan rate.
+
+from pathlib import Path
+import random
+import struct
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+sys.path.append(str(Path(__file__).resolve().parent))
+import build
+from test_noise import COMMAND_ANALOG_STREAM, NUM_KEYS, replay
+
+KEYBOARD = "he60"
+# Calibration of the keyboard, see `keyboards/he60/keyboard.json`
+REST_VALUE = 2400
+
+# Defaults of `idle.h` and `matrix.h`
+IDLE_TIMEOUT = 5000
+IDLE_SCAN_INTERVAL = 2
+MATRIX_CALIBRATION_DURATION = 500
+
+COMMAND_GET_IDLE_STATS = 23
+# `idle_stats_t`
+IDLE_STATS = struct.Struct("<4I")
+
+# Time of the first line of the output of `tools/host/idle_test.c`
+START = MATRIX_CALIBRATION_DURATION + 2
+
+
+def build_idle(defines: dict[str, object]) -> Path:
+    name = "-".join(f"{k}={v}" for k, v in defines.items())
+    output = build.BUILD / KEYBOARD / f"idle_test-{name}"
+    return build.build("idle_test", KEYBOARD, True, defines, output, [])
+
+
+def run(exe: Path, adc_values: list[int], wake_times: tuple = ()) -> dict:
+    result = subprocess.run(
+        [str(exe), *(str(t) for t in wake_times)],
+        input="\n".join(str(x) for x in adc_values),
+        capture_output=True,
+        text=True,
+    )
+    if result.returncode != 0:
+        raise RuntimeError(result.stderr)
+
+    # Whether the conversion loop is continuous, the number of sweeps, the idle
+    # time and the number of wake-ups at each time
+    states = {}
+    for line in result.stdout.splitlines():
+        time, *state = map(int, line.split())
+        states[time] = tuple(state)
+    return states
+
+
+def noisy_rest(rng: random.Random, length: int) -> list[int]:
+    # The distance changes quickly near the rest position, so only a few ADC
+    # counts of noise stay below `IDLE_WAKE_THRESHOLD`
+    return [REST_VALUE + rng.randint(-5, 5) for _ in range(length)]
+
+
+class IdleTest(unittest.TestCase):
+    def assertIdle(self, states: dict, start: int, end: int, interval: int):
+        # The conversion loop is stopped from `start` until `end` excluded, or
+        # the end of the trace, and a sweep is started every `interval`
+        # milliseconds after the first one in progress
+        sweeps = states[start - 1][1]
+        for time in range(start - 1, min(end, max(states)) + 1):
+            continuous, num_sweeps, _, _ = states[time]
+            idle = start <= time < end
+            self.assertEqual(continuous, not idle, f"at {time} ms")
+            if idle:
+                expected = sweeps + (time - start) // interval
+                self.assertEqual(num_sweeps, expected, f"at {time} ms")
+
+    def check_timeout_and_wake(self, interval: int):
+        exe = build_idle({"IDLE_SCAN_INTERVAL": interval})
+        rng = random.Random(interval)
+        for offset in range(interval):
+            wake_request = START + IDLE_TIMEOUT // 2
+            enter = wake_request + IDLE_TIMEOUT
+            move = enter + IDLE_TIMEOUT // 2 + offset
+            # The key is held short of its actuation point, then released
+            release = move + 2 * IDLE_TIMEOUT + offset
+            adc_values = (
+                noisy_rest(rng, move - START)
+                + [REST_VALUE + 100] * (release - move)
+                + [REST_VALUE] * 100
+            )
+            states = run(exe, adc_values, (wake_request,))
+
+            # The requested wake-up restarts the timeout, and the noise does not
+            # count as activity
+            self.assertEqual(states[enter - 1], (True, 0, 0, 0))
+
+            # The movement is seen by the first sweep started after it
+            wake = enter + -(-(move - enter) // interval) * interval
+            self.assertIdle(states, enter, wake, interval)
+            self.assertEqual(states[wake][2:], (wake - enter, 1))
+
+            # The held key is idle once the filtered distance has settled, and
+            # its release is seen like a press
+            enter2 = min(t for t in range(wake, release) if not states[t][0])
+            self.assertGreaterEqual(enter2, wake + IDLE_TIMEOUT)
+            wake2 = enter2 + -(-(release - enter2) // interval) * interval
+            self.assertIdle(states, enter2, wake2, interval)
+            idle_time = wake - enter + wake2 - enter2
+            self.assertEqual(states[wake2][2:], (idle_time, 2))
+
+    def test_default_interval(self):
+        self.check_timeout_and_wake(IDLE_SCAN_INTERVAL)
+
+    def test_long_interval(self):
+        self.check_timeout_and_wake(5)
+
+    def test_wake_requested(self):
+        exe = build_idle({"IDLE_TIMEOUT": 1000})
+        # The timeout starts at the end of the calibration
+        enter = START - 1 + 1000
+        states = run(exe, [REST_VALUE] * 4000, (enter + 301, enter + 1301 + 500))
+
+        # Each request is handled at the same millisecond
+        self.assertIdle(states, enter, enter + 301, IDLE_SCAN_INTERVAL)
+        self.assertIdle(states, enter + 1301, enter + 1801, IDLE_SCAN_INTERVAL)
+        self.assertEqual(states[enter + 1801][2:], (301 + 500, 2))
+        self.assertIdle(states, enter + 2801, START + 4000, IDLE_SCAN_INTERVAL)
+        self.assertFalse(states[START + 3999][0])
+
+    def test_stream(self):
+        # The analog stream keeps the full scan rate until it is stopped at 12 s,
+        # even though no key moves. The idle time of the current period only
+        # counts after the wake-up by the first request of the statistics.
+        bitmap = bytes([1]) + bytes((NUM_KEYS + 7) // 8 - 1)
+        commands = [
+            (1000, bytes([COMMAND_ANALOG_STREAM, 5, 0]) + bitmap),
+            (12000, bytes([COMMAND_ANALOG_STREAM, 0, 0]) + bytes(len(bitmap))),
+            (24000, bytes([COMMAND_GET_IDLE_STATS])),
+            (24001, bytes([COMMAND_GET_IDLE_STATS])),
+        ]
+        _, reports = replay([[REST_VALUE] * NUM_KEYS] * 24002, commands)
+        stats = [
+            IDLE_STATS.unpack_from(report, 1)
+            for _, report in reports
+            if report[0] == COMMAND_GET_IDLE_STATS
+        ]
+        self.assertEqual(len(stats), 2)
+        self.assertEqual(stats[0][:2], (0, 0))
+        self.assertEqual(stats[1][:2], (24000 - 12000 - IDLE_TIMEOUT, 1))
+
+
+if __name__ == "__main__":
+    unittest.main()
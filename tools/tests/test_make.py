@@ -0,0 +1,180 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Ordering of the analog inputs for simultaneous conversion by the build
+# script, checked against the channels that each ADC of the MCU can convert.
+
+from pathlib import Path
+from unittest import mock
+import itertools
+import os
+import random
+import sys
+import unittest
+
+REPO = Path(__file__).resolve().parents[2]
+sys.path.append(str(REPO / "scripts"))
+import utils
+from drivers import STM32F446XX
+from schema.keyboard import Keyboard, KeyboardAnalog, KeyboardAnalogRaw
+
+ADC = STM32F446XX.metadata.adc
+
+
+def load_keyboard(keyboard):
+    path = REPO / "keyboards" / keyboard / "keyboard.json"
+    return Keyboard.model_validate_json(path.read_text())
+
+
+class Environment(dict):
+    """PlatformIO construction environment of `scripts/make.py`"""
+
+    def Append(self, **kwargs):
+        for key, value in kwargs.items():
+            self.setdefault(key, []).extend(value)
+
+
+def get_make_defines(keyboard: str, kb_json: Keyboard) -> dict[str, object]:
+    """Run `scripts/make.py` on a keyboard configuration.
+
+    Returns the preprocessor definitions of the build flags. The configuration
+    is copied, since the build script reorders the analog inputs.
+    """
+    kb_json = kb_json.model_copy(deep=True)
+    env = Environment(PIOENV=keyboard)
+    cwd = os.getcwd()
+    try:
+        os.chdir(REPO)
+        with mock.patch.object(utils, "get_kb_json", return_value=kb_json):
+            make = REPO / "scripts" / "make.py"
+            code = compile(make.read_text(), str(make), "exec")
+            exec(code, {"Import": lambda _: None, "env": env})
+    finally:
+        os.chdir(cwd)
+
+    defines = {}
+    for flag in env["BUILD_FLAGS"]:
+        if flag.startswith("-D"):
+            name, _, value = flag[2:].partition("=")
+            defines[name] = value.strip("'") if value else None
+    return defines
+
+
+class OrderSimultaneousInputsTest(unittest.TestCase):
+    def assertValidOrder(self, channels, adc_channels, order, offset=0):
+        self.assertEqual(sorted(order), list(range(len(channels))))
+        for p, i in enumerate(order):
+            adc = (offset + p) % len(adc_channels)
+            self.assertIn(channels[i], adc_channels[adc], f"position {p}")
+
+    def test_to_adc_inputs(self):
+        self.assertEqual(
+            ADC.to_adc_inputs(["A0", "B1", 3, "C5", 15]), [0, 9, 3, 15, 15]
+        )
+
+    def test_identity(self):
+        # ADC1 and ADC2 are connected to every channel
+        channels = list(range(16))
+        order = utils.order_simultaneous_inputs(channels, ADC.channels[:2])
+        self.assertEqual(order, channels)
+
+    def test_adc3_restriction(self):
+        adc_channels = ADC.channels
+        channels = ADC.to_adc_inputs(
+            ["A0", "A1", "A2", "A3", "A4", "A5", "A6", "A7", "B0"]
+        )
+        order = utils.order_simultaneous_inputs(channels, adc_channels)
+        self.assertIsNotNone(order)
+        self.assertValidOrder(channels, adc_channels, order)
+
+    def test_impossible(self):
+        # ADC3 is not connected to any of these inputs
+        channels = ADC.to_adc_inputs(["A4", "A5", "A6", "A7", "B0", "B1"])
+        self.assertIsNone(utils.order_simultaneous_inputs(channels, ADC.channels))
+        # Too many inputs for the positions of ADC3
+        channels = ADC.to_adc_inputs(["A0", "A4", "A5", "A6", "A7", "B0"])
+        self.assertIsNone(utils.order_simultaneous_inputs(channels, ADC.channels))
+
+    def test_offset(self):
+        channels = ADC.to_adc_inputs(["A4", "A5", "A0"])
+        # ADC3 converts position 2 without offset, and position 1 with offset 1
+        self.assertEqual(
+            utils.order_simultaneous_inputs(channels, ADC.channels), [0, 1, 2]
+        )
+        order = utils.order_simultaneous_inputs(channels, ADC.channels, 1)
+        self.assertValidOrder(channels, ADC.channels, order, 1)
+        self.assertEqual(order[1], 2)
+
+    def test_random(self):
+        rng = random.Random(0)
+        for _ in range(200):
+            num_adcs = rng.randint(1, 3)
+            adc_channels = ADC.channels[:num_adcs]
+            channels = rng.sample(range(16), rng.randint(1, 12))
+            offset = rng.randint(0, 5)
+            order = utils.order_simultaneous_inputs(channels, adc_channels, offset)
+            # Exhaustive search on the small cases
+            exists = None
+            if len(channels) <= 7:
+                exists = any(
+                    all(
+                        channels[i] in adc_channels[(offset + p) % num_adcs]
+                        for p, i in enumerate(perm)
+                    )
+                    for perm in itertools.permutations(range(len(channels)))
+                )
+            if order is None:
+                self.assertNotEqual(exists, True, (channels, num_adcs, offset))
+            else:
+                self.assertValidOrder(channels, adc_channels, order, offset)
+
+
+class OrderSimultaneousAnalogTest(unittest.TestCase):
+    def test_he60(self):
+        analog = load_keyboard("he60").analog
+        mux = analog.mux
+        pairs = sorted(zip(ADC.to_adc_inputs(mux.input), mux.matrix))
+        utils.order_simultaneous_analog(analog, ADC, 3)
+        channels = ADC.to_adc_inputs(mux.input)
+        for p, channel in enumerate(channels):
+            self.assertIn(channel, ADC.channels[p % 3], f"position {p}")
+        # Each input keeps its row of key mappings
+        self.assertEqual(sorted(zip(channels, mux.matrix)), pairs)
+
+    def test_raw_offset(self):
+        # Without B0, the raw inputs follow 8 multiplexer inputs, so the first
+        # raw input is converted by ADC3
+        analog = load_keyboard("he60").analog
+        analog.mux.input = analog.mux.input[:8]
+        analog.mux.matrix = analog.mux.matrix[:8]
+        analog.raw = KeyboardAnalogRaw(input=["A4", "A5", "A0"], vector=[70, 71, 72])
+        utils.order_simultaneous_analog(analog, ADC, 3)
+        self.assertEqual(analog.raw.input[0], "A0")
+        self.assertEqual(
+            sorted(zip(analog.raw.input, analog.raw.vector)),
+            [("A0", 72), ("A4", 70), ("A5", 71)],
+        )
+
+        analog.raw = KeyboardAnalogRaw(input=["A4", "A5", "A6"], vector=[70, 71, 72])
+        with self.assertRaises(ValueError):
+            utils.order_simultaneous_analog(analog, ADC, 3)
+
+    def test_too_many_adcs(self):
+        analog = KeyboardAnalog(raw=KeyboardAnalogRaw(input=[0], vector=[0]))
+        with self.assertRaises(ValueError):
+            utils.order_simultaneous_analog(analog, STM32F446XX.metadata.adc, 4)
+
+
+if __name__ == "__main__":
+    unittest.main()
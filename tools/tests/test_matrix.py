@@ -0,0 +1,183 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of the Rapid Trigger state machine of `src/matrix.c`, with 8-bit
+# and 16-bit (`DISTANCE_HIGH_RESOLUTION`) distances.
+
+from decimal import Decimal
+from pathlib import Path
+import random
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import distance_lut
+
+KEYBOARD = "he60"
+# Calibration of the keyboard, see `keyboards/he60/keyboard.json`
+REST_VALUE = 2400
+BOTTOM_OUT_THRESHOLD = 650
+
+# Distance curve of the lookup tables
+A = Decimal("0.01")
+
+
+def build_matrix(name: str, high_resolution: bool, lut: list[int]) -> Path:
+    defines = {"DISTANCE_HIGH_RESOLUTION": None} if high_resolution else {}
+    output = build.BUILD / KEYBOARD / f"matrix_test-{name}"
+    return build.build(
+        "matrix_test", KEYBOARD, True, defines, output, distance_luts=[lut]
+    )
+
+
+def run(exe: Path, actuation: tuple, adc_values: list[int]) -> list[tuple]:
+    result = subprocess.run(
+        [str(exe), *(str(x) for x in actuation)],
+        input="\n".join(str(x) for x in adc_values),
+        capture_output=True,
+        text=True,
+    )
+    if result.returncode != 0:
+        raise RuntimeError(result.stderr)
+    return [tuple(map(int, line.split())) for line in result.stdout.splitlines()]
+
+
+def random_trace(rng: random.Random, length: int = 3000) -> list[int]:
+    # Presses and releases at random speeds, stopping short of the bottom-out
+    # value so that the distance is never clamped to `DISTANCE_MAX`
+    adc_values = []
+    value = REST_VALUE
+    while len(adc_values) < length:
+        target = REST_VALUE + rng.randrange(BOTTOM_OUT_THRESHOLD - 32)
+        speed = rng.randint(1, 8)
+        while abs(target - value) > speed:
+            value += speed if target > value else -speed
+            adc_values.append(value)
+        adc_values += [target] * rng.randrange(20)
+        value = target
+    return adc_values
+
+
+def random_actuation(rng: random.Random, fractional: bool) -> tuple:
+    def wide(lo: int, hi: int) -> int:
+        return rng.randint(lo, hi) << 8 | (rng.randrange(256) if fractional else 0)
+
+    rt_down = 0 if rng.random() < 0.2 else wide(1, 30)
+    rt_up = 0 if rng.random() < 0.3 else wide(1, 30)
+    return (wide(1, 200), rt_down, rt_up, int(rng.random() < 0.3))
+
+
+def reference(distances: list[int], actuation: tuple) -> list[int]:
+    # Model of the Rapid Trigger state machine of `matrix_scan()` on 16-bit
+    # distances, without the auto-tune
+    actuation_point, rt_down, rt_up, continuous = actuation
+    reset_point = 0 if continuous else actuation_point
+    rt_up = rt_up or rt_down
+    key_dir, extremum, pressed = "inactive", 0, False
+    states = []
+    for d in distances:
+        if rt_down == 0:
+            pressed = d >= actuation_point
+        elif key_dir == "inactive":
+            if d > actuation_point:
+                key_dir, extremum, pressed = "down", d, True
+        elif d <= reset_point:
+            key_dir, extremum, pressed = "inactive", d, False
+        elif key_dir == "down":
+            if d + rt_up < extremum:
+                key_dir, extremum, pressed = "up", d, False
+            elif d > extremum:
+                extremum = d
+        else:
+            if extremum + rt_down < d:
+                key_dir, extremum, pressed = "down", d, True
+            elif d < extremum:
+                extremum = d
+        states.append(int(pressed))
+    return states
+
+
+class MatrixTest(unittest.TestCase):
+    def assertTraceEqual(self, actual: list, expected: list):
+        # Report the first mismatching scan instead of diffing the traces
+        self.assertEqual(len(actual), len(expected))
+        mismatch = next(
+            (i for i, (x, y) in enumerate(zip(actual, expected)) if x != y), None
+        )
+        if mismatch is not None:
+            self.fail(f"scan {mismatch}: {actual[mismatch]} != {expected[mismatch]}")
+
+    def test_high_resolution_integer(self):
+        # With lookup table values and settings without fractional parts, the
+        # 16-bit distances are the 8-bit distances times 256, so the keys
+        # behave like with the 8-bit distances
+        lut = distance_lut.generate_lut(A)
+        exe_8 = build_matrix("8-bit", False, lut)
+        exe_16 = build_matrix("16-bit-integer", True, [x << 8 for x in lut])
+        rng = random.Random(1)
+        for i in range(20):
+            actuation = random_actuation(rng, fractional=False)
+            adc_values = random_trace(rng)
+            with self.subTest(i=i, actuation=actuation):
+                expected = run(exe_8, actuation, adc_values)
+                self.assertTraceEqual(run(exe_16, actuation, adc_values), expected)
+                self.assertTrue(any(state for _, _, state in expected))
+
+    def test_high_resolution_fractional(self):
+        # The fractional parts of the settings are compared with the fractional
+        # parts of the distances
+        lut = distance_lut.generate_lut(A, max_value=65535)
+        exe = build_matrix("16-bit", True, lut)
+        rng = random.Random(2)
+        num_truncated_differences = 0
+        for i in range(20):
+            actuation = random_actuation(rng, fractional=True)
+            adc_values = random_trace(rng)
+            with self.subTest(i=i, actuation=actuation):
+                output = run(exe, actuation, adc_values)
+                distances = [wide for _, wide, _ in output]
+                self.assertTraceEqual(
+                    [distance >> 8 for _, distance, _ in output],
+                    [distance for distance, _, _ in output],
+                )
+                self.assertTraceEqual(
+                    [state for _, _, state in output],
+                    reference(distances, actuation),
+                )
+                truncated = tuple(x & ~0xFF for x in actuation[:3]) + actuation[3:]
+                if reference(distances, truncated) != reference(distances, actuation):
+                    num_truncated_differences += 1
+        # The fractional parts change when the keys are pressed and released
+        self.assertGreater(num_truncated_differences, 0)
+
+    def test_actuation_point_fraction(self):
+        # Slowly pressing a key actuates it at the first distance past the
+        # actuation point, to 1/256 of the 8-bit distance
+        lut = distance_lut.generate_lut(A, max_value=65535)
+        exe = build_matrix("16-bit", True, lut)
+        adc_values = list(range(REST_VALUE, REST_VALUE + 400))
+        distances = [wide for _, wide, _ in run(exe, (0xFF00, 0, 0, 0), adc_values)]
+        for actuation_point in (0x4000, 0x4040, 0x4080, 0x40C0, 0x40FF):
+            with self.subTest(actuation_point=hex(actuation_point)):
+                output = run(exe, (actuation_point, 0, 0, 0), adc_values)
+                first = next(i for i, (_, _, state) in enumerate(output) if state)
+                self.assertGreaterEqual(distances[first], actuation_point)
+                self.assertLess(distances[first - 1], actuation_point)
+
+
+if __name__ == "__main__":
+    unittest.main()
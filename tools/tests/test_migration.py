@@ -0,0 +1,130 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+
+# Migration of synthetic v1.0 configurations to the latest version for each
+# keyboard, checked against the layout of `eeconfig_t` field by field.
+
+from pathlib import Path
+import random
+import struct
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+
+MAGIC_START = 0x0A42494C
+MAGIC_END = 0x0A4B4D48
+LATEST_VERSION = 0x0108
+
+AK_TYPE_TAP_HOLD = 3
+
+# `gamepad_options_t` inserted by the v1.1 migration
+DEFAULT_GAMEPAD_OPTIONS = bytes([4, 20, 85, 95, 165, 170, 255, 255, 0b00001001])
+# `save_bottom_out_threshold` (v1.3) and `high_polling_rate_enabled` (v1.4)
+DEFAULT_OPTIONS = 0b0110
+
+
+def v1_1_keycode(keycode: int) -> int:
+    if 0x70 <= keycode <= 0x71:
+        return keycode + 0x06
+    if 0x72 <= keycode <= 0x96:
+        return keycode + 0x09
+    return keycode
+
+
+class MigrationTest(unittest.TestCase):
+    def migrate(self, keyboard: str, seed: int):
+        defines = build.get_defines(keyboard)
+        num_profiles = defines["NUM_PROFILES"]
+        num_layers = defines["NUM_LAYERS"]
+        num_keys = defines["NUM_KEYS"]
+        num_advanced_keys = defines["NUM_ADVANCED_KEYS"]
+        rng = random.Random(seed)
+
+        def rand(n: int) -> bytes:
+            return bytes(rng.randrange(256) for _ in range(n))
+
+        # v1.0 image
+        calibration = rand(4)
+        current_profile = rng.randrange(num_profiles)
+        last_non_default_profile = rng.randrange(num_profiles)
+        image = struct.pack(
+            "<IH4sBB",
+            MAGIC_START,
+            0x0100,
+            calibration,
+            current_profile,
+            last_non_default_profile,
+        )
+        profiles = []
+        for _ in range(num_profiles):
+            keymap = rand(num_layers * num_keys)
+            actuation_map = rand(num_keys * 4)
+            advanced_keys = bytearray(rand(num_advanced_keys * 12))
+            for i in range(0, len(advanced_keys), 12):
+                if rng.random() < 0.5:
+                    advanced_keys[i + 2] = AK_TYPE_TAP_HOLD
+            tick_rate = rand(1)
+            profiles.append((keymap, actuation_map, bytes(advanced_keys), tick_rate))
+            image += keymap + actuation_map + advanced_keys + tick_rate
+
+        exe = build.build("migration_test", keyboard, sanitize=True)
+        result = subprocess.run([str(exe)], input=image, capture_output=True)
+        self.assertEqual(result.returncode, 0, result.stderr)
+        config = result.stdout
+
+        # Latest global configuration
+        expected = struct.pack("<IH4s", MAGIC_START, LATEST_VERSION, calibration)
+        # Bottom-out threshold
+        expected += bytes(num_keys * 2)
+        expected += struct.pack(
+            "<HBB", DEFAULT_OPTIONS, current_profile, last_non_default_profile
+        )
+        # Default switch models and calibration epsilon
+        expected += bytes(num_keys) + bytes(num_keys)
+
+        for keymap, actuation_map, advanced_keys, tick_rate in profiles:
+            advanced_keys = bytearray(advanced_keys)
+            for i in range(0, len(advanced_keys), 12):
+                if advanced_keys[i + 2] == AK_TYPE_TAP_HOLD:
+                    # `hold_on_other_key_press`
+                    advanced_keys[i + 7] = 0
+            expected += bytes(v1_1_keycode(keycode) for keycode in keymap)
+            expected += actuation_map
+            # Fine actuation map
+            expected += bytes(num_keys * 3)
+            expected += advanced_keys
+            # Gamepad buttons
+            expected += bytes(num_keys)
+            expected += DEFAULT_GAMEPAD_OPTIONS + tick_rate
+        expected += struct.pack("<I", MAGIC_END)
+
+        self.assertEqual(len(config), len(expected))
+        self.assertEqual(config, expected)
+
+    def test_v1_0(self):
+        keyboards = sorted(
+            p.parent.name for p in build.ROOT.glob("keyboards/*/keyboard.json")
+        )
+        for keyboard in keyboards:
+            for seed in range(2):
+                with self.subTest(keyboard=keyboard, seed=seed):
+                    self.migrate(keyboard, seed)
+
+
+if __name__ == "__main__":
+    unittest.main()
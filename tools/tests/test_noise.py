@@ -0,0 +1,336 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Replay of synthetic noisy ADC traces through the scan loop, to test the noise
+# measurement of `src/noise.c` and its raw HID commands.
+
+from pathlib import Path
+import math
+import random
+import statistics
+import struct
+import sys
+import tempfile
+import unittest
+
+sys.path.insert(0, str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parent))
+import trace
+from test_trace_replay import ANALOG_STREAM_ENTRY, run
+
+COMMAND_GET_OPTIONS = 9
+COMMAND_SET_OPTIONS = 10
+COMMAND_ANALOG_STREAM = 16
+COMMAND_NOISE_DIAGNOSTICS = 24
+COMMAND_GET_NOISE_STATS = 25
+COMMAND_GET_CALIBRATION_EPSILON = 26
+COMMAND_GET_AUTO_TUNE = 28
+COMMAND_SET_ACTUATION_MAP = 131
+
+# `noise_stats_t`, 2 of them per report after the `active` flag
+NOISE_STATS = struct.Struct("<HHIHhHHIHHB")
+NOISE_STATS_PER_REPORT = 2
+# `noise_tune_t`, 5 of them per report
+NOISE_TUNE = struct.Struct("<6H")
+
+# `auto_tune_enabled` of `eeconfig_options_t`
+AUTO_TUNE_ENABLED = 1 << 3
+
+KC_1 = 0x1C
+
+# Configuration of the HE60, see `keyboards/he60/keyboard.json`
+NUM_KEYS = 67
+ADC_RESOLUTION = 12
+ADC_MAX_VALUE = (1 << ADC_RESOLUTION) - 1
+REST_VALUE = 2400
+
+# Defaults of `matrix.h` and `noise.h`
+MATRIX_EMA_ALPHA_EXPONENT = 4
+NOISE_MIN_SAMPLES = 256
+NOISE_EPSILON_MARGIN = 1
+NOISE_TUNE_WINDOW = 1000
+NOISE_TUNE_DECAY_EXPONENT = 3
+NOISE_TUNE_MARGIN = 1
+
+
+def ema(x: int, y: int) -> int:
+    return (x + y * ((1 << MATRIX_EMA_ALPHA_EXPONENT) - 1)) >> MATRIX_EMA_ALPHA_EXPONENT
+
+
+def replay(
+    values: list[list[int]], commands: list[tuple[int, bytes]]
+) -> tuple[list[tuple[int, str, int]], list[tuple[int, bytes]]]:
+    # Replay the ADC values of each key, after the inversion of the HE60, one
+    # frame per millisecond from 1 ms, and return the keycode events and the
+    # reports sent back with their times
+    frames = [(1, [ADC_MAX_VALUE - value for value in frame]) for frame in values]
+    with tempfile.TemporaryDirectory() as tmp:
+        path = Path(tmp) / "noise.trace"
+        path.write_bytes(trace.encode(ADC_RESOLUTION, frames))
+        output = run("he60", path, sorted(commands, key=lambda command: command[0]))
+
+    events, reports = [], []
+    for time, event, data in output:
+        if event == "report":
+            reports.append((int(time), bytes.fromhex(data)))
+        else:
+            events.append((int(time), event, int(data)))
+    return events, reports
+
+
+def get_noise_stats(reports: list[bytes]) -> list[tuple]:
+    stats = []
+    for report in reports:
+        if report[0] != COMMAND_GET_NOISE_STATS:
+            continue
+        for i in range(NOISE_STATS_PER_REPORT):
+            stats.append(NOISE_STATS.unpack_from(report, 2 + i * NOISE_STATS.size))
+    return stats[:NUM_KEYS]
+
+
+class NoiseDiagnosticsTest(unittest.TestCase):
+    def test_measurement(self):
+        # Peak-to-peak noise of the unfiltered ADC value of the first keys. The
+        # other keys are quiet, except for a key held down during the whole
+        # measurement.
+        amplitudes = [0, 2, 5, 12, 30]
+        held_key = 5
+        start, duration, end = 600, 2000, 2800
+        rng = random.Random(1)
+
+        values = []
+        for time in range(1, end + 1):
+            frame = [REST_VALUE] * NUM_KEYS
+            frame[held_key] = REST_VALUE + 640
+            # The noise starts after the calibration
+            if time > 550:
+                for key, amplitude in enumerate(amplitudes):
+                    frame[key] += rng.randint(
+                        -(amplitude // 2), amplitude - amplitude // 2
+                    )
+            values.append(frame)
+
+        commands = [
+            (start, bytes([COMMAND_NOISE_DIAGNOSTICS, *struct.pack("<H", duration), 1]))
+        ]
+        for offset in range(0, NUM_KEYS, NOISE_STATS_PER_REPORT):
+            commands.append((end - 100, bytes([COMMAND_GET_NOISE_STATS, offset])))
+        commands.append((end - 100, bytes([COMMAND_GET_CALIBRATION_EPSILON, 0])))
+        commands.append((end - 100, bytes([COMMAND_GET_CALIBRATION_EPSILON, 63])))
+        _, reports = replay(values, commands)
+        reports = [report for _, report in reports]
+
+        # The measurement is not active anymore
+        self.assertEqual(reports[0], bytes([COMMAND_NOISE_DIAGNOSTICS]) + bytes(63))
+        self.assertTrue(
+            all(
+                report[1] == 0
+                for report in reports
+                if report[0] == COMMAND_GET_NOISE_STATS
+            )
+        )
+        stats = get_noise_stats(reports)
+        epsilon_reports = [
+            report for report in reports if report[0] == COMMAND_GET_CALIBRATION_EPSILON
+        ]
+        saved_epsilon = list(epsilon_reports[0][1:64] + epsilon_reports[1][1:5])
+
+        # The filtered ADC values of each key, as in `matrix_scan()`
+        filtered = [[REST_VALUE] * NUM_KEYS]
+        for frame in values:
+            filtered.append([ema(x, y) for x, y in zip(frame, filtered[-1])])
+        filtered = filtered[1:]
+
+        # The keys are sampled once per millisecond from the time of the
+        # command until the measurement completes
+        window = range(start - 1, start + duration)
+        for key in range(NUM_KEYS):
+            with self.subTest(key=key):
+                (
+                    rest_samples,
+                    rest_peak_to_peak,
+                    rest_variance,
+                    rest_filtered_peak_to_peak,
+                    _,
+                    bottom_out_samples,
+                    bottom_out_peak_to_peak,
+                    _,
+                    _,
+                    _,
+                    epsilon,
+                ) = stats[key]
+                samples = [ADC_MAX_VALUE - values[i][key] for i in window]
+                filtered_samples = [filtered[i][key] for i in window]
+
+                if key == held_key:
+                    self.assertEqual(rest_samples, 0)
+                    self.assertEqual(bottom_out_samples, len(window))
+                    self.assertEqual(bottom_out_peak_to_peak, 0)
+                    # Not enough samples at rest, so the epsilon is not saved
+                    self.assertEqual(epsilon, 0)
+                    self.assertEqual(saved_epsilon[key], 0)
+                    continue
+
+                self.assertEqual(rest_samples, len(window))
+                self.assertEqual(bottom_out_samples, 0)
+                self.assertEqual(rest_peak_to_peak, max(samples) - min(samples))
+                if key < len(amplitudes):
+                    self.assertEqual(rest_peak_to_peak, amplitudes[key])
+
+                # The variance is in 1/256 ADC counts squared
+                n = len(samples)
+                expected = n * sum(x * x for x in samples) - sum(samples) ** 2
+                self.assertEqual(rest_variance, expected // n * 256 // n)
+                self.assertAlmostEqual(
+                    math.sqrt(rest_variance / 256),
+                    statistics.pstdev(samples),
+                    delta=1 / 16,
+                )
+
+                # The epsilon clears the peak-to-peak noise of the filtered ADC
+                # value, and is saved when the measurement completes
+                filtered_peak_to_peak = max(filtered_samples) - min(filtered_samples)
+                self.assertEqual(rest_filtered_peak_to_peak, filtered_peak_to_peak)
+                self.assertLess(filtered_peak_to_peak, max(rest_peak_to_peak, 1))
+                self.assertEqual(epsilon, filtered_peak_to_peak + NOISE_EPSILON_MARGIN)
+                self.assertEqual(saved_epsilon[key], epsilon)
+
+
+class AutoTuneTest(unittest.TestCase):
+    KEY = 1
+    NOISE_END = 6000
+    END = 20000
+
+    def replay_noisy_key(self, auto_tune: bool) -> tuple[list, dict, dict]:
+        # The second key is noisy from the end of the calibration to 6 s. Its
+        # noise only raises the ADC value, like a disturbance of the magnetic
+        # field would. Once the auto-tune has measured the noise, the key is
+        # set to actuate at 2/255 with Continuous Rapid Trigger, below its
+        # noise.
+        key = self.KEY
+        rng = random.Random(1)
+        values = []
+        for time in range(1, self.END + 1):
+            frame = [REST_VALUE] * NUM_KEYS
+            if 550 < time <= self.NOISE_END:
+                frame[key] += rng.randint(0, 24)
+            values.append(frame)
+
+        _, reports = replay(
+            [[REST_VALUE] * NUM_KEYS] * 10, [(1, bytes([COMMAND_GET_OPTIONS]))]
+        )
+        (options,) = struct.unpack_from("<H", reports[0][1], 1)
+        bitmap = bytearray(9)
+        bitmap[key // 8] |= 1 << key % 8
+        commands = [
+            (600, bytes([COMMAND_ANALOG_STREAM, 1, 0]) + bitmap),
+            (2600, bytes([COMMAND_SET_ACTUATION_MAP, 0, key, 1, 2, 1, 0, 1])),
+        ]
+        if auto_tune:
+            options |= AUTO_TUNE_ENABLED
+            commands.append(
+                (600, bytes([COMMAND_SET_OPTIONS, *struct.pack("<H", options)]))
+            )
+        # The state is read in the middle of each window
+        for time in range(1500, self.END, NOISE_TUNE_WINDOW):
+            commands.append((time, bytes([COMMAND_GET_AUTO_TUNE, 0])))
+        events, reports = replay(values, commands)
+
+        # Auto-tune state of the quiet first key and of the noisy key
+        tunes = {}
+        # Maximum distance of the noisy key in each window
+        distances = {}
+        for time, report in reports:
+            if report[0] == COMMAND_GET_AUTO_TUNE:
+                tunes[time] = [
+                    NOISE_TUNE.unpack_from(report, 1 + i * NOISE_TUNE.size)
+                    for i in (0, key)
+                ]
+            elif report[0] == COMMAND_ANALOG_STREAM and report[2] > 0:
+                _, _, distance = ANALOG_STREAM_ENTRY.unpack_from(report, 4)
+                window = time // NOISE_TUNE_WINDOW
+                distances[window] = max(distances.get(window, 0), distance)
+
+        return [event for event in events if event[2] == KC_1], tunes, distances
+
+    def test_noisy_key(self):
+        events, tunes, distances = self.replay_noisy_key(auto_tune=True)
+        margin = NOISE_TUNE_MARGIN << 8
+
+        for time, (quiet, noisy) in tunes.items():
+            with self.subTest(time=time):
+                # The quiet key is only raised by the margin
+                self.assertEqual(quiet[:3], (0, margin, margin))
+                self.assertEqual(quiet[3], 128 << 8)
+
+                (
+                    adc_noise,
+                    min_actuation_point,
+                    min_rt,
+                    actuation_point,
+                    rt_down,
+                    rt_up,
+                ) = noisy
+                # The effective configuration is the stored one raised to the
+                # minimum values. The sensitivities are the same, since Continuous
+                # Rapid Trigger runs from the rest position.
+                if time > 2600:
+                    self.assertEqual(actuation_point, max(2 << 8, min_actuation_point))
+                    self.assertEqual(rt_down, max(1 << 8, min_rt))
+                    self.assertEqual(rt_up, rt_down)
+                    self.assertEqual(min_rt, min_actuation_point)
+                if time < self.NOISE_END:
+                    # The minimum values rise above the noise as soon as the
+                    # first window is measured
+                    self.assertGreater(adc_noise, 0)
+                    self.assertGreater(
+                        min_actuation_point >> 8,
+                        max(distances[time // NOISE_TUNE_WINDOW - i] for i in (0, 1)),
+                    )
+                    self.assertGreater(min_actuation_point, 2 << 8)
+
+        # The noise reaches past the stored actuation point, but the key is
+        # never pressed
+        self.assertGreater(max(distances.values()), 2)
+        self.assertEqual(events, [])
+
+        # Once the noise drops and the filtered ADC value has settled, the
+        # estimate decays by 1/8 of the difference per window, and the stored
+        # configuration is restored
+        estimates = [
+            noisy[0]
+            for time, (_, noisy) in sorted(tunes.items())
+            if time > self.NOISE_END + 2 * NOISE_TUNE_WINDOW
+        ]
+        self.assertGreater(estimates[0], 4)
+        for estimate, next_estimate in zip(estimates, estimates[1:]):
+            step = (
+                estimate + (1 << NOISE_TUNE_DECAY_EXPONENT) - 1
+            ) >> NOISE_TUNE_DECAY_EXPONENT
+            self.assertEqual(next_estimate, estimate - step)
+        _, noisy = tunes[max(tunes)]
+        self.assertEqual(noisy, (0, margin, margin, 2 << 8, 1 << 8, 1 << 8))
+
+    def test_disabled(self):
+        # Without the auto-tune, the noise presses the key once it is set to
+        # actuate below the noise
+        events, tunes, _ = self.replay_noisy_key(auto_tune=False)
+        self.assertGreater(len(events), 0)
+        self.assertGreaterEqual(events[0][0], 2600)
+        for _, noisy in tunes.values():
+            self.assertEqual(noisy[:3], (0, 0, 0))
+
+
+if __name__ == "__main__":
+    unittest.main()
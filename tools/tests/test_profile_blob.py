@@ -0,0 +1,155 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Round trips between `tools/profile_blob.py` and `include/lib/compress.h`,
+# built on the host with the default CRC32 implementation.
+
+from pathlib import Path
+import random
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import profile_blob
+
+# Exit status of `tools/host/profile_blob.c`
+EXIT_MALFORMED = 2
+EXIT_LENGTH = 3
+EXIT_CRC = 4
+
+
+# Profile without any match in the window, which compresses to the upper bound
+def incompressible(size: int, seed: int = 0) -> bytes:
+    rng = random.Random(seed)
+    out = bytearray()
+    while len(out) < size:
+        b = rng.randrange(256)
+        window = out[-profile_blob.WINDOW_SIZE :]
+        if len(out) >= 2 and bytes(out[-2:]) + bytes([b]) in window:
+            continue
+        out.append(b)
+    return bytes(out)
+
+
+class ProfileBlobTest(unittest.TestCase):
+    @classmethod
+    def setUpClass(cls):
+        cls.exe = build.build("profile_blob", sanitize=True)
+        cls.profile_size = int(cls.run_c("size").stdout)
+
+    @classmethod
+    def run_c(cls, mode: str, data: bytes = b"", size: int | None = None):
+        args = [str(cls.exe), mode] + ([str(size)] if size is not None else [])
+        return subprocess.run(args, input=data, capture_output=True)
+
+    def profiles(self):
+        size = self.profile_size
+        rng = random.Random(1)
+        return {
+            "empty": b"",
+            "zero": bytes(size),
+            "random": bytes(rng.randrange(256) for _ in range(size)),
+            # Mostly repeated structure with a few changes
+            "sparse": bytes(
+                rng.randrange(256) if rng.random() < 0.05 else i % 12
+                for i in range(size)
+            ),
+            "worst": incompressible(size),
+        }
+
+    def test_round_trip(self):
+        for name, profile in self.profiles().items():
+            with self.subTest(name):
+                blob = profile_blob.encode(profile, "software")
+                bound = len(profile) + -(-len(profile) // profile_blob.MAX_LITERAL)
+                self.assertLessEqual(len(blob), profile_blob.HEADER.size + bound)
+
+                result = self.run_c("encode", profile, len(profile))
+                self.assertEqual(result.returncode, 0, result.stderr)
+                self.assertEqual(result.stdout, blob)
+
+                result = self.run_c("decode", blob, len(profile))
+                self.assertEqual(result.returncode, 0, result.stderr)
+                self.assertEqual(result.stdout, profile)
+                self.assertEqual(profile_blob.decode(blob, "software"), profile)
+
+    def test_worst_case(self):
+        profile = incompressible(self.profile_size)
+        payload = profile_blob.compress(profile)
+        bound = len(profile) + -(-len(profile) // profile_blob.MAX_LITERAL)
+        self.assertEqual(len(payload), bound)
+
+    def assert_rejected(self, payload: bytes, size: int, status: int):
+        profile = profile_blob.decompress(payload) if status == EXIT_CRC else b""
+        blob = (
+            profile_blob.HEADER.pack(
+                len(payload), profile_blob.crc32_software(profile) ^ 1
+            )
+            + payload
+        )
+        result = self.run_c("decode", blob, size)
+        self.assertEqual(result.returncode, status, result.stderr)
+        self.assertEqual(result.stdout, b"")
+
+    def test_distance_before_start(self):
+        # Copy from 1 byte back at the start of the output
+        self.assert_rejected(bytes([0x80, 0x00]), 16, EXIT_MALFORMED)
+        # Copy from 3 bytes back after 2 bytes
+        self.assert_rejected(bytes([0x01, 1, 2, 0x80, 0x02]), 16, EXIT_MALFORMED)
+        with self.assertRaises(ValueError):
+            profile_blob.decompress(bytes([0x80, 0x00]))
+
+    def test_truncated_literal(self):
+        self.assert_rejected(bytes([0x05, 1, 2, 3]), 16, EXIT_MALFORMED)
+        with self.assertRaises(ValueError):
+            profile_blob.decompress(bytes([0x05, 1, 2, 3]))
+
+    def test_truncated_copy(self):
+        self.assert_rejected(bytes([0x00, 1, 0x80]), 16, EXIT_MALFORMED)
+        with self.assertRaises(ValueError):
+            profile_blob.decompress(bytes([0x00, 1, 0x80]))
+
+    def test_output_overflow(self):
+        # Literal run past the end of the output
+        self.assert_rejected(bytes([0x07]) + bytes(8), 4, EXIT_MALFORMED)
+        # Copy past the end of the output
+        self.assert_rejected(bytes([0x00, 1, 0x81, 0x00]), 4, EXIT_MALFORMED)
+
+    def test_short_output(self):
+        self.assert_rejected(bytes([0x01, 1, 2]), 16, EXIT_LENGTH)
+
+    def test_length_mismatch(self):
+        blob = profile_blob.encode(bytes(16), "software")
+        for blob in (blob[:-1], blob + b"\x00", blob[:4]):
+            result = self.run_c("decode", blob, 16)
+            self.assertEqual(result.returncode, EXIT_LENGTH, result.stderr)
+
+    def test_crc_mismatch(self):
+        self.assert_rejected(profile_blob.compress(bytes(16)), 16, EXIT_CRC)
+
+        # Corrupted literal byte with the CRC of the original profile
+        profile = bytes(range(16))
+        blob = bytearray(profile_blob.encode(profile, "software"))
+        blob[-1] ^= 0xFF
+        result = self.run_c("decode", bytes(blob), 16)
+        self.assertEqual(result.returncode, EXIT_CRC, result.stderr)
+        with self.assertRaises(ValueError):
+            profile_blob.decode(bytes(blob), "software")
+
+
+if __name__ == "__main__":
+    unittest.main()
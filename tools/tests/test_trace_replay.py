@@ -0,0 +1,180 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+
+# Replay of the sample ADC input traces through the scan loop with the default
+# configuration, including the raw HID reports of the streaming commands.
+
+from pathlib import Path
+import struct
+import subprocess
+import sys
+import tempfile
+import unittest
+
+# `tools/trace.py` must take precedence over the standard `trace` module
+sys.path.insert(0, str(Path(__file__).resolve().parents[1]))
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+import trace
+
+SAMPLES = build.ROOT / "tools" / "trace_replay" / "samples"
+
+COMMAND_ANALOG_INFO = 5
+COMMAND_ANALOG_STREAM = 16
+# Key, ADC value and distance of an analog stream entry, 15 of them per report
+ANALOG_STREAM_ENTRY = struct.Struct("<BHB")
+ANALOG_STREAM_ENTRIES = 15
+
+KC_A = 0x02
+KC_D = 0x05
+KC_S = 0x14
+
+
+# Run `tools/host/trace_replay_run.c` with raw HID commands at given times, and
+# return its output lines split into their fields
+def run(
+    keyboard: str, sample: Path, commands: list[tuple[int, bytes]] | None = None
+) -> list[list[str]]:
+    exe = build.build("trace_replay_run", keyboard, sanitize=True)
+    args = [str(exe), str(sample)]
+    with tempfile.TemporaryDirectory() as tmp:
+        if commands is not None:
+            path = Path(tmp) / "commands"
+            path.write_text(
+                "".join(f"{time} {report.hex()}\n" for time, report in commands)
+            )
+            args.append(str(path))
+        result = subprocess.run(args, capture_output=True, text=True)
+    if result.returncode != 0:
+        raise RuntimeError(result.stderr)
+
+    return [line.split() for line in result.stdout.splitlines()]
+
+
+class TraceReplayTest(unittest.TestCase):
+    def replay(self, keyboard: str, sample: Path) -> list[tuple[int, str, int]]:
+        return [
+            (int(time), event, int(keycode))
+            for time, event, keycode in run(keyboard, sample)
+        ]
+
+    def test_he60(self):
+        # A rolled over to S after the calibration, then D held down
+        sample = SAMPLES / "he60.trace"
+        _, frames = trace.decode(sample.read_bytes())
+        end = sum(delta_time for delta_time, _ in frames)
+
+        events = self.replay("he60", sample)
+        self.assertEqual(
+            [(event, keycode) for _, event, keycode in events],
+            [
+                ("add", KC_A),
+                ("add", KC_S),
+                ("remove", KC_A),
+                ("remove", KC_S),
+                ("add", KC_D),
+                ("remove", KC_D),
+            ],
+        )
+        times = [time for time, _, _ in events]
+        self.assertEqual(times, sorted(times))
+        self.assertGreaterEqual(times[0], 500)
+        self.assertLessEqual(times[-1], end)
+
+    def test_capture(self):
+        # Capture the replayed trace with the reports sent by the firmware
+        sample = SAMPLES / "he60.trace"
+        adc_resolution, frames = trace.decode(sample.read_bytes())
+        start = 100
+        command = bytes([trace.COMMAND_TRACE_CAPTURE, 1])
+        reports = [
+            bytes.fromhex(data)
+            for _, event, data in run("he60", sample, [(start, command)])
+            if event == "report"
+        ]
+
+        # The reply to the command comes first, and has no data
+        self.assertEqual(reports[0][:3], bytes([trace.COMMAND_TRACE_CAPTURE, 0, 0]))
+        self.assertTrue(all(report[2] > 0 for report in reports[1:]))
+
+        captured_resolution, captured = trace.decode(trace.extract(reports))
+        self.assertEqual(captured_resolution, adc_resolution)
+        self.assertGreater(len(captured), 10)
+
+        # Each captured frame has the values of the replayed frame at its time
+        values_at = {}
+        time = 0
+        for delta_time, values in frames:
+            time += delta_time
+            values_at[time] = values
+        time = start
+        for delta_time, values in captured:
+            time += delta_time
+            self.assertEqual(values, values_at[time])
+
+    def test_analog_stream(self):
+        sample = SAMPLES / "he60.trace"
+        keys = set(range(0, 67, 3))
+        bitmap = bytearray(9)
+        for key in keys:
+            bitmap[key // 8] |= 1 << key % 8
+        # The reply of another command is sent before the stream starts
+        commands = [
+            (90, bytes([COMMAND_ANALOG_INFO, 0])),
+            (100, bytes([COMMAND_ANALOG_STREAM, 5, 0]) + bitmap),
+        ]
+        reports = [
+            bytes.fromhex(data)
+            for _, event, data in run("he60", sample, commands)
+            if event == "report"
+        ]
+        self.assertEqual(reports[0][0], COMMAND_ANALOG_INFO)
+
+        # The reply to the command is all zeros after its ID
+        self.assertEqual(reports[1], bytes([COMMAND_ANALOG_STREAM]) + bytes(63))
+
+        # Reassemble the frames of the stream without the reply
+        frames = []
+        entries = {}
+        for report in reports[2:]:
+            self.assertEqual(report[0], COMMAND_ANALOG_STREAM)
+            frame, length, last = report[1:4]
+            self.assertTrue(last or length == ANALOG_STREAM_ENTRIES)
+            for i in range(length):
+                key, adc_value, distance = ANALOG_STREAM_ENTRY.unpack_from(
+                    report, 4 + i * ANALOG_STREAM_ENTRY.size
+                )
+                self.assertIn(key, keys)
+                entries[key] = (adc_value, distance)
+            if last:
+                frames.append((frame, entries))
+                entries = {}
+
+        # The first frame holds every subscribed key, and the 8-bit frame
+        # counter only increases, by more than 1 after frames that were not sent
+        self.assertEqual(frames[0][0], 0)
+        self.assertEqual(set(frames[0][1]), keys)
+        self.assertGreater(len(frames), 1)
+        for (a, _), (b, _) in zip(frames, frames[1:]):
+            self.assertNotEqual((b - a) & 0xFF, 0)
+
+    def test_mismatched_trace(self):
+        # The sample has the number of keys of the HE60
+        with self.assertRaises(RuntimeError):
+            run("he16", SAMPLES / "he60.trace")
+
+
+if __name__ == "__main__":
+    unittest.main()
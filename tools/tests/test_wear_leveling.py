@@ -0,0 +1,117 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Host tests of `src/wear_leveling.c` on the simulated flash
+
+from pathlib import Path
+import subprocess
+import sys
+import unittest
+
+sys.path.append(str(Path(__file__).resolve().parents[1] / "host"))
+import build
+
+# Keyboard and additional definitions of each tested configuration
+CONFIGS = {
+    "he60": ("he60", {}),
+    "he16": ("he16", {}),
+    "he60-double-bank": ("he60", {"WL_DOUBLE_BANK": None}),
+    "he16-double-bank": ("he16", {"WL_DOUBLE_BANK": None}),
+}
+
+# Same configurations with a write log smaller than the virtual storage, which
+# some scenarios require
+SMALL_LOG_CONFIGS = {
+    config: (keyboard, {**defines, "WL_WRITE_LOG_SIZE": 4096})
+    for config, (keyboard, defines) in CONFIGS.items()
+}
+
+
+def build_config(target: str, config: str) -> Path:
+    keyboard, defines = CONFIGS[config]
+    output = build.BUILD / keyboard / f"{target}-{config}"
+    return build.build(target, keyboard, True, defines, output)
+
+
+class ReplayBenchTest(unittest.TestCase):
+    def test_replay(self):
+        # The benchmark checks the virtual storage after each replay
+        for config in CONFIGS:
+            with self.subTest(config):
+                exe = build_config("wl_replay_bench", config)
+                result = subprocess.run(
+                    [str(exe), "1"], capture_output=True, text=True
+                )
+                self.assertEqual(result.returncode, 0, result.stderr)
+                rows = result.stdout.splitlines()[1:]
+                self.assertEqual(len(rows), 20)
+
+
+class ScenarioTest(unittest.TestCase):
+    def run_scenario(self, scenario: str, configs: dict[str, tuple[str, dict]]):
+        for config, (keyboard, defines) in configs.items():
+            with self.subTest(config):
+                output = build.BUILD / keyboard / f"wl_test-{scenario}-{config}"
+                exe = build.build("wl_test", keyboard, True, defines, output)
+                result = subprocess.run(
+                    [str(exe), scenario], capture_output=True, text=True
+                )
+                self.assertEqual(result.returncode, 0, result.stderr)
+
+    def test_overflow(self):
+        # The changes made during a consolidation do not fit in the write log
+        small_log = {"WL_DOUBLE_BANK": None, "WL_WRITE_LOG_SIZE": 4096}
+        self.run_scenario(
+            "overflow", {"he60": ("he60", small_log), "he16": ("he16", small_log)}
+        )
+
+    def test_merge(self):
+        self.run_scenario("merge", SMALL_LOG_CONFIGS)
+
+    def test_dirty_overflow(self):
+        self.run_scenario("dirty_overflow", SMALL_LOG_CONFIGS)
+
+    def test_power_cut(self):
+        # The pending writes are lost, not torn
+        self.run_scenario("power_cut", SMALL_LOG_CONFIGS)
+
+    def test_legacy(self):
+        # The write log of an older firmware extends over the wear statistics
+        self.run_scenario("legacy", SMALL_LOG_CONFIGS)
+
+
+class PowerCutTest(unittest.TestCase):
+    def test_power_cut(self):
+        # The small write log consolidates every hundred writes or so
+        small_log = {"WL_WRITE_LOG_SIZE": 4096}
+        for config, (keyboard, defines) in CONFIGS.items():
+            with self.subTest(config):
+                output = build.BUILD / keyboard / f"wl_power_cut-{config}"
+                exe = build.build(
+                    "wl_power_cut", keyboard, True, {**defines, **small_log}, output
+                )
+                result = subprocess.run(
+                    [str(exe), "5000"], capture_output=True, text=True
+                )
+                self.assertEqual(result.returncode, 0, result.stderr)
+                header, row = result.stdout.splitlines()
+                stats = dict(zip(header.split(","), row.split(",")))
+                self.assertGreater(int(stats["power cuts"]), 0)
+                self.assertGreater(int(stats["consolidations"]), 0)
+                if "WL_DOUBLE_BANK" in defines:
+                    self.assertEqual(int(stats["cleared"]), 0)
+
+
+if __name__ == "__main__":
+    unittest.main()
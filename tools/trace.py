@@ -0,0 +1,210 @@
+# This program is free software: you can redistribute it and/or modify it under
+# the terms of the GNU General Public License as published by the Free Software
+# Foundation, either version 3 of the License, or (at your option) any later
+# version.
+#
+# This program is distributed in the hope that it will be useful, but WITHOUT
+# ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+# FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+# details.
+#
+# You should have received a copy of the GNU General Public License along with
+# this program. If not, see <https://www.gnu.org/licenses/>.
+
+
+# Recorder, encoder and decoder for the ADC input traces of
+# `COMMAND_TRACE_CAPTURE`. See `include/lib/trace.h` for the format.
+
+from pathlib import Path
+import argparse
+import csv
+import struct
+import time
+
+MAGIC = 0x52544548
+VERSION = 1
+
+HEADER = struct.Struct("<IBBH")
+
+RAW_HID_USAGE_PAGE = 0xFFAB
+RAW_HID_USAGE = 0xAB
+RAW_HID_EP_SIZE = 64
+
+COMMAND_TRACE_CAPTURE = 21
+
+
+def read_varint(data: bytes, pos: int) -> tuple[int, int]:
+    value = 0
+    for i in range(5):
+        if pos >= len(data):
+            raise ValueError("Truncated varint")
+        byte = data[pos]
+        pos += 1
+        value |= (byte & 0x7F) << (7 * i)
+        if not byte & 0x80:
+            return value, pos
+
+    raise ValueError("Varint is too long")
+
+
+def write_varint(value: int) -> bytes:
+    out = bytearray()
+    while value >= 0x80:
+        out.append((value & 0x7F) | 0x80)
+        value >>= 7
+    out.append(value)
+
+    return bytes(out)
+
+
+# Decode a trace into its ADC resolution and its frames. Each frame is a tuple
+# of the milliseconds since the previous frame and the ADC values of each key.
+# A truncated last frame is dropped.
+def decode(data: bytes) -> tuple[int, list[tuple[int, list[int]]]]:
+    magic, version, adc_resolution, num_keys = HEADER.unpack_from(data)
+    if magic != MAGIC or version != VERSION:
+        raise ValueError("Invalid trace header")
+
+    frames = []
+    values = [0] * num_keys
+    pos = HEADER.size
+    try:
+        while pos < len(data):
+            delta_time, pos = read_varint(data, pos)
+            new_values = []
+            for value in values:
+                zigzag, pos = read_varint(data, pos)
+                delta = (zigzag >> 1) ^ -(zigzag & 1)
+                new_values.append((value + delta) & 0xFFFF)
+            values = new_values
+            frames.append((delta_time, values))
+    except ValueError:
+        pass
+
+    return adc_resolution, frames
+
+
+def encode(adc_resolution: int, frames: list[tuple[int, list[int]]]) -> bytes:
+    num_keys = len(frames[0][1]) if frames else 0
+    out = bytearray(HEADER.pack(MAGIC, VERSION, adc_resolution, num_keys))
+
+    values = [0] * num_keys
+    for delta_time, new_values in frames:
+        if len(new_values) != num_keys:
+            raise ValueError("Inconsistent number of keys")
+        out += write_varint(delta_time)
+        for value, new_value in zip(values, new_values):
+            delta = new_value - value
+            out += write_varint((delta << 1) ^ (delta >> 31))
+        values = new_values
+
+    return bytes(out)
+
+
+# Reassemble a trace from the raw HID reports of `COMMAND_TRACE_CAPTURE`. The
+# replies to the command have no data, unlike the reports of the capture.
+def extract(reports: list[bytes]) -> bytes:
+    out = bytearray()
+    seq = None
+    for report in reports:
+        if report[0] != COMMAND_TRACE_CAPTURE or report[2] == 0:
+            continue
+        if seq is not None and report[1] != (seq + 1) & 0xFF:
+            raise ValueError(f"Lost reports after report {seq}")
+        seq = report[1]
+        out += report[3 : 3 + report[2]]
+
+    return bytes(out)
+
+
+def record(vid: int, pid: int, interval: int, duration: float) -> bytes:
+    # Requires the `hidapi` package
+    import hid
+
+    path = next(
+        (
+            d["path"]
+            for d in hid.enumerate(vid, pid)
+            if d["usage_page"] == RAW_HID_USAGE_PAGE and d["usage"] == RAW_HID_USAGE
+        ),
+        None,
+    )
+    if path is None:
+        raise RuntimeError("Raw HID interface not found")
+
+    device = hid.device()
+    device.open_path(path)
+    reports = []
+    try:
+        # Raw HID reports have no report ID, so a zero is prepended
+        device.write(bytes([0, COMMAND_TRACE_CAPTURE, interval]))
+        end = time.monotonic() + duration
+        while time.monotonic() < end:
+            report = device.read(RAW_HID_EP_SIZE, 100)
+            if report:
+                reports.append(bytes(report))
+    finally:
+        device.write(bytes([0, COMMAND_TRACE_CAPTURE, 0]))
+        device.close()
+
+    return extract(reports)
+
+
+if __name__ == "__main__":
+    parser = argparse.ArgumentParser()
+    subparsers = parser.add_subparsers(dest="mode", required=True)
+
+    record_parser = subparsers.add_parser("record", help="Record a trace")
+    record_parser.add_argument("output", type=Path, help="Output trace file")
+    record_parser.add_argument(
+        "--vid", type=lambda x: int(x, 0), required=True, help="USB vendor ID"
+    )
+    record_parser.add_argument(
+        "--pid", type=lambda x: int(x, 0), required=True, help="USB product ID"
+    )
+    record_parser.add_argument(
+        "-i", type=int, default=1, help="Interval between frames in milliseconds"
+    )
+    record_parser.add_argument(
+        "-d", type=float, default=10, help="Duration of the recording in seconds"
+    )
+
+    decode_parser = subparsers.add_parser("decode", help="Decode a trace to CSV")
+    decode_parser.add_argument("input", type=Path, help="Input trace file")
+    decode_parser.add_argument("output", type=Path, help="Output CSV file")
+
+    encode_parser = subparsers.add_parser("encode", help="Encode a trace from CSV")
+    encode_parser.add_argument("input", type=Path, help="Input CSV file")
+    encode_parser.add_argument("output", type=Path, help="Output trace file")
+    encode_parser.add_argument(
+        "-r", type=int, default=12, help="ADC resolution in bits"
+    )
+
+    args = parser.parse_args()
+
+    match args.mode:
+        case "record":
+            trace = record(args.vid, args.pid, args.i, args.d)
+            args.output.write_bytes(trace)
+            print(f"Recorded {len(decode(trace)[1])} frames ({len(trace)} bytes)")
+
+        case "decode":
+            _, frames = decode(args.input.read_bytes())
+            with open(args.output, "w", newline="") as f:
+                writer = csv.writer(f)
+                timestamp = 0
+                for delta_time, values in frames:
+                    timestamp += delta_time
+                    writer.writerow([timestamp] + values)
+
+        case "encode":
+            frames = []
+            with open(args.input, "r", newline="") as f:
+                last_timestamp = 0
+                for row in csv.reader(f):
+                    timestamp = int(row[0])
+                    frames.append(
+                        (timestamp - last_timestamp, [int(x) for x in row[1:]])
+                    )
+                    last_timestamp = timestamp
+            args.output.write_bytes(encode(args.r, frames))
@@ -0,0 +1,124 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "trace_replay.h"
+
+#include <stdio.h>
+
+#include "hardware/hardware.h"
+#include "lib/trace.h"
+
+// Replay state
+static struct {
+  // Trace file contents
+  uint8_t *data;
+  // Length of the trace in bytes
+  uint32_t len;
+  // Position of the next frame in the trace
+  uint32_t pos;
+  // Time of the current frame in milliseconds
+  uint32_t time;
+  // ADC values of each key in the current frame
+  uint16_t adc_values[NUM_KEYS];
+} replay;
+
+bool trace_replay_open(const char *path) {
+  FILE *f = fopen(path, "rb");
+  trace_header_t header;
+
+  trace_replay_close();
+  if (f == NULL)
+    return false;
+
+  if (fseek(f, 0, SEEK_END) == 0) {
+    const long len = ftell(f);
+
+    if (len > 0 && (replay.data = malloc((size_t)len)) != NULL) {
+      rewind(f);
+      replay.len = (uint32_t)fread(replay.data, 1, (size_t)len, f);
+    }
+  }
+  fclose(f);
+
+  if (replay.len < sizeof(header)) {
+    trace_replay_close();
+    return false;
+  }
+
+  memcpy(&header, replay.data, sizeof(header));
+  if (header.magic != TRACE_MAGIC || header.version != TRACE_VERSION ||
+      header.adc_resolution != ADC_RESOLUTION || header.num_keys != NUM_KEYS) {
+    trace_replay_close();
+    return false;
+  }
+  replay.pos = sizeof(header);
+
+  return true;
+}
+
+bool trace_replay_next_frame(void) { return replay.pos < replay.len; }
+
+void trace_replay_close(void) {
+  free(replay.data);
+  memset(&replay, 0, sizeof(replay));
+}
+
+//--------------------------------------------------------------------+
+// Analog API
+//--------------------------------------------------------------------+
+
+void analog_init(void) {}
+
+void analog_task(void) {
+  uint32_t pos = replay.pos;
+  uint32_t delta_time;
+  uint16_t adc_values[NUM_KEYS];
+
+  memcpy(adc_values, replay.adc_values, sizeof(adc_values));
+  bool success =
+      trace_decode_varint(replay.data, replay.len, &pos, &delta_time);
+  for (uint32_t i = 0; success && i < NUM_KEYS; i++)
+    success =
+        trace_decode_sample(replay.data, replay.len, &pos, &adc_values[i]);
+
+  if (!success) {
+    // A truncated frame at the end of the trace is discarded, and the last
+    // complete frame is repeated.
+    replay.pos = replay.len;
+    return;
+  }
+
+  replay.pos = pos;
+  replay.time += delta_time;
+  memcpy(replay.adc_values, adc_values, sizeof(adc_values));
+}
+
+uint16_t analog_read(uint8_t key) {
+  return key < NUM_KEYS ? replay.adc_values[key] : 0;
+}
+
+// Each call to `analog_task()` replays a complete frame, so the conversion loop
+// cannot be paused.
+void analog_set_continuous(bool continuous) { (void)continuous; }
+
+void analog_start_sweep(void) {}
+
+//--------------------------------------------------------------------+
+// Timer API
+//--------------------------------------------------------------------+
+
+void timer_init(void) {}
+
+uint32_t timer_read(void) { return replay.time; }
@@ -0,0 +1,64 @@
+/*
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS
+ * FOR A PARTICULAR PURPOSE. See the GNU General Public License for more
+ * details.
+ *
+ * You should have received a copy of the GNU General Public License along with
+ * this program. If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "common.h"
+
+//--------------------------------------------------------------------+
+// Trace Replay Driver
+//
+// Host implementation of the analog and timer APIs that replays a trace
+// recorded with `tools/trace.py record`. Each call to `analog_task()` advances
+// the replay by one frame, and `timer_read()` returns the time of the current
+// frame. A host harness compiles it together with the core modules, e.g.
+//
+//   trace_replay_open("session.trace");
+//   matrix_init();
+//   while (trace_replay_next_frame()) {
+//     analog_task();
+//     matrix_scan();
+//     layout_task();
+//   }
+//
+// `tools/host/trace_replay_run.c` is such a harness, which replays the sample
+// traces in `samples/` in the tests.
+//--------------------------------------------------------------------+
+
+/**
+ * @brief Open a trace for replay
+ *
+ * The number of keys and the ADC resolution of the trace must match the
+ * keyboard configuration the harness is compiled with.
+ *
+ * @param path Path to the trace file
+ *
+ * @return true if successful, false otherwise
+ */
+bool trace_replay_open(const char *path);
+
+/**
+ * @brief Check whether there is a frame left to replay
+ *
+ * @return true if there is a frame left, false otherwise
+ */
+bool trace_replay_next_frame(void);
+
+/**
+ * @brief Close the trace
+ *
+ * @return None
+ */
+void trace_replay_close(void);